@@ -75,6 +75,12 @@ typedef enum IotNetworkError
  * @function_brief{platform_network_function_close}
  * - @function_name{platform_network_function_destroy}
  * @function_brief{platform_network_function_destroy}
+ * - @function_name{platform_network_function_receivebuffer}
+ * @function_brief{platform_network_function_receivebuffer}
+ * - @function_name{platform_network_function_releasebuffer}
+ * @function_brief{platform_network_function_releasebuffer}
+ * - @function_name{platform_network_function_sendvector}
+ * @function_brief{platform_network_function_sendvector}
  * - @function_name{platform_network_function_receivecallback}
  * @function_brief{platform_network_function_receivecallback}
  */
@@ -101,6 +107,15 @@ typedef enum IotNetworkError
  * @function_page{IotNetworkInterface_t::destroy,platform_network,destroy}
  * @function_snippet{platform_network,destroy,this}
  * @copydoc IotNetworkInterface_t::destroy
+ * @function_page{IotNetworkInterface_t::receiveBuffer,platform_network,receivebuffer}
+ * @function_snippet{platform_network,receivebuffer,this}
+ * @copydoc IotNetworkInterface_t::receiveBuffer
+ * @function_page{IotNetworkInterface_t::releaseBuffer,platform_network,releasebuffer}
+ * @function_snippet{platform_network,releasebuffer,this}
+ * @copydoc IotNetworkInterface_t::releaseBuffer
+ * @function_page{IotNetworkInterface_t::sendVector,platform_network,sendvector}
+ * @function_snippet{platform_network,sendvector,this}
+ * @copydoc IotNetworkInterface_t::sendVector
  * @function_page{IotNetworkReceiveCallback_t,platform_network,receivecallback}
  * @function_snippet{platform_network,receivecallback,this}
  * @copydoc IotNetworkReceiveCallback_t
@@ -121,6 +136,16 @@ typedef void ( * IotNetworkReceiveCallback_t )( void * pConnection,
                                                 void * pContext );
 /* @[declare_platform_network_receivecallback] */
 
+/**
+ * @ingroup platform_datatypes_paramstructs
+ * @brief One contiguous piece of a message sent with @ref platform_network_function_sendvector.
+ */
+typedef struct IotNetworkBuffer
+{
+    const uint8_t * pBuffer; /**< @brief Start of the data to send. */
+    size_t length;           /**< @brief Length of #IotNetworkBuffer_t.pBuffer. */
+} IotNetworkBuffer_t;
+
 /**
  * @ingroup platform_datatypes_paramstructs
  * @brief Represents the functions of a network stack.
@@ -281,6 +306,77 @@ typedef struct IotNetworkInterface
     /* @[declare_platform_network_destroy] */
     IotNetworkError_t ( * destroy )( void * pConnection );
     /* @[declare_platform_network_destroy] */
+
+    /**
+     * @brief Block and wait for incoming network data, lending it in place.
+     *
+     * Wait for a message of size `bytesRequested` to arrive on the network and
+     * return a pointer to it in the network stack's own storage (such as a
+     * receive ring buffer or a pooled segment) instead of copying it. The data
+     * stays valid and unmodified until it is given back with
+     * @ref platform_network_function_releasebuffer.
+     *
+     * This function is optional and may be `NULL`. It may also return `NULL`
+     * without consuming any data when the message cannot be lent, e.g. because
+     * it is not contiguous or no lending storage is free; the caller then reads
+     * the message with @ref platform_network_function_receive.
+     *
+     * @param[in] pConnection The connection to wait on, defined by the network
+     * stack.
+     * @param[in] bytesRequested How many bytes to wait for.
+     *
+     * @return `bytesRequested` bytes of incoming data; `NULL` if the data was
+     * not lent.
+     *
+     * @note Lent buffers may be outstanding when the connection is closed.
+     * The MQTT library gives them back before it destroys a connection that it
+     * created. A connection created by the application may still have lent
+     * buffers outstanding after `IotMqtt_Disconnect` returns, e.g. for messages
+     * retained by subscription callbacks; it must not be destroyed until they
+     * are given back.
+     */
+    /* @[declare_platform_network_receivebuffer] */
+    uint8_t * ( * receiveBuffer )( void * pConnection,
+                                   size_t bytesRequested );
+    /* @[declare_platform_network_receivebuffer] */
+
+    /**
+     * @brief Give back data lent by @ref platform_network_function_receivebuffer.
+     *
+     * Must be set if @ref platform_network_function_receivebuffer is set. This
+     * function may be called from any thread.
+     *
+     * @param[in] pConnection The connection that lent `pBuffer`.
+     * @param[in] pBuffer A value returned by @ref platform_network_function_receivebuffer.
+     */
+    /* @[declare_platform_network_releasebuffer] */
+    void ( * releaseBuffer )( void * pConnection,
+                              uint8_t * pBuffer );
+    /* @[declare_platform_network_releasebuffer] */
+
+    /**
+     * @brief Send a message gathered from several buffers.
+     *
+     * Attempts to transmit the `bufferCount` buffers of `pBuffers`, in order,
+     * as one message across the connection represented by `pConnection`, in the
+     * manner of `writev`. The buffers are only read during this call. Returns
+     * the total number of bytes actually sent, `0` on failure.
+     *
+     * This function is optional and may be `NULL`, in which case each buffer is
+     * sent with @ref platform_network_function_send.
+     *
+     * @param[in] pConnection The connection used to send data, defined by the
+     * network stack.
+     * @param[in] pBuffers The buffers to send.
+     * @param[in] bufferCount The number of entries in `pBuffers`.
+     *
+     * @return The number of bytes successfully sent, `0` on failure.
+     */
+    /* @[declare_platform_network_sendvector] */
+    size_t ( * sendVector )( void * pConnection,
+                             const IotNetworkBuffer_t * pBuffers,
+                             size_t bufferCount );
+    /* @[declare_platform_network_sendvector] */
 } IotNetworkInterface_t;
 
 /**
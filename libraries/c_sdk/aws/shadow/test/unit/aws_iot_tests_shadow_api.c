@@ -592,8 +592,7 @@ static IotMqttError_t _setContext( IotMqttConnection_t pMqttConnection )
         /* Fill the values for network buffer. */
         networkBuffer.pBuffer = &( connToContext[ contextIndex ].buffer[ 0 ] );
         networkBuffer.size = NETWORK_BUFFER_SIZE;
-        subscriptionMutexCreated = IotMutex_CreateNonRecursiveMutex( &( connToContext[ contextIndex ].subscriptionMutex ),
-                                                                     &( connToContext[ contextIndex ].subscriptionMutexStorage ) );
+        subscriptionMutexCreated = _IotMqtt_CreateSubscriptionLocks( contextIndex );
 
         if( subscriptionMutexCreated == false )
         {
@@ -0,0 +1,1556 @@
+/*
+ * FreeRTOS Common V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_indexed_containers.h
+ * @brief Declares and implements intrusive hash tables and red-black trees.
+ *
+ * Like the linear containers, the indexed containers never allocate memory.
+ * Elements embed an #IotHashLink_t or #IotTreeLink_t member, and the macro
+ * #IotLink_Container may be used to calculate the starting address of the
+ * link's container.
+ */
+
+#ifndef IOT_INDEXED_CONTAINERS_H_
+#define IOT_INDEXED_CONTAINERS_H_
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Linear containers include, for IotLink_Container and IotContainers_Assert. */
+#include "iot_linear_containers.h"
+
+/**
+ * @defgroup indexed_containers_datatypes_hashtree Hash table and tree
+ * @brief Structures that represent a hash table or a red-black tree.
+ */
+
+/**
+ * @ingroup indexed_containers_datatypes_hashtree
+ * @brief Link member placed in structs of a hash table.
+ *
+ * All elements in a hash table must contain one of these members.
+ */
+typedef struct IotHashLink
+{
+    struct IotHashLink * pNext;       /**< @brief Pointer to the next element of the same bucket. */
+    struct IotHashLink ** ppPrevious; /**< @brief Pointer to the pointer referencing this element. */
+    uint32_t hash;                    /**< @brief Hash of the element's key. */
+} IotHashLink_t;
+
+/**
+ * @ingroup indexed_containers_datatypes_hashtree
+ * @brief Represents a hash table.
+ *
+ * The buckets of a hash table are provided by its user, so a hash table has a
+ * fixed number of buckets.
+ */
+typedef struct IotHashTable
+{
+    IotHashLink_t ** pBuckets; /**< @brief Array of bucket heads. */
+    size_t bucketCount;        /**< @brief Number of buckets; always a power of 2. */
+    size_t count;              /**< @brief Number of elements in the hash table. */
+} IotHashTable_t;
+
+/**
+ * @ingroup indexed_containers_datatypes_hashtree
+ * @brief Link member placed in structs of a red-black tree.
+ *
+ * All elements in a red-black tree must contain one of these members.
+ */
+typedef struct IotTreeLink
+{
+    struct IotTreeLink * pParent; /**< @brief Pointer to the parent element. */
+    struct IotTreeLink * pLeft;   /**< @brief Pointer to the left child. */
+    struct IotTreeLink * pRight;  /**< @brief Pointer to the right child. */
+    uint8_t color;                /**< @brief Color of the element; zero when not linked. */
+} IotTreeLink_t;
+
+/**
+ * @ingroup indexed_containers_datatypes_hashtree
+ * @brief Represents a red-black tree.
+ */
+typedef struct IotTree
+{
+    IotTreeLink_t * pRoot; /**< @brief The root element of the tree. */
+    size_t count;          /**< @brief Number of elements in the tree. */
+} IotTree_t;
+
+/**
+ * @constants_page{indexed_containers}
+ * @constants_brief{indexed containers library}
+ *
+ * @section indexed_containers_constants_initializers Indexed Containers Initializers
+ * @brief Provides default values for initializing the indexed containers data types.
+ *
+ * @snippet this define_indexed_containers_initializers
+ *
+ * All user-facing data types of the indexed containers library should be initialized
+ * using one of the following.
+ *
+ * @warning Failure to initialize an indexed containers data type with the appropriate
+ * initializer may result in a runtime error!
+ * @note The initializers may change at any time in future versions, but their
+ * names will remain the same.
+ */
+/* @[define_indexed_containers_initializers] */
+#define IOT_HASH_LINK_INITIALIZER     { 0 } /**< @brief Initializer for an #IotHashLink_t. */
+#define IOT_HASH_TABLE_INITIALIZER    { 0 } /**< @brief Initializer for an #IotHashTable_t. */
+#define IOT_TREE_LINK_INITIALIZER     { 0 } /**< @brief Initializer for an #IotTreeLink_t. */
+#define IOT_TREE_INITIALIZER          { 0 } /**< @brief Initializer for an #IotTree_t. */
+/* @[define_indexed_containers_initializers] */
+
+/**
+ * @brief Color of a red element of a red-black tree.
+ */
+#define IOT_TREE_RED      ( ( uint8_t ) 1 )
+
+/**
+ * @brief Color of a black element of a red-black tree.
+ */
+#define IOT_TREE_BLACK    ( ( uint8_t ) 2 )
+
+/**
+ * @brief Iterates through all elements of a red-black tree in ascending order.
+ *
+ * Tree elements must not be freed or removed while iterating.
+ *
+ * @param[in] pTree The tree to iterate.
+ * @param[out] pLink Pointer to a tree element.
+ */
+#define IotTree_ForEach( pTree, pLink )         \
+    for( ( pLink ) = IotTree_First( pTree );    \
+         ( pLink ) != NULL;                     \
+         ( pLink ) = IotTree_Next( pLink ) )
+
+/**
+ * @functions_page{indexed_containers, Indexed Containers}
+ * @functions_brief{indexed containers}
+ * - @function_name{indexed_containers_function_hash_string}
+ * @function_brief{indexed_containers_function_hash_string}
+ * - @function_name{indexed_containers_function_hash_uint32}
+ * @function_brief{indexed_containers_function_hash_uint32}
+ * - @function_name{indexed_containers_function_hash_link_islinked}
+ * @function_brief{indexed_containers_function_hash_link_islinked}
+ * - @function_name{indexed_containers_function_hash_table_create}
+ * @function_brief{indexed_containers_function_hash_table_create}
+ * - @function_name{indexed_containers_function_hash_table_count}
+ * @function_brief{indexed_containers_function_hash_table_count}
+ * - @function_name{indexed_containers_function_hash_table_insert}
+ * @function_brief{indexed_containers_function_hash_table_insert}
+ * - @function_name{indexed_containers_function_hash_table_findfirstmatch}
+ * @function_brief{indexed_containers_function_hash_table_findfirstmatch}
+ * - @function_name{indexed_containers_function_hash_table_findnextmatch}
+ * @function_brief{indexed_containers_function_hash_table_findnextmatch}
+ * - @function_name{indexed_containers_function_hash_table_remove}
+ * @function_brief{indexed_containers_function_hash_table_remove}
+ * - @function_name{indexed_containers_function_hash_table_removefirstmatch}
+ * @function_brief{indexed_containers_function_hash_table_removefirstmatch}
+ * - @function_name{indexed_containers_function_hash_table_removeall}
+ * @function_brief{indexed_containers_function_hash_table_removeall}
+ * - @function_name{indexed_containers_function_hash_table_first}
+ * @function_brief{indexed_containers_function_hash_table_first}
+ * - @function_name{indexed_containers_function_hash_table_next}
+ * @function_brief{indexed_containers_function_hash_table_next}
+ * - @function_name{indexed_containers_function_tree_link_islinked}
+ * @function_brief{indexed_containers_function_tree_link_islinked}
+ * - @function_name{indexed_containers_function_tree_create}
+ * @function_brief{indexed_containers_function_tree_create}
+ * - @function_name{indexed_containers_function_tree_count}
+ * @function_brief{indexed_containers_function_tree_count}
+ * - @function_name{indexed_containers_function_tree_isempty}
+ * @function_brief{indexed_containers_function_tree_isempty}
+ * - @function_name{indexed_containers_function_tree_first}
+ * @function_brief{indexed_containers_function_tree_first}
+ * - @function_name{indexed_containers_function_tree_last}
+ * @function_brief{indexed_containers_function_tree_last}
+ * - @function_name{indexed_containers_function_tree_next}
+ * @function_brief{indexed_containers_function_tree_next}
+ * - @function_name{indexed_containers_function_tree_previous}
+ * @function_brief{indexed_containers_function_tree_previous}
+ * - @function_name{indexed_containers_function_tree_insert}
+ * @function_brief{indexed_containers_function_tree_insert}
+ * - @function_name{indexed_containers_function_tree_find}
+ * @function_brief{indexed_containers_function_tree_find}
+ * - @function_name{indexed_containers_function_tree_lowerbound}
+ * @function_brief{indexed_containers_function_tree_lowerbound}
+ * - @function_name{indexed_containers_function_tree_remove}
+ * @function_brief{indexed_containers_function_tree_remove}
+ * - @function_name{indexed_containers_function_tree_removefirstmatch}
+ * @function_brief{indexed_containers_function_tree_removefirstmatch}
+ * - @function_name{indexed_containers_function_tree_removeall}
+ * @function_brief{indexed_containers_function_tree_removeall}
+ */
+
+/**
+ * @function_page{IotHash_String,indexed_containers,hash_string}
+ * @function_snippet{indexed_containers,hash_string,this}
+ * @copydoc IotHash_String
+ * @function_page{IotHash_Uint32,indexed_containers,hash_uint32}
+ * @function_snippet{indexed_containers,hash_uint32,this}
+ * @copydoc IotHash_Uint32
+ * @function_page{IotHashLink_IsLinked,indexed_containers,hash_link_islinked}
+ * @function_snippet{indexed_containers,hash_link_islinked,this}
+ * @copydoc IotHashLink_IsLinked
+ * @function_page{IotHashTable_Create,indexed_containers,hash_table_create}
+ * @function_snippet{indexed_containers,hash_table_create,this}
+ * @copydoc IotHashTable_Create
+ * @function_page{IotHashTable_Count,indexed_containers,hash_table_count}
+ * @function_snippet{indexed_containers,hash_table_count,this}
+ * @copydoc IotHashTable_Count
+ * @function_page{IotHashTable_Insert,indexed_containers,hash_table_insert}
+ * @function_snippet{indexed_containers,hash_table_insert,this}
+ * @copydoc IotHashTable_Insert
+ * @function_page{IotHashTable_FindFirstMatch,indexed_containers,hash_table_findfirstmatch}
+ * @function_snippet{indexed_containers,hash_table_findfirstmatch,this}
+ * @copydoc IotHashTable_FindFirstMatch
+ * @function_page{IotHashTable_FindNextMatch,indexed_containers,hash_table_findnextmatch}
+ * @function_snippet{indexed_containers,hash_table_findnextmatch,this}
+ * @copydoc IotHashTable_FindNextMatch
+ * @function_page{IotHashTable_Remove,indexed_containers,hash_table_remove}
+ * @function_snippet{indexed_containers,hash_table_remove,this}
+ * @copydoc IotHashTable_Remove
+ * @function_page{IotHashTable_RemoveFirstMatch,indexed_containers,hash_table_removefirstmatch}
+ * @function_snippet{indexed_containers,hash_table_removefirstmatch,this}
+ * @copydoc IotHashTable_RemoveFirstMatch
+ * @function_page{IotHashTable_RemoveAll,indexed_containers,hash_table_removeall}
+ * @function_snippet{indexed_containers,hash_table_removeall,this}
+ * @copydoc IotHashTable_RemoveAll
+ * @function_page{IotHashTable_First,indexed_containers,hash_table_first}
+ * @function_snippet{indexed_containers,hash_table_first,this}
+ * @copydoc IotHashTable_First
+ * @function_page{IotHashTable_Next,indexed_containers,hash_table_next}
+ * @function_snippet{indexed_containers,hash_table_next,this}
+ * @copydoc IotHashTable_Next
+ * @function_page{IotTreeLink_IsLinked,indexed_containers,tree_link_islinked}
+ * @function_snippet{indexed_containers,tree_link_islinked,this}
+ * @copydoc IotTreeLink_IsLinked
+ * @function_page{IotTree_Create,indexed_containers,tree_create}
+ * @function_snippet{indexed_containers,tree_create,this}
+ * @copydoc IotTree_Create
+ * @function_page{IotTree_Count,indexed_containers,tree_count}
+ * @function_snippet{indexed_containers,tree_count,this}
+ * @copydoc IotTree_Count
+ * @function_page{IotTree_IsEmpty,indexed_containers,tree_isempty}
+ * @function_snippet{indexed_containers,tree_isempty,this}
+ * @copydoc IotTree_IsEmpty
+ * @function_page{IotTree_First,indexed_containers,tree_first}
+ * @function_snippet{indexed_containers,tree_first,this}
+ * @copydoc IotTree_First
+ * @function_page{IotTree_Last,indexed_containers,tree_last}
+ * @function_snippet{indexed_containers,tree_last,this}
+ * @copydoc IotTree_Last
+ * @function_page{IotTree_Next,indexed_containers,tree_next}
+ * @function_snippet{indexed_containers,tree_next,this}
+ * @copydoc IotTree_Next
+ * @function_page{IotTree_Previous,indexed_containers,tree_previous}
+ * @function_snippet{indexed_containers,tree_previous,this}
+ * @copydoc IotTree_Previous
+ * @function_page{IotTree_Insert,indexed_containers,tree_insert}
+ * @function_snippet{indexed_containers,tree_insert,this}
+ * @copydoc IotTree_Insert
+ * @function_page{IotTree_Find,indexed_containers,tree_find}
+ * @function_snippet{indexed_containers,tree_find,this}
+ * @copydoc IotTree_Find
+ * @function_page{IotTree_LowerBound,indexed_containers,tree_lowerbound}
+ * @function_snippet{indexed_containers,tree_lowerbound,this}
+ * @copydoc IotTree_LowerBound
+ * @function_page{IotTree_Remove,indexed_containers,tree_remove}
+ * @function_snippet{indexed_containers,tree_remove,this}
+ * @copydoc IotTree_Remove
+ * @function_page{IotTree_RemoveFirstMatch,indexed_containers,tree_removefirstmatch}
+ * @function_snippet{indexed_containers,tree_removefirstmatch,this}
+ * @copydoc IotTree_RemoveFirstMatch
+ * @function_page{IotTree_RemoveAll,indexed_containers,tree_removeall}
+ * @function_snippet{indexed_containers,tree_removeall,this}
+ * @copydoc IotTree_RemoveAll
+ */
+
+/**
+ * @brief Calculate the 32-bit FNV-1a hash of a buffer.
+ *
+ * @param[in] pBuffer The buffer to hash, e.g. a string key.
+ * @param[in] length Length of `pBuffer`.
+ *
+ * @return The hash of `pBuffer`.
+ */
+/* @[declare_indexed_containers_hash_string] */
+static inline uint32_t IotHash_String( const char * pBuffer,
+                                       size_t length )
+/* @[declare_indexed_containers_hash_string] */
+{
+    size_t i = 0;
+    uint32_t hash = 2166136261UL;
+
+    /* This function must not be called with a NULL buffer. */
+    IotContainers_Assert( ( pBuffer != NULL ) || ( length == 0 ) );
+
+    for( i = 0; i < length; i++ )
+    {
+        hash ^= ( uint32_t ) ( uint8_t ) pBuffer[ i ];
+        hash *= 16777619UL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Calculate the hash of a 32-bit integer key.
+ *
+ * Integer keys such as packet identifiers are rarely uniformly distributed in
+ * their low bits, so they are mixed before selecting a bucket.
+ *
+ * @param[in] key The key to hash.
+ *
+ * @return The hash of `key`.
+ */
+/* @[declare_indexed_containers_hash_uint32] */
+static inline uint32_t IotHash_Uint32( uint32_t key )
+/* @[declare_indexed_containers_hash_uint32] */
+{
+    uint32_t hash = key;
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bUL;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35UL;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+/**
+ * @brief Check if an #IotHashLink_t is linked in a hash table.
+ *
+ * @param[in] pLink The link to check.
+ *
+ * @return `true` if `pLink` is linked in a hash table; `false` otherwise.
+ */
+/* @[declare_indexed_containers_hash_link_islinked] */
+static inline bool IotHashLink_IsLinked( const IotHashLink_t * const pLink )
+/* @[declare_indexed_containers_hash_link_islinked] */
+{
+    bool isLinked = false;
+
+    if( pLink != NULL )
+    {
+        isLinked = ( pLink->ppPrevious != NULL );
+    }
+
+    return isLinked;
+}
+
+/**
+ * @brief Create a new hash table.
+ *
+ * This function initializes a new hash table. It must be called on an
+ * uninitialized #IotHashTable_t before calling any other hash table function.
+ *
+ * This function will not fail. The function @ref indexed_containers_function_hash_table_removeall
+ * may be called to destroy a hash table.
+ *
+ * @param[in] pTable Pointer to the memory that will hold the new hash table.
+ * @param[in] pBuckets Array of bucket heads, which must remain valid for the
+ * lifetime of the hash table.
+ * @param[in] bucketCount Number of elements of `pBuckets`. Must be a power of 2.
+ */
+/* @[declare_indexed_containers_hash_table_create] */
+static inline void IotHashTable_Create( IotHashTable_t * const pTable,
+                                        IotHashLink_t ** pBuckets,
+                                        size_t bucketCount )
+/* @[declare_indexed_containers_hash_table_create] */
+{
+    size_t i = 0;
+
+    /* This function must not be called with NULL parameters. */
+    IotContainers_Assert( pTable != NULL );
+    IotContainers_Assert( pBuckets != NULL );
+
+    /* The bucket of a hash is selected with a mask. */
+    IotContainers_Assert( bucketCount > 0 );
+    IotContainers_Assert( ( bucketCount & ( bucketCount - 1 ) ) == 0 );
+
+    for( i = 0; i < bucketCount; i++ )
+    {
+        pBuckets[ i ] = NULL;
+    }
+
+    pTable->pBuckets = pBuckets;
+    pTable->bucketCount = bucketCount;
+    pTable->count = 0;
+}
+
+/**
+ * @brief Return the number of elements contained in an #IotHashTable_t.
+ *
+ * @param[in] pTable The hash table with the elements to count.
+ *
+ * @return The number of elements in the hash table.
+ */
+/* @[declare_indexed_containers_hash_table_count] */
+static inline size_t IotHashTable_Count( const IotHashTable_t * const pTable )
+/* @[declare_indexed_containers_hash_table_count] */
+{
+    size_t count = 0;
+
+    if( pTable != NULL )
+    {
+        count = pTable->count;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Insert an element in a hash table.
+ *
+ * Elements with equal keys may be inserted; they are found in the reverse order
+ * of their insertion.
+ *
+ * @param[in] pTable The hash table that will hold the new element.
+ * @param[in] pLink Pointer to the new element's link member.
+ * @param[in] hash Hash of the new element's key.
+ */
+/* @[declare_indexed_containers_hash_table_insert] */
+static inline void IotHashTable_Insert( IotHashTable_t * const pTable,
+                                        IotHashLink_t * const pLink,
+                                        uint32_t hash )
+/* @[declare_indexed_containers_hash_table_insert] */
+{
+    IotHashLink_t ** ppBucket = NULL;
+
+    /* This function must not be called with NULL parameters. */
+    IotContainers_Assert( pTable != NULL );
+    IotContainers_Assert( pLink != NULL );
+
+    /* This function must not be called on a linked element. */
+    IotContainers_Assert( IotHashLink_IsLinked( pLink ) == false );
+
+    ppBucket = &( pTable->pBuckets[ hash & ( pTable->bucketCount - 1 ) ] );
+
+    /* Place the new element at the head of its bucket. */
+    pLink->hash = hash;
+    pLink->pNext = *ppBucket;
+    pLink->ppPrevious = ppBucket;
+
+    if( *ppBucket != NULL )
+    {
+        ( *ppBucket )->ppPrevious = &( pLink->pNext );
+    }
+
+    *ppBucket = pLink;
+    pTable->count++;
+}
+
+/**
+ * @brief Search the bucket chain starting at an element for a match.
+ *
+ * @param[in] pStart The first element of the chain to check.
+ * @param[in] hash Hash of the key to find.
+ * @param[in] isMatch Function to determine if an element matches.
+ * @param[in] pMatch Passed as the second argument to `isMatch`.
+ *
+ * @return The first matching element; `NULL` if no match is found.
+ */
+static inline IotHashLink_t * _IotHashTable_SearchChain( IotHashLink_t * pStart,
+                                                         uint32_t hash,
+                                                         bool ( * isMatch )( const IotHashLink_t * const, void * ),
+                                                         void * pMatch )
+{
+    IotHashLink_t * pCurrent = pStart;
+
+    while( pCurrent != NULL )
+    {
+        /* Comparing the full hashes first avoids most calls to isMatch. */
+        if( pCurrent->hash == hash )
+        {
+            if( ( isMatch == NULL ) || ( isMatch( pCurrent, pMatch ) == true ) )
+            {
+                break;
+            }
+        }
+
+        pCurrent = pCurrent->pNext;
+    }
+
+    return pCurrent;
+}
+
+/**
+ * @brief Search a hash table for the first matching element.
+ *
+ * Only the bucket of `hash` is searched, so the cost of this function does not
+ * depend on the number of elements when the hash function spreads keys well.
+ *
+ * @param[in] pTable The hash table to search.
+ * @param[in] hash Hash of the key to find.
+ * @param[in] isMatch Function to determine if an element with hash `hash`
+ * matches. Pass `NULL` to match any element with hash `hash`.
+ * @param[in] pMatch Passed as the second argument to `isMatch`.
+ *
+ * @return Pointer to an #IotHashLink_t representing the first matched element;
+ * `NULL` if no match is found. The macro #IotLink_Container may be used to
+ * determine the address of the link's container.
+ */
+/* @[declare_indexed_containers_hash_table_findfirstmatch] */
+static inline IotHashLink_t * IotHashTable_FindFirstMatch( const IotHashTable_t * const pTable,
+                                                           uint32_t hash,
+                                                           bool ( * isMatch )( const IotHashLink_t * const, void * ),
+                                                           void * pMatch )
+/* @[declare_indexed_containers_hash_table_findfirstmatch] */
+{
+    /* This function must not be called with a NULL table. */
+    IotContainers_Assert( pTable != NULL );
+
+    return _IotHashTable_SearchChain( pTable->pBuckets[ hash & ( pTable->bucketCount - 1 ) ],
+                                      hash,
+                                      isMatch,
+                                      pMatch );
+}
+
+/**
+ * @brief Search a hash table for the next element matching the same key as a
+ * previous match.
+ *
+ * @param[in] pPrevious A match previously returned by @ref indexed_containers_function_hash_table_findfirstmatch
+ * or this function.
+ * @param[in] isMatch Function to determine if an element matches. Pass `NULL` to
+ * match any element with the hash of `pPrevious`.
+ * @param[in] pMatch Passed as the second argument to `isMatch`.
+ *
+ * @return Pointer to an #IotHashLink_t representing the next matched element;
+ * `NULL` if no further match is found.
+ */
+/* @[declare_indexed_containers_hash_table_findnextmatch] */
+static inline IotHashLink_t * IotHashTable_FindNextMatch( const IotHashLink_t * const pPrevious,
+                                                          bool ( * isMatch )( const IotHashLink_t * const, void * ),
+                                                          void * pMatch )
+/* @[declare_indexed_containers_hash_table_findnextmatch] */
+{
+    /* This function must be called on a linked element. */
+    IotContainers_Assert( IotHashLink_IsLinked( pPrevious ) == true );
+
+    return _IotHashTable_SearchChain( pPrevious->pNext,
+                                      pPrevious->hash,
+                                      isMatch,
+                                      pMatch );
+}
+
+/**
+ * @brief Remove a single element from a hash table.
+ *
+ * This function runs in constant time.
+ *
+ * @param[in] pTable The hash table that holds the element to remove.
+ * @param[in] pLink The element to remove.
+ */
+/* @[declare_indexed_containers_hash_table_remove] */
+static inline void IotHashTable_Remove( IotHashTable_t * const pTable,
+                                        IotHashLink_t * const pLink )
+/* @[declare_indexed_containers_hash_table_remove] */
+{
+    /* This function must not be called with NULL parameters. */
+    IotContainers_Assert( pTable != NULL );
+    IotContainers_Assert( pLink != NULL );
+
+    /* This function must be called on a linked element. */
+    IotContainers_Assert( IotHashLink_IsLinked( pLink ) == true );
+    IotContainers_Assert( pTable->count > 0 );
+
+    *( pLink->ppPrevious ) = pLink->pNext;
+
+    if( pLink->pNext != NULL )
+    {
+        pLink->pNext->ppPrevious = pLink->ppPrevious;
+    }
+
+    pLink->pNext = NULL;
+    pLink->ppPrevious = NULL;
+    pTable->count--;
+}
+
+/**
+ * @brief Remove the first matching element from a hash table.
+ *
+ * @param[in] pTable The hash table to search.
+ * @param[in] hash Hash of the key to find.
+ * @param[in] isMatch Function to determine if an element with hash `hash`
+ * matches. Pass `NULL` to match any element with hash `hash`.
+ * @param[in] pMatch Passed as the second argument to `isMatch`.
+ *
+ * @return Pointer to an #IotHashLink_t representing the removed element; `NULL`
+ * if no element was found. The macro #IotLink_Container may be used to determine
+ * the address of the link's container.
+ */
+/* @[declare_indexed_containers_hash_table_removefirstmatch] */
+static inline IotHashLink_t * IotHashTable_RemoveFirstMatch( IotHashTable_t * const pTable,
+                                                             uint32_t hash,
+                                                             bool ( * isMatch )( const IotHashLink_t * const, void * ),
+                                                             void * pMatch )
+/* @[declare_indexed_containers_hash_table_removefirstmatch] */
+{
+    IotHashLink_t * pMatchedElement = IotHashTable_FindFirstMatch( pTable,
+                                                                   hash,
+                                                                   isMatch,
+                                                                   pMatch );
+
+    if( pMatchedElement != NULL )
+    {
+        IotHashTable_Remove( pTable, pMatchedElement );
+    }
+
+    return pMatchedElement;
+}
+
+/**
+ * @brief Remove all elements in a hash table.
+ *
+ * @param[in] pTable The hash table to empty.
+ * @param[in] freeElement A function to free memory used by each removed element.
+ * Optional; pass `NULL` to ignore.
+ * @param[in] linkOffset Offset in bytes of a link member in its container, used
+ * to calculate the pointer to pass to `freeElement`. This value should be calculated
+ * with the C `offsetof` macro. This parameter is ignored if `freeElement` is `NULL`
+ * or its value is `0`.
+ */
+/* @[declare_indexed_containers_hash_table_removeall] */
+static inline void IotHashTable_RemoveAll( IotHashTable_t * const pTable,
+                                           void ( * freeElement )( void * ),
+                                           size_t linkOffset )
+/* @[declare_indexed_containers_hash_table_removeall] */
+{
+    size_t i = 0;
+    IotHashLink_t * pCurrent = NULL, * pNext = NULL;
+
+    /* This function must not be called with a NULL table. */
+    IotContainers_Assert( pTable != NULL );
+
+    for( i = 0; i < pTable->bucketCount; i++ )
+    {
+        pCurrent = pTable->pBuckets[ i ];
+        pTable->pBuckets[ i ] = NULL;
+
+        while( pCurrent != NULL )
+        {
+            /* Save a pointer to the next element before it is freed. */
+            pNext = pCurrent->pNext;
+
+            pCurrent->pNext = NULL;
+            pCurrent->ppPrevious = NULL;
+
+            if( freeElement != NULL )
+            {
+                freeElement( ( ( uint8_t * ) pCurrent ) - linkOffset );
+            }
+
+            pCurrent = pNext;
+        }
+    }
+
+    pTable->count = 0;
+}
+
+/**
+ * @brief Return the first non-empty bucket head at or after a bucket index.
+ *
+ * @param[in] pTable The hash table to search.
+ * @param[in] bucket The first bucket index to check.
+ *
+ * @return The head of the first non-empty bucket; `NULL` if all are empty.
+ */
+static inline IotHashLink_t * _IotHashTable_NextBucket( const IotHashTable_t * const pTable,
+                                                        size_t bucket )
+{
+    IotHashLink_t * pHead = NULL;
+    size_t i = 0;
+
+    for( i = bucket; i < pTable->bucketCount; i++ )
+    {
+        if( pTable->pBuckets[ i ] != NULL )
+        {
+            pHead = pTable->pBuckets[ i ];
+            break;
+        }
+    }
+
+    return pHead;
+}
+
+/**
+ * @brief Return the first element of a hash table in iteration order.
+ *
+ * Hash tables are iterated in bucket order, which is unrelated to the order
+ * of insertion. Elements must not be inserted while iterating.
+ *
+ * @param[in] pTable The hash table to iterate.
+ *
+ * @return The first element; `NULL` if the hash table is empty.
+ */
+/* @[declare_indexed_containers_hash_table_first] */
+static inline IotHashLink_t * IotHashTable_First( const IotHashTable_t * const pTable )
+/* @[declare_indexed_containers_hash_table_first] */
+{
+    IotHashLink_t * pFirst = NULL;
+
+    if( ( pTable != NULL ) && ( pTable->count > 0 ) )
+    {
+        pFirst = _IotHashTable_NextBucket( pTable, 0 );
+    }
+
+    return pFirst;
+}
+
+/**
+ * @brief Return the element following another element of a hash table in
+ * iteration order.
+ *
+ * @param[in] pTable The hash table to iterate.
+ * @param[in] pLink An element of `pTable`.
+ *
+ * @return The next element; `NULL` if `pLink` is the last element.
+ */
+/* @[declare_indexed_containers_hash_table_next] */
+static inline IotHashLink_t * IotHashTable_Next( const IotHashTable_t * const pTable,
+                                                 const IotHashLink_t * const pLink )
+/* @[declare_indexed_containers_hash_table_next] */
+{
+    IotHashLink_t * pNext = NULL;
+
+    /* This function must not be called with NULL parameters. */
+    IotContainers_Assert( pTable != NULL );
+    IotContainers_Assert( pLink != NULL );
+
+    pNext = pLink->pNext;
+
+    if( pNext == NULL )
+    {
+        pNext = _IotHashTable_NextBucket( pTable,
+                                          ( size_t ) ( pLink->hash & ( pTable->bucketCount - 1 ) ) + 1 );
+    }
+
+    return pNext;
+}
+
+/**
+ * @brief Check if an #IotTreeLink_t is linked in a red-black tree.
+ *
+ * @param[in] pLink The link to check.
+ *
+ * @return `true` if `pLink` is linked in a tree; `false` otherwise.
+ */
+/* @[declare_indexed_containers_tree_link_islinked] */
+static inline bool IotTreeLink_IsLinked( const IotTreeLink_t * const pLink )
+/* @[declare_indexed_containers_tree_link_islinked] */
+{
+    bool isLinked = false;
+
+    if( pLink != NULL )
+    {
+        isLinked = ( pLink->color != 0 );
+    }
+
+    return isLinked;
+}
+
+/**
+ * @brief Create a new red-black tree.
+ *
+ * This function initializes a new tree. It must be called on an uninitialized
+ * #IotTree_t before calling any other tree function.
+ *
+ * This function will not fail. The function @ref indexed_containers_function_tree_removeall
+ * may be called to destroy a tree.
+ *
+ * @param[in] pTree Pointer to the memory that will hold the new tree.
+ */
+/* @[declare_indexed_containers_tree_create] */
+static inline void IotTree_Create( IotTree_t * const pTree )
+/* @[declare_indexed_containers_tree_create] */
+{
+    /* This function must not be called with a NULL parameter. */
+    IotContainers_Assert( pTree != NULL );
+
+    pTree->pRoot = NULL;
+    pTree->count = 0;
+}
+
+/**
+ * @brief Return the number of elements contained in an #IotTree_t.
+ *
+ * @param[in] pTree The tree with the elements to count.
+ *
+ * @return The number of elements in the tree.
+ */
+/* @[declare_indexed_containers_tree_count] */
+static inline size_t IotTree_Count( const IotTree_t * const pTree )
+/* @[declare_indexed_containers_tree_count] */
+{
+    size_t count = 0;
+
+    if( pTree != NULL )
+    {
+        count = pTree->count;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Check if a red-black tree is empty.
+ *
+ * @param[in] pTree The tree to check.
+ *
+ * @return `true` if the tree is empty; `false` otherwise.
+ */
+/* @[declare_indexed_containers_tree_isempty] */
+static inline bool IotTree_IsEmpty( const IotTree_t * const pTree )
+/* @[declare_indexed_containers_tree_isempty] */
+{
+    return( ( pTree == NULL ) || ( pTree->pRoot == NULL ) );
+}
+
+/**
+ * @brief Return the smallest element of a subtree.
+ *
+ * @param[in] pLink The root of the subtree.
+ *
+ * @return The leftmost element of the subtree.
+ */
+static inline IotTreeLink_t * _IotTree_Minimum( IotTreeLink_t * pLink )
+{
+    while( pLink->pLeft != NULL )
+    {
+        pLink = pLink->pLeft;
+    }
+
+    return pLink;
+}
+
+/**
+ * @brief Return the largest element of a subtree.
+ *
+ * @param[in] pLink The root of the subtree.
+ *
+ * @return The rightmost element of the subtree.
+ */
+static inline IotTreeLink_t * _IotTree_Maximum( IotTreeLink_t * pLink )
+{
+    while( pLink->pRight != NULL )
+    {
+        pLink = pLink->pRight;
+    }
+
+    return pLink;
+}
+
+/**
+ * @brief Return the smallest element of a red-black tree.
+ *
+ * @param[in] pTree The tree to peek.
+ *
+ * @return Pointer to an #IotTreeLink_t representing the smallest element;
+ * `NULL` if the tree is empty.
+ */
+/* @[declare_indexed_containers_tree_first] */
+static inline IotTreeLink_t * IotTree_First( const IotTree_t * const pTree )
+/* @[declare_indexed_containers_tree_first] */
+{
+    IotTreeLink_t * pFirst = NULL;
+
+    if( IotTree_IsEmpty( pTree ) == false )
+    {
+        pFirst = _IotTree_Minimum( pTree->pRoot );
+    }
+
+    return pFirst;
+}
+
+/**
+ * @brief Return the largest element of a red-black tree.
+ *
+ * @param[in] pTree The tree to peek.
+ *
+ * @return Pointer to an #IotTreeLink_t representing the largest element;
+ * `NULL` if the tree is empty.
+ */
+/* @[declare_indexed_containers_tree_last] */
+static inline IotTreeLink_t * IotTree_Last( const IotTree_t * const pTree )
+/* @[declare_indexed_containers_tree_last] */
+{
+    IotTreeLink_t * pLast = NULL;
+
+    if( IotTree_IsEmpty( pTree ) == false )
+    {
+        pLast = _IotTree_Maximum( pTree->pRoot );
+    }
+
+    return pLast;
+}
+
+/**
+ * @brief Return the element following another element of a red-black tree.
+ *
+ * @param[in] pLink An element of a tree.
+ *
+ * @return The next larger element; `NULL` if `pLink` is the largest element.
+ */
+/* @[declare_indexed_containers_tree_next] */
+static inline IotTreeLink_t * IotTree_Next( const IotTreeLink_t * pLink )
+/* @[declare_indexed_containers_tree_next] */
+{
+    IotTreeLink_t * pNext = NULL;
+
+    /* This function must be called on a linked element. */
+    IotContainers_Assert( IotTreeLink_IsLinked( pLink ) == true );
+
+    if( pLink->pRight != NULL )
+    {
+        pNext = _IotTree_Minimum( pLink->pRight );
+    }
+    else
+    {
+        /* Climb until coming up from a left subtree. */
+        pNext = pLink->pParent;
+
+        while( ( pNext != NULL ) && ( pLink == pNext->pRight ) )
+        {
+            pLink = pNext;
+            pNext = pNext->pParent;
+        }
+    }
+
+    return pNext;
+}
+
+/**
+ * @brief Return the element preceding another element of a red-black tree.
+ *
+ * @param[in] pLink An element of a tree.
+ *
+ * @return The next smaller element; `NULL` if `pLink` is the smallest element.
+ */
+/* @[declare_indexed_containers_tree_previous] */
+static inline IotTreeLink_t * IotTree_Previous( const IotTreeLink_t * pLink )
+/* @[declare_indexed_containers_tree_previous] */
+{
+    IotTreeLink_t * pPrevious = NULL;
+
+    /* This function must be called on a linked element. */
+    IotContainers_Assert( IotTreeLink_IsLinked( pLink ) == true );
+
+    if( pLink->pLeft != NULL )
+    {
+        pPrevious = _IotTree_Maximum( pLink->pLeft );
+    }
+    else
+    {
+        /* Climb until coming up from a right subtree. */
+        pPrevious = pLink->pParent;
+
+        while( ( pPrevious != NULL ) && ( pLink == pPrevious->pLeft ) )
+        {
+            pLink = pPrevious;
+            pPrevious = pPrevious->pParent;
+        }
+    }
+
+    return pPrevious;
+}
+
+/**
+ * @brief Replace the subtree rooted at one element with the subtree rooted at
+ * another element.
+ *
+ * @param[in] pTree The tree to modify.
+ * @param[in] pOld The root of the subtree to replace.
+ * @param[in] pNew The root of the replacement subtree; may be `NULL`.
+ */
+static inline void _IotTree_Replace( IotTree_t * const pTree,
+                                     IotTreeLink_t * pOld,
+                                     IotTreeLink_t * pNew )
+{
+    if( pOld->pParent == NULL )
+    {
+        pTree->pRoot = pNew;
+    }
+    else if( pOld == pOld->pParent->pLeft )
+    {
+        pOld->pParent->pLeft = pNew;
+    }
+    else
+    {
+        pOld->pParent->pRight = pNew;
+    }
+
+    if( pNew != NULL )
+    {
+        pNew->pParent = pOld->pParent;
+    }
+}
+
+/**
+ * @brief Rotate a subtree to the left.
+ *
+ * @param[in] pTree The tree to modify.
+ * @param[in] pLink The root of the subtree; its right child becomes the new root.
+ */
+static inline void _IotTree_RotateLeft( IotTree_t * const pTree,
+                                        IotTreeLink_t * pLink )
+{
+    IotTreeLink_t * pPivot = pLink->pRight;
+
+    pLink->pRight = pPivot->pLeft;
+
+    if( pPivot->pLeft != NULL )
+    {
+        pPivot->pLeft->pParent = pLink;
+    }
+
+    _IotTree_Replace( pTree, pLink, pPivot );
+    pPivot->pLeft = pLink;
+    pLink->pParent = pPivot;
+}
+
+/**
+ * @brief Rotate a subtree to the right.
+ *
+ * @param[in] pTree The tree to modify.
+ * @param[in] pLink The root of the subtree; its left child becomes the new root.
+ */
+static inline void _IotTree_RotateRight( IotTree_t * const pTree,
+                                         IotTreeLink_t * pLink )
+{
+    IotTreeLink_t * pPivot = pLink->pLeft;
+
+    pLink->pLeft = pPivot->pRight;
+
+    if( pPivot->pRight != NULL )
+    {
+        pPivot->pRight->pParent = pLink;
+    }
+
+    _IotTree_Replace( pTree, pLink, pPivot );
+    pPivot->pRight = pLink;
+    pLink->pParent = pPivot;
+}
+
+/**
+ * @brief Check if an element of a red-black tree is black.
+ *
+ * @param[in] pLink The element to check; `NULL` leaves are black.
+ *
+ * @return `true` if the element is black; `false` if it is red.
+ */
+static inline bool _IotTree_IsBlack( const IotTreeLink_t * const pLink )
+{
+    return( ( pLink == NULL ) || ( pLink->color == IOT_TREE_BLACK ) );
+}
+
+/**
+ * @brief Insert an element in a red-black tree.
+ *
+ * Elements with equal keys may be inserted; they are iterated in the order of
+ * their insertion. This function runs in logarithmic time.
+ *
+ * @param[in] pTree The tree that will hold the new element.
+ * @param[in] pLink Pointer to the new element's link member.
+ * @param[in] compare Determines the order of the tree. Returns a negative
+ * value if its first argument is less than its second argument; returns
+ * zero if its first argument is equal to its second argument; returns a
+ * positive value if its first argument is greater than its second argument.
+ * The parameters to this function are #IotTreeLink_t, so the macro #IotLink_Container
+ * may be used to determine the address of the link's container.
+ */
+/* @[declare_indexed_containers_tree_insert] */
+static inline void IotTree_Insert( IotTree_t * const pTree,
+                                   IotTreeLink_t * const pLink,
+                                   int32_t ( * compare )( const IotTreeLink_t * const, const IotTreeLink_t * const ) )
+/* @[declare_indexed_containers_tree_insert] */
+{
+    IotTreeLink_t * pParent = NULL, * pCurrent = NULL, * pUncle = NULL, * pGrandparent = NULL;
+    IotTreeLink_t * pNode = pLink;
+    bool insertLeft = false;
+
+    /* This function must not be called with NULL parameters. */
+    IotContainers_Assert( pTree != NULL );
+    IotContainers_Assert( pLink != NULL );
+    IotContainers_Assert( compare != NULL );
+
+    /* This function must not be called on a linked element. */
+    IotContainers_Assert( IotTreeLink_IsLinked( pLink ) == false );
+
+    /* Find the leaf position of the new element. Comparing for '<' places
+     * equal elements after existing ones, preserving the order of insertion. */
+    pCurrent = pTree->pRoot;
+
+    while( pCurrent != NULL )
+    {
+        pParent = pCurrent;
+        insertLeft = ( compare( pLink, pCurrent ) < 0 );
+
+        if( insertLeft == true )
+        {
+            pCurrent = pCurrent->pLeft;
+        }
+        else
+        {
+            pCurrent = pCurrent->pRight;
+        }
+    }
+
+    pLink->pParent = pParent;
+    pLink->pLeft = NULL;
+    pLink->pRight = NULL;
+    pLink->color = IOT_TREE_RED;
+
+    if( pParent == NULL )
+    {
+        pTree->pRoot = pLink;
+    }
+    else if( insertLeft == true )
+    {
+        pParent->pLeft = pLink;
+    }
+    else
+    {
+        pParent->pRight = pLink;
+    }
+
+    /* Restore the red-black properties: a red element never has a red parent. */
+    while( ( pNode->pParent != NULL ) && ( pNode->pParent->color == IOT_TREE_RED ) )
+    {
+        pParent = pNode->pParent;
+
+        /* A red parent is never the root, so the grandparent exists. */
+        pGrandparent = pParent->pParent;
+
+        if( pParent == pGrandparent->pLeft )
+        {
+            pUncle = pGrandparent->pRight;
+
+            if( _IotTree_IsBlack( pUncle ) == false )
+            {
+                pParent->color = IOT_TREE_BLACK;
+                pUncle->color = IOT_TREE_BLACK;
+                pGrandparent->color = IOT_TREE_RED;
+                pNode = pGrandparent;
+            }
+            else
+            {
+                if( pNode == pParent->pRight )
+                {
+                    pNode = pParent;
+                    _IotTree_RotateLeft( pTree, pNode );
+                    pParent = pNode->pParent;
+                }
+
+                pParent->color = IOT_TREE_BLACK;
+                pGrandparent->color = IOT_TREE_RED;
+                _IotTree_RotateRight( pTree, pGrandparent );
+            }
+        }
+        else
+        {
+            pUncle = pGrandparent->pLeft;
+
+            if( _IotTree_IsBlack( pUncle ) == false )
+            {
+                pParent->color = IOT_TREE_BLACK;
+                pUncle->color = IOT_TREE_BLACK;
+                pGrandparent->color = IOT_TREE_RED;
+                pNode = pGrandparent;
+            }
+            else
+            {
+                if( pNode == pParent->pLeft )
+                {
+                    pNode = pParent;
+                    _IotTree_RotateRight( pTree, pNode );
+                    pParent = pNode->pParent;
+                }
+
+                pParent->color = IOT_TREE_BLACK;
+                pGrandparent->color = IOT_TREE_RED;
+                _IotTree_RotateLeft( pTree, pGrandparent );
+            }
+        }
+    }
+
+    pTree->pRoot->color = IOT_TREE_BLACK;
+    pTree->count++;
+}
+
+/**
+ * @brief Search a red-black tree for the first element not less than a key.
+ *
+ * @param[in] pTree The tree to search.
+ * @param[in] pKey The key to search for.
+ * @param[in] compare Compares an element of the tree with `pKey`. Returns a
+ * negative value if the element is less than the key, zero if it is equal, and
+ * a positive value if it is greater. Must order elements the same way as the
+ * function passed to @ref indexed_containers_function_tree_insert.
+ *
+ * @return Pointer to an #IotTreeLink_t representing the smallest element not
+ * less than `pKey`; `NULL` if all elements are less than `pKey`.
+ */
+/* @[declare_indexed_containers_tree_lowerbound] */
+static inline IotTreeLink_t * IotTree_LowerBound( const IotTree_t * const pTree,
+                                                  const void * pKey,
+                                                  int32_t ( * compare )( const IotTreeLink_t * const, const void * ) )
+/* @[declare_indexed_containers_tree_lowerbound] */
+{
+    IotTreeLink_t * pCurrent = NULL, * pBound = NULL;
+
+    /* This function must not be called with NULL parameters. */
+    IotContainers_Assert( pTree != NULL );
+    IotContainers_Assert( compare != NULL );
+
+    pCurrent = pTree->pRoot;
+
+    while( pCurrent != NULL )
+    {
+        if( compare( pCurrent, pKey ) < 0 )
+        {
+            pCurrent = pCurrent->pRight;
+        }
+        else
+        {
+            pBound = pCurrent;
+            pCurrent = pCurrent->pLeft;
+        }
+    }
+
+    return pBound;
+}
+
+/**
+ * @brief Search a red-black tree for the first element equal to a key.
+ *
+ * This function runs in logarithmic time.
+ *
+ * @param[in] pTree The tree to search.
+ * @param[in] pKey The key to search for.
+ * @param[in] compare Compares an element of the tree with `pKey`, as for
+ * @ref indexed_containers_function_tree_lowerbound.
+ *
+ * @return Pointer to an #IotTreeLink_t representing the first (in order of
+ * insertion) element equal to `pKey`; `NULL` if no match is found. The macro
+ * #IotLink_Container may be used to determine the address of the link's container.
+ */
+/* @[declare_indexed_containers_tree_find] */
+static inline IotTreeLink_t * IotTree_Find( const IotTree_t * const pTree,
+                                            const void * pKey,
+                                            int32_t ( * compare )( const IotTreeLink_t * const, const void * ) )
+/* @[declare_indexed_containers_tree_find] */
+{
+    IotTreeLink_t * pMatch = IotTree_LowerBound( pTree, pKey, compare );
+
+    if( pMatch != NULL )
+    {
+        if( compare( pMatch, pKey ) != 0 )
+        {
+            pMatch = NULL;
+        }
+    }
+
+    return pMatch;
+}
+
+/**
+ * @brief Restore the red-black properties after removing a black element.
+ *
+ * @param[in] pTree The tree to modify.
+ * @param[in] pNode The element that replaced the removed element; may be `NULL`.
+ * @param[in] pParent The parent of `pNode`.
+ */
+static inline void _IotTree_RemoveFixup( IotTree_t * const pTree,
+                                         IotTreeLink_t * pNode,
+                                         IotTreeLink_t * pParent )
+{
+    IotTreeLink_t * pSibling = NULL;
+
+    while( ( pNode != pTree->pRoot ) && ( _IotTree_IsBlack( pNode ) == true ) )
+    {
+        if( pNode == pParent->pLeft )
+        {
+            pSibling = pParent->pRight;
+
+            if( pSibling->color == IOT_TREE_RED )
+            {
+                pSibling->color = IOT_TREE_BLACK;
+                pParent->color = IOT_TREE_RED;
+                _IotTree_RotateLeft( pTree, pParent );
+                pSibling = pParent->pRight;
+            }
+
+            if( ( _IotTree_IsBlack( pSibling->pLeft ) == true ) &&
+                ( _IotTree_IsBlack( pSibling->pRight ) == true ) )
+            {
+                pSibling->color = IOT_TREE_RED;
+                pNode = pParent;
+                pParent = pNode->pParent;
+            }
+            else
+            {
+                if( _IotTree_IsBlack( pSibling->pRight ) == true )
+                {
+                    pSibling->pLeft->color = IOT_TREE_BLACK;
+                    pSibling->color = IOT_TREE_RED;
+                    _IotTree_RotateRight( pTree, pSibling );
+                    pSibling = pParent->pRight;
+                }
+
+                pSibling->color = pParent->color;
+                pParent->color = IOT_TREE_BLACK;
+                pSibling->pRight->color = IOT_TREE_BLACK;
+                _IotTree_RotateLeft( pTree, pParent );
+                pNode = pTree->pRoot;
+            }
+        }
+        else
+        {
+            pSibling = pParent->pLeft;
+
+            if( pSibling->color == IOT_TREE_RED )
+            {
+                pSibling->color = IOT_TREE_BLACK;
+                pParent->color = IOT_TREE_RED;
+                _IotTree_RotateRight( pTree, pParent );
+                pSibling = pParent->pLeft;
+            }
+
+            if( ( _IotTree_IsBlack( pSibling->pLeft ) == true ) &&
+                ( _IotTree_IsBlack( pSibling->pRight ) == true ) )
+            {
+                pSibling->color = IOT_TREE_RED;
+                pNode = pParent;
+                pParent = pNode->pParent;
+            }
+            else
+            {
+                if( _IotTree_IsBlack( pSibling->pLeft ) == true )
+                {
+                    pSibling->pRight->color = IOT_TREE_BLACK;
+                    pSibling->color = IOT_TREE_RED;
+                    _IotTree_RotateLeft( pTree, pSibling );
+                    pSibling = pParent->pLeft;
+                }
+
+                pSibling->color = pParent->color;
+                pParent->color = IOT_TREE_BLACK;
+                pSibling->pLeft->color = IOT_TREE_BLACK;
+                _IotTree_RotateRight( pTree, pParent );
+                pNode = pTree->pRoot;
+            }
+        }
+    }
+
+    if( pNode != NULL )
+    {
+        pNode->color = IOT_TREE_BLACK;
+    }
+}
+
+/**
+ * @brief Remove a single element from a red-black tree.
+ *
+ * This function runs in logarithmic time.
+ *
+ * @param[in] pTree The tree that holds the element to remove.
+ * @param[in] pLink The element to remove.
+ */
+/* @[declare_indexed_containers_tree_remove] */
+static inline void IotTree_Remove( IotTree_t * const pTree,
+                                   IotTreeLink_t * const pLink )
+/* @[declare_indexed_containers_tree_remove] */
+{
+    IotTreeLink_t * pSuccessor = NULL, * pChild = NULL, * pChildParent = NULL;
+    uint8_t removedColor = 0;
+
+    /* This function must not be called with NULL parameters. */
+    IotContainers_Assert( pTree != NULL );
+    IotContainers_Assert( pLink != NULL );
+
+    /* This function must be called on a linked element. */
+    IotContainers_Assert( IotTreeLink_IsLinked( pLink ) == true );
+    IotContainers_Assert( pTree->count > 0 );
+
+    removedColor = pLink->color;
+
+    if( pLink->pLeft == NULL )
+    {
+        pChild = pLink->pRight;
+        pChildParent = pLink->pParent;
+        _IotTree_Replace( pTree, pLink, pChild );
+    }
+    else if( pLink->pRight == NULL )
+    {
+        pChild = pLink->pLeft;
+        pChildParent = pLink->pParent;
+        _IotTree_Replace( pTree, pLink, pChild );
+    }
+    else
+    {
+        /* An element with two children is replaced by its successor, which
+         * has no left child. */
+        pSuccessor = _IotTree_Minimum( pLink->pRight );
+        removedColor = pSuccessor->color;
+        pChild = pSuccessor->pRight;
+
+        if( pSuccessor->pParent == pLink )
+        {
+            pChildParent = pSuccessor;
+        }
+        else
+        {
+            pChildParent = pSuccessor->pParent;
+            _IotTree_Replace( pTree, pSuccessor, pChild );
+            pSuccessor->pRight = pLink->pRight;
+            pSuccessor->pRight->pParent = pSuccessor;
+        }
+
+        _IotTree_Replace( pTree, pLink, pSuccessor );
+        pSuccessor->pLeft = pLink->pLeft;
+        pSuccessor->pLeft->pParent = pSuccessor;
+        pSuccessor->color = pLink->color;
+    }
+
+    if( removedColor == IOT_TREE_BLACK )
+    {
+        _IotTree_RemoveFixup( pTree, pChild, pChildParent );
+    }
+
+    pLink->pParent = NULL;
+    pLink->pLeft = NULL;
+    pLink->pRight = NULL;
+    pLink->color = 0;
+    pTree->count--;
+}
+
+/**
+ * @brief Remove the first element equal to a key from a red-black tree.
+ *
+ * @param[in] pTree The tree to search.
+ * @param[in] pKey The key to search for.
+ * @param[in] compare Compares an element of the tree with `pKey`, as for
+ * @ref indexed_containers_function_tree_lowerbound.
+ *
+ * @return Pointer to an #IotTreeLink_t representing the removed element; `NULL`
+ * if no element was found. The macro #IotLink_Container may be used to determine
+ * the address of the link's container.
+ */
+/* @[declare_indexed_containers_tree_removefirstmatch] */
+static inline IotTreeLink_t * IotTree_RemoveFirstMatch( IotTree_t * const pTree,
+                                                        const void * pKey,
+                                                        int32_t ( * compare )( const IotTreeLink_t * const, const void * ) )
+/* @[declare_indexed_containers_tree_removefirstmatch] */
+{
+    IotTreeLink_t * pMatchedElement = IotTree_Find( pTree, pKey, compare );
+
+    if( pMatchedElement != NULL )
+    {
+        IotTree_Remove( pTree, pMatchedElement );
+    }
+
+    return pMatchedElement;
+}
+
+/**
+ * @brief Remove all elements in a red-black tree.
+ *
+ * The tree is not rebalanced while it is emptied, so this function runs in
+ * linear time.
+ *
+ * @param[in] pTree The tree to empty.
+ * @param[in] freeElement A function to free memory used by each removed element.
+ * Optional; pass `NULL` to ignore.
+ * @param[in] linkOffset Offset in bytes of a link member in its container, used
+ * to calculate the pointer to pass to `freeElement`. This value should be calculated
+ * with the C `offsetof` macro. This parameter is ignored if `freeElement` is `NULL`
+ * or its value is `0`.
+ */
+/* @[declare_indexed_containers_tree_removeall] */
+static inline void IotTree_RemoveAll( IotTree_t * const pTree,
+                                      void ( * freeElement )( void * ),
+                                      size_t linkOffset )
+/* @[declare_indexed_containers_tree_removeall] */
+{
+    IotTreeLink_t * pCurrent = NULL, * pParent = NULL;
+
+    /* This function must not be called with a NULL tree. */
+    IotContainers_Assert( pTree != NULL );
+
+    pCurrent = pTree->pRoot;
+
+    /* Walk the tree in post-order without recursion, releasing each element
+     * once both of its subtrees are released. */
+    while( pCurrent != NULL )
+    {
+        if( pCurrent->pLeft != NULL )
+        {
+            pCurrent = pCurrent->pLeft;
+        }
+        else if( pCurrent->pRight != NULL )
+        {
+            pCurrent = pCurrent->pRight;
+        }
+        else
+        {
+            pParent = pCurrent->pParent;
+
+            if( pParent != NULL )
+            {
+                if( pParent->pLeft == pCurrent )
+                {
+                    pParent->pLeft = NULL;
+                }
+                else
+                {
+                    pParent->pRight = NULL;
+                }
+            }
+
+            pCurrent->pParent = NULL;
+            pCurrent->color = 0;
+
+            if( freeElement != NULL )
+            {
+                freeElement( ( ( uint8_t * ) pCurrent ) - linkOffset );
+            }
+
+            pCurrent = pParent;
+        }
+    }
+
+    pTree->pRoot = NULL;
+    pTree->count = 0;
+}
+
+#endif /* IOT_INDEXED_CONTAINERS_H_ */
@@ -67,6 +67,8 @@
  * @function_brief{taskpool_function_recyclejob}
  * - @function_name{taskpool_function_schedule}
  * @function_brief{taskpool_function_schedule}
+ * - @function_name{taskpool_function_schedulebatch}
+ * @function_brief{taskpool_function_schedulebatch}
  * - @function_name{taskpool_function_scheduledeferred}
  * @function_brief{taskpool_function_scheduledeferred}
  * - @function_name{taskpool_function_getstatus}
@@ -75,6 +77,16 @@
  * @function_brief{taskpool_function_trycancel}
  * - @function_name{taskpool_function_getjobstoragefromhandle}
  * @function_brief{taskpool_function_getjobstoragefromhandle}
+ * - @function_name{taskpool_function_getjobcachestats}
+ * @function_brief{taskpool_function_getjobcachestats}
+ * - @function_name{taskpool_function_setjobclass}
+ * @function_brief{taskpool_function_setjobclass}
+ * - @function_name{taskpool_function_getjobclassstats}
+ * @function_brief{taskpool_function_getjobclassstats}
+ * - @function_name{taskpool_function_getinstrumentation}
+ * @function_brief{taskpool_function_getinstrumentation}
+ * - @function_name{taskpool_function_histogrampercentile}
+ * @function_brief{taskpool_function_histogrampercentile}
  * - @function_name{taskpool_function_strerror}
  * @function_brief{taskpool_function_strerror}
  */
@@ -110,6 +122,9 @@
  * @function_page{IotTaskPool_Schedule,taskpool,schedule}
  * @function_snippet{taskpool,schedule,this}
  * @copydoc IotTaskPool_Schedule
+ * @function_page{IotTaskPool_ScheduleBatch,taskpool,schedulebatch}
+ * @function_snippet{taskpool,schedulebatch,this}
+ * @copydoc IotTaskPool_ScheduleBatch
  * @function_page{IotTaskPool_ScheduleDeferred,taskpool,scheduledeferred}
  * @function_snippet{taskpool,scheduledeferred,this}
  * @copydoc IotTaskPool_ScheduleDeferred
@@ -122,6 +137,21 @@
  * @function_page{IotTaskPool_GetJobStorageFromHandle,taskpool,getjobstoragefromhandle}
  * @function_snippet{taskpool,getjobstoragefromhandle,this}
  * @copydoc IotTaskPool_GetJobStorageFromHandle
+ * @function_page{IotTaskPool_GetJobCacheStats,taskpool,getjobcachestats}
+ * @function_snippet{taskpool,getjobcachestats,this}
+ * @copydoc IotTaskPool_GetJobCacheStats
+ * @function_page{IotTaskPool_SetJobClass,taskpool,setjobclass}
+ * @function_snippet{taskpool,setjobclass,this}
+ * @copydoc IotTaskPool_SetJobClass
+ * @function_page{IotTaskPool_GetJobClassStats,taskpool,getjobclassstats}
+ * @function_snippet{taskpool,getjobclassstats,this}
+ * @copydoc IotTaskPool_GetJobClassStats
+ * @function_page{IotTaskPool_GetInstrumentation,taskpool,getinstrumentation}
+ * @function_snippet{taskpool,getinstrumentation,this}
+ * @copydoc IotTaskPool_GetInstrumentation
+ * @function_page{IotTaskPool_HistogramPercentile,taskpool,histogrampercentile}
+ * @function_snippet{taskpool,histogrampercentile,this}
+ * @copydoc IotTaskPool_HistogramPercentile
  * @function_page{IotTaskPool_strerror,taskpool,strerror}
  * @function_snippet{taskpool,strerror,this}
  * @copydoc IotTaskPool_strerror
@@ -459,6 +489,42 @@ IotTaskPoolError_t IotTaskPool_Schedule( IotTaskPool_t taskPool,
                                          uint32_t flags );
 /* @[declare_taskpool_schedule] */
 
+/**
+ * @brief This function schedules a batch of jobs created with @ref IotTaskPool_CreateJob or
+ * @ref IotTaskPool_CreateRecyclableJob against the task pool pointed to by `taskPool`.
+ *
+ * All jobs are queued with a single acquisition of the task pool lock, and at most one worker is woken up for each job:
+ * idle workers and the workers created to serve the batch are signaled, while busy workers pick up the remaining jobs
+ * when they complete their current job. This is cheaper than calling @ref IotTaskPool_Schedule for each job when
+ * fanning out work.
+ *
+ * @param[in] taskPool A handle to the task pool that must have been previously initialized with.
+ * a call to @ref IotTaskPool_Create.
+ * @param[in] pJobs An array of `jobCount` jobs to schedule for execution. Each job must be first initialized with a call to
+ * @ref IotTaskPool_CreateJob or @ref IotTaskPool_CreateRecyclableJob.
+ * @param[in] jobCount The number of jobs in `pJobs`.
+ *
+ * @return One of the following:
+ * - #IOT_TASKPOOL_SUCCESS
+ * - #IOT_TASKPOOL_BAD_PARAMETER
+ * - #IOT_TASKPOOL_ILLEGAL_OPERATION
+ * - #IOT_TASKPOOL_SHUTDOWN_IN_PROGRESS
+ *
+ * @note A job that is executing cannot be scheduled. Such jobs are skipped and the function returns
+ * #IOT_TASKPOOL_ILLEGAL_OPERATION, but all other jobs in the batch are scheduled.
+ *
+ * @note This function will not allocate memory. High priority scheduling is not supported for batches; use
+ * @ref IotTaskPool_Schedule with #IOT_TASKPOOL_JOB_HIGH_PRIORITY instead.
+ *
+ * @warning The `taskPool` used in this function should be the same used to create the jobs in `pJobs`, or the
+ * results will be undefined.
+ */
+/* @[declare_taskpool_schedulebatch] */
+IotTaskPoolError_t IotTaskPool_ScheduleBatch( IotTaskPool_t taskPool,
+                                              IotTaskPoolJob_t * const pJobs,
+                                              uint32_t jobCount );
+/* @[declare_taskpool_schedulebatch] */
+
 /**
  * @brief This function schedules a job created with @ref IotTaskPool_CreateJob against the task pool
  * pointed to by `taskPool` to be executed after a user-defined time interval.
@@ -556,6 +622,102 @@ IotTaskPoolError_t IotTaskPool_TryCancel( IotTaskPool_t taskPool,
 IotTaskPoolJobStorage_t * IotTaskPool_GetJobStorageFromHandle( IotTaskPoolJob_t job );
 /* @[declare_taskpool_getjobstoragefromhandle] */
 
+/**
+ * @brief Retrieves the statistics of the recyclable jobs cache of a task pool.
+ *
+ * @param[in] taskPool A handle to the task pool that must have been previously initialized with
+ * a call to @ref IotTaskPool_Create or @ref IotTaskPool_CreateSystemTaskPool.
+ * @param[out] pStats The statistics of the recyclable jobs cache.
+ *
+ * @return One of the following:
+ * - #IOT_TASKPOOL_SUCCESS
+ * - #IOT_TASKPOOL_BAD_PARAMETER
+ *
+ * @note The statistics are a snapshot of counters that are updated concurrently, and
+ * may not be consistent with one another.
+ */
+/* @[declare_taskpool_getjobcachestats] */
+IotTaskPoolError_t IotTaskPool_GetJobCacheStats( IotTaskPool_t taskPool,
+                                                 IotTaskPoolJobCacheStats_t * const pStats );
+/* @[declare_taskpool_getjobcachestats] */
+
+/**
+ * @brief Sets the class of a job, which decides its share of the worker threads of the task pool.
+ *
+ * Creating a job with @ref IotTaskPool_CreateJob or @ref IotTaskPool_CreateRecyclableJob
+ * sets its class to #IOT_TASKPOOL_JOB_CLASS_NORMAL. This function should be called after creating
+ * the job, and before scheduling it.
+ *
+ * @param[in] job The job to set the class of.
+ * @param[in] jobClass The class of the job.
+ *
+ * @return One of the following:
+ * - #IOT_TASKPOOL_SUCCESS
+ * - #IOT_TASKPOOL_BAD_PARAMETER
+ * - #IOT_TASKPOOL_ILLEGAL_OPERATION, if the job is scheduled or deferred.
+ */
+/* @[declare_taskpool_setjobclass] */
+IotTaskPoolError_t IotTaskPool_SetJobClass( IotTaskPoolJob_t job,
+                                            IotTaskPoolJobClass_t jobClass );
+/* @[declare_taskpool_setjobclass] */
+
+/**
+ * @brief Retrieves the queue depth and wait time statistics of one class of jobs of a task pool.
+ *
+ * @param[in] taskPool A handle to the task pool that must have been previously initialized with
+ * a call to @ref IotTaskPool_Create or @ref IotTaskPool_CreateSystemTaskPool.
+ * @param[in] jobClass The class of jobs to retrieve the statistics of.
+ * @param[out] pStats The statistics of the class of jobs.
+ *
+ * @return One of the following:
+ * - #IOT_TASKPOOL_SUCCESS
+ * - #IOT_TASKPOOL_BAD_PARAMETER
+ *
+ * @note The statistics are a snapshot of counters that are updated concurrently, and
+ * may not be consistent with one another.
+ */
+/* @[declare_taskpool_getjobclassstats] */
+IotTaskPoolError_t IotTaskPool_GetJobClassStats( IotTaskPool_t taskPool,
+                                                 IotTaskPoolJobClass_t jobClass,
+                                                 IotTaskPoolJobClassStats_t * const pStats );
+/* @[declare_taskpool_getjobclassstats] */
+
+/**
+ * @brief Take a snapshot of the latency histograms and utilization peaks of a task pool.
+ *
+ * The task pool records these only if #IOT_TASKPOOL_ENABLE_INSTRUMENTATION is set to `1`.
+ *
+ * @param[in] taskPool A handle to the task pool that must have been previously initialized with
+ * a call to @ref IotTaskPool_Create or @ref IotTaskPool_CreateSystemTaskPool.
+ * @param[out] pSnapshot The snapshot of the instrumentation.
+ *
+ * @return One of the following:
+ * - #IOT_TASKPOOL_SUCCESS
+ * - #IOT_TASKPOOL_BAD_PARAMETER
+ * - #IOT_TASKPOOL_ILLEGAL_OPERATION, if the instrumentation is compiled out.
+ *
+ * @note The snapshot is taken without locking the task pool, so values recorded while taking it may be
+ * only partially included.
+ */
+/* @[declare_taskpool_getinstrumentation] */
+IotTaskPoolError_t IotTaskPool_GetInstrumentation( IotTaskPool_t taskPool,
+                                                   IotTaskPoolInstrumentation_t * const pSnapshot );
+/* @[declare_taskpool_getinstrumentation] */
+
+/**
+ * @brief Estimate a percentile of the values recorded in a histogram.
+ *
+ * @param[in] pHistogram The histogram, as found in a #IotTaskPoolInstrumentation_t.
+ * @param[in] percentile The percentile to estimate, between 0 and 100.
+ *
+ * @return The upper bound of the bucket holding the percentile, capped to the largest recorded value,
+ * or `0` if the histogram is empty or the parameters are invalid.
+ */
+/* @[declare_taskpool_histogrampercentile] */
+uint32_t IotTaskPool_HistogramPercentile( const IotTaskPoolHistogram_t * pHistogram,
+                                          uint32_t percentile );
+/* @[declare_taskpool_histogrampercentile] */
+
 /**
  * @brief Returns a string that describes an @ref IotTaskPoolError_t.
  *
@@ -595,10 +757,98 @@ const char * IotTaskPool_strerror( IotTaskPoolError_t status );
 /**
  * @brief The maximum timeout in milliseconds to wait for a job to be scheduled before waking up a worker thread.
  * A worker thread that wakes up as a result of a timeout may exit to allow the task pool to fold back to its
- * minimum number of threads.
+ * minimum number of threads. This is the default for #IotTaskPoolInfo_t.lingerMs.
  */
 #ifndef IOT_TASKPOOL_JOB_WAIT_TIMEOUT_MS
     #define IOT_TASKPOOL_JOB_WAIT_TIMEOUT_MS    ( 60 * 1000UL )
 #endif
 
+/**
+ * @brief Set this to `1` to compile in support for the work-stealing dispatcher
+ * (#IOT_TASKPOOL_DISPATCH_WORK_STEALING).
+ *
+ * Enabling this setting adds #IOT_TASKPOOL_WORKER_QUEUES dispatch queues and their locks to
+ * every task pool, and one field to every job, even for task pools that use the shared queue.
+ */
+#ifndef IOT_TASKPOOL_ENABLE_WORK_STEALING
+    #define IOT_TASKPOOL_ENABLE_WORK_STEALING    ( 0 )
+#endif
+
+/**
+ * @brief The number of per-worker dispatch queues of a task pool using the work-stealing dispatcher.
+ *
+ * Worker threads are assigned a home queue in round-robin order, so task pools with more
+ * worker threads than queues will have some workers sharing a home queue.
+ */
+#ifndef IOT_TASKPOOL_WORKER_QUEUES
+    #define IOT_TASKPOOL_WORKER_QUEUES    ( 4UL )
+#endif
+
+/**
+ * @brief The granularity, in milliseconds, of the timer wheel that holds the deferred jobs of a task pool.
+ *
+ * A deferred job is never dispatched before its deadline, and may be dispatched up to this much late.
+ */
+#ifndef IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS
+    #define IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS    ( 10UL )
+#endif
+
+/**
+ * @brief The number of levels of the timer wheel that holds the deferred jobs of a task pool.
+ *
+ * Each level has 32 slots, so the wheel spans 32 ^ #IOT_TASKPOOL_TIMER_WHEEL_LEVELS times
+ * #IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS milliseconds (about 2.9 hours with the default values).
+ * Jobs deferred further than that are kept in an overflow list, which is revisited once per span.
+ */
+#ifndef IOT_TASKPOOL_TIMER_WHEEL_LEVELS
+    #define IOT_TASKPOOL_TIMER_WHEEL_LEVELS    ( 4UL )
+#endif
+
+/**
+ * @brief The number of jobs of class #IOT_TASKPOOL_JOB_CLASS_NORMAL that may be dispatched in a row
+ * while jobs of other classes are waiting. Must be at least 1.
+ */
+#ifndef IOT_TASKPOOL_JOB_CLASS_NORMAL_WEIGHT
+    #define IOT_TASKPOOL_JOB_CLASS_NORMAL_WEIGHT    ( 2UL )
+#endif
+
+/**
+ * @brief The number of jobs of class #IOT_TASKPOOL_JOB_CLASS_CONTROL that may be dispatched in a row
+ * while jobs of other classes are waiting. Must be at least 1.
+ */
+#ifndef IOT_TASKPOOL_JOB_CLASS_CONTROL_WEIGHT
+    #define IOT_TASKPOOL_JOB_CLASS_CONTROL_WEIGHT    ( 4UL )
+#endif
+
+/**
+ * @brief The number of jobs of class #IOT_TASKPOOL_JOB_CLASS_BULK that may be dispatched in a row
+ * while jobs of other classes are waiting. Must be at least 1.
+ */
+#ifndef IOT_TASKPOOL_JOB_CLASS_BULK_WEIGHT
+    #define IOT_TASKPOOL_JOB_CLASS_BULK_WEIGHT    ( 1UL )
+#endif
+
+/**
+ * @brief Set this to `1` to record the wait and run times of jobs, and the peak numbers of active jobs
+ * and threads of every task pool. See @ref IotTaskPool_GetInstrumentation.
+ *
+ * Enabling this setting adds two histograms to every task pool, one field to every job, and a few
+ * atomic operations and clock reads to the scheduling and execution of every job.
+ */
+#ifndef IOT_TASKPOOL_ENABLE_INSTRUMENTATION
+    #define IOT_TASKPOOL_ENABLE_INSTRUMENTATION    ( 0 )
+#endif
+
+/**
+ * @def IotTaskPool_InstrumentationTime()
+ * @brief The clock of the task pool instrumentation, as a `uint32_t` number of ticks.
+ *
+ * Defaults to the platform clock in milliseconds. Most jobs complete in less than a millisecond, so
+ * this may be mapped to a finer clock, such as `iot_perfcounter_get_value` of the common I/O library.
+ * Only differences between two readings are recorded, so the clock may wrap around.
+ */
+#ifndef IotTaskPool_InstrumentationTime
+    #define IotTaskPool_InstrumentationTime()    ( ( uint32_t ) IotClock_GetTimeMs() )
+#endif
+
 #endif /* ifndef IOT_TASKPOOL_H_ */
@@ -49,6 +49,12 @@
  * @function_brief{static_memory_function_init}
  * - @function_name{static_memory_function_cleanup}
  * @function_brief{static_memory_function_cleanup}
+ * - @function_name{static_memory_function_alloc}
+ * @function_brief{static_memory_function_alloc}
+ * - @function_name{static_memory_function_free}
+ * @function_brief{static_memory_function_free}
+ * - @function_name{static_memory_function_getstats}
+ * @function_brief{static_memory_function_getstats}
  * - @function_name{static_memory_function_findfree}
  * @function_brief{static_memory_function_findfree}
  * - @function_name{static_memory_function_returninuse}
@@ -59,8 +65,94 @@
  * @function_brief{static_memory_function_mallocmessagebuffer}
  * - @function_name{static_memory_function_freemessagebuffer}
  * @function_brief{static_memory_function_freemessagebuffer}
+ * - @function_name{static_memory_function_messagebufferstats}
+ * @function_brief{static_memory_function_messagebufferstats}
  */
 
+/*------------------------------ Pool data types ----------------------------*/
+
+/**
+ * @brief A fixed-size pool of statically-allocated objects.
+ *
+ * Each object of the pool has one bit in a bitmap of "in-use" flags. Objects
+ * are allocated by atomically setting the lowest clear bit and returned by
+ * atomically clearing their bit, so no lock is taken and allocation costs one
+ * bit scan per 32 objects. Pools should be initialized with
+ * #IOT_STATIC_MEMORY_POOL_INITIALIZER.
+ */
+    typedef struct IotStaticMemoryPool
+    {
+        void * pElements;        /**< @brief The statically-allocated objects. */
+        uint32_t * pInUse;       /**< @brief Bitmap of in-use flags, one bit per object. */
+        size_t elementSize;      /**< @brief Size of one object. */
+        size_t elementCount;     /**< @brief Number of objects in the pool. */
+        uint32_t inUse;          /**< @brief Number of objects currently allocated. */
+        uint32_t highWaterMark;  /**< @brief Largest number of objects allocated at once. */
+        uint32_t failures;       /**< @brief Number of allocations that found no free object. */
+    } IotStaticMemoryPool_t;
+
+/**
+ * @brief Occupancy statistics of an #IotStaticMemoryPool_t.
+ *
+ * These may be used to right-size the configuration constants of static pools,
+ * such as @ref IOT_MESSAGE_BUFFERS.
+ */
+    typedef struct IotStaticMemoryStats
+    {
+        size_t elementSize;     /**< @brief Size of one object. */
+        size_t elementCount;    /**< @brief Number of objects in the pool. */
+        uint32_t inUse;         /**< @brief Number of objects currently allocated. */
+        uint32_t highWaterMark; /**< @brief Largest number of objects allocated at once. */
+        uint32_t failures;      /**< @brief Number of allocations that found no free object. */
+    } IotStaticMemoryStats_t;
+
+/**
+ * @brief Number of `uint32_t` words in the in-use bitmap of a pool.
+ *
+ * @param[in] elementCount Number of objects in the pool.
+ */
+    #define IOT_STATIC_MEMORY_POOL_WORDS( elementCount )    ( ( ( elementCount ) + 31 ) / 32 )
+
+/**
+ * @brief Initializer for an #IotStaticMemoryPool_t.
+ *
+ * @param[in] pObjects Array of statically-allocated objects.
+ * @param[in] pInUseBitmap Zeroed `uint32_t` array of #IOT_STATIC_MEMORY_POOL_WORDS
+ * elements.
+ * @param[in] objectSize Size of one object of `pObjects`.
+ * @param[in] objectCount Number of objects of `pObjects`.
+ *
+ * <b>Example</b>:
+ * @code{c}
+ * #define NUMBER_OF_OBJECTS    ...
+ * static uint32_t _pInUseObjects[ IOT_STATIC_MEMORY_POOL_WORDS( NUMBER_OF_OBJECTS ) ] = { 0 };
+ * static Object_t _pObjects[ NUMBER_OF_OBJECTS ] = { { 0 } };
+ * static IotStaticMemoryPool_t _objectPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pObjects,
+ *                                                                                _pInUseObjects,
+ *                                                                                sizeof( Object_t ),
+ *                                                                                NUMBER_OF_OBJECTS );
+ *
+ * void * Iot_MallocObject( size_t size )
+ * {
+ *     void * pNewObject = NULL;
+ *
+ *     if( size == sizeof( Object_t ) )
+ *     {
+ *         pNewObject = IotStaticMemory_Alloc( &_objectPool );
+ *     }
+ *
+ *     return pNewObject;
+ * }
+ *
+ * void Iot_FreeObject( void * ptr )
+ * {
+ *     IotStaticMemory_Free( &_objectPool, ptr );
+ * }
+ * @endcode
+ */
+    #define IOT_STATIC_MEMORY_POOL_INITIALIZER( pObjects, pInUseBitmap, objectSize, objectCount ) \
+    { ( void * ) ( pObjects ), ( pInUseBitmap ), ( objectSize ), ( objectCount ), 0, 0, 0 }
+
 /*----------------------- Initialization and cleanup ------------------------*/
 
 /**
@@ -112,6 +204,60 @@
     void IotStaticMemory_Cleanup( void );
 /* @[declare_static_memory_cleanup] */
 
+/*--------------------------- Pool allocation and free ----------------------*/
+
+/**
+ * @function_page{IotStaticMemory_Alloc,static_memory,alloc}
+ * @function_snippet{static_memory,alloc,this}
+ * @copydoc IotStaticMemory_Alloc
+ * @function_page{IotStaticMemory_Free,static_memory,free}
+ * @function_snippet{static_memory,free,this}
+ * @copydoc IotStaticMemory_Free
+ * @function_page{IotStaticMemory_GetStats,static_memory,getstats}
+ * @function_snippet{static_memory,getstats,this}
+ * @copydoc IotStaticMemory_GetStats
+ */
+
+/**
+ * @brief Allocate an object from a static memory pool.
+ *
+ * This function is lock-free and may be called concurrently on the same pool.
+ * Objects are always zeroed when allocated.
+ *
+ * @param[in] pPool The pool to allocate from.
+ *
+ * @return Pointer to the allocated object; `NULL` if all objects are in-use.
+ */
+/* @[declare_static_memory_alloc] */
+    void * IotStaticMemory_Alloc( IotStaticMemoryPool_t * pPool );
+/* @[declare_static_memory_alloc] */
+
+/**
+ * @brief Return an object to the static memory pool it was allocated from.
+ *
+ * The object is cleared, then made available for allocation. Pointers that are
+ * not in-use objects of `pPool` are ignored. This function runs in constant time
+ * and is lock-free.
+ *
+ * @param[in] pPool The pool that `ptr` was allocated from.
+ * @param[in] ptr Pointer to the object to return.
+ */
+/* @[declare_static_memory_free] */
+    void IotStaticMemory_Free( IotStaticMemoryPool_t * pPool,
+                               void * ptr );
+/* @[declare_static_memory_free] */
+
+/**
+ * @brief Read the occupancy statistics of a static memory pool.
+ *
+ * @param[in] pPool The pool to read.
+ * @param[out] pStats Set to the statistics of `pPool`.
+ */
+/* @[declare_static_memory_getstats] */
+    void IotStaticMemory_GetStats( const IotStaticMemoryPool_t * pPool,
+                                   IotStaticMemoryStats_t * pStats );
+/* @[declare_static_memory_getstats] */
+
 /*------------------------- Buffer allocation and free ----------------------*/
 
 /**
@@ -129,6 +275,9 @@
  * If a free buffer is found, this function marks the buffer in-use. This function
  * is common to the static memory implementation.
  *
+ * @note This function scans `pInUse` linearly while holding a global mutex. It is
+ * kept for existing pools; new pools should use an #IotStaticMemoryPool_t instead.
+ *
  * @param[in] pInUse The "in-use" flags to search.
  * @param[in] limit How many flags to check, i.e. the size of `pInUse`.
  *
@@ -224,6 +373,9 @@
  * @function_page{Iot_FreeMessageBuffer,static_memory,freemessagebuffer}
  * @function_snippet{static_memory,freemessagebuffer,this}
  * @copydoc Iot_FreeMessageBuffer
+ * @function_page{Iot_MessageBufferStats,static_memory,messagebufferstats}
+ * @function_snippet{static_memory,messagebufferstats,this}
+ * @copydoc Iot_MessageBufferStats
  */
 
 /**
@@ -248,9 +400,14 @@
  *
  * @param[in] size Requested size for a message buffer.
  *
+ * Message buffers are kept in size classes: small, medium, standard
+ * (@ref IOT_MESSAGE_BUFFER_SIZE) and an optional jumbo class for large payloads.
+ * The request is served from the smallest class that fits `size`; if that class
+ * is exhausted, the next larger class is tried.
+ *
  * @return Pointer to the start of a message buffer. If the `size` argument is larger
- * than the [fixed size of a message buffer](@ref IOT_MESSAGE_BUFFER_SIZE)
- * or no message buffers are available, `NULL` is returned.
+ * than the largest size class or no message buffers that fit are available, `NULL`
+ * is returned.
  */
 /* @[declare_static_memory_mallocmessagebuffer] */
     void * Iot_MallocMessageBuffer( size_t size );
@@ -263,10 +420,29 @@
  * (http://pubs.opengroup.org/onlinepubs/9699919799/functions/free.html)
  * for message buffers.
  *
- * @param[in] ptr Pointer to the message buffer to free.
+ * @param[in] ptr Pointer to the message buffer to free. Its size class is
+ * found from its address.
  */
 /* @[declare_static_memory_freemessagebuffer] */
     void Iot_FreeMessageBuffer( void * ptr );
 /* @[declare_static_memory_freemessagebuffer] */
 
+/**
+ * @brief Read the occupancy statistics of the message buffer size classes.
+ *
+ * The high-water mark and the number of failed allocations of each class show
+ * whether its buffer count is larger or smaller than an application needs.
+ *
+ * @param[out] pStats Array set to the statistics of each size class, in ascending
+ * order of @ref IotStaticMemoryStats_t.elementSize.
+ * @param[in] statsCount The number of elements in `pStats`. At most this many
+ * classes are written.
+ *
+ * @return The number of message buffer size classes.
+ */
+/* @[declare_static_memory_messagebufferstats] */
+    size_t Iot_MessageBufferStats( IotStaticMemoryStats_t * pStats,
+                                   size_t statsCount );
+/* @[declare_static_memory_messagebufferstats] */
+
 #endif /* if !defined( IOT_STATIC_MEMORY_H_ ) && ( IOT_STATIC_MEMORY_ONLY == 1 ) */
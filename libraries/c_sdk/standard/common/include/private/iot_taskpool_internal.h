@@ -222,17 +222,114 @@
 /**
  * @brief Task pool jobs cache.
  *
+ * The cache is a lock-free stack of jobs linked through the `pNext` pointer of their link.
+ * Jobs are pushed with a compare-and-swap on the head of the stack. Popping is restricted to
+ * one thread at a time with the `popLock` flag, which rules out the ABA problem of lock-free
+ * stacks; a thread that finds the flag taken does not wait, and allocates a job from the heap instead.
+ *
  * @warning This is a system-level data type that should not be modified or used directly in any application.
  * @warning This is a system-level data type that can and will change across different versions of the platform, with no regards for backward compatibility.
  *
  */
 typedef struct _taskPoolCache
 {
-    IotListDouble_t freeList; /**< @brief A list ot hold cached jobs. */
+    void * volatile pFreeList;  /**< @brief The link of the job at the top of the stack of cached jobs. */
+    uint32_t popLock;           /**< @brief Set while a thread is popping a job from the stack. */
 
-    uint32_t freeCount;       /**< @brief A counter to track the number of jobs in the cache. */
+    uint32_t freeCount;         /**< @brief A counter to track the number of jobs in the cache. */
+    uint32_t hits;              /**< @brief The number of jobs taken from the cache. */
+    uint32_t misses;            /**< @brief The number of jobs that could not be taken from the cache. */
+    uint32_t mallocFallbacks;   /**< @brief The number of jobs allocated from the heap after a miss. */
 } _taskPoolCache_t;
 
+/**
+ * @brief The number of bits of a timer wheel tick that index the slots of one level of the wheel.
+ *
+ * The occupied slots of each level are tracked in a 32-bit mask, so this value must not be changed.
+ */
+#define TASKPOOL_TIMER_WHEEL_SLOT_BITS    ( 5UL )
+
+/**
+ * @brief The number of slots in each level of the timer wheel.
+ */
+#define TASKPOOL_TIMER_WHEEL_SLOTS        ( 1UL << TASKPOOL_TIMER_WHEEL_SLOT_BITS )
+
+/**
+ * @brief The slot of a timer event that is in the overflow list of the timer wheel.
+ */
+#define TASKPOOL_TIMER_WHEEL_OVERFLOW     ( IOT_TASKPOOL_TIMER_WHEEL_LEVELS * TASKPOOL_TIMER_WHEEL_SLOTS )
+
+/**
+ * @brief A hierarchical timer wheel holding the timer events of the deferred jobs of a task pool.
+ *
+ * Time is counted in ticks of #IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS. A timer event is linked in the lowest
+ * level whose slots span its expiration tick, so inserting and removing an event are constant time operations.
+ * As the wheel turns, the events in the slots of the upper levels are moved down to the lower levels, and the
+ * events in the slots of the lowest level expire.
+ *
+ * @warning This is a system-level data type that should not be modified or used directly in any application.
+ * @warning This is a system-level data type that can and will change across different versions of the platform, with no regards for backward compatibility.
+ *
+ */
+typedef struct _taskPoolTimerWheel
+{
+    IotListDouble_t slots[ IOT_TASKPOOL_TIMER_WHEEL_LEVELS ][ TASKPOOL_TIMER_WHEEL_SLOTS ]; /**< @brief The timer events, per level and slot. */
+    uint32_t occupiedSlots[ IOT_TASKPOOL_TIMER_WHEEL_LEVELS ];                              /**< @brief A mask of the non-empty slots of each level. */
+    IotListDouble_t overflow;                                                               /**< @brief The timer events expiring beyond the span of the wheel. */
+    uint64_t currentTick;                                                                   /**< @brief The tick up to which all timer events have expired. */
+    uint32_t eventCount;                                                                    /**< @brief The number of timer events in the wheel. */
+    uint64_t armedTime;                                                                     /**< @brief When the timer is due to fire, or 0 if it is not armed. */
+} _taskPoolTimerWheel_t;
+
+/**
+ * @brief The number of classes of jobs, see #IotTaskPoolJobClass_t.
+ */
+#define TASKPOOL_JOB_CLASSES    ( 3UL )
+
+/**
+ * @brief The number of buckets each power of two is split into by the histograms of the
+ * task pool instrumentation, see #IotTaskPoolHistogram_t.
+ */
+#define TASKPOOL_HISTOGRAM_SUB_BUCKETS    ( 4UL )
+
+/**
+ * @brief The dispatch queue and the statistics of one class of jobs.
+ *
+ * The statistics are updated with atomic operations, since the workers of a task pool using the
+ * work-stealing dispatcher pick up jobs without holding the task pool lock.
+ *
+ * @warning This is a system-level data type that should not be modified or used directly in any application.
+ * @warning This is a system-level data type that can and will change across different versions of the platform, with no regards for backward compatibility.
+ *
+ */
+typedef struct _taskPoolJobClassQueue
+{
+    IotDeQueue_t jobs;    /**< @brief The jobs of the class waiting to be executed, for a task pool using the shared queue. */
+    uint32_t depth;       /**< @brief The number of jobs of the class waiting to be executed. */
+    uint32_t dispatched;  /**< @brief The number of jobs of the class picked up by a worker. */
+    uint32_t totalWaitMs; /**< @brief The sum of the wait times of the dispatched jobs of the class. */
+    uint32_t maxWaitMs;   /**< @brief The longest wait time of a dispatched job of the class. */
+} _taskPoolJobClassQueue_t;
+
+#if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+
+/**
+ * @brief One per-worker dispatch queue of a task pool using the work-stealing dispatcher.
+ *
+ * A job in a worker queue can only transition from 'scheduled' to 'executing' while holding
+ * the lock of the worker queue, so the status of a scheduled job is stable under that lock.
+ *
+ * @warning This is a system-level data type that should not be modified or used directly in any application.
+ * @warning This is a system-level data type that can and will change across different versions of the platform, with no regards for backward compatibility.
+ *
+ */
+    typedef struct _taskPoolWorkerQueue
+    {
+        IotDeQueue_t jobs; /**< @brief The jobs waiting to be executed, served from the head by the owner and from the tail by thieves. */
+        IotMutex_t lock;   /**< @brief The lock to protect the queue and the status of the jobs in it. */
+    } _taskPoolWorkerQueue_t;
+#endif /* if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1 */
+
 /**
  * @brief The task pool data structure keeps track of the internal state and the signals for the dispatcher threads.
  * The task pool is a thread safe data structure.
@@ -243,19 +340,36 @@ typedef struct _taskPoolCache
  */
 typedef struct _taskPool
 {
-    IotDeQueue_t dispatchQueue;      /**< @brief The queue for the jobs waiting to be executed. */
-    IotListDouble_t timerEventsList; /**< @brief The timeouts queue for all deferred jobs waiting to be executed. */
+    _taskPoolJobClassQueue_t classQueues[ TASKPOOL_JOB_CLASSES ]; /**< @brief The queues for the jobs waiting to be executed, one per class. */
+    uint32_t currentClass;                                        /**< @brief The class of jobs currently served. */
+    uint32_t classCredits;                                        /**< @brief The number of jobs the current class may still have dispatched in a row. */
+    _taskPoolTimerWheel_t timerWheel; /**< @brief The timeouts for all deferred jobs waiting to be executed. */
     _taskPoolCache_t jobsCache;      /**< @brief A cache to re-use jobs in order to limit memory allocations. */
     uint32_t minThreads;             /**< @brief The minimum number of threads for the task pool. */
     uint32_t maxThreads;             /**< @brief The maximum number of threads for the task pool. */
     uint32_t activeThreads;          /**< @brief The number of threads in the task pool at any given time. */
     uint32_t activeJobs;             /**< @brief The number of active jobs in the task pool at any given time. */
+    uint32_t growQueueDepth;         /**< @brief The number of active jobs in excess of the threads that grows the task pool. */
+    uint32_t growWaitMs;             /**< @brief The wait time of a job that grows the task pool, or 0. */
+    uint32_t lingerMs;               /**< @brief How long an idle thread waits for a job before it may exit. */
     uint32_t stackSize;              /**< @brief The stack size for all task pool threads. */
     int32_t priority;                /**< @brief The priority for all task pool threads. */
     IotSemaphore_t dispatchSignal;   /**< @brief The synchronization object on which threads are waiting for incoming jobs. */
     IotSemaphore_t startStopSignal;  /**< @brief The synchronization object for threads to signal start and stop condition. */
     IotTimer_t timer;                /**< @brief The timer for deferred jobs. */
     IotMutex_t lock;                 /**< @brief The lock to protect the task pool data structure access. */
+    IotTaskPoolDispatchMode_t dispatchMode; /**< @brief How jobs are dispatched to the worker threads. */
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        _taskPoolWorkerQueue_t workerQueues[ IOT_TASKPOOL_WORKER_QUEUES ]; /**< @brief The per-worker queues for the work-stealing dispatcher. */
+        uint32_t nextWorkerQueue;                                          /**< @brief The worker queue that receives the next scheduled job. */
+        uint32_t nextHomeQueue;                                            /**< @brief The home queue of the next worker thread to start. */
+    #endif
+    #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+        IotTaskPoolHistogram_t waitTime; /**< @brief The wait times of the jobs dispatched by the task pool. */
+        IotTaskPoolHistogram_t runTime;  /**< @brief The run times of the jobs executed by the task pool. */
+        uint32_t peakActiveJobs;         /**< @brief The largest number of active jobs so far. */
+        uint32_t peakActiveThreads;      /**< @brief The largest number of threads so far. */
+    #endif
 } _taskPool_t;
 
 /**
@@ -272,19 +386,29 @@ typedef struct _taskPoolJob
     void * pUserContext;               /**< @brief The user provided context. */
     uint32_t flags;                    /**< @brief Internal flags. */
     IotTaskPoolJobStatus_t status;     /**< @brief The status for the job. */
+    struct _taskPoolTimerEvent * pTimerEvent; /**< @brief The timer event of the job while it is deferred. */
+    uint32_t jobClass;                 /**< @brief The class of the job, see #IotTaskPoolJobClass_t. */
+    uint32_t queuedTime;               /**< @brief When the job was queued for dispatch, in milliseconds. */
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        uint32_t queueIndex;           /**< @brief The worker queue holding the job while it is scheduled. */
+    #endif
+    #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+        uint32_t queuedTicks;          /**< @brief When the job was queued for dispatch, in ticks of @ref IotTaskPool_InstrumentationTime. */
+    #endif
 } _taskPoolJob_t;
 
 /**
  * @brief Represents an operation that is subject to a timer.
  *
- * These events are queued per MQTT connection. They are sorted by their
- * expiration time.
+ * These events are held in the timer wheel of the task pool, in the slot
+ * matching their expiration time.
  */
 typedef struct _taskPoolTimerEvent
 {
     IotLink_t link;          /**< @brief List link member. */
     uint64_t expirationTime; /**< @brief When this event should be processed. */
     _taskPoolJob_t * pJob;   /**< @brief The task pool job associated with this event. */
+    uint32_t slot;           /**< @brief The slot of the timer wheel holding this event. */
 } _taskPoolTimerEvent_t;
 
 #endif /* ifndef IOT_TASKPOOL_INTERNAL_H_ */
@@ -196,6 +196,62 @@ typedef enum IotTaskPoolJobStatus
     IOT_TASKPOOL_STATUS_UNDEFINED,
 } IotTaskPoolJobStatus_t;
 
+/**
+ * @ingroup taskpool_datatypes_enums
+ * @brief Dispatcher modes of a [task pool](@ref IotTaskPool_t).
+ *
+ * The dispatcher mode is selected through #IotTaskPoolInfo_t.dispatchMode when the
+ * task pool is created, and it cannot be changed afterwards.
+ */
+typedef enum IotTaskPoolDispatchMode
+{
+    /**
+     * @brief All worker threads share one dispatch queue protected by the task pool lock.
+     *
+     * This is the default mode.
+     */
+    IOT_TASKPOOL_DISPATCH_SHARED_QUEUE = 0,
+
+    /**
+     * @brief Every worker thread serves its own dispatch queue, and steals jobs from the
+     * queues of other workers when its own queue is empty.
+     *
+     * @note This mode is only available when @ref IOT_TASKPOOL_ENABLE_WORK_STEALING is `1`.
+     */
+    IOT_TASKPOOL_DISPATCH_WORK_STEALING
+} IotTaskPoolDispatchMode_t;
+
+/**
+ * @ingroup taskpool_datatypes_enums
+ * @brief Classes of jobs, served in weighted round-robin order by the task pool.
+ *
+ * A task pool keeps one queue of scheduled jobs per class. Each class may have up to its weight
+ * in jobs dispatched in a row before the next class is served, so that a burst of jobs in one class
+ * cannot starve the other classes. The weights are set with @ref IOT_TASKPOOL_JOB_CLASS_NORMAL_WEIGHT,
+ * @ref IOT_TASKPOOL_JOB_CLASS_CONTROL_WEIGHT and @ref IOT_TASKPOOL_JOB_CLASS_BULK_WEIGHT.
+ *
+ * The class of a job is set with @ref taskpool_function_setjobclass.
+ */
+typedef enum IotTaskPoolJobClass
+{
+    /**
+     * @brief The class of all jobs, unless set otherwise.
+     */
+    IOT_TASKPOOL_JOB_CLASS_NORMAL = 0,
+
+    /**
+     * @brief Short, latency-sensitive jobs, such as keep-alive processing.
+     *
+     * With the work-stealing dispatcher, jobs in this class are queued ahead of other jobs instead.
+     */
+    IOT_TASKPOOL_JOB_CLASS_CONTROL,
+
+    /**
+     * @brief Jobs that come in bursts, such as the processing of incoming messages.
+     */
+    IOT_TASKPOOL_JOB_CLASS_BULK
+} IotTaskPoolJobClass_t;
+
 /*------------------------- Task pool types and handles --------------------------*/
 
 /**
@@ -231,6 +287,15 @@ typedef struct IotTaskPoolJobStorage
     void * dummy3;                 /**< @brief Placeholder. */
     uint32_t dummy4;               /**< @brief Placeholder. */
     IotTaskPoolJobStatus_t status; /**< @brief Placeholder. */
+    void * dummy5;                 /**< @brief Placeholder. */
+    uint32_t dummy6;               /**< @brief Placeholder. */
+    uint32_t dummy7;               /**< @brief Placeholder. */
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        uint32_t dummy8;           /**< @brief Placeholder. */
+    #endif
+    #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+        uint32_t dummy9;           /**< @brief Placeholder. */
+    #endif
 } IotTaskPoolJobStorage_t;
 
 /**
@@ -289,8 +354,118 @@ typedef struct IotTaskPoolInfo
     uint32_t maxThreads; /**< @brief Maximum number of threads in a task pool. A task pool may try and grow the number of active threads up to #IotTaskPoolInfo_t.maxThreads. */
     uint32_t stackSize;  /**< @brief Stack size for every task pool thread. The stack size for each thread is fixed after the task pool is created and cannot be changed. */
     int32_t priority;    /**< @brief priority for every task pool thread. The priority for each thread is fixed after the task pool is created and cannot be changed. */
+
+    /**
+     * @brief How jobs are dispatched to the worker threads of the task pool.
+     *
+     * Defaults to #IOT_TASKPOOL_DISPATCH_SHARED_QUEUE when left zero-initialized. Selecting
+     * #IOT_TASKPOOL_DISPATCH_WORK_STEALING when @ref IOT_TASKPOOL_ENABLE_WORK_STEALING is not `1`
+     * causes task pool creation to fail with #IOT_TASKPOOL_BAD_PARAMETER.
+     */
+    IotTaskPoolDispatchMode_t dispatchMode;
+
+    /**
+     * @brief The task pool grows when the number of scheduled and executing jobs exceeds the number of
+     * worker threads by this much.
+     *
+     * Left zero-initialized, the task pool grows as soon as every worker thread is busy. Larger values let short
+     * bursts of jobs queue up rather than create worker threads that would only live for #IotTaskPoolInfo_t.lingerMs.
+     */
+    uint32_t growQueueDepth;
+
+    /**
+     * @brief The task pool also grows when a job has been waiting for a worker thread for this many milliseconds.
+     *
+     * The wait time is checked when jobs are scheduled and when worker threads pick up jobs. Task pools using
+     * #IOT_TASKPOOL_DISPATCH_WORK_STEALING only check it when worker threads pick up jobs. Left zero-initialized,
+     * wait times do not grow the task pool.
+     */
+    uint32_t growWaitMs;
+
+    /**
+     * @brief How long, in milliseconds, a worker thread stays idle before exiting, when there are more than
+     * #IotTaskPoolInfo_t.minThreads worker threads.
+     *
+     * Left zero-initialized, idle worker threads linger for #IOT_TASKPOOL_JOB_WAIT_TIMEOUT_MS.
+     */
+    uint32_t lingerMs;
 } IotTaskPoolInfo_t;
 
+/**
+ * @ingroup taskpool_datatypes_paramstructs
+ * @brief Statistics of the recyclable jobs cache of a task pool.
+ *
+ * @paramfor @ref taskpool_function_getjobcachestats
+ *
+ * The counters are updated without locking and wrap around on overflow. They are meant for
+ * tuning #IOT_TASKPOOL_JOBS_RECYCLE_LIMIT rather than for exact accounting.
+ */
+typedef struct IotTaskPoolJobCacheStats
+{
+    uint32_t hits;            /**< @brief Number of recyclable jobs taken from the cache. */
+    uint32_t misses;          /**< @brief Number of recyclable jobs that could not be taken from the cache. */
+    uint32_t mallocFallbacks; /**< @brief Number of recyclable jobs allocated from the heap after a miss. */
+    uint32_t freeCount;       /**< @brief Number of jobs in the cache. */
+} IotTaskPoolJobCacheStats_t;
+
+/**
+ * @ingroup taskpool_datatypes_paramstructs
+ * @brief Statistics of one class of jobs of a task pool.
+ *
+ * @paramfor @ref taskpool_function_getjobclassstats
+ *
+ * Wait times are measured from the time a job is scheduled, or from the time a deferred job expires,
+ * to the time a worker thread picks it up. The counters wrap around on overflow.
+ */
+typedef struct IotTaskPoolJobClassStats
+{
+    uint32_t depth;       /**< @brief Number of jobs of the class waiting to be executed. */
+    uint32_t dispatched;  /**< @brief Number of jobs of the class picked up by a worker thread. */
+    uint32_t totalWaitMs; /**< @brief Sum of the wait times of the dispatched jobs of the class. */
+    uint32_t maxWaitMs;   /**< @brief Longest wait time of a dispatched job of the class. */
+} IotTaskPoolJobClassStats_t;
+
+/**
+ * @brief The number of buckets of a #IotTaskPoolHistogram_t.
+ *
+ * Values below 8 have a bucket each. Every following power of two is split into 4 buckets
+ * of equal width, and the last bucket holds all values from 114688 up.
+ */
+#define IOT_TASKPOOL_HISTOGRAM_BUCKETS    ( 64 )
+
+/**
+ * @ingroup taskpool_datatypes_paramstructs
+ * @brief A log-linear histogram of durations measured by the task pool instrumentation.
+ *
+ * The bucket of a value is at most 25% wider than the value, so percentiles read from the histogram with
+ * @ref taskpool_function_histogrampercentile are within 25% of the exact percentiles.
+ */
+typedef struct IotTaskPoolHistogram
+{
+    uint32_t count;                                     /**< @brief Number of recorded values. */
+    uint32_t max;                                       /**< @brief Largest recorded value. */
+    uint32_t buckets[ IOT_TASKPOOL_HISTOGRAM_BUCKETS ]; /**< @brief Number of recorded values in each bucket. */
+} IotTaskPoolHistogram_t;
+
+/**
+ * @ingroup taskpool_datatypes_paramstructs
+ * @brief A snapshot of the instrumentation of a task pool.
+ *
+ * @paramfor @ref taskpool_function_getinstrumentation
+ *
+ * Durations are expressed in ticks of @ref IotTaskPool_InstrumentationTime, which are milliseconds
+ * unless configured otherwise.
+ */
+typedef struct IotTaskPoolInstrumentation
+{
+    IotTaskPoolHistogram_t waitTime; /**< @brief Time from scheduling a job, or from the expiration of a deferred job, to its start. */
+    IotTaskPoolHistogram_t runTime;  /**< @brief Time from the start of a job to the return of its callback. */
+    uint32_t activeJobs;             /**< @brief Number of jobs waiting or executing. */
+    uint32_t activeThreads;          /**< @brief Number of worker threads. */
+    uint32_t peakActiveJobs;         /**< @brief Largest number of jobs waiting or executing at the same time. */
+    uint32_t peakActiveThreads;      /**< @brief Largest number of worker threads at the same time. */
+} IotTaskPoolInstrumentation_t;
+
 /*------------------------- TASKPOOL defined constants --------------------------*/
 
 /**
@@ -43,6 +43,9 @@
 /* Platform layer includes. */
     #include "platform/iot_threads.h"
 
+/* Atomics include. */
+    #include "iot_atomic.h"
+
 /* Static memory include. */
     #include "private/iot_static_memory.h"
 
@@ -52,13 +55,32 @@
  * @cond DOXYGEN_IGNORE
  * Doxygen should ignore this section.
  *
- * Provide default values for undefined configuration constants.
+ * Provide default values for undefined configuration constants. The default
+ * size classes take 8 KB in total: 7 standard, 8 small and 2 medium buffers.
  */
     #ifndef IOT_MESSAGE_BUFFERS
-        #define IOT_MESSAGE_BUFFERS        ( 8 )
+        #define IOT_MESSAGE_BUFFERS                ( 7 )
     #endif
     #ifndef IOT_MESSAGE_BUFFER_SIZE
-        #define IOT_MESSAGE_BUFFER_SIZE    ( 1024 )
+        #define IOT_MESSAGE_BUFFER_SIZE            ( 1024 )
+    #endif
+    #ifndef IOT_MESSAGE_BUFFERS_SMALL
+        #define IOT_MESSAGE_BUFFERS_SMALL          ( 8 )
+    #endif
+    #ifndef IOT_MESSAGE_BUFFER_SMALL_SIZE
+        #define IOT_MESSAGE_BUFFER_SMALL_SIZE      ( 64 )
+    #endif
+    #ifndef IOT_MESSAGE_BUFFERS_MEDIUM
+        #define IOT_MESSAGE_BUFFERS_MEDIUM         ( 2 )
+    #endif
+    #ifndef IOT_MESSAGE_BUFFER_MEDIUM_SIZE
+        #define IOT_MESSAGE_BUFFER_MEDIUM_SIZE     ( 256 )
+    #endif
+    #ifndef IOT_MESSAGE_BUFFERS_JUMBO
+        #define IOT_MESSAGE_BUFFERS_JUMBO          ( 0 )
+    #endif
+    #ifndef IOT_MESSAGE_BUFFER_JUMBO_SIZE
+        #define IOT_MESSAGE_BUFFER_JUMBO_SIZE      ( 4096 )
     #endif
 /** @endcond */
 
@@ -69,6 +91,35 @@
     #if IOT_MESSAGE_BUFFER_SIZE <= 0
         #error "IOT_MESSAGE_BUFFER_SIZE cannot be 0 or negative."
     #endif
+    #if IOT_MESSAGE_BUFFERS_SMALL < 0
+        #error "IOT_MESSAGE_BUFFERS_SMALL cannot be negative."
+    #endif
+    #if IOT_MESSAGE_BUFFERS_MEDIUM < 0
+        #error "IOT_MESSAGE_BUFFERS_MEDIUM cannot be negative."
+    #endif
+    #if IOT_MESSAGE_BUFFERS_JUMBO < 0
+        #error "IOT_MESSAGE_BUFFERS_JUMBO cannot be negative."
+    #endif
+    #if ( IOT_MESSAGE_BUFFERS_SMALL > 0 ) && ( ( IOT_MESSAGE_BUFFER_SMALL_SIZE <= 0 ) || ( IOT_MESSAGE_BUFFER_SMALL_SIZE >= IOT_MESSAGE_BUFFER_SIZE ) )
+        #error "IOT_MESSAGE_BUFFER_SMALL_SIZE must be positive and less than IOT_MESSAGE_BUFFER_SIZE."
+    #endif
+    #if ( IOT_MESSAGE_BUFFERS_MEDIUM > 0 ) && ( ( IOT_MESSAGE_BUFFER_MEDIUM_SIZE <= 0 ) || ( IOT_MESSAGE_BUFFER_MEDIUM_SIZE >= IOT_MESSAGE_BUFFER_SIZE ) )
+        #error "IOT_MESSAGE_BUFFER_MEDIUM_SIZE must be positive and less than IOT_MESSAGE_BUFFER_SIZE."
+    #endif
+    #if ( IOT_MESSAGE_BUFFERS_SMALL > 0 ) && ( IOT_MESSAGE_BUFFERS_MEDIUM > 0 ) && ( IOT_MESSAGE_BUFFER_SMALL_SIZE >= IOT_MESSAGE_BUFFER_MEDIUM_SIZE )
+        #error "IOT_MESSAGE_BUFFER_SMALL_SIZE must be less than IOT_MESSAGE_BUFFER_MEDIUM_SIZE."
+    #endif
+    #if ( IOT_MESSAGE_BUFFERS_JUMBO > 0 ) && ( IOT_MESSAGE_BUFFER_JUMBO_SIZE <= IOT_MESSAGE_BUFFER_SIZE )
+        #error "IOT_MESSAGE_BUFFER_JUMBO_SIZE must be greater than IOT_MESSAGE_BUFFER_SIZE."
+    #endif
+
+/**
+ * @brief The number of message buffer size classes.
+ */
+    #define MESSAGE_BUFFER_CLASSES                                \
+    ( ( ( IOT_MESSAGE_BUFFERS_SMALL > 0 ) ? 1 : 0 ) +             \
+      ( ( IOT_MESSAGE_BUFFERS_MEDIUM > 0 ) ? 1 : 0 ) + 1 +        \
+      ( ( IOT_MESSAGE_BUFFERS_JUMBO > 0 ) ? 1 : 0 ) )
 
 /*-----------------------------------------------------------*/
 
@@ -80,8 +131,226 @@
 /*
  * Static memory buffers and flags, allocated and zeroed at compile-time.
  */
-    static bool _pInUseMessageBuffers[ IOT_MESSAGE_BUFFERS ] = { 0 };                           /**< @brief Message buffer in-use flags. */
-    static char _pMessageBuffers[ IOT_MESSAGE_BUFFERS ][ IOT_MESSAGE_BUFFER_SIZE ] = { { 0 } }; /**< @brief Message buffers. */
+    static uint32_t _pInUseMessageBuffers[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_MESSAGE_BUFFERS ) ] = { 0 }; /**< @brief Message buffer in-use flags. */
+    static char _pMessageBuffers[ IOT_MESSAGE_BUFFERS ][ IOT_MESSAGE_BUFFER_SIZE ] = { { 0 } };           /**< @brief Message buffers. */
+
+/** @brief Pool of message buffers of #IOT_MESSAGE_BUFFER_SIZE. */
+    static IotStaticMemoryPool_t _messageBufferPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pMessageBuffers,
+                                                                                          _pInUseMessageBuffers,
+                                                                                          IOT_MESSAGE_BUFFER_SIZE,
+                                                                                          IOT_MESSAGE_BUFFERS );
+
+    #if IOT_MESSAGE_BUFFERS_SMALL > 0
+        static uint32_t _pInUseSmallMessageBuffers[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_MESSAGE_BUFFERS_SMALL ) ] = { 0 };    /**< @brief Small message buffer in-use flags. */
+        static char _pSmallMessageBuffers[ IOT_MESSAGE_BUFFERS_SMALL ][ IOT_MESSAGE_BUFFER_SMALL_SIZE ] = { { 0 } };         /**< @brief Small message buffers. */
+
+/** @brief Pool of message buffers of #IOT_MESSAGE_BUFFER_SMALL_SIZE. */
+        static IotStaticMemoryPool_t _smallMessageBufferPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pSmallMessageBuffers,
+                                                                                                   _pInUseSmallMessageBuffers,
+                                                                                                   IOT_MESSAGE_BUFFER_SMALL_SIZE,
+                                                                                                   IOT_MESSAGE_BUFFERS_SMALL );
+    #endif
+
+    #if IOT_MESSAGE_BUFFERS_MEDIUM > 0
+        static uint32_t _pInUseMediumMessageBuffers[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_MESSAGE_BUFFERS_MEDIUM ) ] = { 0 }; /**< @brief Medium message buffer in-use flags. */
+        static char _pMediumMessageBuffers[ IOT_MESSAGE_BUFFERS_MEDIUM ][ IOT_MESSAGE_BUFFER_MEDIUM_SIZE ] = { { 0 } };     /**< @brief Medium message buffers. */
+
+/** @brief Pool of message buffers of #IOT_MESSAGE_BUFFER_MEDIUM_SIZE. */
+        static IotStaticMemoryPool_t _mediumMessageBufferPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pMediumMessageBuffers,
+                                                                                                    _pInUseMediumMessageBuffers,
+                                                                                                    IOT_MESSAGE_BUFFER_MEDIUM_SIZE,
+                                                                                                    IOT_MESSAGE_BUFFERS_MEDIUM );
+    #endif
+
+    #if IOT_MESSAGE_BUFFERS_JUMBO > 0
+        static uint32_t _pInUseJumboMessageBuffers[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_MESSAGE_BUFFERS_JUMBO ) ] = { 0 }; /**< @brief Jumbo message buffer in-use flags. */
+        static char _pJumboMessageBuffers[ IOT_MESSAGE_BUFFERS_JUMBO ][ IOT_MESSAGE_BUFFER_JUMBO_SIZE ] = { { 0 } };      /**< @brief Jumbo message buffers. */
+
+/** @brief Pool of message buffers of #IOT_MESSAGE_BUFFER_JUMBO_SIZE. */
+        static IotStaticMemoryPool_t _jumboMessageBufferPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pJumboMessageBuffers,
+                                                                                                   _pInUseJumboMessageBuffers,
+                                                                                                   IOT_MESSAGE_BUFFER_JUMBO_SIZE,
+                                                                                                   IOT_MESSAGE_BUFFERS_JUMBO );
+    #endif
+
+/**
+ * @brief The message buffer size classes, in ascending order of size.
+ */
+    static IotStaticMemoryPool_t * const _pMessageBufferClasses[ MESSAGE_BUFFER_CLASSES ] =
+    {
+        #if IOT_MESSAGE_BUFFERS_SMALL > 0
+            &_smallMessageBufferPool,
+        #endif
+        #if IOT_MESSAGE_BUFFERS_MEDIUM > 0
+            &_mediumMessageBufferPool,
+        #endif
+        &_messageBufferPool,
+        #if IOT_MESSAGE_BUFFERS_JUMBO > 0
+            &_jumboMessageBufferPool,
+        #endif
+    };
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the lowest clear bit of a word.
+ *
+ * @param[in] word A word with at least one clear bit.
+ *
+ * @return The index of the lowest clear bit of `word`.
+ */
+    static uint32_t _lowestClearBit( uint32_t word );
+
+/**
+ * @brief Raise a counter to at least a value.
+ *
+ * @param[in] pMaximum The counter to raise.
+ * @param[in] value The value to raise the counter to.
+ */
+    static void _raiseMaximum( uint32_t * pMaximum,
+                               uint32_t value );
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t _lowestClearBit( uint32_t word )
+    {
+        /* De Bruijn sequence lookup table; see "Using de Bruijn Sequences to
+         * Index a 1 in a Computer Word" (Leiserson, Prokop, Randall). */
+        static const uint8_t pDeBruijnBitIndex[ 32 ] =
+        {
+            0,  1,  28, 2,  29, 14, 24, 3,  30, 22, 20, 15, 25, 17, 4,  8,
+            31, 27, 13, 23, 21, 19, 16, 7,  26, 12, 18, 6,  11, 5,  10, 9
+        };
+
+        /* Isolate the lowest set bit of the inverted word. */
+        uint32_t lowestBit = ( ~word ) & ( word + 1UL );
+
+        return ( uint32_t ) pDeBruijnBitIndex[ ( uint32_t ) ( lowestBit * 0x077CB531UL ) >> 27 ];
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void _raiseMaximum( uint32_t * pMaximum,
+                               uint32_t value )
+    {
+        uint32_t current = *pMaximum;
+
+        while( value > current )
+        {
+            if( Atomic_CompareAndSwap_u32( pMaximum, value, current ) == ATOMIC_COMPARE_AND_SWAP_SUCCESS )
+            {
+                break;
+            }
+
+            current = *pMaximum;
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void * IotStaticMemory_Alloc( IotStaticMemoryPool_t * pPool )
+    {
+        size_t word = 0, index = 0;
+        uint32_t current = 0, bit = 0;
+        void * pNewObject = NULL;
+
+        for( word = 0; ( word < IOT_STATIC_MEMORY_POOL_WORDS( pPool->elementCount ) ) && ( pNewObject == NULL ); word++ )
+        {
+            current = pPool->pInUse[ word ];
+
+            while( current != UINT32_MAX )
+            {
+                bit = _lowestClearBit( current );
+                index = ( word * 32U ) + bit;
+
+                /* The bits past the last object of the pool are never set, so
+                 * reaching one means this word has no free object. */
+                if( index >= pPool->elementCount )
+                {
+                    break;
+                }
+
+                /* Claim the object; another thread may have claimed an object
+                 * of this word since it was read, in which case try again. */
+                if( Atomic_CompareAndSwap_u32( &( pPool->pInUse[ word ] ),
+                                               current | ( 1UL << bit ),
+                                               current ) == ATOMIC_COMPARE_AND_SWAP_SUCCESS )
+                {
+                    pNewObject = ( ( uint8_t * ) pPool->pElements ) + ( index * pPool->elementSize );
+                    break;
+                }
+
+                current = pPool->pInUse[ word ];
+            }
+        }
+
+        if( pNewObject != NULL )
+        {
+            /* The atomic operation returns the value before the increment. */
+            _raiseMaximum( &( pPool->highWaterMark ),
+                           Atomic_Increment_u32( &( pPool->inUse ) ) + 1UL );
+        }
+        else
+        {
+            ( void ) Atomic_Increment_u32( &( pPool->failures ) );
+        }
+
+        return pNewObject;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotStaticMemory_Free( IotStaticMemoryPool_t * pPool,
+                               void * ptr )
+    {
+        size_t offset = 0, index = 0;
+        uint32_t mask = 0;
+        uint32_t * pWord = NULL;
+
+        /* Calculate the index of ptr from its address, ignoring pointers that
+         * are not the start of an object of this pool. */
+        if( ( ( uint8_t * ) ptr >= ( uint8_t * ) pPool->pElements ) &&
+            ( ( uint8_t * ) ptr < ( ( uint8_t * ) pPool->pElements ) + ( pPool->elementCount * pPool->elementSize ) ) )
+        {
+            offset = ( size_t ) ( ( uint8_t * ) ptr - ( uint8_t * ) pPool->pElements );
+
+            if( ( offset % pPool->elementSize ) == 0U )
+            {
+                index = offset / pPool->elementSize;
+                pWord = &( pPool->pInUse[ index / 32U ] );
+                mask = 1UL << ( index % 32U );
+            }
+        }
+
+        if( ( pWord != NULL ) && ( ( *pWord & mask ) != 0U ) )
+        {
+            /* Clear the object before another thread can allocate it. */
+            ( void ) memset( ptr, 0x00, pPool->elementSize );
+
+            /* Update the occupancy before the object can be allocated again, so
+             * that it never counts more objects than the pool has. */
+            ( void ) Atomic_Decrement_u32( &( pPool->inUse ) );
+
+            /* The atomic operation returns the value before the AND. If another
+             * caller freed the same object concurrently, restore the occupancy. */
+            if( ( Atomic_AND_u32( pWord, ~mask ) & mask ) == 0U )
+            {
+                ( void ) Atomic_Increment_u32( &( pPool->inUse ) );
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    void IotStaticMemory_GetStats( const IotStaticMemoryPool_t * pPool,
+                                   IotStaticMemoryStats_t * pStats )
+    {
+        pStats->elementSize = pPool->elementSize;
+        pStats->elementCount = pPool->elementCount;
+        pStats->inUse = pPool->inUse;
+        pStats->highWaterMark = pPool->highWaterMark;
+        pStats->failures = pPool->failures;
+    }
 
 /*-----------------------------------------------------------*/
 
@@ -172,19 +441,16 @@
 
     void * Iot_MallocMessageBuffer( size_t size )
     {
-        int32_t freeIndex = -1;
+        size_t sizeClass = 0;
         void * pNewBuffer = NULL;
 
-        /* Check that size is within the fixed message buffer size. */
-        if( size <= IOT_MESSAGE_BUFFER_SIZE )
+        /* Serve the request from the smallest class that fits it. When that class
+         * is exhausted, fall back to the larger classes. */
+        for( sizeClass = 0; ( sizeClass < MESSAGE_BUFFER_CLASSES ) && ( pNewBuffer == NULL ); sizeClass++ )
         {
-            /* Get the index of a free message buffer. */
-            freeIndex = IotStaticMemory_FindFree( _pInUseMessageBuffers,
-                                                  IOT_MESSAGE_BUFFERS );
-
-            if( freeIndex != -1 )
+            if( size <= _pMessageBufferClasses[ sizeClass ]->elementSize )
             {
-                pNewBuffer = &( _pMessageBuffers[ freeIndex ][ 0 ] );
+                pNewBuffer = IotStaticMemory_Alloc( _pMessageBufferClasses[ sizeClass ] );
             }
         }
 
@@ -195,12 +461,37 @@
 
     void Iot_FreeMessageBuffer( void * ptr )
     {
-        /* Return the in-use message buffer. */
-        IotStaticMemory_ReturnInUse( ptr,
-                                     _pMessageBuffers,
-                                     _pInUseMessageBuffers,
-                                     IOT_MESSAGE_BUFFERS,
-                                     IOT_MESSAGE_BUFFER_SIZE );
+        size_t sizeClass = 0;
+        const IotStaticMemoryPool_t * pPool = NULL;
+
+        /* Find the class of ptr from its address. */
+        for( sizeClass = 0; sizeClass < MESSAGE_BUFFER_CLASSES; sizeClass++ )
+        {
+            pPool = _pMessageBufferClasses[ sizeClass ];
+
+            if( ( ( uint8_t * ) ptr >= ( uint8_t * ) pPool->pElements ) &&
+                ( ( uint8_t * ) ptr < ( ( uint8_t * ) pPool->pElements ) + ( pPool->elementCount * pPool->elementSize ) ) )
+            {
+                /* Return the in-use message buffer. */
+                IotStaticMemory_Free( _pMessageBufferClasses[ sizeClass ], ptr );
+                break;
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    size_t Iot_MessageBufferStats( IotStaticMemoryStats_t * pStats,
+                                   size_t statsCount )
+    {
+        size_t sizeClass = 0;
+
+        for( sizeClass = 0; ( sizeClass < MESSAGE_BUFFER_CLASSES ) && ( sizeClass < statsCount ); sizeClass++ )
+        {
+            IotStaticMemory_GetStats( _pMessageBufferClasses[ sizeClass ], &( pStats[ sizeClass ] ) );
+        }
+
+        return ( size_t ) MESSAGE_BUFFER_CLASSES;
     }
 
 /*-----------------------------------------------------------*/
@@ -44,6 +44,9 @@
 /* Task pool internal include. */
 #include "private/iot_taskpool_internal.h"
 
+/* Atomic include. */
+#include "iot_atomic.h"
+
 /**
  * @brief Enter a critical section by locking a mutex.
  *
@@ -76,7 +79,17 @@
  * the system libraries as well. The system task pool needs to be initialized before any library is used or
  * before any code that posts jobs to the task pool runs.
  */
-_taskPool_t _IotSystemTaskPool = { .dispatchQueue = IOT_DEQUEUE_INITIALIZER };
+_taskPool_t _IotSystemTaskPool = { .classQueues = { { .jobs = IOT_DEQUEUE_INITIALIZER } } };
+
+/**
+ * @brief The weights of the classes of jobs, indexed by #IotTaskPoolJobClass_t.
+ */
+static const uint32_t _jobClassWeights[ TASKPOOL_JOB_CLASSES ] =
+{
+    IOT_TASKPOOL_JOB_CLASS_NORMAL_WEIGHT,
+    IOT_TASKPOOL_JOB_CLASS_CONTROL_WEIGHT,
+    IOT_TASKPOOL_JOB_CLASS_BULK_WEIGHT
+};
 
 /* -------------- Convenience functions to create/recycle/destroy jobs -------------- */
 
@@ -87,6 +100,16 @@ _taskPool_t _IotSystemTaskPool = { .dispatchQueue = IOT_DEQUEUE_INITIALIZER };
  */
 static void _initJobsCache( _taskPoolCache_t * const pCache );
 
+/**
+ * @brief Destroys all jobs in one instance of a Task pool cache.
+ *
+ * This function waits for any thread popping a job from the cache, so it must
+ * not be called while holding the task pool lock.
+ *
+ * @param[in] pCache The instance of the cache to destroy the jobs of.
+ */
+static void _destroyJobsCache( _taskPoolCache_t * const pCache );
+
 /**
  * @brief Initialize a job.
  *
@@ -103,6 +126,8 @@ static void _initializeJob( _taskPoolJob_t * const pJob,
 /**
  * @brief Extracts and initializes one instance of a job from the cache or, if there is none available, it allocates and initializes a new one.
  *
+ * This function is lock-free, and may be called without holding the task pool lock.
+ *
  * @param[in] pCache The instance of the cache to extract the job from.
  */
 static _taskPoolJob_t * _fetchOrAllocateJob( _taskPoolCache_t * const pCache );
@@ -110,6 +135,8 @@ static _taskPoolJob_t * _fetchOrAllocateJob( _taskPoolCache_t * const pCache );
 /**
  * Recycles one instance of a job into the cache or, if the cache is full, it destroys it.
  *
+ * This function is lock-free, and may be called without holding the task pool lock.
+ *
  * @param[in] pCache The instance of the cache to recycle the job into.
  * @param[in] pJob The job to recycle.
  *
@@ -135,25 +162,160 @@ static void _destroyJob( _taskPoolJob_t * const pJob );
  */
 static void _taskPoolWorker( void * pUserContext );
 
+#if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+
+/**
+ * Dequeues the next job for a worker thread of a task pool using the work-stealing dispatcher.
+ *
+ * The job is taken from the head of the home queue of the worker, or else stolen from the tail
+ * of the first non-empty queue of another worker. The job status is updated to 'executing' under
+ * the lock of the queue the job was taken from.
+ *
+ * @param[in] pTaskPool The task pool to dequeue a job from.
+ * @param[in] homeQueue The index of the home queue of the worker thread.
+ * @param[out] pUserCallback The callback of the dequeued job.
+ *
+ * @return The dequeued job, or `NULL` if all worker queues are empty.
+ */
+    static _taskPoolJob_t * _stealJob( _taskPool_t * const pTaskPool,
+                                       uint32_t homeQueue,
+                                       IotTaskPoolRoutine_t * const pUserCallback );
+#endif
+
+/**
+ * Dequeues the next job of a task pool using the shared queue, serving the classes of jobs
+ * in weighted round-robin order. Must be called while holding the task pool lock.
+ *
+ * @param[in] pTaskPool The task pool to dequeue a job from.
+ *
+ * @return The dequeued job, or `NULL` if all class queues are empty.
+ */
+static _taskPoolJob_t * _dequeueJob( _taskPool_t * const pTaskPool );
+
+/**
+ * Updates the statistics of the class of a job that was just picked up by a worker.
+ *
+ * @param[in] pTaskPool The task pool the job was dequeued from.
+ * @param[in] pJob The dequeued job.
+ */
+static void _recordJobDispatch( _taskPool_t * const pTaskPool,
+                                const _taskPoolJob_t * const pJob );
+
+/**
+ * Raises a maximum to a new value, unless another thread raised it higher in the meantime.
+ *
+ * @param[in] pMaximum The maximum to raise.
+ * @param[in] value The new value.
+ */
+static void _raiseMaximum( uint32_t * pMaximum,
+                           uint32_t value );
+
+/**
+ * Returns the largest value held by a bucket of a histogram.
+ *
+ * @param[in] bucket The index of the bucket.
+ *
+ * @return The upper bound of the bucket, or `UINT32_MAX` for the last bucket.
+ */
+static uint32_t _histogramBucketUpperBound( uint32_t bucket );
+
+#if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+
+/**
+ * Returns the index of the histogram bucket holding a value.
+ *
+ * @param[in] value The value.
+ *
+ * @return The index of the bucket.
+ */
+    static uint32_t _histogramBucket( uint32_t value );
+
+/**
+ * Records a value in a histogram, without locking.
+ *
+ * @param[in] pHistogram The histogram.
+ * @param[in] value The value to record.
+ */
+    static void _histogramRecord( IotTaskPoolHistogram_t * const pHistogram,
+                                  uint32_t value );
+#endif
+
 /* -------------- Convenience functions to handle timer events  -------------- */
 
 /**
- * Comparer for the time list.
+ * Initializes an empty timer wheel.
+ *
+ * param[in] pWheel The timer wheel to initialize.
+ */
+static void _timerWheelCreate( _taskPoolTimerWheel_t * const pWheel );
+
+/**
+ * Links a timer event in the slot of the timer wheel matching its expiration time.
+ *
+ * param[in] pWheel The timer wheel to link the timer event in.
+ * param[in] pTimerEvent The timer event to link.
+ */
+static void _timerWheelLink( _taskPoolTimerWheel_t * const pWheel,
+                             _taskPoolTimerEvent_t * const pTimerEvent );
+
+/**
+ * Inserts a new timer event in the timer wheel.
+ *
+ * param[in] pWheel The timer wheel to insert the timer event in.
+ * param[in] pTimerEvent The timer event to insert.
+ * param[in] now The current time.
+ */
+static void _timerWheelInsert( _taskPoolTimerWheel_t * const pWheel,
+                               _taskPoolTimerEvent_t * const pTimerEvent,
+                               uint64_t now );
+
+/**
+ * Removes a timer event from the timer wheel.
+ *
+ * param[in] pWheel The timer wheel holding the timer event.
+ * param[in] pTimerEvent The timer event to remove.
+ */
+static void _timerWheelRemove( _taskPoolTimerWheel_t * const pWheel,
+                               _taskPoolTimerEvent_t * const pTimerEvent );
+
+/**
+ * Computes the next tick at which the timer wheel has timer events to expire or to move down a level.
+ *
+ * param[in] pWheel The timer wheel.
+ * param[out] pNextTick The next tick of interest.
+ *
+ * @return `true` if the timer wheel holds any timer event, `false` otherwise.
+ */
+static bool _timerWheelNextTick( const _taskPoolTimerWheel_t * const pWheel,
+                                 uint64_t * const pNextTick );
+
+/**
+ * Turns the timer wheel up to a given tick and collects the expired timer events.
+ *
+ * param[in] pWheel The timer wheel to turn.
+ * param[in] targetTick The tick to turn the timer wheel to.
+ * param[out] pExpired The list receiving the expired timer events.
+ */
+static void _timerWheelAdvance( _taskPoolTimerWheel_t * const pWheel,
+                                uint64_t targetTick,
+                                IotListDouble_t * const pExpired );
+
+/**
+ * Moves all timer events out of a list of the timer wheel and links them again.
  *
- * param[in] pTimerEventLink1 The link to the first timer event.
- * param[in] pTimerEventLink1 The link to the first timer event.
+ * param[in] pWheel The timer wheel.
+ * param[in] pList The timer wheel list to empty.
  */
-static int32_t _timerEventCompare( const IotLink_t * const pTimerEventLink1,
-                                   const IotLink_t * const pTimerEventLink2 );
+static void _timerWheelCascade( _taskPoolTimerWheel_t * const pWheel,
+                                IotListDouble_t * const pList );
 
 /**
- * Reschedules the timer for handling deferred jobs to the next timeout.
+ * Reschedules the timer for handling deferred jobs to the next tick of interest of the timer wheel,
+ * unless the timer is already due to fire earlier.
  *
- * param[in] pTimer The timer to reschedule.
- * param[in] pFirstTimerEvent The timer event that carries the timeout and job information.
+ * param[in] pTaskPool The task pool owning the timer.
  */
-static void _rescheduleDeferredJobsTimer( IotTimer_t * const pTimer,
-                                          _taskPoolTimerEvent_t * const pFirstTimerEvent );
+static void _rescheduleDeferredJobsTimer( _taskPool_t * const pTaskPool );
 
 /**
  * The task pool timer procedure for scheduling deferred jobs.
@@ -231,14 +393,60 @@ static IotTaskPoolError_t _scheduleInternal( _taskPool_t * const pTaskPool,
                                              uint32_t flags );
 
 /**
- * Matches a deferred job in the timer queue with its timer event wrapper.
+ * Schedules a batch of jobs, and wakes up at most one worker per job.
+ *
+ * @param[in] pTaskPool The task pool to schedule the jobs with.
+ * @param[in] pJobs The jobs to schedule.
+ * @param[in] jobCount The number of jobs in `pJobs`.
+ *
+ */
+static IotTaskPoolError_t _scheduleBatchInternal( _taskPool_t * const pTaskPool,
+                                                  IotTaskPoolJob_t * const pJobs,
+                                                  uint32_t jobCount );
+
+/**
+ * Creates a new worker thread, and waits for it to start.
+ *
+ * @param[in] pTaskPool The task pool to add the worker to.
+ *
+ * @return `true` if the worker was created, `false` otherwise.
+ *
+ */
+static bool _createWorker( _taskPool_t * const pTaskPool );
+
+/**
+ * Appends a job marked as scheduled to its dispatch queue, without signaling the workers.
+ *
+ * @param[in] pTaskPool The task pool to schedule the job with.
+ * @param[in] pJob The job to enqueue.
+ * @param[in] queueAtHead Whether the job must be placed at the head of the queue.
+ *
+ */
+static void _enqueueJob( _taskPool_t * const pTaskPool,
+                         _taskPoolJob_t * const pJob,
+                         bool queueAtHead );
+
+/**
+ * Checks whether the queue pressure passed the thresholds for growing the task pool.
+ * Must be called with the task pool lock held.
+ *
+ * @param[in] pTaskPool The task pool to check.
+ *
+ * @return `true` if the task pool should grow by one worker thread, `false` otherwise.
+ *
+ */
+static bool _shouldGrow( const _taskPool_t * const pTaskPool );
+
+/**
+ * Grows the task pool if a job picked up by a worker waited longer than the wait threshold of the
+ * task pool, and more jobs are still waiting. Must be called with the task pool lock held.
  *
- * @param[in] pLink A pointer to the timer event link in the timer queue.
- * @param[in] pMatch A pointer to the job to match.
+ * @param[in] pTaskPool The task pool the job was dequeued from.
+ * @param[in] pJob The dequeued job.
  *
  */
-static bool _matchJobByPointer( const IotLink_t * const pLink,
-                                void * pMatch );
+static void _growOnWait( _taskPool_t * const pTaskPool,
+                         const _taskPoolJob_t * const pJob );
 
 /**
  * Tries to cancel a job.
@@ -358,62 +566,81 @@ IotTaskPoolError_t IotTaskPool_Destroy( IotTaskPool_t taskPoolHandle )
         /* Record how many active threads in the task pool. */
         activeThreads = pTaskPool->activeThreads;
 
-        /* Destroying a Task pool happens in six (6) stages: First, (1) we clear the job queue and (2) the timer queue.
-         * Then (3) we clear the jobs cache. We will then (4) wait for all worker threads to signal exit,
-         * before (5) setting the exit condition and wake up all active worker threads. Finally (6) destroying
-         * all task pool data structures and release the associated memory.
+        /* Destroying a Task pool happens in five (5) stages: First, (1) we clear the job queue and (2) the timer queue.
+         * Then (3) we set the exit condition and wake up all active worker threads. We will then (4) wait for all
+         * worker threads to signal exit. Finally (5) we clear the jobs cache, destroy all task pool data structures
+         * and release the associated memory. The jobs cache is cleared without holding the task pool lock, since
+         * it may have to wait for a thread popping a job from the cache.
          */
 
-        /* (1) Clear the job queue. */
-        do
+        /* (1) Clear the job queues. */
+        for( count = 0; count < TASKPOOL_JOB_CLASSES; ++count )
         {
-            pItemLink = NULL;
+            do
+            {
+                pItemLink = NULL;
+
+                pItemLink = IotDeQueue_DequeueHead( &pTaskPool->classQueues[ count ].jobs );
+
+                if( pItemLink != NULL )
+                {
+                    _taskPoolJob_t * pJob = IotLink_Container( _taskPoolJob_t, pItemLink, link );
 
-            pItemLink = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue );
+                    _destroyJob( pJob );
+                }
+            } while( pItemLink );
+        }
 
-            if( pItemLink != NULL )
+        #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+            for( count = 0; count < IOT_TASKPOOL_WORKER_QUEUES; ++count )
             {
-                _taskPoolJob_t * pJob = IotLink_Container( _taskPoolJob_t, pItemLink, link );
+                _taskPoolWorkerQueue_t * pQueue = &pTaskPool->workerQueues[ count ];
+
+                IotMutex_Lock( &pQueue->lock );
+
+                do
+                {
+                    pItemLink = IotDeQueue_DequeueHead( &pQueue->jobs );
+
+                    if( pItemLink != NULL )
+                    {
+                        _taskPoolJob_t * pJob = IotLink_Container( _taskPoolJob_t, pItemLink, link );
+
+                        _destroyJob( pJob );
+                    }
+                } while( pItemLink );
 
-                _destroyJob( pJob );
+                IotMutex_Unlock( &pQueue->lock );
             }
-        } while( pItemLink );
+        #endif
 
-        /* (2) Clear the timer queue. */
+        /* (2) Clear the timer wheel. */
         {
+            _taskPoolTimerWheel_t * pWheel = &pTaskPool->timerWheel;
             _taskPoolTimerEvent_t * pTimerEvent;
+            uint64_t now = IotClock_GetTimeMs();
 
             /* A deferred job may have fired already. Since deferred jobs will go through the same mutex
              * the shutdown sequence is holding at this stage, there is no risk for race conditions. Yet, we
              * need to let the deferred job to destroy the task pool. */
-
-            pItemLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
-
-            if( pItemLink != NULL )
+            if( ( pWheel->armedTime != 0ULL ) && ( pWheel->armedTime <= now ) )
             {
-                uint64_t now = IotClock_GetTimeMs();
-
-                pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pItemLink, link );
+                IotLogDebug( "Shutdown will be deferred to the timer thread" );
 
-                if( pTimerEvent->expirationTime <= now )
-                {
-                    IotLogDebug( "Shutdown will be deferred to the timer thread" );
+                /* Timer may have fired already! Let the timer thread destroy
+                 * complete the taskpool destruction sequence. */
+                completeShutdown = false;
+            }
 
-                    /* Timer may have fired already! Let the timer thread destroy
-                     * complete the taskpool destruction sequence. */
-                    completeShutdown = false;
-                }
+            /* Remove all timers from the timer wheel. */
+            for( count = 0; count <= TASKPOOL_TIMER_WHEEL_OVERFLOW; ++count )
+            {
+                IotListDouble_t * pList = ( count == TASKPOOL_TIMER_WHEEL_OVERFLOW ) ?
+                                          &pWheel->overflow :
+                                          &pWheel->slots[ count / TASKPOOL_TIMER_WHEEL_SLOTS ][ count % TASKPOOL_TIMER_WHEEL_SLOTS ];
 
-                /* Remove all timers from the timeout list. */
-                for( ; ; )
+                while( ( pItemLink = IotListDouble_RemoveHead( pList ) ) != NULL )
                 {
-                    pItemLink = IotListDouble_RemoveHead( &pTaskPool->timerEventsList );
-
-                    if( pItemLink == NULL )
-                    {
-                        break;
-                    }
-
                     pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pItemLink, link );
 
                     _destroyJob( pTimerEvent->pJob );
@@ -421,29 +648,16 @@ IotTaskPoolError_t IotTaskPool_Destroy( IotTaskPool_t taskPoolHandle )
                     IotTaskPool_FreeTimerEvent( pTimerEvent );
                 }
             }
-        }
-
-        /* (3) Clear the job cache. */
-        do
-        {
-            pItemLink = NULL;
 
-            pItemLink = IotListDouble_RemoveHead( &pTaskPool->jobsCache.freeList );
-
-            if( pItemLink != NULL )
-            {
-                _taskPoolJob_t * pJob = IotLink_Container( _taskPoolJob_t, pItemLink, link );
-
-                _destroyJob( pJob );
-            }
-        } while( pItemLink );
+            _timerWheelCreate( pWheel );
+        }
 
-        /* (4) Set the exit condition. */
+        /* (3) Set the exit condition. */
         _signalShutdown( pTaskPool, activeThreads );
     }
     TASKPOOL_EXIT_CRITICAL();
 
-    /* (5) Wait for all active threads to reach the end of their life-span. */
+    /* (4) Wait for all active threads to reach the end of their life-span. */
     for( count = 0; count < activeThreads; ++count )
     {
         IotSemaphore_Wait( &pTaskPool->startStopSignal );
@@ -452,7 +666,7 @@ IotTaskPoolError_t IotTaskPool_Destroy( IotTaskPool_t taskPoolHandle )
     IotTaskPool_Assert( IotSemaphore_GetCount( &pTaskPool->startStopSignal ) == 0 );
     IotTaskPool_Assert( pTaskPool->activeThreads == 0 );
 
-    /* (6) Destroy all signaling objects. */
+    /* (5) Destroy the jobs cache and all signaling objects. */
     if( completeShutdown == true )
     {
         _destroyTaskPool( pTaskPool );
@@ -575,10 +789,12 @@ IotTaskPoolError_t IotTaskPool_CreateRecyclableJob( IotTaskPool_t taskPoolHandle
                 TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_SHUTDOWN_IN_PROGRESS );
             }
 
-            pTempJob = _fetchOrAllocateJob( &pTaskPool->jobsCache );
         }
         TASKPOOL_EXIT_CRITICAL();
 
+        /* The jobs cache is lock-free, so allocating a job does not contend with dispatching. */
+        pTempJob = _fetchOrAllocateJob( &pTaskPool->jobsCache );
+
         if( pTempJob == NULL )
         {
             IotLogInfo( "Failed to allocate a job." );
@@ -656,6 +872,10 @@ IotTaskPoolError_t IotTaskPool_RecycleJob( IotTaskPool_t taskPoolHandle,
 
     pTaskPool = ( _taskPool_t * ) taskPoolHandle;
 
+    /* Jobs in the cache have an undefined status. Recycling a job twice would push it
+     * on the cache twice and corrupt the cache. */
+    IotTaskPool_Assert( pJob->status != IOT_TASKPOOL_STATUS_UNDEFINED );
+
     TASKPOOL_ENTER_CRITICAL();
     {
         /* Bail out early if this task pool is shutting down. */
@@ -730,6 +950,45 @@ IotTaskPoolError_t IotTaskPool_Schedule( IotTaskPool_t taskPoolHandle,
 
 /*-----------------------------------------------------------*/
 
+IotTaskPoolError_t IotTaskPool_ScheduleBatch( IotTaskPool_t taskPoolHandle,
+                                              IotTaskPoolJob_t * const pJobs,
+                                              uint32_t jobCount )
+{
+    TASKPOOL_FUNCTION_ENTRY( IOT_TASKPOOL_SUCCESS );
+    _taskPool_t * pTaskPool = NULL;
+    uint32_t count;
+
+    /* Parameter checking. */
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( taskPoolHandle );
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pJobs );
+    TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( jobCount == 0UL );
+
+    for( count = 0; count < jobCount; ++count )
+    {
+        TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pJobs[ count ] );
+    }
+
+    pTaskPool = ( _taskPool_t * ) taskPoolHandle;
+
+    TASKPOOL_ENTER_CRITICAL();
+    {
+        /* Bail out early if this task pool is shutting down. */
+        if( _IsShutdownStarted( pTaskPool ) )
+        {
+            status = IOT_TASKPOOL_SHUTDOWN_IN_PROGRESS;
+        }
+        else
+        {
+            status = _scheduleBatchInternal( pTaskPool, pJobs, jobCount );
+        }
+    }
+    TASKPOOL_EXIT_CRITICAL();
+
+    TASKPOOL_NO_FUNCTION_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
 IotTaskPoolError_t IotTaskPool_ScheduleDeferred( IotTaskPool_t taskPoolHandle,
                                                  IotTaskPoolJob_t pJob,
                                                  uint32_t timeMs )
@@ -761,7 +1020,6 @@ IotTaskPoolError_t IotTaskPool_ScheduleDeferred( IotTaskPool_t taskPoolHandle,
         /* If all safety checks completed, proceed. */
         if( TASKPOOL_SUCCEEDED( _trySafeExtraction( pTaskPool, pJob, false ) ) )
         {
-            IotLink_t * pTimerEventLink;
             uint64_t now;
 
             _taskPoolTimerEvent_t * pTimerEvent = ( _taskPoolTimerEvent_t * ) IotTaskPool_MallocTimerEvent( sizeof( _taskPoolTimerEvent_t ) );
@@ -782,25 +1040,15 @@ IotTaskPoolError_t IotTaskPool_ScheduleDeferred( IotTaskPool_t taskPoolHandle,
             pTimerEvent->expirationTime = now + timeMs;
             pTimerEvent->pJob = ( _taskPoolJob_t * ) pJob;
 
-            /* Append the timer event to the timer list. */
-            IotListDouble_InsertSorted( &pTaskPool->timerEventsList, &pTimerEvent->link, _timerEventCompare );
+            /* Insert the timer event in the timer wheel. */
+            _timerWheelInsert( &pTaskPool->timerWheel, pTimerEvent, now );
 
             /* Update the job status to 'scheduled'. */
             pJob->status = IOT_TASKPOOL_STATUS_DEFERRED;
+            pJob->pTimerEvent = pTimerEvent;
 
-            /* Peek the first event in the timer event list. There must be at least one,
-             * since we just inserted it. */
-            pTimerEventLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
-            IotTaskPool_Assert( pTimerEventLink != NULL );
-
-            /* If the event we inserted is at the front of the queue, then
-             * we need to reschedule the underlying timer. */
-            if( pTimerEventLink == &pTimerEvent->link )
-            {
-                pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pTimerEventLink, link );
-
-                _rescheduleDeferredJobsTimer( &pTaskPool->timer, pTimerEvent );
-            }
+            /* The timer needs to be re-armed only if the new event expires before it fires. */
+            _rescheduleDeferredJobsTimer( pTaskPool );
         }
         else
         {
@@ -891,6 +1139,150 @@ IotTaskPoolJobStorage_t * IotTaskPool_GetJobStorageFromHandle( IotTaskPoolJob_t
     return ( IotTaskPoolJobStorage_t * ) pJob;
 }
 
+/*-----------------------------------------------------------*/
+
+IotTaskPoolError_t IotTaskPool_GetJobCacheStats( IotTaskPool_t taskPoolHandle,
+                                                 IotTaskPoolJobCacheStats_t * const pStats )
+{
+    TASKPOOL_FUNCTION_ENTRY( IOT_TASKPOOL_SUCCESS );
+    _taskPool_t * pTaskPool = NULL;
+
+    /* Parameter checking. */
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( taskPoolHandle );
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pStats );
+
+    pTaskPool = ( _taskPool_t * ) taskPoolHandle;
+
+    /* The counters are read without locking, as they are updated without locking. */
+    pStats->hits = pTaskPool->jobsCache.hits;
+    pStats->misses = pTaskPool->jobsCache.misses;
+    pStats->mallocFallbacks = pTaskPool->jobsCache.mallocFallbacks;
+    pStats->freeCount = pTaskPool->jobsCache.freeCount;
+
+    TASKPOOL_NO_FUNCTION_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+IotTaskPoolError_t IotTaskPool_SetJobClass( IotTaskPoolJob_t pJob,
+                                            IotTaskPoolJobClass_t jobClass )
+{
+    TASKPOOL_FUNCTION_ENTRY( IOT_TASKPOOL_SUCCESS );
+
+    /* Parameter checking. */
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pJob );
+    TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( ( uint32_t ) jobClass >= TASKPOOL_JOB_CLASSES );
+
+    /* The class of a job decides which queue it goes into, so it cannot change while the job is in a queue. */
+    if( ( pJob->status == IOT_TASKPOOL_STATUS_SCHEDULED ) || ( pJob->status == IOT_TASKPOOL_STATUS_DEFERRED ) )
+    {
+        TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_ILLEGAL_OPERATION );
+    }
+
+    pJob->jobClass = ( uint32_t ) jobClass;
+
+    TASKPOOL_NO_FUNCTION_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+IotTaskPoolError_t IotTaskPool_GetJobClassStats( IotTaskPool_t taskPoolHandle,
+                                                 IotTaskPoolJobClass_t jobClass,
+                                                 IotTaskPoolJobClassStats_t * const pStats )
+{
+    TASKPOOL_FUNCTION_ENTRY( IOT_TASKPOOL_SUCCESS );
+    _taskPool_t * pTaskPool = NULL;
+    const _taskPoolJobClassQueue_t * pClass = NULL;
+
+    /* Parameter checking. */
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( taskPoolHandle );
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pStats );
+    TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( ( uint32_t ) jobClass >= TASKPOOL_JOB_CLASSES );
+
+    pTaskPool = ( _taskPool_t * ) taskPoolHandle;
+    pClass = &pTaskPool->classQueues[ jobClass ];
+
+    /* The counters are read without locking, as they are updated without locking. */
+    pStats->depth = pClass->depth;
+    pStats->dispatched = pClass->dispatched;
+    pStats->totalWaitMs = pClass->totalWaitMs;
+    pStats->maxWaitMs = pClass->maxWaitMs;
+
+    TASKPOOL_NO_FUNCTION_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+IotTaskPoolError_t IotTaskPool_GetInstrumentation( IotTaskPool_t taskPoolHandle,
+                                                   IotTaskPoolInstrumentation_t * const pSnapshot )
+{
+    TASKPOOL_FUNCTION_ENTRY( IOT_TASKPOOL_SUCCESS );
+
+    /* Parameter checking. */
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( taskPoolHandle );
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pSnapshot );
+
+    #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+        {
+            _taskPool_t * pTaskPool = ( _taskPool_t * ) taskPoolHandle;
+
+            /* The histograms are read without locking, as they are updated without locking. */
+            pSnapshot->waitTime = pTaskPool->waitTime;
+            pSnapshot->runTime = pTaskPool->runTime;
+            pSnapshot->activeJobs = pTaskPool->activeJobs;
+            pSnapshot->activeThreads = pTaskPool->activeThreads;
+            pSnapshot->peakActiveJobs = pTaskPool->peakActiveJobs;
+            pSnapshot->peakActiveThreads = pTaskPool->peakActiveThreads;
+        }
+    #else
+        TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_ILLEGAL_OPERATION );
+    #endif
+
+    TASKPOOL_NO_FUNCTION_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t IotTaskPool_HistogramPercentile( const IotTaskPoolHistogram_t * pHistogram,
+                                          uint32_t percentile )
+{
+    uint32_t value = 0;
+    uint32_t bucket = 0, rank = 0, seen = 0;
+
+    if( ( pHistogram != NULL ) && ( pHistogram->count != 0UL ) && ( percentile <= 100UL ) )
+    {
+        /* The rank of the percentile among the recorded values, rounded up and at least 1. */
+        rank = ( uint32_t ) ( ( ( ( uint64_t ) pHistogram->count * percentile ) + 99ULL ) / 100ULL );
+
+        if( rank == 0UL )
+        {
+            rank = 1;
+        }
+
+        for( bucket = 0; bucket < IOT_TASKPOOL_HISTOGRAM_BUCKETS; ++bucket )
+        {
+            seen += pHistogram->buckets[ bucket ];
+
+            if( seen >= rank )
+            {
+                break;
+            }
+        }
+
+        value = _histogramBucketUpperBound( bucket );
+
+        /* No recorded value is larger than the maximum. */
+        if( value > pHistogram->max )
+        {
+            value = pHistogram->max;
+        }
+    }
+
+    return value;
+}
+
+/*-----------------------------------------------------------*/
+
 const char * IotTaskPool_strerror( IotTaskPoolError_t status )
 {
     const char * pMessage = NULL;
@@ -943,6 +1335,13 @@ IotTaskPoolError_t _performTaskPoolParameterValidation( const IotTaskPoolInfo_t
     TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( pInfo->minThreads < 1UL );
     TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( pInfo->maxThreads < 1UL );
 
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( ( pInfo->dispatchMode != IOT_TASKPOOL_DISPATCH_SHARED_QUEUE ) &&
+                                            ( pInfo->dispatchMode != IOT_TASKPOOL_DISPATCH_WORK_STEALING ) );
+    #else
+        TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( pInfo->dispatchMode != IOT_TASKPOOL_DISPATCH_SHARED_QUEUE );
+    #endif
+
     TASKPOOL_NO_FUNCTION_CLEANUP();
 }
 
@@ -955,6 +1354,11 @@ static IotTaskPoolError_t _initTaskPoolControlStructures( const IotTaskPoolInfo_
     bool lockInit = false;
     bool semDispatchInit = false;
     bool timerInit = false;
+    uint32_t count;
+
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        uint32_t queueLocksInit = 0;
+    #endif
 
     /* Zero out all data structures. */
     memset( ( void * ) pTaskPool, 0x00, sizeof( _taskPool_t ) );
@@ -962,16 +1366,42 @@ static IotTaskPoolError_t _initTaskPoolControlStructures( const IotTaskPoolInfo_
     /* Initialize a job data structures that require no de-initialization.
      * All other data structures carry a value of 'NULL' before initialization.
      */
-    IotDeQueue_Create( &pTaskPool->dispatchQueue );
-    IotListDouble_Create( &pTaskPool->timerEventsList );
-
+    for( count = 0; count < TASKPOOL_JOB_CLASSES; ++count )
+    {
+        IotDeQueue_Create( &pTaskPool->classQueues[ count ].jobs );
+    }
+
+    /* Start serving the classes of jobs from the first one. */
+    pTaskPool->currentClass = 0;
+    pTaskPool->classCredits = _jobClassWeights[ 0 ];
+    _timerWheelCreate( &pTaskPool->timerWheel );
+
     pTaskPool->minThreads = pInfo->minThreads;
     pTaskPool->maxThreads = pInfo->maxThreads;
     pTaskPool->stackSize = pInfo->stackSize;
     pTaskPool->priority = pInfo->priority;
+    pTaskPool->dispatchMode = pInfo->dispatchMode;
+    pTaskPool->growQueueDepth = pInfo->growQueueDepth;
+    pTaskPool->growWaitMs = pInfo->growWaitMs;
+    pTaskPool->lingerMs = ( pInfo->lingerMs != 0UL ) ? pInfo->lingerMs : IOT_TASKPOOL_JOB_WAIT_TIMEOUT_MS;
 
     _initJobsCache( &pTaskPool->jobsCache );
 
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+
+        /* The worker queues are always initialized, so that shutdown does not need to
+         * check the dispatcher mode. */
+        for( ; queueLocksInit < IOT_TASKPOOL_WORKER_QUEUES; ++queueLocksInit )
+        {
+            IotDeQueue_Create( &pTaskPool->workerQueues[ queueLocksInit ].jobs );
+
+            if( IotMutex_Create( &pTaskPool->workerQueues[ queueLocksInit ].lock, false ) == false )
+            {
+                TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_NO_MEMORY );
+            }
+        }
+    #endif
+
     /* Initialize the semaphore to ensure all threads have started. */
     if( IotSemaphore_Create( &pTaskPool->startStopSignal, 0, TASKPOOL_MAX_SEM_VALUE ) == true )
     {
@@ -1034,6 +1464,15 @@ static IotTaskPoolError_t _initTaskPoolControlStructures( const IotTaskPoolInfo_
         {
             IotClock_TimerDestroy( &pTaskPool->timer );
         }
+
+        #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+            while( queueLocksInit > 0UL )
+            {
+                --queueLocksInit;
+
+                IotMutex_Destroy( &pTaskPool->workerQueues[ queueLocksInit ].lock );
+            }
+        #endif
     }
 
     TASKPOOL_FUNCTION_CLEANUP_END();
@@ -1079,6 +1518,10 @@ static IotTaskPoolError_t _createTaskPool( const IotTaskPoolInfo_t * const pInfo
         /* Upon successful thread creation, increase the number of active threads. */
         pTaskPool->activeThreads++;
 
+        #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+            _raiseMaximum( &pTaskPool->peakActiveThreads, pTaskPool->activeThreads );
+        #endif
+
         ++threadsCreated;
     }
 
@@ -1115,10 +1558,23 @@ static IotTaskPoolError_t _createTaskPool( const IotTaskPoolInfo_t * const pInfo
 
 static void _destroyTaskPool( _taskPool_t * const pTaskPool )
 {
+    _destroyJobsCache( &pTaskPool->jobsCache );
+
     IotClock_TimerDestroy( &pTaskPool->timer );
     IotSemaphore_Destroy( &pTaskPool->dispatchSignal );
     IotSemaphore_Destroy( &pTaskPool->startStopSignal );
     IotMutex_Destroy( &pTaskPool->lock );
+
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        {
+            uint32_t count;
+
+            for( count = 0; count < IOT_TASKPOOL_WORKER_QUEUES; ++count )
+            {
+                IotMutex_Destroy( &pTaskPool->workerQueues[ count ].lock );
+            }
+        }
+    #endif
 }
 
 /* ---------------------------------------------------------------------------------------------- */
@@ -1133,6 +1589,13 @@ static void _taskPoolWorker( void * pUserContext )
     /* Extract pTaskPool pointer from context. */
     _taskPool_t * pTaskPool = ( _taskPool_t * ) pUserContext;
 
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+
+        /* Pick the home queue of this worker. The thread creating this worker may be holding
+         * the task pool lock while waiting for the start signal below. */
+        uint32_t homeQueue = Atomic_Increment_u32( &pTaskPool->nextHomeQueue ) % IOT_TASKPOOL_WORKER_QUEUES;
+    #endif
+
     /* Signal that this worker completed initialization and it is ready to receive notifications. */
     IotSemaphore_Post( &pTaskPool->startStopSignal );
 
@@ -1143,13 +1606,12 @@ static void _taskPoolWorker( void * pUserContext )
     do
     {
         bool jobAvailable;
-        IotLink_t * pFirst;
         _taskPoolJob_t * pJob = NULL;
 
         /* Wait on incoming notifications. If waiting on the semaphore return with timeout, then
          * it means that this thread should consider shutting down for the task pool to fold back
          * to its minimum number of threads. */
-        jobAvailable = IotSemaphore_TimedWait( &pTaskPool->dispatchSignal, IOT_TASKPOOL_JOB_WAIT_TIMEOUT_MS );
+        jobAvailable = IotSemaphore_TimedWait( &pTaskPool->dispatchSignal, pTaskPool->lingerMs );
 
         /* Acquire the lock to check the exit condition, and release the lock if the exit condition is verified,
          * or before waiting for incoming notifications.
@@ -1206,26 +1668,40 @@ static void _taskPoolWorker( void * pUserContext )
                 }
             }
 
-            /* Only look for a job if waiting did not timed out. */
-            if( jobAvailable == true )
+            /* Only look for a job if waiting did not timed out. Workers of a task pool using the
+             * work-stealing dispatcher look for a job after releasing the task pool lock. */
+            if( ( jobAvailable == true ) && ( pTaskPool->dispatchMode == IOT_TASKPOOL_DISPATCH_SHARED_QUEUE ) )
             {
-                /* Dequeue the first job in FIFO order. */
-                pFirst = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue );
+                /* Dequeue the next job, in FIFO order within its class. */
+                pJob = _dequeueJob( pTaskPool );
 
                 /* If there is indeed a job, then update status under lock, and release the lock before processing the job. */
-                if( pFirst != NULL )
+                if( pJob != NULL )
                 {
-                    /* Extract the job from its link. */
-                    pJob = IotLink_Container( _taskPoolJob_t, pFirst, link );
-
                     /* Update status to 'executing'. */
                     pJob->status = IOT_TASKPOOL_STATUS_COMPLETED;
                     userCallback = pJob->userCallback;
+
+                    _growOnWait( pTaskPool, pJob );
                 }
             }
         }
         TASKPOOL_EXIT_CRITICAL();
 
+        #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+            if( ( jobAvailable == true ) && ( pTaskPool->dispatchMode == IOT_TASKPOOL_DISPATCH_WORK_STEALING ) )
+            {
+                pJob = _stealJob( pTaskPool, homeQueue, &userCallback );
+
+                if( ( pJob != NULL ) && ( pTaskPool->growWaitMs != 0UL ) )
+                {
+                    TASKPOOL_ENTER_CRITICAL();
+                    _growOnWait( pTaskPool, pJob );
+                    TASKPOOL_EXIT_CRITICAL();
+                }
+            }
+        #endif
+
         /* INNER LOOP: it controls the execution of jobs: the exit condition is the lack of a job to execute. */
         while( pJob != NULL )
         {
@@ -1236,8 +1712,17 @@ static void _taskPoolWorker( void * pUserContext )
                 IotTaskPool_Assert( IotLink_IsLinked( &pJob->link ) == false );
                 IotTaskPool_Assert( userCallback != NULL );
 
+                #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+                    uint32_t startTicks = IotTaskPool_InstrumentationTime();
+                #endif
+
                 userCallback( pTaskPool, pJob, pJob->pUserContext );
 
+                /* The job may have been recycled or destroyed by its callback. */
+                #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+                    _histogramRecord( &pTaskPool->runTime, IotTaskPool_InstrumentationTime() - startTicks );
+                #endif
+
                 /* This job is finished, clear its pointer. */
                 pJob = NULL;
                 userCallback = NULL;
@@ -1250,20 +1735,38 @@ static void _taskPoolWorker( void * pUserContext )
                 }
             }
 
+            #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+
+                /* Workers of a task pool using the work-stealing dispatcher do not take the task pool
+                 * lock between jobs, only the lock of the worker queue they take the next job from. */
+                if( pTaskPool->dispatchMode == IOT_TASKPOOL_DISPATCH_WORK_STEALING )
+                {
+                    ( void ) Atomic_Decrement_u32( &pTaskPool->activeJobs );
+
+                    pJob = _stealJob( pTaskPool, homeQueue, &userCallback );
+
+                    if( ( pJob != NULL ) && ( pTaskPool->growWaitMs != 0UL ) )
+                    {
+                        TASKPOOL_ENTER_CRITICAL();
+                        _growOnWait( pTaskPool, pJob );
+                        TASKPOOL_EXIT_CRITICAL();
+                    }
+
+                    continue;
+                }
+            #endif
+
             /* Acquire the lock before updating the job status. */
             TASKPOOL_ENTER_CRITICAL();
             {
                 /* Update the number of busy threads, so new requests can be served by creating new threads, up to maxThreads. */
                 pTaskPool->activeJobs--;
 
-                /* Try and dequeue the next job in the dispatch queue. */
-                IotLink_t * pItem = NULL;
-
-                /* Dequeue the next job from the dispatch queue. */
-                pItem = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue );
+                /* Dequeue the next job from the dispatch queues. */
+                pJob = _dequeueJob( pTaskPool );
 
-                /* If there is no job left in the dispatch queue, update the worker status and leave. */
-                if( pItem == NULL )
+                /* If there is no job left in the dispatch queues, update the worker status and leave. */
+                if( pJob == NULL )
                 {
                     TASKPOOL_EXIT_CRITICAL();
 
@@ -1272,25 +1775,249 @@ static void _taskPoolWorker( void * pUserContext )
                 }
                 else
                 {
-                    pJob = IotLink_Container( _taskPoolJob_t, pItem, link );
-
                     userCallback = pJob->userCallback;
                 }
 
                 pJob->status = IOT_TASKPOOL_STATUS_COMPLETED;
+
+                _growOnWait( pTaskPool, pJob );
             }
             TASKPOOL_EXIT_CRITICAL();
         }
     } while( running == true );
 }
 
+#if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+
+/*-----------------------------------------------------------*/
+
+    static _taskPoolJob_t * _stealJob( _taskPool_t * const pTaskPool,
+                                       uint32_t homeQueue,
+                                       IotTaskPoolRoutine_t * const pUserCallback )
+    {
+        uint32_t count;
+        _taskPoolJob_t * pJob = NULL;
+
+        for( count = 0; ( count < IOT_TASKPOOL_WORKER_QUEUES ) && ( pJob == NULL ); ++count )
+        {
+            IotLink_t * pItem = NULL;
+            _taskPoolWorkerQueue_t * pQueue = &pTaskPool->workerQueues[ ( homeQueue + count ) % IOT_TASKPOOL_WORKER_QUEUES ];
+
+            IotMutex_Lock( &pQueue->lock );
+            {
+                /* Serve the home queue in FIFO order, and steal from the tail of other queues to
+                 * keep away from the owner of the queue. */
+                if( count == 0UL )
+                {
+                    pItem = IotDeQueue_DequeueHead( &pQueue->jobs );
+                }
+                else
+                {
+                    pItem = IotDeQueue_DequeueTail( &pQueue->jobs );
+                }
+
+                if( pItem != NULL )
+                {
+                    pJob = IotLink_Container( _taskPoolJob_t, pItem, link );
+
+                    /* Update status to 'executing'. */
+                    pJob->status = IOT_TASKPOOL_STATUS_COMPLETED;
+                    *pUserCallback = pJob->userCallback;
+
+                    _recordJobDispatch( pTaskPool, pJob );
+                }
+            }
+            IotMutex_Unlock( &pQueue->lock );
+        }
+
+        return pJob;
+    }
+#endif /* if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1 */
+
+/*-----------------------------------------------------------*/
+
+static _taskPoolJob_t * _dequeueJob( _taskPool_t * const pTaskPool )
+{
+    uint32_t count;
+    IotLink_t * pItem = NULL;
+    _taskPoolJob_t * pJob = NULL;
+
+    /* Each class may have up to its weight in jobs dispatched in a row, before yielding to the next class.
+     * Visiting one class more than there are classes finds a job if there is any, since the class served
+     * first may have no credits left. */
+    for( count = 0; ( count <= TASKPOOL_JOB_CLASSES ) && ( pItem == NULL ); ++count )
+    {
+        if( pTaskPool->classCredits > 0UL )
+        {
+            pItem = IotDeQueue_DequeueHead( &pTaskPool->classQueues[ pTaskPool->currentClass ].jobs );
+        }
+
+        if( pItem != NULL )
+        {
+            pTaskPool->classCredits--;
+        }
+        else
+        {
+            /* Empty classes, and classes with no credits left, yield to the next class. */
+            pTaskPool->currentClass = ( pTaskPool->currentClass + 1UL ) % TASKPOOL_JOB_CLASSES;
+            pTaskPool->classCredits = _jobClassWeights[ pTaskPool->currentClass ];
+        }
+    }
+
+    if( pItem != NULL )
+    {
+        pJob = IotLink_Container( _taskPoolJob_t, pItem, link );
+
+        _recordJobDispatch( pTaskPool, pJob );
+    }
+
+    return pJob;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _recordJobDispatch( _taskPool_t * const pTaskPool,
+                                const _taskPoolJob_t * const pJob )
+{
+    _taskPoolJobClassQueue_t * pClass = &pTaskPool->classQueues[ pJob->jobClass ];
+    uint32_t waitMs = ( uint32_t ) IotClock_GetTimeMs() - pJob->queuedTime;
+
+    ( void ) Atomic_Decrement_u32( &pClass->depth );
+    ( void ) Atomic_Increment_u32( &pClass->dispatched );
+    ( void ) Atomic_Add_u32( &pClass->totalWaitMs, waitMs );
+
+    _raiseMaximum( &pClass->maxWaitMs, waitMs );
+
+    #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+        _histogramRecord( &pTaskPool->waitTime, IotTaskPool_InstrumentationTime() - pJob->queuedTicks );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+static void _raiseMaximum( uint32_t * pMaximum,
+                           uint32_t value )
+{
+    uint32_t maximum = 0;
+
+    do
+    {
+        maximum = *pMaximum;
+    } while( ( value > maximum ) &&
+             ( Atomic_CompareAndSwap_u32( pMaximum, value, maximum ) != ATOMIC_COMPARE_AND_SWAP_SUCCESS ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t _histogramBucketUpperBound( uint32_t bucket )
+{
+    uint32_t upperBound = UINT32_MAX;
+    uint32_t exponent = 0, mantissa = 0;
+
+    /* Values below twice the number of sub-buckets have a bucket each. */
+    if( bucket < ( 2UL * TASKPOOL_HISTOGRAM_SUB_BUCKETS ) )
+    {
+        upperBound = bucket;
+    }
+    else if( bucket < ( IOT_TASKPOOL_HISTOGRAM_BUCKETS - 1UL ) )
+    {
+        /* Other buckets hold the values with the same leading bits. */
+        exponent = ( bucket / TASKPOOL_HISTOGRAM_SUB_BUCKETS ) - 1UL;
+        mantissa = TASKPOOL_HISTOGRAM_SUB_BUCKETS + ( bucket % TASKPOOL_HISTOGRAM_SUB_BUCKETS );
+
+        upperBound = ( ( mantissa + 1UL ) << exponent ) - 1UL;
+    }
+    else
+    {
+        /* The last bucket holds all larger values. */
+    }
+
+    return upperBound;
+}
+
+#if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t _histogramBucket( uint32_t value )
+    {
+        uint32_t bucket = value;
+        uint32_t exponent = 0;
+
+        if( value >= ( 2UL * TASKPOOL_HISTOGRAM_SUB_BUCKETS ) )
+        {
+            /* Keep the leading bits of the value, which select a sub-bucket within its power of two. */
+            while( ( value >> exponent ) >= ( 2UL * TASKPOOL_HISTOGRAM_SUB_BUCKETS ) )
+            {
+                exponent++;
+            }
+
+            bucket = ( ( exponent + 1UL ) * TASKPOOL_HISTOGRAM_SUB_BUCKETS ) +
+                     ( ( value >> exponent ) - TASKPOOL_HISTOGRAM_SUB_BUCKETS );
+        }
+
+        if( bucket >= IOT_TASKPOOL_HISTOGRAM_BUCKETS )
+        {
+            bucket = IOT_TASKPOOL_HISTOGRAM_BUCKETS - 1UL;
+        }
+
+        return bucket;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void _histogramRecord( IotTaskPoolHistogram_t * const pHistogram,
+                                  uint32_t value )
+    {
+        ( void ) Atomic_Increment_u32( &pHistogram->buckets[ _histogramBucket( value ) ] );
+        ( void ) Atomic_Increment_u32( &pHistogram->count );
+
+        _raiseMaximum( &pHistogram->max, value );
+    }
+
+#endif /* if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1 */
+
 /* ---------------------------------------------------------------------------------------------- */
 
 static void _initJobsCache( _taskPoolCache_t * const pCache )
 {
-    IotDeQueue_Create( &pCache->freeList );
+    pCache->pFreeList = NULL;
+    pCache->popLock = 0;
 
     pCache->freeCount = 0;
+    pCache->hits = 0;
+    pCache->misses = 0;
+    pCache->mallocFallbacks = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _destroyJobsCache( _taskPoolCache_t * const pCache )
+{
+    IotLink_t * pItemLink = NULL;
+
+    /* Wait for any thread popping a job from the cache first, since that thread
+     * may still be reading the job at the top of the stack. */
+    while( Atomic_CompareAndSwap_u32( &pCache->popLock, 1, 0 ) != ATOMIC_COMPARE_AND_SWAP_SUCCESS )
+    {
+        IotClock_SleepMs( 1 );
+    }
+
+    pItemLink = ( IotLink_t * ) Atomic_SwapPointers_p32( &pCache->pFreeList, NULL );
+
+    while( pItemLink != NULL )
+    {
+        _taskPoolJob_t * pJob = IotLink_Container( _taskPoolJob_t, pItemLink, link );
+
+        pItemLink = pItemLink->pNext;
+        pJob->link.pNext = NULL;
+
+        _destroyJob( pJob );
+    }
+
+    pCache->freeCount = 0;
+
+    ( void ) Atomic_CompareAndSwap_u32( &pCache->popLock, 0, 1 );
 }
 
 /*-----------------------------------------------------------*/
@@ -1304,6 +2031,8 @@ static void _initializeJob( _taskPoolJob_t * const pJob,
     pJob->link.pPrevious = NULL;
     pJob->userCallback = userCallback;
     pJob->pUserContext = pUserContext;
+    pJob->pTimerEvent = NULL;
+    pJob->jobClass = ( uint32_t ) IOT_TASKPOOL_JOB_CLASS_NORMAL;
 
     if( isStatic )
     {
@@ -1319,21 +2048,47 @@ static void _initializeJob( _taskPoolJob_t * const pJob,
 static _taskPoolJob_t * _fetchOrAllocateJob( _taskPoolCache_t * const pCache )
 {
     _taskPoolJob_t * pJob = NULL;
-    IotLink_t * pLink = IotListDouble_RemoveHead( &( pCache->freeList ) );
+    IotLink_t * pLink = NULL;
+
+    /* Only one thread at a time may pop a job from the cache. Rather than waiting
+     * for another thread to be done, fall back to allocating a new job. */
+    if( Atomic_CompareAndSwap_u32( &pCache->popLock, 1, 0 ) == ATOMIC_COMPARE_AND_SWAP_SUCCESS )
+    {
+        /* Jobs cannot leave the stack while holding the pop lock, so the next pointer
+         * of the top job is stable until the compare-and-swap succeeds or fails. */
+        do
+        {
+            pLink = ( IotLink_t * ) pCache->pFreeList;
+        } while( ( pLink != NULL ) &&
+                 ( Atomic_CompareAndSwapPointers_p32( &pCache->pFreeList, pLink->pNext, pLink ) != ATOMIC_COMPARE_AND_SWAP_SUCCESS ) );
+
+        ( void ) Atomic_CompareAndSwap_u32( &pCache->popLock, 0, 1 );
+    }
 
     if( pLink != NULL )
     {
         pJob = IotLink_Container( _taskPoolJob_t, pLink, link );
-    }
 
+        pJob->link.pNext = NULL;
+
+        /* Make sure we keep the counters up-to-date. */
+        IotTaskPool_Assert( pCache->freeCount > 0 );
+
+        ( void ) Atomic_Decrement_u32( &pCache->freeCount );
+        ( void ) Atomic_Increment_u32( &pCache->hits );
+    }
     /* If there is no available job in the cache, then allocate one. */
-    if( pJob == NULL )
+    else
     {
+        ( void ) Atomic_Increment_u32( &pCache->misses );
+
         pJob = ( _taskPoolJob_t * ) IotTaskPool_MallocJob( sizeof( _taskPoolJob_t ) );
 
         if( pJob != NULL )
         {
             memset( pJob, 0x00, sizeof( _taskPoolJob_t ) );
+
+            ( void ) Atomic_Increment_u32( &pCache->mallocFallbacks );
         }
         else
         {
@@ -1341,13 +2096,6 @@ static _taskPoolJob_t * _fetchOrAllocateJob( _taskPoolCache_t * const pCache )
             IotLogInfo( "Failed to allocate job." );
         }
     }
-    /* If there was a job in the cache, then make sure we keep the counters up-to-date. */
-    else
-    {
-        IotTaskPool_Assert( pCache->freeCount > 0 );
-
-        pCache->freeCount--;
-    }
 
     return pJob;
 }
@@ -1357,11 +2105,14 @@ static _taskPoolJob_t * _fetchOrAllocateJob( _taskPoolCache_t * const pCache )
 static void _recycleJob( _taskPoolCache_t * const pCache,
                          _taskPoolJob_t * const pJob )
 {
+    IotLink_t * pHead = NULL;
+
     /* We should never try and recycling a job that is linked into some queue. */
     IotTaskPool_Assert( IotLink_IsLinked( &pJob->link ) == false );
 
-    /* We will recycle the job if there is space in the cache. */
-    if( pCache->freeCount < IOT_TASKPOOL_JOBS_RECYCLE_LIMIT )
+    /* We will recycle the job if there is space in the cache. The space is reserved before
+     * pushing the job, so that concurrent recycling cannot overfill the cache. */
+    if( Atomic_Increment_u32( &pCache->freeCount ) < IOT_TASKPOOL_JOBS_RECYCLE_LIMIT )
     {
         /* Destroy user data, for added safety & security. */
         pJob->userCallback = NULL;
@@ -1370,14 +2121,16 @@ static void _recycleJob( _taskPoolCache_t * const pCache,
         /* Reset the status for added debugability. */
         pJob->status = IOT_TASKPOOL_STATUS_UNDEFINED;
 
-        IotListDouble_InsertTail( &pCache->freeList, &pJob->link );
-
-        pCache->freeCount++;
-
-        IotTaskPool_Assert( pCache->freeCount >= 1 );
+        do
+        {
+            pHead = ( IotLink_t * ) pCache->pFreeList;
+            pJob->link.pNext = pHead;
+        } while( Atomic_CompareAndSwapPointers_p32( &pCache->pFreeList, &pJob->link, pHead ) != ATOMIC_COMPARE_AND_SWAP_SUCCESS );
     }
     else
     {
+        ( void ) Atomic_Decrement_u32( &pCache->freeCount );
+
         _destroyJob( pJob );
     }
 }
@@ -1438,110 +2191,298 @@ static IotTaskPoolError_t _scheduleInternal( _taskPool_t * const pTaskPool,
     /* Update the job status to 'scheduled'. */
     pJob->status = IOT_TASKPOOL_STATUS_SCHEDULED;
 
-    /* Update the number of active jobs optimistically, so new requests can be served by creating new threads. */
-    pTaskPool->activeJobs++;
+    /* Update the number of active jobs optimistically, so new requests can be served by creating new threads.
+     * Workers of a task pool using the work-stealing dispatcher update the number of active jobs without
+     * holding the task pool lock. */
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        ( void ) Atomic_Increment_u32( &pTaskPool->activeJobs );
+    #else
+        pTaskPool->activeJobs++;
+    #endif
 
     /* If all threads are busy, try and create a new one. Failing to create a new thread
      * only has performance implications on correctly executing the scheduled job.
      */
     uint32_t activeThreads = pTaskPool->activeThreads;
 
-    if( activeThreads <= pTaskPool->activeJobs )
+    /* If the job scheduling is tagged as high priority, then we must grow the task pool,
+     * no matter how many threads are active already. */
+    if( ( activeThreads <= pTaskPool->activeJobs ) &&
+        ( ( flags & IOT_TASKPOOL_JOB_HIGH_PRIORITY ) == IOT_TASKPOOL_JOB_HIGH_PRIORITY ) )
     {
-        /* If the job scheduling is tagged as high priority, then we must grow the task pool,
-         * no matter how many threads are active already. */
-        if( ( flags & IOT_TASKPOOL_JOB_HIGH_PRIORITY ) == IOT_TASKPOOL_JOB_HIGH_PRIORITY )
-        {
-            mustGrow = true;
-        }
+        mustGrow = true;
+    }
 
-        /* Grow the task pool up to the maximum number of threads indicated by the user.
-         * Growing the taskpool can safely fail, the existing threads will eventually pick up
-         * the job sometimes later. */
-        else if( activeThreads < pTaskPool->maxThreads )
+    /* Grow the task pool up to the maximum number of threads indicated by the user, once the
+     * queue pressure passes the thresholds of the task pool. Growing the taskpool can safely fail,
+     * the existing threads will eventually pick up the job sometimes later. */
+    else
+    {
+        shouldGrow = _shouldGrow( pTaskPool );
+    }
+
+    if( ( mustGrow == true ) || ( shouldGrow == true ) )
+    {
+        /* Failure to create a worker thread for a high priority job is considered a failure. */
+        if( ( _createWorker( pTaskPool ) == false ) && ( mustGrow == true ) )
         {
-            shouldGrow = true;
+            TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_NO_MEMORY );
         }
-        else
+    }
+
+    TASKPOOL_FUNCTION_CLEANUP();
+
+    if( TASKPOOL_SUCCEEDED( status ) )
+    {
+        /* Put the job at the front, if it is a high priority job. */
+        _enqueueJob( pTaskPool, pJob, mustGrow );
+
+        /* Signal a worker to pick up the job. */
+        IotSemaphore_Post( &pTaskPool->dispatchSignal );
+    }
+    else
+    {
+        /* Scheduling can only fail to allocate a new worker, which is an error
+         * only for high priority tasks. */
+        IotTaskPool_Assert( mustGrow == true );
+
+        /* Revert updating the number of active jobs. */
+        #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+            ( void ) Atomic_Decrement_u32( &pTaskPool->activeJobs );
+        #else
+            pTaskPool->activeJobs--;
+        #endif
+    }
+
+    TASKPOOL_FUNCTION_CLEANUP_END();
+}
+
+/*-----------------------------------------------------------*/
+
+static IotTaskPoolError_t _scheduleBatchInternal( _taskPool_t * const pTaskPool,
+                                                  IotTaskPoolJob_t * const pJobs,
+                                                  uint32_t jobCount )
+{
+    IotTaskPoolError_t status = IOT_TASKPOOL_SUCCESS;
+    uint32_t count;
+    uint32_t scheduled = 0;
+    uint32_t workersToWake = 0;
+    bool canGrow = true;
+
+    /* Idle workers can pick up jobs from the batch right away. Busy workers will drain the
+     * dispatch queues after completing their current job, so they do not need a signal. */
+    if( pTaskPool->activeThreads > pTaskPool->activeJobs )
+    {
+        workersToWake = pTaskPool->activeThreads - pTaskPool->activeJobs;
+    }
+
+    for( count = 0; count < jobCount; ++count )
+    {
+        _taskPoolJob_t * pJob = pJobs[ count ];
+
+        /* Skip jobs that are executing, but keep scheduling the rest of the batch. */
+        if( TASKPOOL_FAILED( _trySafeExtraction( pTaskPool, pJob, false ) ) )
         {
-            /* Nothing to do. */
+            status = IOT_TASKPOOL_ILLEGAL_OPERATION;
+
+            continue;
         }
 
-        if( ( mustGrow == true ) || ( shouldGrow == true ) )
-        {
-            IotLogInfo( "Growing a Task pool with a new worker thread..." );
+        /* Update the job status to 'scheduled'. */
+        pJob->status = IOT_TASKPOOL_STATUS_SCHEDULED;
 
-            if( Iot_CreateDetachedThread( _taskPoolWorker,
-                                          pTaskPool,
-                                          pTaskPool->priority,
-                                          pTaskPool->stackSize ) )
-            {
-                IotSemaphore_Wait( &pTaskPool->startStopSignal );
+        #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+            ( void ) Atomic_Increment_u32( &pTaskPool->activeJobs );
+        #else
+            pTaskPool->activeJobs++;
+        #endif
 
-                pTaskPool->activeThreads++;
-            }
-            else
-            {
-                /* Failure to create a worker thread may not hinder functional correctness, but rather just responsiveness. */
-                IotLogWarn( "Task pool failed to create a worker thread." );
+        /* Grow the task pool as _scheduleInternal would, but stop trying after the first failure. */
+        if( ( canGrow == true ) && ( _shouldGrow( pTaskPool ) == true ) )
+        {
+            canGrow = _createWorker( pTaskPool );
 
-                /* Failure to create a worker thread for a high priority job is considered a failure. */
-                if( mustGrow )
-                {
-                    TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_NO_MEMORY );
-                }
+            /* A new worker waits for a signal like any idle worker. */
+            if( canGrow == true )
+            {
+                workersToWake++;
             }
         }
+
+        _enqueueJob( pTaskPool, pJob, false );
+
+        scheduled++;
     }
 
-    TASKPOOL_FUNCTION_CLEANUP();
+    /* Wake up at most one worker per job. */
+    if( workersToWake > scheduled )
+    {
+        workersToWake = scheduled;
+    }
 
-    if( TASKPOOL_SUCCEEDED( status ) )
+    for( count = 0; count < workersToWake; ++count )
+    {
+        IotSemaphore_Post( &pTaskPool->dispatchSignal );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _createWorker( _taskPool_t * const pTaskPool )
+{
+    bool created = false;
+
+    IotLogInfo( "Growing a Task pool with a new worker thread..." );
+
+    if( Iot_CreateDetachedThread( _taskPoolWorker,
+                                  pTaskPool,
+                                  pTaskPool->priority,
+                                  pTaskPool->stackSize ) )
+    {
+        IotSemaphore_Wait( &pTaskPool->startStopSignal );
+
+        pTaskPool->activeThreads++;
+
+        #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+            _raiseMaximum( &pTaskPool->peakActiveThreads, pTaskPool->activeThreads );
+        #endif
+
+        created = true;
+    }
+    else
+    {
+        /* Failure to create a worker thread may not hinder functional correctness, but rather just responsiveness. */
+        IotLogWarn( "Task pool failed to create a worker thread." );
+    }
+
+    return created;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _shouldGrow( const _taskPool_t * const pTaskPool )
+{
+    bool grow = false;
+    uint32_t jobClass;
+    IotLink_t * pItem = NULL;
+    const _taskPoolJob_t * pOldestJob = NULL;
+
+    if( pTaskPool->activeThreads < pTaskPool->maxThreads )
     {
-        /* Append the job to the dispatch queue.
-         * Put the job at the front, if it is a high priority job. */
-        if( mustGrow == true )
+        if( pTaskPool->activeJobs >= ( pTaskPool->activeThreads + pTaskPool->growQueueDepth ) )
+        {
+            grow = true;
+        }
+        else if( ( pTaskPool->growWaitMs != 0UL ) && ( pTaskPool->dispatchMode == IOT_TASKPOOL_DISPATCH_SHARED_QUEUE ) )
         {
-            IotLogDebug( "High priority job: placing job at the head of the queue." );
+            /* The oldest job of each class is at the head of its queue. */
+            for( jobClass = 0; ( jobClass < TASKPOOL_JOB_CLASSES ) && ( grow == false ); ++jobClass )
+            {
+                pItem = IotDeQueue_PeekHead( &pTaskPool->classQueues[ jobClass ].jobs );
+
+                if( pItem != NULL )
+                {
+                    pOldestJob = IotLink_Container( _taskPoolJob_t, pItem, link );
 
-            IotDeQueue_EnqueueHead( &pTaskPool->dispatchQueue, &pJob->link );
+                    grow = ( ( ( uint32_t ) IotClock_GetTimeMs() - pOldestJob->queuedTime ) >= pTaskPool->growWaitMs );
+                }
+            }
         }
         else
         {
-            IotDeQueue_EnqueueTail( &pTaskPool->dispatchQueue, &pJob->link );
+            /* Nothing to do. */
         }
-
-        /* Signal a worker to pick up the job. */
-        IotSemaphore_Post( &pTaskPool->dispatchSignal );
     }
-    else
+
+    return grow;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _growOnWait( _taskPool_t * const pTaskPool,
+                         const _taskPoolJob_t * const pJob )
+{
+    uint32_t jobClass;
+    uint32_t waitingJobs = 0;
+
+    if( ( pTaskPool->growWaitMs != 0UL ) &&
+        ( pTaskPool->activeThreads < pTaskPool->maxThreads ) &&
+        ( ( ( uint32_t ) IotClock_GetTimeMs() - pJob->queuedTime ) >= pTaskPool->growWaitMs ) )
     {
-        /* Scheduling can only fail to allocate a new worker, which is an error
-         * only for high priority tasks. */
-        IotTaskPool_Assert( mustGrow == true );
+        for( jobClass = 0; jobClass < TASKPOOL_JOB_CLASSES; ++jobClass )
+        {
+            waitingJobs += pTaskPool->classQueues[ jobClass ].depth;
+        }
 
-        /* Revert updating the number of active jobs. */
-        pTaskPool->activeJobs--;
+        /* Jobs scheduled in a batch may have fewer pending signals than jobs, so signal the new
+         * worker explicitly. */
+        if( ( waitingJobs > 0UL ) && ( _createWorker( pTaskPool ) == true ) )
+        {
+            IotSemaphore_Post( &pTaskPool->dispatchSignal );
+        }
     }
-
-    TASKPOOL_FUNCTION_CLEANUP_END();
 }
 
 /*-----------------------------------------------------------*/
 
-static bool _matchJobByPointer( const IotLink_t * const pLink,
-                                void * pMatch )
+static void _enqueueJob( _taskPool_t * const pTaskPool,
+                         _taskPoolJob_t * const pJob,
+                         bool queueAtHead )
 {
-    const _taskPoolJob_t * const pJob = ( _taskPoolJob_t * ) pMatch;
+    IotDeQueue_t * pDispatchQueue = &pTaskPool->classQueues[ pJob->jobClass ].jobs;
 
-    const _taskPoolTimerEvent_t * const pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pLink, link );
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        _taskPoolWorkerQueue_t * pWorkerQueue = NULL;
+
+        /* Spread jobs across the worker queues in round-robin order. */
+        if( pTaskPool->dispatchMode == IOT_TASKPOOL_DISPATCH_WORK_STEALING )
+        {
+            pJob->queueIndex = pTaskPool->nextWorkerQueue;
+            pTaskPool->nextWorkerQueue = ( pTaskPool->nextWorkerQueue + 1UL ) % IOT_TASKPOOL_WORKER_QUEUES;
+
+            pWorkerQueue = &pTaskPool->workerQueues[ pJob->queueIndex ];
+            pDispatchQueue = &pWorkerQueue->jobs;
+
+            /* Worker queues are not split by class, so control jobs skip ahead of other jobs instead. */
+            if( pJob->jobClass == ( uint32_t ) IOT_TASKPOOL_JOB_CLASS_CONTROL )
+            {
+                queueAtHead = true;
+            }
+
+            IotMutex_Lock( &pWorkerQueue->lock );
+        }
+    #endif
 
-    if( pJob == pTimerEvent->pJob )
+    /* Record when the job was queued, to measure how long it waits for a worker. */
+    pJob->queuedTime = ( uint32_t ) IotClock_GetTimeMs();
+    ( void ) Atomic_Increment_u32( &pTaskPool->classQueues[ pJob->jobClass ].depth );
+
+    #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+        pJob->queuedTicks = IotTaskPool_InstrumentationTime();
+        _raiseMaximum( &pTaskPool->peakActiveJobs, pTaskPool->activeJobs );
+    #endif
+
+    /* Append the job to the dispatch queue.
+     * Put the job at the front, if it is a high priority job. */
+    if( queueAtHead == true )
+    {
+        IotLogDebug( "High priority job: placing job at the head of the queue." );
+
+        IotDeQueue_EnqueueHead( pDispatchQueue, &pJob->link );
+    }
+    else
     {
-        return true;
+        IotDeQueue_EnqueueTail( pDispatchQueue, &pJob->link );
     }
 
-    return false;
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        if( pWorkerQueue != NULL )
+        {
+            IotMutex_Unlock( &pWorkerQueue->lock );
+        }
+    #endif
 }
 
 /*-----------------------------------------------------------*/
@@ -1558,6 +2499,22 @@ static IotTaskPoolError_t _tryCancelInternal( _taskPool_t * const pTaskPool,
 
     IotTaskPoolJobStatus_t currentStatus = pJob->status;
 
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        _taskPoolWorkerQueue_t * pWorkerQueue = NULL;
+
+        /* Workers of a task pool using the work-stealing dispatcher start a scheduled job without holding
+         * the task pool lock, so read the status of a scheduled job again under the lock of its worker queue. */
+        if( ( pTaskPool->dispatchMode == IOT_TASKPOOL_DISPATCH_WORK_STEALING ) &&
+            ( currentStatus == IOT_TASKPOOL_STATUS_SCHEDULED ) )
+        {
+            pWorkerQueue = &pTaskPool->workerQueues[ pJob->queueIndex ];
+
+            IotMutex_Lock( &pWorkerQueue->lock );
+
+            currentStatus = pJob->status;
+        }
+    #endif
+
     switch( currentStatus )
     {
         case IOT_TASKPOOL_STATUS_READY:
@@ -1601,42 +2558,27 @@ static IotTaskPoolError_t _tryCancelInternal( _taskPool_t * const pTaskPool,
             IotTaskPool_Assert( IotLink_IsLinked( &pJob->link ) );
 
             IotDeQueue_Remove( &pJob->link );
+
+            ( void ) Atomic_Decrement_u32( &pTaskPool->classQueues[ pJob->jobClass ].depth );
         }
 
         /* If the job current status is 'deferred' then the job has to be pending
          * in the timeouts queue. */
         else if( currentStatus == IOT_TASKPOOL_STATUS_DEFERRED )
         {
-            /* Find the timer event associated with the current job. There MUST be one, hence assert if not. */
-            IotLink_t * pTimerEventLink = IotListDouble_FindFirstMatch( &pTaskPool->timerEventsList, NULL, _matchJobByPointer, pJob );
-            IotTaskPool_Assert( pTimerEventLink != NULL );
+            /* The timer event associated with the current job. There MUST be one, hence assert if not. */
+            _taskPoolTimerEvent_t * pTimerEvent = pJob->pTimerEvent;
+            IotTaskPool_Assert( pTimerEvent != NULL );
 
-            if( pTimerEventLink != NULL )
+            if( pTimerEvent != NULL )
             {
-                bool shouldReschedule = false;
+                /* Remove the timer event associated with the canceled job and free the associated memory.
+                 * The timer is left armed: if it fires, it will find nothing to do and re-arm itself
+                 * for the next timer event. */
+                _timerWheelRemove( &pTaskPool->timerWheel, pTimerEvent );
+                IotTaskPool_FreeTimerEvent( pTimerEvent );
 
-                /* If the job being cancelled was at the head of the timeouts queue, then we need to reschedule the timer
-                 * with the next job timeout */
-                IotLink_t * pHeadLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
-
-                if( pHeadLink == pTimerEventLink )
-                {
-                    shouldReschedule = true;
-                }
-
-                /* Remove the timer event associated with the canceled job and free the associated memory. */
-                IotListDouble_Remove( pTimerEventLink );
-                IotTaskPool_FreeTimerEvent( IotLink_Container( _taskPoolTimerEvent_t, pTimerEventLink, link ) );
-
-                if( shouldReschedule )
-                {
-                    IotLink_t * pNextTimerEventLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
-
-                    if( pNextTimerEventLink != NULL )
-                    {
-                        _rescheduleDeferredJobsTimer( &pTaskPool->timer, IotLink_Container( _taskPoolTimerEvent_t, pNextTimerEventLink, link ) );
-                    }
-                }
+                pJob->pTimerEvent = NULL;
             }
         }
         else
@@ -1646,7 +2588,16 @@ static IotTaskPoolError_t _tryCancelInternal( _taskPool_t * const pTaskPool,
         }
     }
 
-    TASKPOOL_NO_FUNCTION_CLEANUP();
+    TASKPOOL_FUNCTION_CLEANUP();
+
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        if( pWorkerQueue != NULL )
+        {
+            IotMutex_Unlock( &pWorkerQueue->lock );
+        }
+    #endif
+
+    TASKPOOL_FUNCTION_CLEANUP_END();
 }
 
 /*-----------------------------------------------------------*/
@@ -1689,69 +2640,284 @@ static IotTaskPoolError_t _trySafeExtraction( _taskPool_t * const pTaskPool,
                 break;
         }
     }
-    else if( IotLink_IsLinked( &pJob->link ) )
+    else
+    {
+        /* Nothing to do */
+    }
+
+    TASKPOOL_NO_FUNCTION_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+static void _timerWheelCreate( _taskPoolTimerWheel_t * const pWheel )
+{
+    uint32_t level, index;
+
+    for( level = 0; level < IOT_TASKPOOL_TIMER_WHEEL_LEVELS; ++level )
+    {
+        for( index = 0; index < TASKPOOL_TIMER_WHEEL_SLOTS; ++index )
+        {
+            IotListDouble_Create( &pWheel->slots[ level ][ index ] );
+        }
+
+        pWheel->occupiedSlots[ level ] = 0;
+    }
+
+    IotListDouble_Create( &pWheel->overflow );
+
+    pWheel->currentTick = 0;
+    pWheel->eventCount = 0;
+    pWheel->armedTime = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _timerWheelLink( _taskPoolTimerWheel_t * const pWheel,
+                             _taskPoolTimerEvent_t * const pTimerEvent )
+{
+    uint32_t level = 0;
+    uint32_t index = 0;
+    uint64_t expirationTick = ( pTimerEvent->expirationTime + IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS - 1ULL ) /
+                              IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS;
+
+    /* An event that is already due expires on the next tick. */
+    if( expirationTick <= pWheel->currentTick )
     {
-        /* If the job is not in the dispatch or timer queue, it must be in the cache. */
-        IotTaskPool_Assert( ( pJob->flags & IOT_TASK_POOL_INTERNAL_STATIC ) == 0 );
+        expirationTick = pWheel->currentTick + 1ULL;
+    }
 
-        IotListDouble_Remove( &pJob->link );
+    /* Find the lowest level spanning the expiration tick, i.e. the lowest level above which
+     * the expiration tick and the current tick are equal. */
+    while( ( level < IOT_TASKPOOL_TIMER_WHEEL_LEVELS ) &&
+           ( ( expirationTick >> ( ( level + 1UL ) * TASKPOOL_TIMER_WHEEL_SLOT_BITS ) ) !=
+             ( pWheel->currentTick >> ( ( level + 1UL ) * TASKPOOL_TIMER_WHEEL_SLOT_BITS ) ) ) )
+    {
+        level++;
+    }
+
+    if( level == IOT_TASKPOOL_TIMER_WHEEL_LEVELS )
+    {
+        IotListDouble_InsertTail( &pWheel->overflow, &pTimerEvent->link );
+
+        pTimerEvent->slot = TASKPOOL_TIMER_WHEEL_OVERFLOW;
     }
     else
     {
-        /* Nothing to do */
+        index = ( uint32_t ) ( expirationTick >> ( level * TASKPOOL_TIMER_WHEEL_SLOT_BITS ) ) & ( TASKPOOL_TIMER_WHEEL_SLOTS - 1UL );
+
+        IotListDouble_InsertTail( &pWheel->slots[ level ][ index ], &pTimerEvent->link );
+        pWheel->occupiedSlots[ level ] |= ( ( uint32_t ) 1U << index );
+
+        pTimerEvent->slot = ( level * TASKPOOL_TIMER_WHEEL_SLOTS ) + index;
     }
+}
 
-    TASKPOOL_NO_FUNCTION_CLEANUP();
+/*-----------------------------------------------------------*/
+
+static void _timerWheelInsert( _taskPoolTimerWheel_t * const pWheel,
+                               _taskPoolTimerEvent_t * const pTimerEvent,
+                               uint64_t now )
+{
+    uint64_t nowTick = now / IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS;
+
+    /* An empty wheel can jump to the current time, so that the new event is linked
+     * relative to the current time rather than to the last time the wheel turned. */
+    if( ( pWheel->eventCount == 0UL ) && ( nowTick > pWheel->currentTick ) )
+    {
+        pWheel->currentTick = nowTick;
+    }
+
+    _timerWheelLink( pWheel, pTimerEvent );
+
+    pWheel->eventCount++;
 }
 
 /*-----------------------------------------------------------*/
 
-static int32_t _timerEventCompare( const IotLink_t * const pTimerEventLink1,
-                                   const IotLink_t * const pTimerEventLink2 )
+static void _timerWheelRemove( _taskPoolTimerWheel_t * const pWheel,
+                               _taskPoolTimerEvent_t * const pTimerEvent )
 {
-    const _taskPoolTimerEvent_t * const pTimerEvent1 = IotLink_Container( _taskPoolTimerEvent_t,
-                                                                          pTimerEventLink1,
-                                                                          link );
-    const _taskPoolTimerEvent_t * const pTimerEvent2 = IotLink_Container( _taskPoolTimerEvent_t,
-                                                                          pTimerEventLink2,
-                                                                          link );
+    uint32_t level, index;
 
-    if( pTimerEvent1->expirationTime < pTimerEvent2->expirationTime )
+    IotListDouble_Remove( &pTimerEvent->link );
+
+    if( pTimerEvent->slot != TASKPOOL_TIMER_WHEEL_OVERFLOW )
     {
-        return -1;
+        level = pTimerEvent->slot / TASKPOOL_TIMER_WHEEL_SLOTS;
+        index = pTimerEvent->slot % TASKPOOL_TIMER_WHEEL_SLOTS;
+
+        if( IotListDouble_IsEmpty( &pWheel->slots[ level ][ index ] ) )
+        {
+            pWheel->occupiedSlots[ level ] &= ~( ( uint32_t ) 1U << index );
+        }
     }
 
-    if( pTimerEvent1->expirationTime > pTimerEvent2->expirationTime )
+    IotTaskPool_Assert( pWheel->eventCount > 0UL );
+
+    pWheel->eventCount--;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _timerWheelNextTick( const _taskPoolTimerWheel_t * const pWheel,
+                                 uint64_t * const pNextTick )
+{
+    bool found = false;
+    uint32_t level = 0;
+    uint32_t index = 0;
+    uint32_t pendingSlots = 0;
+    uint64_t levelTick = 0;
+
+    /* The events of a level expire before the events of the levels above it, so the first
+     * occupied slot past the current one, starting from the bottom level, is the next tick of interest.
+     * The current slot of each level is always empty, since it was emptied when the wheel turned to it. */
+    for( level = 0; ( level < IOT_TASKPOOL_TIMER_WHEEL_LEVELS ) && ( found == false ); ++level )
     {
-        return 1;
+        levelTick = pWheel->currentTick >> ( level * TASKPOOL_TIMER_WHEEL_SLOT_BITS );
+        index = ( uint32_t ) levelTick & ( TASKPOOL_TIMER_WHEEL_SLOTS - 1UL );
+
+        /* Mask out the current slot and the slots before it. */
+        pendingSlots = pWheel->occupiedSlots[ level ] & ~( ( ( uint32_t ) 2U << index ) - 1U );
+
+        if( pendingSlots != 0U )
+        {
+            while( ( pendingSlots & ( ( uint32_t ) 1U << index ) ) == 0U )
+            {
+                index++;
+            }
+
+            *pNextTick = ( ( levelTick & ~( ( uint64_t ) TASKPOOL_TIMER_WHEEL_SLOTS - 1ULL ) ) | index ) <<
+                         ( level * TASKPOOL_TIMER_WHEEL_SLOT_BITS );
+
+            found = true;
+        }
+    }
+
+    /* With all levels empty, the events in the overflow list are revisited when the wheel completes its turn. */
+    if( ( found == false ) && ( IotListDouble_IsEmpty( &pWheel->overflow ) == false ) )
+    {
+        *pNextTick = ( ( pWheel->currentTick >> ( IOT_TASKPOOL_TIMER_WHEEL_LEVELS * TASKPOOL_TIMER_WHEEL_SLOT_BITS ) ) + 1ULL ) <<
+                     ( IOT_TASKPOOL_TIMER_WHEEL_LEVELS * TASKPOOL_TIMER_WHEEL_SLOT_BITS );
+
+        found = true;
     }
 
-    return 0;
+    return found;
 }
 
 /*-----------------------------------------------------------*/
 
-static void _rescheduleDeferredJobsTimer( IotTimer_t * const pTimer,
-                                          _taskPoolTimerEvent_t * const pFirstTimerEvent )
+static void _timerWheelCascade( _taskPoolTimerWheel_t * const pWheel,
+                                IotListDouble_t * const pList )
 {
-    uint64_t delta = 0;
-    uint64_t now = IotClock_GetTimeMs();
+    IotListDouble_t timerEvents;
+    IotLink_t * pLink = NULL;
 
-    if( pFirstTimerEvent->expirationTime > now )
+    /* Detach all events first, since some events of the overflow list may be linked to it again. */
+    IotListDouble_Create( &timerEvents );
+
+    while( ( pLink = IotListDouble_RemoveHead( pList ) ) != NULL )
     {
-        delta = pFirstTimerEvent->expirationTime - now;
+        IotListDouble_InsertTail( &timerEvents, pLink );
     }
 
-    if( delta < TASKPOOL_JOB_RESCHEDULE_DELAY_MS )
+    while( ( pLink = IotListDouble_RemoveHead( &timerEvents ) ) != NULL )
     {
-        delta = TASKPOOL_JOB_RESCHEDULE_DELAY_MS; /* The job will be late... */
+        _timerWheelLink( pWheel, IotLink_Container( _taskPoolTimerEvent_t, pLink, link ) );
     }
+}
 
-    IotTaskPool_Assert( delta > 0 );
+/*-----------------------------------------------------------*/
 
-    if( IotClock_TimerArm( pTimer, ( uint32_t ) delta, 0 ) == false )
+static void _timerWheelAdvance( _taskPoolTimerWheel_t * const pWheel,
+                                uint64_t targetTick,
+                                IotListDouble_t * const pExpired )
+{
+    uint32_t level = 0;
+    uint32_t index = 0;
+    uint64_t nextTick = 0;
+    IotLink_t * pLink = NULL;
+
+    /* Jump from one tick of interest to the next, skipping the ticks without any event. */
+    while( ( _timerWheelNextTick( pWheel, &nextTick ) == true ) && ( nextTick <= targetTick ) )
     {
-        IotLogWarn( "Failed to re-arm timer for task pool" );
+        pWheel->currentTick = nextTick;
+
+        /* Revisit the overflow list when the wheel completes a turn. */
+        if( ( nextTick & ( ( 1ULL << ( IOT_TASKPOOL_TIMER_WHEEL_LEVELS * TASKPOOL_TIMER_WHEEL_SLOT_BITS ) ) - 1ULL ) ) == 0ULL )
+        {
+            _timerWheelCascade( pWheel, &pWheel->overflow );
+        }
+
+        /* Move the events of the upper level slots starting at this tick down, top level first. */
+        for( level = IOT_TASKPOOL_TIMER_WHEEL_LEVELS - 1UL; level > 0UL; --level )
+        {
+            if( ( nextTick & ( ( 1ULL << ( level * TASKPOOL_TIMER_WHEEL_SLOT_BITS ) ) - 1ULL ) ) == 0ULL )
+            {
+                index = ( uint32_t ) ( nextTick >> ( level * TASKPOOL_TIMER_WHEEL_SLOT_BITS ) ) & ( TASKPOOL_TIMER_WHEEL_SLOTS - 1UL );
+
+                pWheel->occupiedSlots[ level ] &= ~( ( uint32_t ) 1U << index );
+
+                _timerWheelCascade( pWheel, &pWheel->slots[ level ][ index ] );
+            }
+        }
+
+        /* The events in the bottom level slot of this tick expire. */
+        index = ( uint32_t ) nextTick & ( TASKPOOL_TIMER_WHEEL_SLOTS - 1UL );
+
+        pWheel->occupiedSlots[ 0 ] &= ~( ( uint32_t ) 1U << index );
+
+        while( ( pLink = IotListDouble_RemoveHead( &pWheel->slots[ 0 ][ index ] ) ) != NULL )
+        {
+            IotListDouble_InsertTail( pExpired, pLink );
+
+            pWheel->eventCount--;
+        }
+    }
+
+    if( targetTick > pWheel->currentTick )
+    {
+        pWheel->currentTick = targetTick;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _rescheduleDeferredJobsTimer( _taskPool_t * const pTaskPool )
+{
+    _taskPoolTimerWheel_t * const pWheel = &pTaskPool->timerWheel;
+    uint64_t nextTick = 0;
+    uint64_t delta = 0;
+    uint64_t now = IotClock_GetTimeMs();
+
+    /* Nothing to do if the timer wheel is empty. */
+    if( _timerWheelNextTick( pWheel, &nextTick ) == true )
+    {
+        if( ( nextTick * IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS ) > now )
+        {
+            delta = ( nextTick * IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS ) - now;
+        }
+
+        if( delta < TASKPOOL_JOB_RESCHEDULE_DELAY_MS )
+        {
+            delta = TASKPOOL_JOB_RESCHEDULE_DELAY_MS; /* The job will be late... */
+        }
+
+        IotTaskPool_Assert( delta > 0 );
+
+        /* Re-arm the timer only if it is not due to fire by then already. */
+        if( ( pWheel->armedTime == 0ULL ) || ( pWheel->armedTime > ( now + delta ) ) )
+        {
+            if( IotClock_TimerArm( &pTaskPool->timer, ( uint32_t ) delta, 0 ) == false )
+            {
+                IotLogWarn( "Failed to re-arm timer for task pool" );
+            }
+            else
+            {
+                pWheel->armedTime = now + delta;
+            }
+        }
     }
 }
 
@@ -1761,9 +2927,13 @@ static void _timerThread( void * pArgument )
 {
     _taskPool_t * pTaskPool = ( _taskPool_t * ) pArgument;
     _taskPoolTimerEvent_t * pTimerEvent = NULL;
+    IotListDouble_t expiredEvents;
+    IotLink_t * pLink = NULL;
 
     IotLogDebug( "Timer thread started for task pool %p.", pTaskPool );
 
+    IotListDouble_Create( &expiredEvents );
+
     /* Attempt to lock the timer mutex. Return immediately if the mutex cannot be locked.
      * If this mutex cannot be locked it means that another thread is manipulating the
      * timeouts list, and will reset the timer to fire again, although it will be late.
@@ -1783,53 +2953,33 @@ static void _timerThread( void * pArgument )
             return;
         }
 
-        /* Dispatch all deferred job whose timer expired, then reset the timer for the next
-         * job down the line. */
-        for( ; ; )
-        {
-            /* Peek the first event in the timer event list. */
-            IotLink_t * pLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
-
-            /* Check if the timer misfired for any reason.  */
-            if( pLink != NULL )
-            {
-                /* Record the current time. */
-                uint64_t now = IotClock_GetTimeMs();
-
-                /* Extract the job from its envelope. */
-                pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pLink, link );
+        /* The timer fired, so it is not armed anymore. */
+        pTaskPool->timerWheel.armedTime = 0;
 
-                /* Check if the first event should be processed now. */
-                if( pTimerEvent->expirationTime <= now )
-                {
-                    /*  Remove the timer event for immediate processing. */
-                    IotListDouble_Remove( &( pTimerEvent->link ) );
-                }
-                else
-                {
-                    /* The first element in the timer queue shouldn't be processed yet.
-                     * Arm the timer for when it should be processed and leave altogether. */
-                    _rescheduleDeferredJobsTimer( &pTaskPool->timer, pTimerEvent );
+        /* Turn the timer wheel to the current time, and collect all timer events that expired. */
+        _timerWheelAdvance( &pTaskPool->timerWheel,
+                            IotClock_GetTimeMs() / IOT_TASKPOOL_TIMER_WHEEL_RESOLUTION_MS,
+                            &expiredEvents );
 
-                    break;
-                }
-            }
-            /* If there are no timer events to process, terminate this thread. */
-            else
-            {
-                IotLogDebug( "No further timer events to process. Exiting timer thread." );
-
-                break;
-            }
+        /* Dispatch all deferred job whose timer expired. */
+        while( ( pLink = IotListDouble_RemoveHead( &expiredEvents ) ) != NULL )
+        {
+            /* Extract the job from its envelope. */
+            pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pLink, link );
 
             IotLogDebug( "Scheduling job from timer event." );
 
+            pTimerEvent->pJob->pTimerEvent = NULL;
+
             /* Queue the job associated with the received timer event. */
             ( void ) _scheduleInternal( pTaskPool, pTimerEvent->pJob, 0 );
 
             /* Free the timer event. */
             IotTaskPool_FreeTimerEvent( pTimerEvent );
         }
+
+        /* Arm the timer for the next job down the line, if any. */
+        _rescheduleDeferredJobsTimer( pTaskPool );
     }
     TASKPOOL_EXIT_CRITICAL();
 }
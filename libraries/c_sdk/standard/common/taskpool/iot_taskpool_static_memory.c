@@ -37,6 +37,7 @@
 /* Standard includes. */
     #include <stdbool.h>
     #include <stddef.h>
+    #include <stdint.h>
     #include <string.h>
 
 /* Static memory include. */
@@ -57,32 +58,44 @@
 /*
  * Static memory buffers and flags, allocated and zeroed at compile-time.
  */
-    static bool _pInUseTaskPools[ IOT_TASKPOOLS ] = { 0 };                                                          /**< @brief Task pools in-use flags. */
-    static _taskPool_t _pTaskPools[ IOT_TASKPOOLS ] = { { .dispatchQueue = IOT_DEQUEUE_INITIALIZER } };             /**< @brief Task pools. */
+    static uint32_t _pInUseTaskPools[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_TASKPOOLS ) ] = { 0 };                             /**< @brief Task pools in-use flags. */
+    static _taskPool_t _pTaskPools[ IOT_TASKPOOLS ] = { { .classQueues = { { .jobs = IOT_DEQUEUE_INITIALIZER } } } };            /**< @brief Task pools. */
 
-    static bool _pInUseTaskPoolJobs[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { 0 };                                     /**< @brief Task pool jobs in-use flags. */
-    static _taskPoolJob_t _pTaskPoolJobs[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { { .link = IOT_LINK_INITIALIZER } }; /**< @brief Task pool jobs. */
+    static uint32_t _pInUseTaskPoolJobs[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ) ] = { 0 };        /**< @brief Task pool jobs in-use flags. */
+    static _taskPoolJob_t _pTaskPoolJobs[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { { .link = IOT_LINK_INITIALIZER } };        /**< @brief Task pool jobs. */
 
-    static bool _pInUseTaskPoolTimerEvents[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { 0 };                              /**< @brief Task pool timer event in-use flags. */
-    static _taskPoolTimerEvent_t _pTaskPoolTimerEvents[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { { .link = { 0 } } };  /**< @brief Task pool timer events. */
+    static uint32_t _pInUseTaskPoolTimerEvents[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ) ] = { 0 }; /**< @brief Task pool timer event in-use flags. */
+    static _taskPoolTimerEvent_t _pTaskPoolTimerEvents[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { { .link = { 0 } } };         /**< @brief Task pool timer events. */
+
+/** @brief Pool of task pools. */
+    static IotStaticMemoryPool_t _taskPoolPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pTaskPools,
+                                                                                     _pInUseTaskPools,
+                                                                                     sizeof( _taskPool_t ),
+                                                                                     IOT_TASKPOOLS );
+
+/** @brief Pool of task pool jobs. */
+    static IotStaticMemoryPool_t _taskPoolJobPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pTaskPoolJobs,
+                                                                                        _pInUseTaskPoolJobs,
+                                                                                        sizeof( _taskPoolJob_t ),
+                                                                                        IOT_TASKPOOL_JOBS_RECYCLE_LIMIT );
+
+/** @brief Pool of task pool timer events. */
+    static IotStaticMemoryPool_t _taskPoolTimerEventPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pTaskPoolTimerEvents,
+                                                                                               _pInUseTaskPoolTimerEvents,
+                                                                                               sizeof( _taskPoolTimerEvent_t ),
+                                                                                               IOT_TASKPOOL_JOBS_RECYCLE_LIMIT );
 
 /*-----------------------------------------------------------*/
 
     void * IotTaskPool_MallocTaskPool( size_t size )
     {
-        int freeIndex = -1;
         void * pNewTaskPool = NULL;
 
         /* Check size argument. */
         if( size == sizeof( _taskPool_t ) )
         {
             /* Find a free task pool job. */
-            freeIndex = IotStaticMemory_FindFree( _pInUseTaskPools, IOT_TASKPOOLS );
-
-            if( freeIndex != -1 )
-            {
-                pNewTaskPool = &( _pTaskPools[ freeIndex ] );
-            }
+            pNewTaskPool = IotStaticMemory_Alloc( &_taskPoolPool );
         }
 
         return pNewTaskPool;
@@ -93,31 +106,20 @@
     void IotTaskPool_FreeTaskPool( void * ptr )
     {
         /* Return the in-use task pool job. */
-        IotStaticMemory_ReturnInUse( ptr,
-                                     _pTaskPools,
-                                     _pInUseTaskPools,
-                                     IOT_TASKPOOLS,
-                                     sizeof( _taskPool_t ) );
+        IotStaticMemory_Free( &_taskPoolPool, ptr );
     }
 
 /*-----------------------------------------------------------*/
 
     void * IotTaskPool_MallocJob( size_t size )
     {
-        int32_t freeIndex = -1;
         void * pNewJob = NULL;
 
         /* Check size argument. */
         if( size == sizeof( _taskPoolJob_t ) )
         {
             /* Find a free task pool job. */
-            freeIndex = IotStaticMemory_FindFree( _pInUseTaskPoolJobs,
-                                                  IOT_TASKPOOL_JOBS_RECYCLE_LIMIT );
-
-            if( freeIndex != -1 )
-            {
-                pNewJob = &( _pTaskPoolJobs[ freeIndex ] );
-            }
+            pNewJob = IotStaticMemory_Alloc( &_taskPoolJobPool );
         }
 
         return pNewJob;
@@ -128,31 +130,20 @@
     void IotTaskPool_FreeJob( void * ptr )
     {
         /* Return the in-use task pool job. */
-        IotStaticMemory_ReturnInUse( ptr,
-                                     _pTaskPoolJobs,
-                                     _pInUseTaskPoolJobs,
-                                     IOT_TASKPOOL_JOBS_RECYCLE_LIMIT,
-                                     sizeof( _taskPoolJob_t ) );
+        IotStaticMemory_Free( &_taskPoolJobPool, ptr );
     }
 
 /*-----------------------------------------------------------*/
 
     void * IotTaskPool_MallocTimerEvent( size_t size )
     {
-        int32_t freeIndex = -1;
         void * pNewTimerEvent = NULL;
 
         /* Check size argument. */
         if( size == sizeof( _taskPoolTimerEvent_t ) )
         {
             /* Find a free task pool timer event. */
-            freeIndex = IotStaticMemory_FindFree( _pInUseTaskPoolTimerEvents,
-                                                  IOT_TASKPOOL_JOBS_RECYCLE_LIMIT );
-
-            if( freeIndex != -1 )
-            {
-                pNewTimerEvent = &( _pTaskPoolTimerEvents[ freeIndex ] );
-            }
+            pNewTimerEvent = IotStaticMemory_Alloc( &_taskPoolTimerEventPool );
         }
 
         return pNewTimerEvent;
@@ -163,11 +154,7 @@
     void IotTaskPool_FreeTimerEvent( void * ptr )
     {
         /* Return the in-use task pool timer event. */
-        IotStaticMemory_ReturnInUse( ptr,
-                                     _pTaskPoolTimerEvents,
-                                     _pInUseTaskPoolTimerEvents,
-                                     IOT_TASKPOOL_JOBS_RECYCLE_LIMIT,
-                                     sizeof( _taskPoolTimerEvent_t ) );
+        IotStaticMemory_Free( &_taskPoolTimerEventPool, ptr );
     }
 
 /*-----------------------------------------------------------*/
@@ -0,0 +1,481 @@
+/*
+ * FreeRTOS Common V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_tests_indexed_containers.c
+ * @brief Tests for the intrusive hash table and red-black tree.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Indexed containers include. */
+#include "iot_indexed_containers.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Number of elements used by each test.
+ */
+#define TEST_ELEMENT_COUNT    ( 257 )
+
+/**
+ * @brief Number of buckets of the hash table used by each test.
+ */
+#define TEST_BUCKET_COUNT     ( 32 )
+
+/**
+ * @brief A prime used to shuffle the order of insertion and removal.
+ */
+#define TEST_PRIME            ( 7919UL )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief An element that may be linked in a hash table and a tree at the same time.
+ */
+typedef struct TestElement
+{
+    uint32_t key;               /**< @brief Key of the element. */
+    uint32_t order;             /**< @brief Order in which the element was inserted. */
+    IotHashLink_t hashLink;     /**< @brief Hash table link. */
+    IotTreeLink_t treeLink;     /**< @brief Tree link. */
+} TestElement_t;
+
+/**
+ * @brief Elements used by the tests.
+ */
+static TestElement_t _elements[ TEST_ELEMENT_COUNT ];
+
+/**
+ * @brief Buckets of the hash table used by the tests.
+ */
+static IotHashLink_t * _buckets[ TEST_BUCKET_COUNT ];
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Match a hash table element against a key.
+ */
+static bool _hashMatch( const IotHashLink_t * const pLink,
+                        void * pMatch )
+{
+    return( IotLink_Container( TestElement_t, pLink, hashLink )->key == *( ( uint32_t * ) pMatch ) );
+}
+
+/**
+ * @brief Order two tree elements by key.
+ */
+static int32_t _treeCompare( const IotTreeLink_t * const pFirst,
+                             const IotTreeLink_t * const pSecond )
+{
+    uint32_t firstKey = IotLink_Container( TestElement_t, pFirst, treeLink )->key;
+    uint32_t secondKey = IotLink_Container( TestElement_t, pSecond, treeLink )->key;
+
+    return( ( firstKey > secondKey ) - ( firstKey < secondKey ) );
+}
+
+/**
+ * @brief Compare a tree element with a key.
+ */
+static int32_t _treeCompareKey( const IotTreeLink_t * const pLink,
+                                const void * pKey )
+{
+    uint32_t elementKey = IotLink_Container( TestElement_t, pLink, treeLink )->key;
+    uint32_t key = *( ( const uint32_t * ) pKey );
+
+    return( ( elementKey > key ) - ( elementKey < key ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check the red-black properties of a subtree.
+ *
+ * @return The black height of the subtree; -1 if a property is violated.
+ */
+static int32_t _checkSubtree( const IotTreeLink_t * pLink,
+                              const IotTreeLink_t * pParent,
+                              size_t * pCount )
+{
+    int32_t leftHeight = 0, rightHeight = 0, height = -1;
+
+    if( pLink == NULL )
+    {
+        height = 1;
+    }
+    else if( pLink->pParent == pParent )
+    {
+        ( *pCount )++;
+
+        /* A red element never has a red child. */
+        if( ( pLink->color == IOT_TREE_BLACK ) ||
+            ( ( ( pLink->pLeft == NULL ) || ( pLink->pLeft->color == IOT_TREE_BLACK ) ) &&
+              ( ( pLink->pRight == NULL ) || ( pLink->pRight->color == IOT_TREE_BLACK ) ) ) )
+        {
+            leftHeight = _checkSubtree( pLink->pLeft, pLink, pCount );
+            rightHeight = _checkSubtree( pLink->pRight, pLink, pCount );
+
+            /* Every path to a leaf has the same number of black elements. */
+            if( ( leftHeight > 0 ) && ( leftHeight == rightHeight ) )
+            {
+                height = leftHeight + ( ( pLink->color == IOT_TREE_BLACK ) ? 1 : 0 );
+            }
+        }
+    }
+
+    return height;
+}
+
+/**
+ * @brief Check the red-black properties, order and count of a tree.
+ */
+static void _checkTree( const IotTree_t * pTree )
+{
+    size_t count = 0, iterated = 0;
+    const IotTreeLink_t * pLink = NULL, * pPrevious = NULL;
+
+    TEST_ASSERT_TRUE( ( pTree->pRoot == NULL ) || ( pTree->pRoot->color == IOT_TREE_BLACK ) );
+    TEST_ASSERT_GREATER_THAN( 0, _checkSubtree( pTree->pRoot, NULL, &count ) );
+    TEST_ASSERT_EQUAL( IotTree_Count( pTree ), count );
+
+    IotTree_ForEach( pTree, pLink )
+    {
+        if( pPrevious != NULL )
+        {
+            TEST_ASSERT_TRUE( _treeCompare( pPrevious, pLink ) <= 0 );
+            TEST_ASSERT_TRUE( IotTree_Previous( pLink ) == pPrevious );
+        }
+
+        pPrevious = pLink;
+        iterated++;
+    }
+
+    TEST_ASSERT_EQUAL( count, iterated );
+    TEST_ASSERT_TRUE( IotTree_Last( pTree ) == pPrevious );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for indexed containers tests.
+ */
+TEST_GROUP( Common_Unit_Indexed_Containers );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for indexed containers tests.
+ */
+TEST_SETUP( Common_Unit_Indexed_Containers )
+{
+    uint32_t i = 0;
+
+    ( void ) memset( _elements, 0x00, sizeof( _elements ) );
+
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        _elements[ i ].key = i;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for indexed containers tests.
+ */
+TEST_TEAR_DOWN( Common_Unit_Indexed_Containers )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for indexed containers tests.
+ */
+TEST_GROUP_RUNNER( Common_Unit_Indexed_Containers )
+{
+    RUN_TEST_CASE( Common_Unit_Indexed_Containers, HashTableInsertFindRemove );
+    RUN_TEST_CASE( Common_Unit_Indexed_Containers, HashTableDuplicatesIterate );
+    RUN_TEST_CASE( Common_Unit_Indexed_Containers, TreeInsertFindRemove );
+    RUN_TEST_CASE( Common_Unit_Indexed_Containers, TreeDuplicatesRemoveAll );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Insert, find, and remove elements of a hash table.
+ */
+TEST( Common_Unit_Indexed_Containers, HashTableInsertFindRemove )
+{
+    uint32_t i = 0, key = 0;
+    IotHashTable_t table = IOT_HASH_TABLE_INITIALIZER;
+    IotHashLink_t * pLink = NULL;
+
+    IotHashTable_Create( &table, _buckets, TEST_BUCKET_COUNT );
+    TEST_ASSERT_EQUAL( 0, IotHashTable_Count( &table ) );
+    TEST_ASSERT_NULL( IotHashTable_First( &table ) );
+
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        IotHashTable_Insert( &table, &( _elements[ i ].hashLink ), IotHash_Uint32( i ) );
+        TEST_ASSERT_TRUE( IotHashLink_IsLinked( &( _elements[ i ].hashLink ) ) );
+    }
+
+    TEST_ASSERT_EQUAL( TEST_ELEMENT_COUNT, IotHashTable_Count( &table ) );
+
+    /* Every element is found by its key. */
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        pLink = IotHashTable_FindFirstMatch( &table, IotHash_Uint32( i ), _hashMatch, &i );
+        TEST_ASSERT_TRUE( pLink == &( _elements[ i ].hashLink ) );
+    }
+
+    /* A key not in the table is not found. */
+    key = TEST_ELEMENT_COUNT;
+    TEST_ASSERT_NULL( IotHashTable_FindFirstMatch( &table, IotHash_Uint32( key ), _hashMatch, &key ) );
+
+    /* Remove elements in a shuffled order. */
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        key = ( uint32_t ) ( ( i * TEST_PRIME ) % TEST_ELEMENT_COUNT );
+
+        if( ( i % 2 ) == 0 )
+        {
+            pLink = IotHashTable_RemoveFirstMatch( &table, IotHash_Uint32( key ), _hashMatch, &key );
+            TEST_ASSERT_TRUE( pLink == &( _elements[ key ].hashLink ) );
+        }
+        else
+        {
+            IotHashTable_Remove( &table, &( _elements[ key ].hashLink ) );
+        }
+
+        TEST_ASSERT_FALSE( IotHashLink_IsLinked( &( _elements[ key ].hashLink ) ) );
+        TEST_ASSERT_NULL( IotHashTable_FindFirstMatch( &table, IotHash_Uint32( key ), _hashMatch, &key ) );
+        TEST_ASSERT_EQUAL( TEST_ELEMENT_COUNT - i - 1, IotHashTable_Count( &table ) );
+    }
+
+    TEST_ASSERT_NULL( IotHashTable_First( &table ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find elements with equal keys and iterate a hash table.
+ */
+TEST( Common_Unit_Indexed_Containers, HashTableDuplicatesIterate )
+{
+    uint32_t i = 0, key = 7, iterated = 0, matches = 0;
+    const char * pName = "topic/name";
+    IotHashTable_t table = IOT_HASH_TABLE_INITIALIZER;
+    IotHashLink_t * pLink = NULL;
+
+    IotHashTable_Create( &table, _buckets, TEST_BUCKET_COUNT );
+
+    /* Give a few elements the same key. */
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        if( ( i % 16 ) == 0 )
+        {
+            _elements[ i ].key = key;
+        }
+
+        IotHashTable_Insert( &table,
+                             &( _elements[ i ].hashLink ),
+                             IotHash_String( ( const char * ) &( _elements[ i ].key ), sizeof( uint32_t ) ) );
+    }
+
+    /* All elements with the same key are found. */
+    pLink = IotHashTable_FindFirstMatch( &table,
+                                         IotHash_String( ( const char * ) &key, sizeof( uint32_t ) ),
+                                         _hashMatch,
+                                         &key );
+
+    while( pLink != NULL )
+    {
+        TEST_ASSERT_EQUAL( key, IotLink_Container( TestElement_t, pLink, hashLink )->key );
+        matches++;
+        pLink = IotHashTable_FindNextMatch( pLink, _hashMatch, &key );
+    }
+
+    /* Element 7 and every 16th element share the key. */
+    TEST_ASSERT_EQUAL( ( ( TEST_ELEMENT_COUNT - 1 ) / 16 ) + 2, matches );
+
+    /* Iteration visits every element exactly once. */
+    for( pLink = IotHashTable_First( &table ); pLink != NULL; pLink = IotHashTable_Next( &table, pLink ) )
+    {
+        IotLink_Container( TestElement_t, pLink, hashLink )->order++;
+        iterated++;
+    }
+
+    TEST_ASSERT_EQUAL( TEST_ELEMENT_COUNT, iterated );
+
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( 1, _elements[ i ].order );
+    }
+
+    /* String hashes are stable. */
+    TEST_ASSERT_EQUAL( IotHash_String( pName, strlen( pName ) ), IotHash_String( "topic/name", 10 ) );
+    TEST_ASSERT_EQUAL( 2166136261UL, IotHash_String( NULL, 0 ) );
+
+    IotHashTable_RemoveAll( &table, NULL, 0 );
+    TEST_ASSERT_EQUAL( 0, IotHashTable_Count( &table ) );
+    TEST_ASSERT_FALSE( IotHashLink_IsLinked( &( _elements[ 0 ].hashLink ) ) );
+    TEST_ASSERT_NULL( IotHashTable_First( &table ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Insert, find, and remove elements of a red-black tree, checking the
+ * red-black properties after every change.
+ */
+TEST( Common_Unit_Indexed_Containers, TreeInsertFindRemove )
+{
+    uint32_t i = 0, key = 0;
+    IotTree_t tree = IOT_TREE_INITIALIZER;
+    IotTreeLink_t * pLink = NULL;
+
+    IotTree_Create( &tree );
+    TEST_ASSERT_TRUE( IotTree_IsEmpty( &tree ) );
+    TEST_ASSERT_NULL( IotTree_First( &tree ) );
+    TEST_ASSERT_NULL( IotTree_Last( &tree ) );
+
+    /* Insert elements in a shuffled order. */
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        key = ( uint32_t ) ( ( i * TEST_PRIME ) % TEST_ELEMENT_COUNT );
+        IotTree_Insert( &tree, &( _elements[ key ].treeLink ), _treeCompare );
+        TEST_ASSERT_TRUE( IotTreeLink_IsLinked( &( _elements[ key ].treeLink ) ) );
+        _checkTree( &tree );
+    }
+
+    TEST_ASSERT_EQUAL( TEST_ELEMENT_COUNT, IotTree_Count( &tree ) );
+    TEST_ASSERT_TRUE( IotTree_First( &tree ) == &( _elements[ 0 ].treeLink ) );
+    TEST_ASSERT_TRUE( IotTree_Last( &tree ) == &( _elements[ TEST_ELEMENT_COUNT - 1 ].treeLink ) );
+
+    /* Every element is found by its key. */
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        TEST_ASSERT_TRUE( IotTree_Find( &tree, &i, _treeCompareKey ) == &( _elements[ i ].treeLink ) );
+    }
+
+    key = TEST_ELEMENT_COUNT;
+    TEST_ASSERT_NULL( IotTree_Find( &tree, &key, _treeCompareKey ) );
+    TEST_ASSERT_NULL( IotTree_LowerBound( &tree, &key, _treeCompareKey ) );
+
+    /* Remove the odd keys, so lower bounds of odd keys are the next even key. */
+    for( i = 1; i < TEST_ELEMENT_COUNT; i += 2 )
+    {
+        pLink = IotTree_RemoveFirstMatch( &tree, &i, _treeCompareKey );
+        TEST_ASSERT_TRUE( pLink == &( _elements[ i ].treeLink ) );
+        TEST_ASSERT_FALSE( IotTreeLink_IsLinked( pLink ) );
+        _checkTree( &tree );
+    }
+
+    key = 5;
+    TEST_ASSERT_NULL( IotTree_Find( &tree, &key, _treeCompareKey ) );
+    TEST_ASSERT_TRUE( IotTree_LowerBound( &tree, &key, _treeCompareKey ) == &( _elements[ 6 ].treeLink ) );
+
+    /* Remove the remaining elements in a shuffled order. */
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        key = ( uint32_t ) ( ( i * TEST_PRIME ) % TEST_ELEMENT_COUNT );
+
+        if( IotTreeLink_IsLinked( &( _elements[ key ].treeLink ) ) == true )
+        {
+            IotTree_Remove( &tree, &( _elements[ key ].treeLink ) );
+            _checkTree( &tree );
+        }
+    }
+
+    TEST_ASSERT_TRUE( IotTree_IsEmpty( &tree ) );
+    TEST_ASSERT_EQUAL( 0, IotTree_Count( &tree ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Free function that counts the elements released by a RemoveAll call.
+ */
+static void _countRemoved( void * pElement )
+{
+    ( ( TestElement_t * ) pElement )->order = UINT32_MAX;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check that elements with equal keys keep their order of insertion, and
+ * that a tree can be emptied at once.
+ */
+TEST( Common_Unit_Indexed_Containers, TreeDuplicatesRemoveAll )
+{
+    uint32_t i = 0, key = 3, expectedOrder = 0;
+    IotTree_t tree = IOT_TREE_INITIALIZER;
+    IotTreeLink_t * pLink = NULL;
+
+    IotTree_Create( &tree );
+
+    /* Only keys 0 to 7 are used, so every key is inserted many times. */
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        _elements[ i ].key = ( uint32_t ) ( ( i * TEST_PRIME ) % 8 );
+        _elements[ i ].order = i;
+        IotTree_Insert( &tree, &( _elements[ i ].treeLink ), _treeCompare );
+    }
+
+    _checkTree( &tree );
+
+    /* Equal elements are iterated in their order of insertion. */
+    for( pLink = IotTree_Find( &tree, &key, _treeCompareKey );
+         ( pLink != NULL ) && ( _treeCompareKey( pLink, &key ) == 0 );
+         pLink = IotTree_Next( pLink ) )
+    {
+        TEST_ASSERT_TRUE( IotLink_Container( TestElement_t, pLink, treeLink )->order >= expectedOrder );
+        expectedOrder = IotLink_Container( TestElement_t, pLink, treeLink )->order;
+    }
+
+    IotTree_RemoveAll( &tree, _countRemoved, offsetof( TestElement_t, treeLink ) );
+    TEST_ASSERT_TRUE( IotTree_IsEmpty( &tree ) );
+
+    for( i = 0; i < TEST_ELEMENT_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( UINT32_MAX, _elements[ i ].order );
+        TEST_ASSERT_FALSE( IotTreeLink_IsLinked( &( _elements[ i ].treeLink ) ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
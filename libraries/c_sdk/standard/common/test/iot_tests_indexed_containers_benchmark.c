@@ -0,0 +1,433 @@
+/*
+ * FreeRTOS Common V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_tests_indexed_containers_benchmark.c
+ * @brief Lookup and removal benchmarks comparing the indexed containers with
+ * doubly-linked lists.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+
+/* Container includes. */
+#include "iot_linear_containers.h"
+#include "iot_indexed_containers.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The largest number of elements to measure with. Containers are measured
+ * with 16, 64, 256, ... elements up to this number.
+ */
+#ifndef TEST_CONTAINERS_BENCHMARK_MAX_ELEMENTS
+    #define TEST_CONTAINERS_BENCHMARK_MAX_ELEMENTS    ( 1024 )
+#endif
+
+/**
+ * @brief Number of lookups performed by every lookup measurement.
+ */
+#ifndef TEST_CONTAINERS_BENCHMARK_LOOKUPS
+    #define TEST_CONTAINERS_BENCHMARK_LOOKUPS    ( 20000 )
+#endif
+
+/**
+ * @brief Number of buckets of the benchmarked hash table.
+ */
+#ifndef TEST_CONTAINERS_BENCHMARK_BUCKETS
+    #define TEST_CONTAINERS_BENCHMARK_BUCKETS    ( 256 )
+#endif
+
+/**
+ * @brief A prime used to shuffle the order of lookups and removals.
+ */
+#define TEST_CONTAINERS_BENCHMARK_PRIME    ( 7919UL )
+
+/**
+ * @brief Length of the buffer for printing benchmark results.
+ */
+#define TEST_CONTAINERS_BENCHMARK_RESULT_LENGTH    ( 160 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief An element linked in a list, a hash table, and a tree at the same time.
+ */
+typedef struct BenchmarkElement
+{
+    uint32_t key;               /**< @brief Key of the element. */
+    IotLink_t listLink;         /**< @brief List link. */
+    IotHashLink_t hashLink;     /**< @brief Hash table link. */
+    IotTreeLink_t treeLink;     /**< @brief Tree link. */
+} BenchmarkElement_t;
+
+/**
+ * @brief Elements of the benchmarked containers.
+ */
+static BenchmarkElement_t _benchmarkElements[ TEST_CONTAINERS_BENCHMARK_MAX_ELEMENTS ];
+
+/**
+ * @brief Buckets of the benchmarked hash table.
+ */
+static IotHashLink_t * _benchmarkBuckets[ TEST_CONTAINERS_BENCHMARK_BUCKETS ];
+
+/**
+ * @brief Time taken by one measurement of each container, in milliseconds.
+ */
+typedef struct BenchmarkResult
+{
+    uint32_t list;  /**< @brief Time taken by the doubly-linked list. */
+    uint32_t hash;  /**< @brief Time taken by the hash table. */
+    uint32_t tree;  /**< @brief Time taken by the red-black tree. */
+} BenchmarkResult_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for indexed containers benchmarks.
+ */
+TEST_GROUP( Common_Benchmark_Indexed_Containers );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for indexed containers benchmarks.
+ */
+TEST_SETUP( Common_Benchmark_Indexed_Containers )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for indexed containers benchmarks.
+ */
+TEST_TEAR_DOWN( Common_Benchmark_Indexed_Containers )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for indexed containers benchmarks.
+ */
+TEST_GROUP_RUNNER( Common_Benchmark_Indexed_Containers )
+{
+    RUN_TEST_CASE( Common_Benchmark_Indexed_Containers, Lookup );
+    RUN_TEST_CASE( Common_Benchmark_Indexed_Containers, Removal );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Match a list element against a key.
+ */
+static bool _listMatch( const IotLink_t * pLink,
+                        void * pMatch )
+{
+    return( IotLink_Container( BenchmarkElement_t, pLink, listLink )->key == *( ( uint32_t * ) pMatch ) );
+}
+
+/**
+ * @brief Match a hash table element against a key.
+ */
+static bool _hashMatch( const IotHashLink_t * const pLink,
+                        void * pMatch )
+{
+    return( IotLink_Container( BenchmarkElement_t, pLink, hashLink )->key == *( ( uint32_t * ) pMatch ) );
+}
+
+/**
+ * @brief Order two tree elements by key.
+ */
+static int32_t _treeCompare( const IotTreeLink_t * const pFirst,
+                             const IotTreeLink_t * const pSecond )
+{
+    uint32_t firstKey = IotLink_Container( BenchmarkElement_t, pFirst, treeLink )->key;
+    uint32_t secondKey = IotLink_Container( BenchmarkElement_t, pSecond, treeLink )->key;
+
+    return( ( firstKey > secondKey ) - ( firstKey < secondKey ) );
+}
+
+/**
+ * @brief Compare a tree element with a key.
+ */
+static int32_t _treeCompareKey( const IotTreeLink_t * const pLink,
+                                const void * pKey )
+{
+    uint32_t elementKey = IotLink_Container( BenchmarkElement_t, pLink, treeLink )->key;
+    uint32_t key = *( ( const uint32_t * ) pKey );
+
+    return( ( elementKey > key ) - ( elementKey < key ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Fill a list, a hash table, and a tree with the same elements.
+ */
+static void _fillContainers( uint32_t elementCount,
+                             IotListDouble_t * pList,
+                             IotHashTable_t * pTable,
+                             IotTree_t * pTree )
+{
+    uint32_t i = 0;
+
+    ( void ) memset( _benchmarkElements, 0x00, sizeof( _benchmarkElements ) );
+
+    IotListDouble_Create( pList );
+    IotHashTable_Create( pTable, _benchmarkBuckets, TEST_CONTAINERS_BENCHMARK_BUCKETS );
+    IotTree_Create( pTree );
+
+    for( i = 0; i < elementCount; i++ )
+    {
+        /* Spread the keys, like packet identifiers or topic hashes would be. */
+        _benchmarkElements[ i ].key = i * TEST_CONTAINERS_BENCHMARK_PRIME;
+
+        IotListDouble_InsertTail( pList, &( _benchmarkElements[ i ].listLink ) );
+        IotHashTable_Insert( pTable, &( _benchmarkElements[ i ].hashLink ), IotHash_Uint32( _benchmarkElements[ i ].key ) );
+        IotTree_Insert( pTree, &( _benchmarkElements[ i ].treeLink ), _treeCompare );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return the elapsed time since a start time, never 0.
+ */
+static uint32_t _elapsedMs( uint64_t startTime )
+{
+    uint64_t elapsedTime = IotClock_GetTimeMs() - startTime;
+
+    /* Avoid reporting zero on very fast runs. */
+    if( elapsedTime == 0ULL )
+    {
+        elapsedTime = 1ULL;
+    }
+
+    return ( uint32_t ) elapsedTime;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Print the result of one measurement.
+ */
+static void _printResult( const char * pOperation,
+                          uint32_t elementCount,
+                          uint32_t operationCount,
+                          const BenchmarkResult_t * pResult )
+{
+    char pOutput[ TEST_CONTAINERS_BENCHMARK_RESULT_LENGTH ] = { 0 };
+
+    snprintf( pOutput,
+              TEST_CONTAINERS_BENCHMARK_RESULT_LENGTH,
+              "%lu %s with %lu elements: list %lu ms, hash table %lu ms, tree %lu ms.\r\n",
+              ( unsigned long ) operationCount,
+              pOperation,
+              ( unsigned long ) elementCount,
+              ( unsigned long ) pResult->list,
+              ( unsigned long ) pResult->hash,
+              ( unsigned long ) pResult->tree );
+
+    UnityPrint( pOutput );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare the time taken to look up elements by key in a list, a hash
+ * table, and a tree as the number of elements grows.
+ */
+TEST( Common_Benchmark_Indexed_Containers, Lookup )
+{
+    uint32_t elementCount = 0, i = 0, key = 0, found = 0;
+    uint64_t startTime = 0;
+    IotListDouble_t list = IOT_LIST_DOUBLE_INITIALIZER;
+    IotHashTable_t table = IOT_HASH_TABLE_INITIALIZER;
+    IotTree_t tree = IOT_TREE_INITIALIZER;
+    BenchmarkResult_t result = { 0 };
+
+    for( elementCount = 16; elementCount <= TEST_CONTAINERS_BENCHMARK_MAX_ELEMENTS; elementCount *= 4 )
+    {
+        _fillContainers( elementCount, &list, &table, &tree );
+
+        startTime = IotClock_GetTimeMs();
+
+        for( i = 0, found = 0; i < TEST_CONTAINERS_BENCHMARK_LOOKUPS; i++ )
+        {
+            key = ( i % elementCount ) * TEST_CONTAINERS_BENCHMARK_PRIME;
+            found += ( IotListDouble_FindFirstMatch( &list, NULL, _listMatch, &key ) != NULL ) ? 1 : 0;
+        }
+
+        result.list = _elapsedMs( startTime );
+        TEST_ASSERT_EQUAL( TEST_CONTAINERS_BENCHMARK_LOOKUPS, found );
+
+        startTime = IotClock_GetTimeMs();
+
+        for( i = 0, found = 0; i < TEST_CONTAINERS_BENCHMARK_LOOKUPS; i++ )
+        {
+            key = ( i % elementCount ) * TEST_CONTAINERS_BENCHMARK_PRIME;
+            found += ( IotHashTable_FindFirstMatch( &table, IotHash_Uint32( key ), _hashMatch, &key ) != NULL ) ? 1 : 0;
+        }
+
+        result.hash = _elapsedMs( startTime );
+        TEST_ASSERT_EQUAL( TEST_CONTAINERS_BENCHMARK_LOOKUPS, found );
+
+        startTime = IotClock_GetTimeMs();
+
+        for( i = 0, found = 0; i < TEST_CONTAINERS_BENCHMARK_LOOKUPS; i++ )
+        {
+            key = ( i % elementCount ) * TEST_CONTAINERS_BENCHMARK_PRIME;
+            found += ( IotTree_Find( &tree, &key, _treeCompareKey ) != NULL ) ? 1 : 0;
+        }
+
+        result.tree = _elapsedMs( startTime );
+        TEST_ASSERT_EQUAL( TEST_CONTAINERS_BENCHMARK_LOOKUPS, found );
+
+        _printResult( "lookups", elementCount, TEST_CONTAINERS_BENCHMARK_LOOKUPS, &result );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return the key of the element removed at a position of the shuffled
+ * removal order. 31 and the element counts are coprime, so every element is
+ * removed once.
+ */
+static uint32_t _removalKey( uint32_t position,
+                             uint32_t elementCount )
+{
+    return ( uint32_t ) ( ( ( position * 31UL ) + 7UL ) % elementCount ) * TEST_CONTAINERS_BENCHMARK_PRIME;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare the time taken to remove every element by key, in a shuffled
+ * order, from a list, a hash table, and a tree as the number of elements grows.
+ *
+ * Elements are inserted back after each round of removals so that every
+ * measurement performs about #TEST_CONTAINERS_BENCHMARK_LOOKUPS removals.
+ */
+TEST( Common_Benchmark_Indexed_Containers, Removal )
+{
+    uint32_t elementCount = 0, rounds = 0, round = 0, i = 0, key = 0;
+    uint64_t startTime = 0;
+    IotLink_t * pListLink = NULL;
+    IotHashLink_t * pHashLink = NULL;
+    IotTreeLink_t * pTreeLink = NULL;
+    IotListDouble_t list = IOT_LIST_DOUBLE_INITIALIZER;
+    IotHashTable_t table = IOT_HASH_TABLE_INITIALIZER;
+    IotTree_t tree = IOT_TREE_INITIALIZER;
+    BenchmarkResult_t result = { 0 };
+
+    for( elementCount = 16; elementCount <= TEST_CONTAINERS_BENCHMARK_MAX_ELEMENTS; elementCount *= 4 )
+    {
+        _fillContainers( elementCount, &list, &table, &tree );
+        rounds = ( TEST_CONTAINERS_BENCHMARK_LOOKUPS + elementCount - 1 ) / elementCount;
+
+        startTime = IotClock_GetTimeMs();
+
+        for( round = 0; round < rounds; round++ )
+        {
+            for( i = 0; i < elementCount; i++ )
+            {
+                key = _removalKey( i, elementCount );
+                pListLink = IotListDouble_RemoveFirstMatch( &list, NULL, _listMatch, &key );
+                TEST_ASSERT_NOT_NULL( pListLink );
+            }
+
+            TEST_ASSERT_TRUE( IotListDouble_IsEmpty( &list ) );
+
+            for( i = 0; i < elementCount; i++ )
+            {
+                IotListDouble_InsertTail( &list, &( _benchmarkElements[ i ].listLink ) );
+            }
+        }
+
+        result.list = _elapsedMs( startTime );
+
+        startTime = IotClock_GetTimeMs();
+
+        for( round = 0; round < rounds; round++ )
+        {
+            for( i = 0; i < elementCount; i++ )
+            {
+                key = _removalKey( i, elementCount );
+                pHashLink = IotHashTable_RemoveFirstMatch( &table, IotHash_Uint32( key ), _hashMatch, &key );
+                TEST_ASSERT_NOT_NULL( pHashLink );
+            }
+
+            TEST_ASSERT_EQUAL( 0, IotHashTable_Count( &table ) );
+
+            for( i = 0; i < elementCount; i++ )
+            {
+                IotHashTable_Insert( &table, &( _benchmarkElements[ i ].hashLink ), IotHash_Uint32( _benchmarkElements[ i ].key ) );
+            }
+        }
+
+        result.hash = _elapsedMs( startTime );
+
+        startTime = IotClock_GetTimeMs();
+
+        for( round = 0; round < rounds; round++ )
+        {
+            for( i = 0; i < elementCount; i++ )
+            {
+                key = _removalKey( i, elementCount );
+                pTreeLink = IotTree_RemoveFirstMatch( &tree, &key, _treeCompareKey );
+                TEST_ASSERT_NOT_NULL( pTreeLink );
+            }
+
+            TEST_ASSERT_TRUE( IotTree_IsEmpty( &tree ) );
+
+            for( i = 0; i < elementCount; i++ )
+            {
+                IotTree_Insert( &tree, &( _benchmarkElements[ i ].treeLink ), _treeCompare );
+            }
+        }
+
+        result.tree = _elapsedMs( startTime );
+
+        _printResult( "removals and re-insertions", elementCount, rounds * elementCount, &result );
+    }
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,626 @@
+/*
+ * FreeRTOS Common V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_tests_static_memory.c
+ * @brief Tests for static memory pools and message buffers.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Platform layer includes. */
+#include "platform/iot_threads.h"
+
+/* Static memory include. */
+#include "private/iot_static_memory.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/* The static memory functions only exist in static memory only mode. */
+#if IOT_STATIC_MEMORY_ONLY == 1
+
+/**
+ * @brief Number of objects in the pool used by the tests.
+ *
+ * Chosen so that the pool spans more than one word of its in-use bitmap.
+ */
+    #define TEST_POOL_SIZE             ( 40 )
+
+/**
+ * @brief Number of threads that allocate concurrently.
+ */
+    #define TEST_THREAD_COUNT          ( 4 )
+
+/**
+ * @brief Number of allocations made by each thread.
+ */
+    #define TEST_THREAD_ITERATIONS     ( 2000 )
+
+/**
+ * @brief Number of objects held at once by each thread.
+ */
+    #define TEST_THREAD_HELD_OBJECTS   ( 12 )
+
+/**
+ * @brief Largest number of message buffer size classes.
+ */
+    #define TEST_MESSAGE_BUFFER_CLASSES    ( 4 )
+
+/**
+ * @brief Largest number of message buffers held by a test.
+ */
+    #define TEST_MESSAGE_BUFFERS_HELD      ( 64 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief An object of the pool used by the tests.
+ */
+    typedef struct TestObject
+    {
+        uint32_t owner;        /**< @brief Identifies the thread that allocated the object. */
+        uint32_t payload[ 3 ]; /**< @brief Data written by the owner. */
+    } TestObject_t;
+
+/**
+ * @brief Context of the threads that allocate concurrently.
+ */
+    typedef struct TestThreadContext
+    {
+        uint32_t id;               /**< @brief Identifies the thread. */
+        uint32_t corruptions;      /**< @brief Number of objects changed by another thread. */
+        IotSemaphore_t * pDone;    /**< @brief Posted when the thread finishes. */
+    } TestThreadContext_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Objects of the pool used by the tests.
+ */
+    static TestObject_t _pObjects[ TEST_POOL_SIZE ];
+
+/**
+ * @brief In-use bitmap of the pool used by the tests.
+ */
+    static uint32_t _pInUseObjects[ IOT_STATIC_MEMORY_POOL_WORDS( TEST_POOL_SIZE ) ];
+
+/**
+ * @brief The pool used by the tests.
+ */
+    static IotStaticMemoryPool_t _pool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pObjects,
+                                                                             _pInUseObjects,
+                                                                             sizeof( TestObject_t ),
+                                                                             TEST_POOL_SIZE );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check that an allocated object belongs to the test pool and is zeroed.
+ */
+    static void _verifyObject( const TestObject_t * pObject )
+    {
+        const TestObject_t zero = { 0 };
+
+        TEST_ASSERT_NOT_NULL( pObject );
+        TEST_ASSERT_TRUE( pObject >= &( _pObjects[ 0 ] ) );
+        TEST_ASSERT_TRUE( pObject < &( _pObjects[ TEST_POOL_SIZE ] ) );
+        TEST_ASSERT_EQUAL_MEMORY( &zero, pObject, sizeof( TestObject_t ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check the statistics of the test pool.
+ */
+    static void _verifyStats( uint32_t inUse,
+                              uint32_t highWaterMark,
+                              uint32_t failures )
+    {
+        IotStaticMemoryStats_t stats = { 0 };
+
+        IotStaticMemory_GetStats( &_pool, &stats );
+
+        TEST_ASSERT_EQUAL( sizeof( TestObject_t ), stats.elementSize );
+        TEST_ASSERT_EQUAL( TEST_POOL_SIZE, stats.elementCount );
+        TEST_ASSERT_EQUAL_UINT32( inUse, stats.inUse );
+        TEST_ASSERT_EQUAL_UINT32( highWaterMark, stats.highWaterMark );
+        TEST_ASSERT_EQUAL_UINT32( failures, stats.failures );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Thread routine that repeatedly allocates and frees objects of the test pool.
+ */
+    static void _allocFreeThread( void * pArgument )
+    {
+        TestThreadContext_t * pContext = ( TestThreadContext_t * ) pArgument;
+        TestObject_t * pHeld[ TEST_THREAD_HELD_OBJECTS ] = { 0 };
+        uint32_t i = 0, slot = 0;
+
+        for( i = 0; i < TEST_THREAD_ITERATIONS; i++ )
+        {
+            slot = i % TEST_THREAD_HELD_OBJECTS;
+
+            /* Check and return the object held in this slot. No other thread
+             * may have been given it while it was held. */
+            if( pHeld[ slot ] != NULL )
+            {
+                if( ( pHeld[ slot ]->owner != pContext->id ) ||
+                    ( pHeld[ slot ]->payload[ 0 ] != i - TEST_THREAD_HELD_OBJECTS ) )
+                {
+                    pContext->corruptions++;
+                }
+
+                IotStaticMemory_Free( &_pool, pHeld[ slot ] );
+            }
+
+            pHeld[ slot ] = IotStaticMemory_Alloc( &_pool );
+
+            if( pHeld[ slot ] != NULL )
+            {
+                if( pHeld[ slot ]->owner != 0U )
+                {
+                    pContext->corruptions++;
+                }
+
+                pHeld[ slot ]->owner = pContext->id;
+                pHeld[ slot ]->payload[ 0 ] = i;
+            }
+        }
+
+        for( slot = 0; slot < TEST_THREAD_HELD_OBJECTS; slot++ )
+        {
+            IotStaticMemory_Free( &_pool, pHeld[ slot ] );
+        }
+
+        IotSemaphore_Post( pContext->pDone );
+    }
+
+#endif /* if IOT_STATIC_MEMORY_ONLY == 1 */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for static memory tests.
+ */
+TEST_GROUP( Common_Unit_Static_Memory );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for static memory tests.
+ */
+TEST_SETUP( Common_Unit_Static_Memory )
+{
+    #if IOT_STATIC_MEMORY_ONLY == 1
+        IotStaticMemoryPool_t emptyPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pObjects,
+                                                                              _pInUseObjects,
+                                                                              sizeof( TestObject_t ),
+                                                                              TEST_POOL_SIZE );
+
+        ( void ) memset( _pObjects, 0x00, sizeof( _pObjects ) );
+        ( void ) memset( _pInUseObjects, 0x00, sizeof( _pInUseObjects ) );
+        _pool = emptyPool;
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for static memory tests.
+ */
+TEST_TEAR_DOWN( Common_Unit_Static_Memory )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for static memory tests.
+ */
+TEST_GROUP_RUNNER( Common_Unit_Static_Memory )
+{
+    #if IOT_STATIC_MEMORY_ONLY == 1
+        RUN_TEST_CASE( Common_Unit_Static_Memory, PoolExhaustRefill );
+        RUN_TEST_CASE( Common_Unit_Static_Memory, PoolFreeIgnoresInvalidPointers );
+        RUN_TEST_CASE( Common_Unit_Static_Memory, PoolHighWaterMark );
+        RUN_TEST_CASE( Common_Unit_Static_Memory, PoolConcurrentAllocFree );
+        RUN_TEST_CASE( Common_Unit_Static_Memory, MessageBufferStats );
+        RUN_TEST_CASE( Common_Unit_Static_Memory, MessageBufferClassFallback );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+#if IOT_STATIC_MEMORY_ONLY == 1
+
+/**
+ * @brief Allocate every object of a pool, then free and allocate them again.
+ */
+    TEST( Common_Unit_Static_Memory, PoolExhaustRefill )
+    {
+        uint32_t i = 0, j = 0;
+        TestObject_t * pAllocated[ TEST_POOL_SIZE ] = { 0 };
+
+        for( i = 0; i < TEST_POOL_SIZE; i++ )
+        {
+            pAllocated[ i ] = IotStaticMemory_Alloc( &_pool );
+            _verifyObject( pAllocated[ i ] );
+
+            /* Every allocated object is distinct. */
+            for( j = 0; j < i; j++ )
+            {
+                TEST_ASSERT_TRUE( pAllocated[ i ] != pAllocated[ j ] );
+            }
+
+            /* Dirty the object; it must be zeroed when allocated again. */
+            ( void ) memset( pAllocated[ i ], 0xa5, sizeof( TestObject_t ) );
+        }
+
+        _verifyStats( TEST_POOL_SIZE, TEST_POOL_SIZE, 0 );
+
+        /* The exhausted pool fails allocations and counts them. */
+        TEST_ASSERT_NULL( IotStaticMemory_Alloc( &_pool ) );
+        TEST_ASSERT_NULL( IotStaticMemory_Alloc( &_pool ) );
+        _verifyStats( TEST_POOL_SIZE, TEST_POOL_SIZE, 2 );
+
+        /* An object freed from the second bitmap word is the only one available. */
+        IotStaticMemory_Free( &_pool, pAllocated[ TEST_POOL_SIZE - 1 ] );
+        _verifyStats( TEST_POOL_SIZE - 1, TEST_POOL_SIZE, 2 );
+
+        pAllocated[ TEST_POOL_SIZE - 1 ] = IotStaticMemory_Alloc( &_pool );
+        _verifyObject( pAllocated[ TEST_POOL_SIZE - 1 ] );
+        TEST_ASSERT_TRUE( pAllocated[ TEST_POOL_SIZE - 1 ] == &( _pObjects[ TEST_POOL_SIZE - 1 ] ) );
+        TEST_ASSERT_NULL( IotStaticMemory_Alloc( &_pool ) );
+
+        /* Return every object, then allocate the whole pool again. */
+        for( i = 0; i < TEST_POOL_SIZE; i++ )
+        {
+            IotStaticMemory_Free( &_pool, pAllocated[ i ] );
+        }
+
+        _verifyStats( 0, TEST_POOL_SIZE, 3 );
+
+        for( i = 0; i < TEST_POOL_SIZE; i++ )
+        {
+            pAllocated[ i ] = IotStaticMemory_Alloc( &_pool );
+            _verifyObject( pAllocated[ i ] );
+        }
+
+        _verifyStats( TEST_POOL_SIZE, TEST_POOL_SIZE, 3 );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Free pointers that are not in-use objects of a pool.
+ */
+    TEST( Common_Unit_Static_Memory, PoolFreeIgnoresInvalidPointers )
+    {
+        uint32_t i = 0;
+        TestObject_t foreignObject = { 0 };
+        TestObject_t * pFirst = NULL, * pSecond = NULL;
+        uint32_t pInUseCopy[ IOT_STATIC_MEMORY_POOL_WORDS( TEST_POOL_SIZE ) ] = { 0 };
+
+        pFirst = IotStaticMemory_Alloc( &_pool );
+        pSecond = IotStaticMemory_Alloc( &_pool );
+        _verifyObject( pFirst );
+        _verifyObject( pSecond );
+        pSecond->owner = 1;
+
+        ( void ) memcpy( pInUseCopy, _pInUseObjects, sizeof( _pInUseObjects ) );
+
+        /* A pointer outside the pool, a pointer into the middle of an object,
+         * a pointer one past the last object and an object that was never
+         * allocated. */
+        IotStaticMemory_Free( &_pool, &foreignObject );
+        IotStaticMemory_Free( &_pool, ( ( uint8_t * ) pSecond ) + 1 );
+        IotStaticMemory_Free( &_pool, &( _pObjects[ TEST_POOL_SIZE ] ) );
+        IotStaticMemory_Free( &_pool, &( _pObjects[ TEST_POOL_SIZE - 1 ] ) );
+
+        /* None of them changed the pool or the allocated objects. */
+        TEST_ASSERT_EQUAL_MEMORY( pInUseCopy, _pInUseObjects, sizeof( _pInUseObjects ) );
+        TEST_ASSERT_EQUAL_UINT32( 1, pSecond->owner );
+        _verifyStats( 2, 2, 0 );
+
+        /* A double free returns the object once. */
+        IotStaticMemory_Free( &_pool, pFirst );
+        IotStaticMemory_Free( &_pool, pFirst );
+        _verifyStats( 1, 2, 0 );
+
+        /* Exactly the rest of the pool may be allocated. */
+        for( i = 1; i < TEST_POOL_SIZE; i++ )
+        {
+            _verifyObject( IotStaticMemory_Alloc( &_pool ) );
+        }
+
+        TEST_ASSERT_NULL( IotStaticMemory_Alloc( &_pool ) );
+        _verifyStats( TEST_POOL_SIZE, TEST_POOL_SIZE, 1 );
+        TEST_ASSERT_EQUAL_UINT32( 1, pSecond->owner );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check that the high-water mark only rises.
+ */
+    TEST( Common_Unit_Static_Memory, PoolHighWaterMark )
+    {
+        uint32_t i = 0;
+        TestObject_t * pAllocated[ 6 ] = { 0 };
+
+        _verifyStats( 0, 0, 0 );
+
+        for( i = 0; i < 3; i++ )
+        {
+            pAllocated[ i ] = IotStaticMemory_Alloc( &_pool );
+            _verifyObject( pAllocated[ i ] );
+            _verifyStats( i + 1, i + 1, 0 );
+        }
+
+        /* Freeing does not lower the high-water mark. */
+        IotStaticMemory_Free( &_pool, pAllocated[ 0 ] );
+        IotStaticMemory_Free( &_pool, pAllocated[ 1 ] );
+        _verifyStats( 1, 3, 0 );
+
+        /* Allocating up to the high-water mark does not raise it. */
+        pAllocated[ 0 ] = IotStaticMemory_Alloc( &_pool );
+        pAllocated[ 1 ] = IotStaticMemory_Alloc( &_pool );
+        _verifyStats( 3, 3, 0 );
+
+        /* Allocating past it does. */
+        for( i = 3; i < 6; i++ )
+        {
+            pAllocated[ i ] = IotStaticMemory_Alloc( &_pool );
+            _verifyObject( pAllocated[ i ] );
+            _verifyStats( i + 1, i + 1, 0 );
+        }
+
+        for( i = 0; i < 6; i++ )
+        {
+            IotStaticMemory_Free( &_pool, pAllocated[ i ] );
+        }
+
+        _verifyStats( 0, 6, 0 );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Allocate and free objects of a pool from several threads at once.
+ */
+    TEST( Common_Unit_Static_Memory, PoolConcurrentAllocFree )
+    {
+        uint32_t i = 0, created = 0;
+        IotSemaphore_t done;
+        TestThreadContext_t contexts[ TEST_THREAD_COUNT ] = { { 0 } };
+        IotStaticMemoryStats_t stats = { 0 };
+
+        TEST_ASSERT_TRUE( IotSemaphore_Create( &done, 0, TEST_THREAD_COUNT ) );
+
+        for( i = 0; i < TEST_THREAD_COUNT; i++ )
+        {
+            contexts[ i ].id = i + 1;
+            contexts[ i ].pDone = &done;
+
+            if( Iot_CreateDetachedThread( _allocFreeThread,
+                                          &( contexts[ i ] ),
+                                          IOT_THREAD_DEFAULT_PRIORITY,
+                                          IOT_THREAD_DEFAULT_STACK_SIZE ) == true )
+            {
+                created++;
+            }
+        }
+
+        for( i = 0; i < created; i++ )
+        {
+            IotSemaphore_Wait( &done );
+        }
+
+        IotSemaphore_Destroy( &done );
+
+        TEST_ASSERT_EQUAL_UINT32( TEST_THREAD_COUNT, created );
+
+        /* No object was given to two threads at once. */
+        for( i = 0; i < TEST_THREAD_COUNT; i++ )
+        {
+            TEST_ASSERT_EQUAL_UINT32( 0, contexts[ i ].corruptions );
+        }
+
+        /* Every object was returned, and the occupancy never exceeded the pool. */
+        IotStaticMemory_GetStats( &_pool, &stats );
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.inUse );
+        TEST_ASSERT_TRUE( stats.highWaterMark > 0U );
+        TEST_ASSERT_TRUE( stats.highWaterMark <= TEST_POOL_SIZE );
+
+        for( i = 0; i < IOT_STATIC_MEMORY_POOL_WORDS( TEST_POOL_SIZE ); i++ )
+        {
+            TEST_ASSERT_EQUAL_UINT32( 0, _pInUseObjects[ i ] );
+        }
+
+        /* The whole pool is still available. */
+        for( i = 0; i < TEST_POOL_SIZE; i++ )
+        {
+            _verifyObject( IotStaticMemory_Alloc( &_pool ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Read the statistics of the message buffer size classes.
+ */
+    TEST( Common_Unit_Static_Memory, MessageBufferStats )
+    {
+        size_t i = 0, classCount = 0;
+        void * pBuffer = NULL;
+        IotStaticMemoryStats_t before[ TEST_MESSAGE_BUFFER_CLASSES ] = { { 0 } };
+        IotStaticMemoryStats_t after[ TEST_MESSAGE_BUFFER_CLASSES ] = { { 0 } };
+
+        classCount = Iot_MessageBufferStats( before, TEST_MESSAGE_BUFFER_CLASSES );
+        TEST_ASSERT_TRUE( classCount >= 1U );
+        TEST_ASSERT_TRUE( classCount <= TEST_MESSAGE_BUFFER_CLASSES );
+
+        /* Classes are in ascending order of size, and one of them is the
+         * standard message buffer. */
+        for( i = 1; i < classCount; i++ )
+        {
+            TEST_ASSERT_TRUE( before[ i - 1 ].elementSize < before[ i ].elementSize );
+        }
+
+        for( i = 0; i < classCount; i++ )
+        {
+            TEST_ASSERT_TRUE( before[ i ].elementCount > 0U );
+
+            if( before[ i ].elementSize == Iot_MessageBufferSize() )
+            {
+                break;
+            }
+        }
+
+        TEST_ASSERT_TRUE( i < classCount );
+
+        /* Fewer statistics than classes may be requested. */
+        TEST_ASSERT_EQUAL( classCount, Iot_MessageBufferStats( after, 1 ) );
+        TEST_ASSERT_EQUAL( before[ 0 ].elementSize, after[ 0 ].elementSize );
+
+        /* A buffer of the smallest size is counted in the smallest class. */
+        pBuffer = Iot_MallocMessageBuffer( before[ 0 ].elementSize );
+        TEST_ASSERT_NOT_NULL( pBuffer );
+
+        ( void ) Iot_MessageBufferStats( after, classCount );
+        TEST_ASSERT_EQUAL_UINT32( before[ 0 ].inUse + 1U, after[ 0 ].inUse );
+        TEST_ASSERT_TRUE( after[ 0 ].highWaterMark >= after[ 0 ].inUse );
+
+        Iot_FreeMessageBuffer( pBuffer );
+
+        ( void ) Iot_MessageBufferStats( after, classCount );
+        TEST_ASSERT_EQUAL_UINT32( before[ 0 ].inUse, after[ 0 ].inUse );
+
+        /* A buffer larger than every class is not allocated. */
+        TEST_ASSERT_NULL( Iot_MallocMessageBuffer( before[ classCount - 1 ].elementSize + 1U ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Exhaust each message buffer size class in turn and check that the next
+ * larger class serves the request.
+ */
+    TEST( Common_Unit_Static_Memory, MessageBufferClassFallback )
+    {
+        size_t sizeClass = 0, i = 0, classCount = 0, held = 0;
+        uint32_t available = 0;
+        void * pHeld[ TEST_MESSAGE_BUFFERS_HELD ] = { 0 };
+        IotStaticMemoryStats_t before[ TEST_MESSAGE_BUFFER_CLASSES ] = { { 0 } };
+        IotStaticMemoryStats_t after[ TEST_MESSAGE_BUFFER_CLASSES ] = { { 0 } };
+
+        classCount = Iot_MessageBufferStats( before, TEST_MESSAGE_BUFFER_CLASSES );
+        TEST_ASSERT_TRUE( classCount <= TEST_MESSAGE_BUFFER_CLASSES );
+
+        /* Request buffers of the smallest size. Each class serves them until it
+         * is exhausted, then the next larger class does. */
+        for( sizeClass = 0; sizeClass < classCount; sizeClass++ )
+        {
+            available = ( uint32_t ) before[ sizeClass ].elementCount - before[ sizeClass ].inUse;
+
+            for( i = 0; i < available; i++ )
+            {
+                TEST_ASSERT_TRUE( held < TEST_MESSAGE_BUFFERS_HELD );
+
+                pHeld[ held ] = Iot_MallocMessageBuffer( before[ 0 ].elementSize );
+                TEST_ASSERT_NOT_NULL( pHeld[ held ] );
+                held++;
+
+                ( void ) Iot_MessageBufferStats( after, classCount );
+                TEST_ASSERT_EQUAL_UINT32( before[ sizeClass ].inUse + i + 1U, after[ sizeClass ].inUse );
+            }
+
+            /* The exhausted class counts every request that fell back from it. */
+            if( sizeClass + 1U < classCount )
+            {
+                pHeld[ held ] = Iot_MallocMessageBuffer( before[ 0 ].elementSize );
+                TEST_ASSERT_NOT_NULL( pHeld[ held ] );
+                held++;
+
+                ( void ) Iot_MessageBufferStats( after, classCount );
+                TEST_ASSERT_EQUAL_UINT32( before[ sizeClass ].elementCount, after[ sizeClass ].inUse );
+                TEST_ASSERT_TRUE( after[ sizeClass ].failures > before[ sizeClass ].failures );
+                TEST_ASSERT_EQUAL_UINT32( before[ sizeClass + 1U ].inUse + 1U, after[ sizeClass + 1U ].inUse );
+
+                /* Return it so that the next class is exhausted from its start. */
+                held--;
+                Iot_FreeMessageBuffer( pHeld[ held ] );
+            }
+        }
+
+        /* Every class is exhausted. */
+        TEST_ASSERT_NULL( Iot_MallocMessageBuffer( before[ 0 ].elementSize ) );
+
+        ( void ) Iot_MessageBufferStats( after, classCount );
+
+        for( sizeClass = 0; sizeClass < classCount; sizeClass++ )
+        {
+            TEST_ASSERT_EQUAL_UINT32( before[ sizeClass ].elementCount, after[ sizeClass ].inUse );
+            TEST_ASSERT_EQUAL_UINT32( before[ sizeClass ].elementCount, after[ sizeClass ].highWaterMark );
+        }
+
+        for( i = 0; i < held; i++ )
+        {
+            Iot_FreeMessageBuffer( pHeld[ i ] );
+        }
+
+        ( void ) Iot_MessageBufferStats( after, classCount );
+
+        for( sizeClass = 0; sizeClass < classCount; sizeClass++ )
+        {
+            TEST_ASSERT_EQUAL_UINT32( before[ sizeClass ].inUse, after[ sizeClass ].inUse );
+        }
+
+        /* A large request skips the smaller classes. */
+        pHeld[ 0 ] = Iot_MallocMessageBuffer( before[ classCount - 1U ].elementSize );
+        TEST_ASSERT_NOT_NULL( pHeld[ 0 ] );
+
+        ( void ) Iot_MessageBufferStats( after, classCount );
+        TEST_ASSERT_EQUAL_UINT32( before[ 0 ].inUse, after[ 0 ].inUse );
+        TEST_ASSERT_EQUAL_UINT32( before[ classCount - 1U ].inUse + 1U, after[ classCount - 1U ].inUse );
+
+        Iot_FreeMessageBuffer( pHeld[ 0 ] );
+    }
+
+#endif /* if IOT_STATIC_MEMORY_ONLY == 1 */
+
+/*-----------------------------------------------------------*/
@@ -73,6 +73,16 @@ typedef struct JobBlockingUserContext
     IotSemaphore_t block;  /**< @brief A synch object to wait on. */
 } JobBlockingUserContext_t;
 
+/**
+ * @brief A simple user context to record the order in which jobs are executed.
+ */
+typedef struct JobOrderUserContext
+{
+    IotMutex_t lock;      /**< @brief Protection from concurrent updates. */
+    uint32_t counter;     /**< @brief A counter to keep track of callback invocations. */
+    uint32_t markedOrder; /**< @brief The value of the counter when the marked job was executed. */
+} JobOrderUserContext_t;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -112,18 +122,30 @@ TEST_GROUP_RUNNER( Common_Unit_Task_Pool )
     RUN_TEST_CASE( Common_Unit_Task_Pool, CreateDestroyJobError );
     RUN_TEST_CASE( Common_Unit_Task_Pool, CreateDestroyRecycleRecyclableJobError );
     RUN_TEST_CASE( Common_Unit_Task_Pool, CreateRecyclableJob );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, RecyclableJobCacheStats );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasksError );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_LongRunningAndCachedJobsAndDestroy );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_Grow );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_GrowHighPri );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, ElasticScaling_GrowOnPressure );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, ElasticScaling_ShrinkAfterLinger );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ScheduleOneThenWait );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ScheduleOneDeferredThenWait );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ScheduleAllThenWait );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleBatchError );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleBatch_ScheduleAllThenWait );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ScheduleAllRecyclableThenWait );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ScheduleAllDeferredRecyclableThenWait );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ReSchedule );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ReScheduleDeferred );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_CancelTasks );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, JobClasses_WeightedFairDispatch );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, Instrumentation );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, WorkStealing_CreateDestroy );
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        RUN_TEST_CASE( Common_Unit_Task_Pool, WorkStealing_ScheduleAllThenWait );
+        RUN_TEST_CASE( Common_Unit_Task_Pool, WorkStealing_CancelScheduledTasks );
+    #endif
 }
 
 /*-----------------------------------------------------------*/
@@ -328,6 +350,67 @@ static void ExecutionLongWithoutDestroyCb( IotTaskPool_t pTaskPool,
     IotMutex_Unlock( &pUserContext->lock );
 }
 
+/**
+ * @brief A callback that counts its execution.
+ */
+static void ExecutionCountOrderCb( IotTaskPool_t pTaskPool,
+                                   IotTaskPoolJob_t pJob,
+                                   void * pContext )
+{
+    JobOrderUserContext_t * pUserContext = ( JobOrderUserContext_t * ) pContext;
+
+    ( void ) pTaskPool;
+    ( void ) pJob;
+
+    IotMutex_Lock( &pUserContext->lock );
+    pUserContext->counter++;
+    IotMutex_Unlock( &pUserContext->lock );
+}
+
+/**
+ * @brief A callback that records how many jobs were executed before it.
+ */
+static void ExecutionMarkOrderCb( IotTaskPool_t pTaskPool,
+                                  IotTaskPoolJob_t pJob,
+                                  void * pContext )
+{
+    JobOrderUserContext_t * pUserContext = ( JobOrderUserContext_t * ) pContext;
+
+    ( void ) pTaskPool;
+    ( void ) pJob;
+
+    IotMutex_Lock( &pUserContext->lock );
+    pUserContext->markedOrder = pUserContext->counter;
+    pUserContext->counter++;
+    IotMutex_Unlock( &pUserContext->lock );
+}
+
+/**
+ * @brief Wait until a number of jobs counted by #ExecutionCountOrderCb were executed, or for 5 seconds at most.
+ */
+static uint32_t WaitForCountedJobs( JobOrderUserContext_t * pUserContext,
+                                    uint32_t expected )
+{
+    uint32_t count;
+    uint32_t executed = 0;
+
+    for( count = 0; count < 100; ++count )
+    {
+        IotMutex_Lock( &pUserContext->lock );
+        executed = pUserContext->counter;
+        IotMutex_Unlock( &pUserContext->lock );
+
+        if( executed >= expected )
+        {
+            break;
+        }
+
+        IotClock_SleepMs( 50 );
+    }
+
+    return executed;
+}
+
 /**
  * @brief A callback that does not recycle its job.
  */
@@ -671,6 +754,203 @@ TEST( Common_Unit_Task_Pool, CreateRecyclableJob )
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Test the statistics of the recyclable jobs cache.
+ */
+TEST( Common_Unit_Task_Pool, RecyclableJobCacheStats )
+{
+    uint32_t count;
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    IotTaskPoolJob_t pJobs[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ];
+    IotTaskPoolJobCacheStats_t stats = { 0 };
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = 1, .maxThreads = 1, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    if( TEST_PROTECT() )
+    {
+        /* Bad parameters. */
+        TEST_ASSERT( IotTaskPool_GetJobCacheStats( NULL, &stats ) == IOT_TASKPOOL_BAD_PARAMETER );
+        TEST_ASSERT( IotTaskPool_GetJobCacheStats( taskPool, NULL ) == IOT_TASKPOOL_BAD_PARAMETER );
+
+        /* A new task pool has an empty cache, so all jobs are allocated. */
+        for( count = 0; count < IOT_TASKPOOL_JOBS_RECYCLE_LIMIT; ++count )
+        {
+            TEST_ASSERT( IotTaskPool_CreateRecyclableJob( taskPool, &ExecutionWithRecycleCb, NULL, &pJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        TEST_ASSERT( IotTaskPool_GetJobCacheStats( taskPool, &stats ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.hits );
+        TEST_ASSERT_EQUAL_UINT32( IOT_TASKPOOL_JOBS_RECYCLE_LIMIT, stats.misses );
+        TEST_ASSERT_EQUAL_UINT32( IOT_TASKPOOL_JOBS_RECYCLE_LIMIT, stats.mallocFallbacks );
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.freeCount );
+
+        /* Recycling fills the cache. */
+        for( count = 0; count < IOT_TASKPOOL_JOBS_RECYCLE_LIMIT; ++count )
+        {
+            TEST_ASSERT( IotTaskPool_RecycleJob( taskPool, pJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        TEST_ASSERT( IotTaskPool_GetJobCacheStats( taskPool, &stats ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT_EQUAL_UINT32( IOT_TASKPOOL_JOBS_RECYCLE_LIMIT, stats.freeCount );
+
+        /* All jobs are now served from the cache. */
+        for( count = 0; count < IOT_TASKPOOL_JOBS_RECYCLE_LIMIT; ++count )
+        {
+            TEST_ASSERT( IotTaskPool_CreateRecyclableJob( taskPool, &ExecutionWithRecycleCb, NULL, &pJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        TEST_ASSERT( IotTaskPool_GetJobCacheStats( taskPool, &stats ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT_EQUAL_UINT32( IOT_TASKPOOL_JOBS_RECYCLE_LIMIT, stats.hits );
+        TEST_ASSERT_EQUAL_UINT32( IOT_TASKPOOL_JOBS_RECYCLE_LIMIT, stats.misses );
+        TEST_ASSERT_EQUAL_UINT32( IOT_TASKPOOL_JOBS_RECYCLE_LIMIT, stats.mallocFallbacks );
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.freeCount );
+
+        for( count = 0; count < IOT_TASKPOOL_JOBS_RECYCLE_LIMIT; ++count )
+        {
+            TEST_ASSERT( IotTaskPool_DestroyRecyclableJob( taskPool, pJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+        }
+    }
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test that a task pool grows once the queue depth or the wait time of jobs passes its thresholds.
+ */
+TEST( Common_Unit_Task_Pool, ElasticScaling_GrowOnPressure )
+{
+    uint32_t count;
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    JobBlockingUserContext_t blockingUserContext = { 0 };
+    JobOrderUserContext_t userContext = { 0 };
+    IotTaskPoolJobStorage_t blockingJobStorage = IOT_TASKPOOL_JOB_STORAGE_INITIALIZER;
+    IotTaskPoolJob_t blockingJob = IOT_TASKPOOL_JOB_INITIALIZER;
+    IotTaskPoolJobStorage_t jobsStorage[ 3 ];
+    IotTaskPoolJob_t jobs[ 3 ];
+
+    /* Grow on queue depth only, and on wait time only. */
+    const IotTaskPoolInfo_t depthInfo = { .minThreads = 1, .maxThreads = 2, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY, .growQueueDepth = 3 };
+    const IotTaskPoolInfo_t waitInfo = { .minThreads = 1, .maxThreads = 2, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY, .growQueueDepth = 100, .growWaitMs = 50 };
+    const IotTaskPoolInfo_t * pInfos[ 2 ] = { &depthInfo, &waitInfo };
+    const uint32_t queuedBeforeGrowing[ 2 ] = { 2, 1 };
+
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.signal, 0, 1 ) );
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.block, 0, 1 ) );
+    TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+    for( count = 0; count < 2; ++count )
+    {
+        uint32_t queued;
+
+        userContext.counter = 0;
+
+        TEST_ASSERT( IotTaskPool_Create( pInfos[ count ], &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+        if( TEST_PROTECT() )
+        {
+            /* Keep the only worker busy. */
+            TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionBlockingWithoutDestroyCb, &blockingUserContext, &blockingJobStorage, &blockingJob ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_Schedule( taskPool, blockingJob, 0 ) == IOT_TASKPOOL_SUCCESS );
+            IotSemaphore_Wait( &blockingUserContext.signal );
+
+            /* Queue jobs below the thresholds, and check that they stay queued. */
+            for( queued = 0; queued < queuedBeforeGrowing[ count ]; ++queued )
+            {
+                TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionCountOrderCb, &userContext, &jobsStorage[ queued ], &jobs[ queued ] ) == IOT_TASKPOOL_SUCCESS );
+                TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ queued ], 0 ) == IOT_TASKPOOL_SUCCESS );
+            }
+
+            IotClock_SleepMs( 100 );
+            TEST_ASSERT_EQUAL_UINT32( 0, WaitForCountedJobs( &userContext, 0 ) );
+
+            /* One more job passes the threshold, and a new worker executes all queued jobs. */
+            TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionCountOrderCb, &userContext, &jobsStorage[ queued ], &jobs[ queued ] ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ queued ], 0 ) == IOT_TASKPOOL_SUCCESS );
+
+            TEST_ASSERT_EQUAL_UINT32( queued + 1, WaitForCountedJobs( &userContext, queued + 1 ) );
+
+            IotSemaphore_Post( &blockingUserContext.block );
+        }
+
+        TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+    }
+
+    IotMutex_Destroy( &userContext.lock );
+    IotSemaphore_Destroy( &blockingUserContext.block );
+    IotSemaphore_Destroy( &blockingUserContext.signal );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test that idle worker threads above the minimum exit after lingering.
+ */
+TEST( Common_Unit_Task_Pool, ElasticScaling_ShrinkAfterLinger )
+{
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    JobBlockingUserContext_t blockingUserContext = { 0 };
+    JobOrderUserContext_t userContext = { 0 };
+    IotTaskPoolJobStorage_t blockingJobStorage = IOT_TASKPOOL_JOB_STORAGE_INITIALIZER;
+    IotTaskPoolJob_t blockingJob = IOT_TASKPOOL_JOB_INITIALIZER;
+    IotTaskPoolJobStorage_t jobsStorage[ 3 ];
+    IotTaskPoolJob_t jobs[ 3 ];
+
+    /* Only grow on wait time, so that scheduling a single job never grows the task pool. */
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = 1, .maxThreads = 2, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY, .growQueueDepth = 100, .growWaitMs = 50, .lingerMs = 100 };
+
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.signal, 0, 1 ) );
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.block, 0, 1 ) );
+    TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    if( TEST_PROTECT() )
+    {
+        /* Grow the task pool to two workers. */
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionBlockingWithoutDestroyCb, &blockingUserContext, &blockingJobStorage, &blockingJob ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Schedule( taskPool, blockingJob, 0 ) == IOT_TASKPOOL_SUCCESS );
+        IotSemaphore_Wait( &blockingUserContext.signal );
+
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionCountOrderCb, &userContext, &jobsStorage[ 0 ], &jobs[ 0 ] ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ 0 ], 0 ) == IOT_TASKPOOL_SUCCESS );
+        IotClock_SleepMs( 100 );
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionCountOrderCb, &userContext, &jobsStorage[ 1 ], &jobs[ 1 ] ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ 1 ], 0 ) == IOT_TASKPOOL_SUCCESS );
+
+        TEST_ASSERT_EQUAL_UINT32( 2, WaitForCountedJobs( &userContext, 2 ) );
+
+        /* Let both workers idle for longer than they linger. */
+        IotSemaphore_Post( &blockingUserContext.block );
+        IotClock_SleepMs( 500 );
+
+        /* With a single worker left, a job queued behind a blocking job is not executed. */
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionBlockingWithoutDestroyCb, &blockingUserContext, &blockingJobStorage, &blockingJob ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Schedule( taskPool, blockingJob, 0 ) == IOT_TASKPOOL_SUCCESS );
+        IotSemaphore_Wait( &blockingUserContext.signal );
+
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionCountOrderCb, &userContext, &jobsStorage[ 2 ], &jobs[ 2 ] ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ 2 ], 0 ) == IOT_TASKPOOL_SUCCESS );
+
+        IotClock_SleepMs( 200 );
+        TEST_ASSERT_EQUAL_UINT32( 2, WaitForCountedJobs( &userContext, 0 ) );
+
+        IotSemaphore_Post( &blockingUserContext.block );
+
+        TEST_ASSERT_EQUAL_UINT32( 3, WaitForCountedJobs( &userContext, 3 ) );
+    }
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    IotMutex_Destroy( &userContext.lock );
+    IotSemaphore_Destroy( &blockingUserContext.block );
+    IotSemaphore_Destroy( &blockingUserContext.signal );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Test scheduling a job with bad parameters.
  */
@@ -1853,3 +2133,504 @@ TEST( Common_Unit_Task_Pool, ScheduleTasks_CancelTasks )
 }
 
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Test scheduling a batch of jobs with bad parameters, or containing an executing job.
+ */
+TEST( Common_Unit_Task_Pool, ScheduleBatchError )
+{
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    JobBlockingUserContext_t blockingUserContext = { 0 };
+    JobOrderUserContext_t userContext = { 0 };
+    IotTaskPoolJobStorage_t jobsStorage[ 2 ];
+    IotTaskPoolJob_t jobs[ 2 ] = { IOT_TASKPOOL_JOB_INITIALIZER };
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = 2, .maxThreads = 3, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.signal, 0, 1 ) );
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.block, 0, 1 ) );
+    TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    if( TEST_PROTECT() )
+    {
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionBlockingWithoutDestroyCb, &blockingUserContext, &jobsStorage[ 0 ], &jobs[ 0 ] ) == IOT_TASKPOOL_SUCCESS );
+
+        /* NULL Task Pool Handle. */
+        TEST_ASSERT( IotTaskPool_ScheduleBatch( NULL, jobs, 1 ) == IOT_TASKPOOL_BAD_PARAMETER );
+        /* NULL jobs array. */
+        TEST_ASSERT( IotTaskPool_ScheduleBatch( taskPool, NULL, 1 ) == IOT_TASKPOOL_BAD_PARAMETER );
+        /* Empty batch. */
+        TEST_ASSERT( IotTaskPool_ScheduleBatch( taskPool, jobs, 0 ) == IOT_TASKPOOL_BAD_PARAMETER );
+        /* NULL Work item Handle in the batch. */
+        TEST_ASSERT( IotTaskPool_ScheduleBatch( taskPool, jobs, 2 ) == IOT_TASKPOOL_BAD_PARAMETER );
+
+        /* Start executing the first job. */
+        TEST_ASSERT( IotTaskPool_ScheduleBatch( taskPool, jobs, 1 ) == IOT_TASKPOOL_SUCCESS );
+        IotSemaphore_Wait( &blockingUserContext.signal );
+
+        /* An executing job cannot be scheduled, but the rest of the batch is. */
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionCountOrderCb, &userContext, &jobsStorage[ 1 ], &jobs[ 1 ] ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_ScheduleBatch( taskPool, jobs, 2 ) == IOT_TASKPOOL_ILLEGAL_OPERATION );
+
+        /* Wait until the second job is executed. */
+        TEST_ASSERT_EQUAL_UINT32( 1, WaitForCountedJobs( &userContext, 1 ) );
+
+        IotSemaphore_Post( &blockingUserContext.block );
+    }
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    IotMutex_Destroy( &userContext.lock );
+    IotSemaphore_Destroy( &blockingUserContext.block );
+    IotSemaphore_Destroy( &blockingUserContext.signal );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test scheduling all jobs in batches of different sizes, then waiting for all of them.
+ */
+TEST( Common_Unit_Task_Pool, ScheduleBatch_ScheduleAllThenWait )
+{
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = 1, .maxThreads = 4, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+
+    JobUserContext_t userContext;
+
+    memset( &userContext, 0, sizeof( JobUserContext_t ) );
+
+    /* Initialize user context. */
+    TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    if( TEST_PROTECT() )
+    {
+        uint32_t count;
+        uint32_t batchSize = 1;
+        IotTaskPoolJobStorage_t tpJobsStorage[ TEST_TASKPOOL_ITERATIONS ];
+        IotTaskPoolJob_t tpJobs[ TEST_TASKPOOL_ITERATIONS ];
+
+        for( count = 0; count < TEST_TASKPOOL_ITERATIONS; ++count )
+        {
+            /* Schedule the job NOT to be recycle in the callback, since the buffer is statically allocated. */
+            TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionWithoutDestroyCb, &userContext, &tpJobsStorage[ count ], &tpJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        /* Schedule batches of growing size, to exercise both idle and busy workers. */
+        for( count = 0; count < TEST_TASKPOOL_ITERATIONS; count += batchSize )
+        {
+            batchSize = ( ( count / 8 ) % 16 ) + 1;
+
+            if( batchSize > ( TEST_TASKPOOL_ITERATIONS - count ) )
+            {
+                batchSize = TEST_TASKPOOL_ITERATIONS - count;
+            }
+
+            TEST_ASSERT( IotTaskPool_ScheduleBatch( taskPool, &tpJobs[ count ], batchSize ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        /* Wait until all callbacks are executed. */
+        while( true )
+        {
+            IotClock_SleepMs( 50 );
+
+            IotMutex_Lock( &userContext.lock );
+
+            if( userContext.counter == TEST_TASKPOOL_ITERATIONS )
+            {
+                IotMutex_Unlock( &userContext.lock );
+
+                break;
+            }
+
+            IotMutex_Unlock( &userContext.lock );
+        }
+
+        TEST_ASSERT_TRUE( userContext.counter == TEST_TASKPOOL_ITERATIONS );
+    }
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    /* Destroy user context. */
+    IotMutex_Destroy( &userContext.lock );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test that a control job does not wait behind a burst of bulk jobs, and the per-class statistics.
+ */
+TEST( Common_Unit_Task_Pool, JobClasses_WeightedFairDispatch )
+{
+    uint32_t count;
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    JobBlockingUserContext_t blockingUserContext = { 0 };
+    JobOrderUserContext_t userContext = { 0 };
+    IotTaskPoolJobClassStats_t stats = { 0 };
+    IotTaskPoolJobStorage_t blockingJobStorage = IOT_TASKPOOL_JOB_STORAGE_INITIALIZER;
+    IotTaskPoolJob_t blockingJob = IOT_TASKPOOL_JOB_INITIALIZER;
+    IotTaskPoolJobStorage_t controlJobStorage = IOT_TASKPOOL_JOB_STORAGE_INITIALIZER;
+    IotTaskPoolJob_t controlJob = IOT_TASKPOOL_JOB_INITIALIZER;
+    IotTaskPoolJobStorage_t bulkJobsStorage[ TEST_TASKPOOL_ITERATIONS ];
+    IotTaskPoolJob_t bulkJobs[ TEST_TASKPOOL_ITERATIONS ];
+
+    /* A single worker, so that jobs are dispatched one at a time. */
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = 1, .maxThreads = 1, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.signal, 0, 1 ) );
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.block, 0, 1 ) );
+    TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    if( TEST_PROTECT() )
+    {
+        /* Bad parameters. */
+        TEST_ASSERT( IotTaskPool_SetJobClass( NULL, IOT_TASKPOOL_JOB_CLASS_CONTROL ) == IOT_TASKPOOL_BAD_PARAMETER );
+        TEST_ASSERT( IotTaskPool_GetJobClassStats( NULL, IOT_TASKPOOL_JOB_CLASS_NORMAL, &stats ) == IOT_TASKPOOL_BAD_PARAMETER );
+        TEST_ASSERT( IotTaskPool_GetJobClassStats( taskPool, IOT_TASKPOOL_JOB_CLASS_NORMAL, NULL ) == IOT_TASKPOOL_BAD_PARAMETER );
+        TEST_ASSERT( IotTaskPool_GetJobClassStats( taskPool, ( IotTaskPoolJobClass_t ) 0xFF, &stats ) == IOT_TASKPOOL_BAD_PARAMETER );
+
+        /* Keep the only worker busy. */
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionBlockingWithoutDestroyCb, &blockingUserContext, &blockingJobStorage, &blockingJob ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Schedule( taskPool, blockingJob, 0 ) == IOT_TASKPOOL_SUCCESS );
+        IotSemaphore_Wait( &blockingUserContext.signal );
+
+        /* Queue a burst of bulk jobs, then one control job. */
+        for( count = 0; count < TEST_TASKPOOL_ITERATIONS; ++count )
+        {
+            TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionCountOrderCb, &userContext, &bulkJobsStorage[ count ], &bulkJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_SetJobClass( bulkJobs[ count ], IOT_TASKPOOL_JOB_CLASS_BULK ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_Schedule( taskPool, bulkJobs[ count ], 0 ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionMarkOrderCb, &userContext, &controlJobStorage, &controlJob ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_SetJobClass( controlJob, ( IotTaskPoolJobClass_t ) 0xFF ) == IOT_TASKPOOL_BAD_PARAMETER );
+        TEST_ASSERT( IotTaskPool_SetJobClass( controlJob, IOT_TASKPOOL_JOB_CLASS_CONTROL ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Schedule( taskPool, controlJob, 0 ) == IOT_TASKPOOL_SUCCESS );
+
+        /* The class of a scheduled job cannot change. */
+        TEST_ASSERT( IotTaskPool_SetJobClass( controlJob, IOT_TASKPOOL_JOB_CLASS_NORMAL ) == IOT_TASKPOOL_ILLEGAL_OPERATION );
+
+        TEST_ASSERT( IotTaskPool_GetJobClassStats( taskPool, IOT_TASKPOOL_JOB_CLASS_BULK, &stats ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_ITERATIONS, stats.depth );
+        TEST_ASSERT( IotTaskPool_GetJobClassStats( taskPool, IOT_TASKPOOL_JOB_CLASS_CONTROL, &stats ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT_EQUAL_UINT32( 1, stats.depth );
+
+        /* Let the jobs wait for a while, then release the worker. */
+        IotClock_SleepMs( 100 );
+        IotSemaphore_Post( &blockingUserContext.block );
+
+        /* Wait for all jobs to execute. */
+        TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_ITERATIONS + 1, WaitForCountedJobs( &userContext, TEST_TASKPOOL_ITERATIONS + 1 ) );
+
+        /* The control job cannot wait behind more bulk jobs than the bulk class weight. */
+        TEST_ASSERT( userContext.markedOrder <= IOT_TASKPOOL_JOB_CLASS_BULK_WEIGHT );
+
+        TEST_ASSERT( IotTaskPool_GetJobClassStats( taskPool, IOT_TASKPOOL_JOB_CLASS_BULK, &stats ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.depth );
+        TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_ITERATIONS, stats.dispatched );
+        TEST_ASSERT( stats.maxWaitMs >= 50 );
+        TEST_ASSERT( stats.totalWaitMs >= stats.maxWaitMs );
+
+        TEST_ASSERT( IotTaskPool_GetJobClassStats( taskPool, IOT_TASKPOOL_JOB_CLASS_CONTROL, &stats ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.depth );
+        TEST_ASSERT_EQUAL_UINT32( 1, stats.dispatched );
+    }
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    IotMutex_Destroy( &userContext.lock );
+    IotSemaphore_Destroy( &blockingUserContext.block );
+    IotSemaphore_Destroy( &blockingUserContext.signal );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test the latency histograms and utilization peaks recorded by the task pool instrumentation.
+ */
+TEST( Common_Unit_Task_Pool, Instrumentation )
+{
+    uint32_t count;
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    JobBlockingUserContext_t blockingUserContext = { 0 };
+    JobOrderUserContext_t userContext = { 0 };
+    IotTaskPoolInstrumentation_t snapshot = { 0 };
+    IotTaskPoolJobStorage_t jobsStorage[ TEST_TASKPOOL_ITERATIONS ];
+    IotTaskPoolJob_t jobs[ TEST_TASKPOOL_ITERATIONS ];
+
+    /* A single worker, so that jobs wait behind the blocking job. */
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = 1, .maxThreads = 1, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+
+    /* Empty histograms and bad parameters. */
+    TEST_ASSERT_EQUAL_UINT32( 0, IotTaskPool_HistogramPercentile( NULL, 50 ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, IotTaskPool_HistogramPercentile( &snapshot.waitTime, 50 ) );
+
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.signal, 0, 1 ) );
+    TEST_ASSERT( IotSemaphore_Create( &blockingUserContext.block, 0, 1 ) );
+    TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    if( TEST_PROTECT() )
+    {
+        TEST_ASSERT( IotTaskPool_GetInstrumentation( NULL, &snapshot ) == IOT_TASKPOOL_BAD_PARAMETER );
+        TEST_ASSERT( IotTaskPool_GetInstrumentation( taskPool, NULL ) == IOT_TASKPOOL_BAD_PARAMETER );
+
+        #if IOT_TASKPOOL_ENABLE_INSTRUMENTATION == 1
+            /* Keep the only worker busy for a while, then queue more jobs behind it. */
+            TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionBlockingWithoutDestroyCb, &blockingUserContext, &jobsStorage[ 0 ], &jobs[ 0 ] ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ 0 ], 0 ) == IOT_TASKPOOL_SUCCESS );
+            IotSemaphore_Wait( &blockingUserContext.signal );
+
+            for( count = 1; count < TEST_TASKPOOL_ITERATIONS; ++count )
+            {
+                TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionCountOrderCb, &userContext, &jobsStorage[ count ], &jobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+                TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ count ], 0 ) == IOT_TASKPOOL_SUCCESS );
+            }
+
+            IotClock_SleepMs( 100 );
+            IotSemaphore_Post( &blockingUserContext.block );
+
+            /* Wait until all jobs are recorded as completed. */
+            for( count = 0; count < 100; ++count )
+            {
+                TEST_ASSERT( IotTaskPool_GetInstrumentation( taskPool, &snapshot ) == IOT_TASKPOOL_SUCCESS );
+
+                if( snapshot.runTime.count == TEST_TASKPOOL_ITERATIONS )
+                {
+                    break;
+                }
+
+                IotClock_SleepMs( 50 );
+            }
+
+            TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_ITERATIONS, snapshot.waitTime.count );
+            TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_ITERATIONS, snapshot.runTime.count );
+
+            /* The blocking job ran for at least 100 ticks, and the other jobs waited behind it. */
+            TEST_ASSERT( snapshot.runTime.max >= 100 );
+            TEST_ASSERT( snapshot.waitTime.max >= 100 );
+            TEST_ASSERT_EQUAL_UINT32( snapshot.runTime.max, IotTaskPool_HistogramPercentile( &snapshot.runTime, 100 ) );
+            TEST_ASSERT( IotTaskPool_HistogramPercentile( &snapshot.runTime, 50 ) <= IotTaskPool_HistogramPercentile( &snapshot.runTime, 99 ) );
+            TEST_ASSERT( IotTaskPool_HistogramPercentile( &snapshot.waitTime, 50 ) >= 75 );
+
+            TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_ITERATIONS, snapshot.peakActiveJobs );
+            TEST_ASSERT_EQUAL_UINT32( 1, snapshot.peakActiveThreads );
+            TEST_ASSERT_EQUAL_UINT32( 1, snapshot.activeThreads );
+        #else
+            TEST_ASSERT( IotTaskPool_GetInstrumentation( taskPool, &snapshot ) == IOT_TASKPOOL_ILLEGAL_OPERATION );
+
+            ( void ) count;
+            ( void ) jobsStorage;
+            ( void ) jobs;
+        #endif
+    }
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    IotMutex_Destroy( &userContext.lock );
+    IotSemaphore_Destroy( &blockingUserContext.block );
+    IotSemaphore_Destroy( &blockingUserContext.signal );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test creating task pools with each dispatcher mode.
+ */
+TEST( Common_Unit_Task_Pool, WorkStealing_CreateDestroy )
+{
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    IotTaskPoolInfo_t tpInfo = { .minThreads = 2, .maxThreads = 3, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+
+    /* The shared queue is always available. */
+    tpInfo.dispatchMode = IOT_TASKPOOL_DISPATCH_SHARED_QUEUE;
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    /* The work-stealing dispatcher is only available when compiled in. */
+    tpInfo.dispatchMode = IOT_TASKPOOL_DISPATCH_WORK_STEALING;
+
+    #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+        TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+    #else
+        TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_BAD_PARAMETER );
+    #endif
+
+    /* Unknown dispatcher modes are rejected. */
+    tpInfo.dispatchMode = ( IotTaskPoolDispatchMode_t ) 0xFF;
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_BAD_PARAMETER );
+}
+
+/*-----------------------------------------------------------*/
+
+#if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+
+/**
+ * @brief Test scheduling a set of recyclable jobs on a task pool using the work-stealing dispatcher.
+ */
+    TEST( Common_Unit_Task_Pool, WorkStealing_ScheduleAllThenWait )
+    {
+        uint32_t count;
+        uint32_t scheduled = 0;
+        IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+        const IotTaskPoolInfo_t tpInfo = { .minThreads = 3, .maxThreads = 3, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY, .dispatchMode = IOT_TASKPOOL_DISPATCH_WORK_STEALING };
+
+        JobUserContext_t userContext;
+
+        memset( &userContext, 0, sizeof( JobUserContext_t ) );
+
+        /* Initialize user context. */
+        TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+        TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+        if( TEST_PROTECT() )
+        {
+            /* Schedule more jobs than worker queues, so that every worker queue holds several jobs. */
+            for( count = 0; count < TEST_TASKPOOL_ITERATIONS; ++count )
+            {
+                IotTaskPoolJob_t pJob = IOT_TASKPOOL_JOB_INITIALIZER;
+
+                TEST_ASSERT( IotTaskPool_CreateRecyclableJob( taskPool, &ExecutionWithRecycleCb, &userContext, &pJob ) == IOT_TASKPOOL_SUCCESS );
+
+                /* Alternate normal and high priority jobs. */
+                if( IotTaskPool_Schedule( taskPool, pJob, ( count % 2 ) * IOT_TASKPOOL_JOB_HIGH_PRIORITY ) == IOT_TASKPOOL_SUCCESS )
+                {
+                    ++scheduled;
+                }
+            }
+
+            TEST_ASSERT( scheduled == TEST_TASKPOOL_ITERATIONS );
+
+            /* Wait until all callbacks are executed. */
+            while( true )
+            {
+                IotClock_SleepMs( 50 );
+
+                IotMutex_Lock( &userContext.lock );
+
+                if( userContext.counter == scheduled )
+                {
+                    IotMutex_Unlock( &userContext.lock );
+
+                    break;
+                }
+
+                IotMutex_Unlock( &userContext.lock );
+            }
+
+            TEST_ASSERT( userContext.counter == scheduled );
+        }
+
+        TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+        /* Destroy user context. */
+        IotMutex_Destroy( &userContext.lock );
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test canceling scheduled jobs on a task pool using the work-stealing dispatcher, while
+ * workers may be taking the same jobs from their queues.
+ */
+    TEST( Common_Unit_Task_Pool, WorkStealing_CancelScheduledTasks )
+    {
+        uint32_t count;
+        uint32_t canceled = 0;
+        uint32_t scheduled = 0;
+        IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+        const IotTaskPoolInfo_t tpInfo = { .minThreads = 2, .maxThreads = 2, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY, .dispatchMode = IOT_TASKPOOL_DISPATCH_WORK_STEALING };
+
+        IotTaskPoolJobStorage_t jobsStorage[ TEST_TASKPOOL_ITERATIONS ];
+        IotTaskPoolJob_t jobs[ TEST_TASKPOOL_ITERATIONS ];
+
+        JobUserContext_t userContext;
+
+        memset( &userContext, 0, sizeof( JobUserContext_t ) );
+
+        /* Initialize user context. */
+        TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+        TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+        if( TEST_PROTECT() )
+        {
+            /* Create and schedule loop. */
+            for( count = 0; count < TEST_TASKPOOL_ITERATIONS; ++count )
+            {
+                TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionWithoutDestroyCb, &userContext, &jobsStorage[ count ], &jobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+
+                if( IotTaskPool_Schedule( taskPool, jobs[ count ], 0 ) == IOT_TASKPOOL_SUCCESS )
+                {
+                    ++scheduled;
+                }
+            }
+
+            TEST_ASSERT( scheduled == TEST_TASKPOOL_ITERATIONS );
+
+            /* Cancellation loop, in reverse order so that cancellation races with the workers
+             * serving their queues from the head. */
+            for( count = TEST_TASKPOOL_ITERATIONS; count > 0; --count )
+            {
+                IotTaskPoolJobStatus_t statusAtCancellation = IOT_TASKPOOL_STATUS_READY;
+                IotTaskPoolJobStatus_t statusAfterCancellation = IOT_TASKPOOL_STATUS_READY;
+
+                switch( IotTaskPool_TryCancel( taskPool, jobs[ count - 1 ], &statusAtCancellation ) )
+                {
+                    case IOT_TASKPOOL_SUCCESS:
+                        canceled++;
+
+                        TEST_ASSERT( statusAtCancellation == IOT_TASKPOOL_STATUS_SCHEDULED );
+                        TEST_ASSERT( IotTaskPool_GetStatus( taskPool, jobs[ count - 1 ], &statusAfterCancellation ) == IOT_TASKPOOL_SUCCESS );
+                        TEST_ASSERT( statusAfterCancellation == IOT_TASKPOOL_STATUS_CANCELED );
+                        TEST_ASSERT( IotLink_IsLinked( &jobsStorage[ count - 1 ].link ) == false );
+                        break;
+
+                    case IOT_TASKPOOL_CANCEL_FAILED:
+                        TEST_ASSERT( statusAtCancellation == IOT_TASKPOOL_STATUS_COMPLETED );
+                        break;
+
+                    default:
+                        TEST_ASSERT( false );
+                        break;
+                }
+            }
+
+            /* Wait until the callbacks of all jobs that were not canceled are executed. */
+            while( true )
+            {
+                IotClock_SleepMs( 50 );
+
+                IotMutex_Lock( &userContext.lock );
+
+                if( userContext.counter == ( scheduled - canceled ) )
+                {
+                    IotMutex_Unlock( &userContext.lock );
+
+                    break;
+                }
+
+                IotMutex_Unlock( &userContext.lock );
+            }
+
+            /* Canceled jobs must never execute. */
+            IotClock_SleepMs( 100 );
+            TEST_ASSERT( userContext.counter == ( scheduled - canceled ) );
+        }
+
+        TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+        /* Destroy user context. */
+        IotMutex_Destroy( &userContext.lock );
+    }
+
+#endif /* if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1 */
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,477 @@
+/*
+ * FreeRTOS Common V1.2.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_tests_taskpool_benchmark.c
+ * @brief Throughput benchmarks for the task pool.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* SDK initialization include. */
+#include "iot_init.h"
+
+/* Platform layer includes. */
+#include "platform/iot_threads.h"
+#include "platform/iot_clock.h"
+
+/* Atomic include. */
+#include "iot_atomic.h"
+
+/* Task pool include. */
+#include "iot_taskpool.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Number of jobs scheduled for every throughput measurement.
+ */
+#ifndef TEST_TASKPOOL_BENCHMARK_JOBS
+    #define TEST_TASKPOOL_BENCHMARK_JOBS    ( 512 )
+#endif
+
+/**
+ * @brief The largest number of worker threads to measure throughput with. Throughput
+ * is measured with 1, 2, 4, ... worker threads up to this number.
+ */
+#ifndef TEST_TASKPOOL_BENCHMARK_MAX_WORKERS
+    #define TEST_TASKPOOL_BENCHMARK_MAX_WORKERS    ( 8 )
+#endif
+
+/**
+ * @brief Number of iterations of the busy loop emulating the work of one job.
+ */
+#ifndef TEST_TASKPOOL_BENCHMARK_JOB_SPIN
+    #define TEST_TASKPOOL_BENCHMARK_JOB_SPIN    ( 200 )
+#endif
+
+/**
+ * @brief Number of jobs scheduled together by the batched scheduling benchmark.
+ */
+#ifndef TEST_TASKPOOL_BENCHMARK_BATCH_SIZE
+    #define TEST_TASKPOOL_BENCHMARK_BATCH_SIZE    ( 16 )
+#endif
+
+/**
+ * @brief Number of worker threads of the task pool used by the batched scheduling benchmark.
+ */
+#ifndef TEST_TASKPOOL_BENCHMARK_BATCH_WORKERS
+    #define TEST_TASKPOOL_BENCHMARK_BATCH_WORKERS    ( 4 )
+#endif
+
+/**
+ * @brief Number of deferred jobs scheduled and canceled by the deferred jobs benchmark.
+ *
+ * Every deferred job holds a timer event until it is canceled. With static memory
+ * only, no more than #IOT_TASKPOOL_JOBS_RECYCLE_LIMIT timer events are available.
+ */
+#ifndef TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS
+    #if IOT_STATIC_MEMORY_ONLY == 1
+        #define TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS    IOT_TASKPOOL_JOBS_RECYCLE_LIMIT
+    #else
+        #define TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS    ( 512 )
+    #endif
+#endif
+
+/**
+ * @brief Number of job storages needed by the benchmarks.
+ */
+#if TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS > TEST_TASKPOOL_BENCHMARK_JOBS
+    #define TEST_TASKPOOL_BENCHMARK_JOB_STORAGES    TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS
+#else
+    #define TEST_TASKPOOL_BENCHMARK_JOB_STORAGES    TEST_TASKPOOL_BENCHMARK_JOBS
+#endif
+
+/* Check that the deferred jobs fit in the timer events available with static memory only. */
+#if ( IOT_STATIC_MEMORY_ONLY == 1 ) && ( TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS > IOT_TASKPOOL_JOBS_RECYCLE_LIMIT )
+    #error "TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS cannot exceed IOT_TASKPOOL_JOBS_RECYCLE_LIMIT with static memory only."
+#endif
+
+/**
+ * @brief A prime used to spread the deadlines of the deferred jobs and to shuffle
+ * the order in which they are canceled.
+ */
+#define TEST_TASKPOOL_BENCHMARK_PRIME    ( 7919UL )
+
+/**
+ * @brief Length of the buffer for printing benchmark results.
+ */
+#define TEST_TASKPOOL_BENCHMARK_RESULT_LENGTH    ( 128 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Completion tracking for the jobs of one benchmark.
+ *
+ * Jobs run on the task pool's worker threads, where Unity assertions cannot be
+ * used. Jobs record failures here instead, and the test thread checks them.
+ */
+typedef struct BenchmarkContext
+{
+    uint32_t completed;    /**< @brief The number of jobs executed so far. */
+    uint32_t total;        /**< @brief The number of jobs to execute. */
+    uint32_t failures;     /**< @brief The number of jobs that failed. */
+    IotSemaphore_t done;   /**< @brief Posted when all jobs are executed. */
+} BenchmarkContext_t;
+
+/**
+ * @brief Storage for the jobs of one benchmark.
+ */
+static IotTaskPoolJobStorage_t _benchmarkJobsStorage[ TEST_TASKPOOL_BENCHMARK_JOB_STORAGES ];
+
+/**
+ * @brief Handles of the jobs of one benchmark.
+ */
+static IotTaskPoolJob_t _benchmarkJobs[ TEST_TASKPOOL_BENCHMARK_JOB_STORAGES ];
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for task pool benchmarks.
+ */
+TEST_GROUP( Common_Benchmark_Task_Pool );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for task pool benchmarks.
+ */
+TEST_SETUP( Common_Benchmark_Task_Pool )
+{
+    TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for task pool benchmarks.
+ */
+TEST_TEAR_DOWN( Common_Benchmark_Task_Pool )
+{
+    IotSdk_Cleanup();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for task pool benchmarks.
+ */
+TEST_GROUP_RUNNER( Common_Benchmark_Task_Pool )
+{
+    RUN_TEST_CASE( Common_Benchmark_Task_Pool, DispatchThroughput );
+    RUN_TEST_CASE( Common_Benchmark_Task_Pool, DeferredScheduleCancel );
+    RUN_TEST_CASE( Common_Benchmark_Task_Pool, BatchedFanOut );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A short job that emulates some work, then counts its own completion.
+ */
+static void _benchmarkJob( IotTaskPool_t pTaskPool,
+                           IotTaskPoolJob_t pJob,
+                           void * pContext )
+{
+    volatile uint32_t spin = 0;
+    BenchmarkContext_t * pBenchmark = ( BenchmarkContext_t * ) pContext;
+
+    ( void ) pTaskPool;
+    ( void ) pJob;
+
+    while( spin < TEST_TASKPOOL_BENCHMARK_JOB_SPIN )
+    {
+        spin++;
+    }
+
+    /* The atomic operation returns the value before the increment. */
+    if( ( Atomic_Increment_u32( &pBenchmark->completed ) + 1UL ) == pBenchmark->total )
+    {
+        IotSemaphore_Post( &pBenchmark->done );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measure how many jobs per second a task pool executes.
+ *
+ * @param[in] workers The number of worker threads of the task pool.
+ * @param[in] dispatchMode The dispatcher mode of the task pool.
+ *
+ * @return The number of jobs executed per second.
+ */
+static uint32_t _measureThroughput( uint32_t workers,
+                                    IotTaskPoolDispatchMode_t dispatchMode )
+{
+    uint32_t count;
+    uint64_t startTime, elapsedTime;
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    IotTaskPoolJob_t job = IOT_TASKPOOL_JOB_INITIALIZER;
+    BenchmarkContext_t benchmark = { .completed = 0, .total = TEST_TASKPOOL_BENCHMARK_JOBS };
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = workers, .maxThreads = workers, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY, .dispatchMode = dispatchMode };
+
+    TEST_ASSERT( IotSemaphore_Create( &benchmark.done, 0, 1 ) );
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    startTime = IotClock_GetTimeMs();
+
+    for( count = 0; count < TEST_TASKPOOL_BENCHMARK_JOBS; ++count )
+    {
+        TEST_ASSERT( IotTaskPool_CreateJob( &_benchmarkJob, &benchmark, &_benchmarkJobsStorage[ count ], &job ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( IotTaskPool_Schedule( taskPool, job, 0 ) == IOT_TASKPOOL_SUCCESS );
+    }
+
+    /* Wait for the last job to complete. */
+    IotSemaphore_Wait( &benchmark.done );
+
+    elapsedTime = IotClock_GetTimeMs() - startTime;
+
+    TEST_ASSERT( benchmark.completed == TEST_TASKPOOL_BENCHMARK_JOBS );
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    IotSemaphore_Destroy( &benchmark.done );
+
+    /* Avoid dividing by zero on very fast runs. */
+    if( elapsedTime == 0ULL )
+    {
+        elapsedTime = 1ULL;
+    }
+
+    return ( uint32_t ) ( ( TEST_TASKPOOL_BENCHMARK_JOBS * 1000ULL ) / elapsedTime );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare the throughput of the shared queue and the work-stealing dispatcher
+ * as the number of worker threads grows.
+ */
+TEST( Common_Benchmark_Task_Pool, DispatchThroughput )
+{
+    uint32_t workers;
+    uint32_t sharedQueueThroughput = 0, workStealingThroughput = 0;
+    char pResult[ TEST_TASKPOOL_BENCHMARK_RESULT_LENGTH ] = { 0 };
+
+    for( workers = 1; workers <= TEST_TASKPOOL_BENCHMARK_MAX_WORKERS; workers *= 2 )
+    {
+        sharedQueueThroughput = _measureThroughput( workers, IOT_TASKPOOL_DISPATCH_SHARED_QUEUE );
+
+        #if IOT_TASKPOOL_ENABLE_WORK_STEALING == 1
+            workStealingThroughput = _measureThroughput( workers, IOT_TASKPOOL_DISPATCH_WORK_STEALING );
+        #endif
+
+        snprintf( pResult,
+                  TEST_TASKPOOL_BENCHMARK_RESULT_LENGTH,
+                  "Task pool with %lu workers: shared queue %lu jobs/s, work stealing %lu jobs/s.\r\n",
+                  ( unsigned long ) workers,
+                  ( unsigned long ) sharedQueueThroughput,
+                  ( unsigned long ) workStealingThroughput );
+
+        UnityPrint( pResult );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A deferred job that must never execute, since the benchmark cancels it first.
+ * Executing it counts as a failure.
+ */
+static void _benchmarkDeferredJob( IotTaskPool_t pTaskPool,
+                                   IotTaskPoolJob_t pJob,
+                                   void * pContext )
+{
+    BenchmarkContext_t * pBenchmark = ( BenchmarkContext_t * ) pContext;
+
+    ( void ) pTaskPool;
+    ( void ) pJob;
+
+    ( void ) Atomic_Increment_u32( &pBenchmark->failures );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measure the time taken to schedule many deferred jobs with scattered deadlines,
+ * then to cancel all of them in a shuffled order.
+ */
+TEST( Common_Benchmark_Task_Pool, DeferredScheduleCancel )
+{
+    uint32_t count, index;
+    uint64_t startTime, scheduleTime, cancelTime;
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    IotTaskPoolJobStatus_t status = IOT_TASKPOOL_STATUS_UNDEFINED;
+    BenchmarkContext_t benchmark = { .completed = 0, .total = 0, .failures = 0 };
+    char pResult[ TEST_TASKPOOL_BENCHMARK_RESULT_LENGTH ] = { 0 };
+    const IotTaskPoolInfo_t tpInfo = IOT_TASKPOOL_INFO_INITIALIZER_SMALL;
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    for( count = 0; count < TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS; ++count )
+    {
+        TEST_ASSERT( IotTaskPool_CreateJob( &_benchmarkDeferredJob, &benchmark, &_benchmarkJobsStorage[ count ], &_benchmarkJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+    }
+
+    /* Schedule all jobs with deadlines scattered between 1 and 60 seconds. */
+    startTime = IotClock_GetTimeMs();
+
+    for( count = 0; count < TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS; ++count )
+    {
+        TEST_ASSERT( IotTaskPool_ScheduleDeferred( taskPool,
+                                                   _benchmarkJobs[ count ],
+                                                   1000UL + ( ( count * TEST_TASKPOOL_BENCHMARK_PRIME ) % 59000UL ) ) == IOT_TASKPOOL_SUCCESS );
+    }
+
+    scheduleTime = IotClock_GetTimeMs() - startTime;
+
+    /* Cancel all jobs in a shuffled order. */
+    startTime = IotClock_GetTimeMs();
+
+    for( count = 0; count < TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS; ++count )
+    {
+        index = ( count * TEST_TASKPOOL_BENCHMARK_PRIME ) % TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS;
+
+        TEST_ASSERT( IotTaskPool_TryCancel( taskPool, _benchmarkJobs[ index ], &status ) == IOT_TASKPOOL_SUCCESS );
+        TEST_ASSERT( status == IOT_TASKPOOL_STATUS_DEFERRED );
+    }
+
+    cancelTime = IotClock_GetTimeMs() - startTime;
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+    TEST_ASSERT_EQUAL_UINT32( 0, benchmark.failures );
+
+    snprintf( pResult,
+              TEST_TASKPOOL_BENCHMARK_RESULT_LENGTH,
+              "Task pool deferred jobs: %lu scheduled in %lu ms, canceled in %lu ms.\r\n",
+              ( unsigned long ) TEST_TASKPOOL_BENCHMARK_DEFERRED_JOBS,
+              ( unsigned long ) scheduleTime,
+              ( unsigned long ) cancelTime );
+
+    UnityPrint( pResult );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measure the time taken to fan out jobs in groups, then to execute all of them.
+ *
+ * @param[in] batched Whether each group is scheduled with one call to @ref IotTaskPool_ScheduleBatch,
+ * or with one call to @ref IotTaskPool_Schedule per job.
+ *
+ * @return The elapsed time in milliseconds.
+ */
+static uint32_t _measureFanOut( bool batched )
+{
+    uint32_t count, index;
+    uint64_t startTime;
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    BenchmarkContext_t benchmark = { .completed = 0, .total = TEST_TASKPOOL_BENCHMARK_JOBS };
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = TEST_TASKPOOL_BENCHMARK_BATCH_WORKERS, .maxThreads = TEST_TASKPOOL_BENCHMARK_BATCH_WORKERS, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+
+    TEST_ASSERT( IotSemaphore_Create( &benchmark.done, 0, 1 ) );
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    for( count = 0; count < TEST_TASKPOOL_BENCHMARK_JOBS; ++count )
+    {
+        TEST_ASSERT( IotTaskPool_CreateJob( &_benchmarkJob, &benchmark, &_benchmarkJobsStorage[ count ], &_benchmarkJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+    }
+
+    startTime = IotClock_GetTimeMs();
+
+    for( count = 0; count < TEST_TASKPOOL_BENCHMARK_JOBS; count += TEST_TASKPOOL_BENCHMARK_BATCH_SIZE )
+    {
+        uint32_t batchSize = TEST_TASKPOOL_BENCHMARK_JOBS - count;
+
+        if( batchSize > TEST_TASKPOOL_BENCHMARK_BATCH_SIZE )
+        {
+            batchSize = TEST_TASKPOOL_BENCHMARK_BATCH_SIZE;
+        }
+
+        if( batched == true )
+        {
+            TEST_ASSERT( IotTaskPool_ScheduleBatch( taskPool, &_benchmarkJobs[ count ], batchSize ) == IOT_TASKPOOL_SUCCESS );
+        }
+        else
+        {
+            for( index = count; index < ( count + batchSize ); ++index )
+            {
+                TEST_ASSERT( IotTaskPool_Schedule( taskPool, _benchmarkJobs[ index ], 0 ) == IOT_TASKPOOL_SUCCESS );
+            }
+        }
+    }
+
+    /* Wait for the last job to complete. */
+    IotSemaphore_Wait( &benchmark.done );
+
+    startTime = IotClock_GetTimeMs() - startTime;
+
+    TEST_ASSERT( benchmark.completed == TEST_TASKPOOL_BENCHMARK_JOBS );
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    IotSemaphore_Destroy( &benchmark.done );
+
+    return ( uint32_t ) startTime;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare fanning out jobs one by one and in batches. Each call to schedule
+ * jobs acquires the task pool lock once, so batching divides lock acquisitions by
+ * the batch size.
+ */
+TEST( Common_Benchmark_Task_Pool, BatchedFanOut )
+{
+    uint32_t singleTime, batchedTime;
+    char pResult[ TEST_TASKPOOL_BENCHMARK_RESULT_LENGTH ] = { 0 };
+    const uint32_t batches = ( TEST_TASKPOOL_BENCHMARK_JOBS + TEST_TASKPOOL_BENCHMARK_BATCH_SIZE - 1 ) / TEST_TASKPOOL_BENCHMARK_BATCH_SIZE;
+
+    singleTime = _measureFanOut( false );
+    batchedTime = _measureFanOut( true );
+
+    snprintf( pResult,
+              TEST_TASKPOOL_BENCHMARK_RESULT_LENGTH,
+              "Task pool fan-out of %lu jobs: %lu lock acquisitions in %lu ms, batched %lu in %lu ms.\r\n",
+              ( unsigned long ) TEST_TASKPOOL_BENCHMARK_JOBS,
+              ( unsigned long ) TEST_TASKPOOL_BENCHMARK_JOBS,
+              ( unsigned long ) singleTime,
+              ( unsigned long ) batches,
+              ( unsigned long ) batchedTime );
+
+    UnityPrint( pResult );
+}
+
+/*-----------------------------------------------------------*/
@@ -56,6 +56,8 @@
  * @function_brief{mqtt_function_subscribe}
  * - @function_name{mqtt_function_timedsubscribe}
  * @function_brief{mqtt_function_timedsubscribe}
+ * - @function_name{mqtt_function_timedsubscribebulk}
+ * @function_brief{mqtt_function_timedsubscribebulk}
  * - @function_name{mqtt_function_unsubscribe}
  * @function_brief{mqtt_function_unsubscribe}
  * - @function_name{mqtt_function_timedunsubscribe}
@@ -66,6 +68,42 @@
  * @function_brief{mqtt_function_timedpublish}
  * - @function_name{mqtt_function_wait}
  * @function_brief{mqtt_function_wait}
+ * - @function_name{mqtt_function_retainmessage}
+ * @function_brief{mqtt_function_retainmessage}
+ * - @function_name{mqtt_function_releasemessage}
+ * @function_brief{mqtt_function_releasemessage}
+ * - @function_name{mqtt_function_getcoalescestats}
+ * @function_brief{mqtt_function_getcoalescestats}
+ * - @function_name{mqtt_function_getrttstats}
+ * @function_brief{mqtt_function_getrttstats}
+ * - @function_name{mqtt_function_getoperationpoolstats}
+ * @function_brief{mqtt_function_getoperationpoolstats}
+ * - @function_name{mqtt_function_offlinequeueinit}
+ * @function_brief{mqtt_function_offlinequeueinit}
+ * - @function_name{mqtt_function_offlinequeuedestroy}
+ * @function_brief{mqtt_function_offlinequeuedestroy}
+ * - @function_name{mqtt_function_offlinepublish}
+ * @function_brief{mqtt_function_offlinepublish}
+ * - @function_name{mqtt_function_offlinequeuegetstats}
+ * @function_brief{mqtt_function_offlinequeuegetstats}
+ * - @function_name{mqtt_function_offlineramstoreinit}
+ * @function_brief{mqtt_function_offlineramstoreinit}
+ * - @function_name{mqtt_function_subscriptionregistryinit}
+ * @function_brief{mqtt_function_subscriptionregistryinit}
+ * - @function_name{mqtt_function_subscriptionregistrydestroy}
+ * @function_brief{mqtt_function_subscriptionregistrydestroy}
+ * - @function_name{mqtt_function_subscriptionregistryclear}
+ * @function_brief{mqtt_function_subscriptionregistryclear}
+ * - @function_name{mqtt_function_settracesink}
+ * @function_brief{mqtt_function_settracesink}
+ * - @function_name{mqtt_function_traceringinit}
+ * @function_brief{mqtt_function_traceringinit}
+ * - @function_name{mqtt_function_traceringsink}
+ * @function_brief{mqtt_function_traceringsink}
+ * - @function_name{mqtt_function_traceringdump}
+ * @function_brief{mqtt_function_traceringdump}
+ * - @function_name{mqtt_function_traceeventname}
+ * @function_brief{mqtt_function_traceeventname}
  * - @function_name{mqtt_function_strerror}
  * @function_brief{mqtt_function_strerror}
  * - @function_name{mqtt_function_operationtype}
@@ -96,6 +134,9 @@
  * @page mqtt_function_timedsubscribe IotMqtt_TimedSubscribe
  * @snippet this declare_mqtt_timedsubscribe
  * @copydoc IotMqtt_TimedSubscribe
+ * @page mqtt_function_timedsubscribebulk IotMqtt_TimedSubscribeBulk
+ * @snippet this declare_mqtt_timedsubscribebulk
+ * @copydoc IotMqtt_TimedSubscribeBulk
  * @page mqtt_function_unsubscribe IotMqtt_Unsubscribe
  * @snippet this declare_mqtt_unsubscribe
  * @copydoc IotMqtt_Unsubscribe
@@ -111,6 +152,60 @@
  * @page mqtt_function_wait IotMqtt_Wait
  * @snippet this declare_mqtt_wait
  * @copydoc IotMqtt_Wait
+ * @page mqtt_function_retainmessage IotMqtt_RetainMessage
+ * @snippet this declare_mqtt_retainmessage
+ * @copydoc IotMqtt_RetainMessage
+ * @page mqtt_function_releasemessage IotMqtt_ReleaseMessage
+ * @snippet this declare_mqtt_releasemessage
+ * @copydoc IotMqtt_ReleaseMessage
+ * @page mqtt_function_getcoalescestats IotMqtt_GetCoalesceStats
+ * @snippet this declare_mqtt_getcoalescestats
+ * @copydoc IotMqtt_GetCoalesceStats
+ * @page mqtt_function_getrttstats IotMqtt_GetRttStats
+ * @snippet this declare_mqtt_getrttstats
+ * @copydoc IotMqtt_GetRttStats
+ * @page mqtt_function_getoperationpoolstats IotMqtt_GetOperationPoolStats
+ * @snippet this declare_mqtt_getoperationpoolstats
+ * @copydoc IotMqtt_GetOperationPoolStats
+ * @page mqtt_function_offlinequeueinit IotMqtt_OfflineQueueInit
+ * @snippet this declare_mqtt_offlinequeueinit
+ * @copydoc IotMqtt_OfflineQueueInit
+ * @page mqtt_function_offlinequeuedestroy IotMqtt_OfflineQueueDestroy
+ * @snippet this declare_mqtt_offlinequeuedestroy
+ * @copydoc IotMqtt_OfflineQueueDestroy
+ * @page mqtt_function_offlinepublish IotMqtt_OfflinePublish
+ * @snippet this declare_mqtt_offlinepublish
+ * @copydoc IotMqtt_OfflinePublish
+ * @page mqtt_function_offlinequeuegetstats IotMqtt_OfflineQueueGetStats
+ * @snippet this declare_mqtt_offlinequeuegetstats
+ * @copydoc IotMqtt_OfflineQueueGetStats
+ * @page mqtt_function_offlineramstoreinit IotMqtt_OfflineRamStoreInit
+ * @snippet this declare_mqtt_offlineramstoreinit
+ * @copydoc IotMqtt_OfflineRamStoreInit
+ * @page mqtt_function_subscriptionregistryinit IotMqtt_SubscriptionRegistryInit
+ * @snippet this declare_mqtt_subscriptionregistryinit
+ * @copydoc IotMqtt_SubscriptionRegistryInit
+ * @page mqtt_function_subscriptionregistrydestroy IotMqtt_SubscriptionRegistryDestroy
+ * @snippet this declare_mqtt_subscriptionregistrydestroy
+ * @copydoc IotMqtt_SubscriptionRegistryDestroy
+ * @page mqtt_function_subscriptionregistryclear IotMqtt_SubscriptionRegistryClear
+ * @snippet this declare_mqtt_subscriptionregistryclear
+ * @copydoc IotMqtt_SubscriptionRegistryClear
+ * @page mqtt_function_settracesink IotMqtt_SetTraceSink
+ * @snippet this declare_mqtt_settracesink
+ * @copydoc IotMqtt_SetTraceSink
+ * @page mqtt_function_traceringinit IotMqtt_TraceRingInit
+ * @snippet this declare_mqtt_traceringinit
+ * @copydoc IotMqtt_TraceRingInit
+ * @page mqtt_function_traceringsink IotMqtt_TraceRingSink
+ * @snippet this declare_mqtt_traceringsink
+ * @copydoc IotMqtt_TraceRingSink
+ * @page mqtt_function_traceringdump IotMqtt_TraceRingDump
+ * @snippet this declare_mqtt_traceringdump
+ * @copydoc IotMqtt_TraceRingDump
+ * @page mqtt_function_traceeventname IotMqtt_TraceEventName
+ * @snippet this declare_mqtt_traceeventname
+ * @copydoc IotMqtt_TraceEventName
  * @page mqtt_function_strerror IotMqtt_strerror
  * @snippet this declare_mqtt_strerror
  * @copydoc IotMqtt_strerror
@@ -515,6 +610,43 @@ IotMqttError_t IotMqtt_TimedSubscribe( IotMqttConnection_t mqttConnection,
                                        uint32_t timeoutMs );
 /* @[declare_mqtt_timedsubscribe] */
 
+/**
+ * @brief Subscribes to a list of topic filters of any length with a timeout.
+ *
+ * This function splits the list into as few SUBSCRIBE packets as possible.
+ * In AWS IoT MQTT mode, a packet has at most 8 topic filters; otherwise, a
+ * packet is limited by the connection's network buffer. Packets are sent
+ * without waiting for the SUBACK of the previous one, with up to
+ * `MQTT_BULK_SUBSCRIBE_WINDOW` awaiting SUBACK at once, so a long list takes
+ * about one round trip instead of one per packet.
+ *
+ * The whole list is checked before any packet is sent. Once a packet fails
+ * for a reason other than #IOT_MQTT_SERVER_REFUSED, no more packets are sent.
+ * Topic filters sent in earlier packets stay subscribed.
+ *
+ * @param[in] mqttConnection The MQTT connection to use for the subscriptions.
+ * @param[in] pSubscriptionList Pointer to the first element in the array of
+ * subscriptions.
+ * @param[in] subscriptionCount The number of elements in pSubscriptionList.
+ * @param[in] flags Flags which modify the behavior of this function. See @ref mqtt_constants_flags.
+ * Currently, flags are ignored by this function; this parameter is for
+ * future-compatibility.
+ * @param[in] timeoutMs If the MQTT server does not acknowledge all subscriptions
+ * within this timeout, this function returns #IOT_MQTT_TIMEOUT.
+ *
+ * @return #IOT_MQTT_SUCCESS if every topic filter was accepted;
+ * #IOT_MQTT_SERVER_REFUSED if the server refused some topic filters, which
+ * can be found with @ref mqtt_function_issubscribed; otherwise, the first
+ * failure of @ref mqtt_function_timedsubscribe.
+ */
+/* @[declare_mqtt_timedsubscribebulk] */
+IotMqttError_t IotMqtt_TimedSubscribeBulk( IotMqttConnection_t mqttConnection,
+                                           const IotMqttSubscription_t * pSubscriptionList,
+                                           size_t subscriptionCount,
+                                           uint32_t flags,
+                                           uint32_t timeoutMs );
+/* @[declare_mqtt_timedsubscribebulk] */
+
 /**
  * @brief Unsubscribes from the given array of topic filters and receive an asynchronous
  * notification when the unsubscribe completes.
@@ -635,6 +767,7 @@ IotMqttError_t IotMqtt_TimedUnsubscribe( IotMqttConnection_t mqttConnection,
  * of QoS), it will return one of:
  * - #IOT_MQTT_BAD_PARAMETER
  * - #IOT_MQTT_NO_MEMORY
+ * - #IOT_MQTT_WOULD_BLOCK (QoS 1 only, if too many QoS 1 publishes await PUBACK)
  *
  * @note The parameters `pCallbackInfo` and `pPublishOperation` should only be used for QoS
  * 1 publishes. For QoS 0, they should both be `NULL`.
@@ -720,6 +853,7 @@ IotMqttError_t IotMqtt_Publish( IotMqttConnection_t mqttConnection,
  * - #IOT_MQTT_BAD_RESPONSE
  * - #IOT_MQTT_RETRY_NO_RESPONSE (if [pPublishInfo->retryMs](@ref IotMqttPublishInfo_t.retryMs)
  * and [pPublishInfo->retryLimit](@ref IotMqttPublishInfo_t.retryLimit) were set).
+ * - #IOT_MQTT_WOULD_BLOCK
  */
 /* @[declare_mqtt_timedpublish] */
 IotMqttError_t IotMqtt_TimedPublish( IotMqttConnection_t mqttConnection,
@@ -782,6 +916,367 @@ IotMqttError_t IotMqtt_Wait( IotMqttOperation_t operation,
                              uint32_t timeoutMs );
 /* @[declare_mqtt_wait] */
 
+/**
+ * @brief Keep a received PUBLISH message after its subscription callback returns.
+ *
+ * Incoming PUBLISH messages are deserialized in place: the topic name and payload
+ * passed to a subscription callback point into the buffer the message was received
+ * in. Normally, that buffer is freed as soon as the subscription callbacks return.
+ * This function adds a reference to the message, so that its topic name, payload,
+ * and the rest of #IotMqttCallbackParam_t.u.message.info remain valid until a
+ * matching call to @ref mqtt_function_releasemessage. This avoids copying large
+ * payloads that must be processed later, e.g. by another task.
+ *
+ * This function must be called from a subscription callback for `message`, or
+ * while holding a reference from an earlier call to this function.
+ *
+ * @param[in] message The message to retain, from #IotMqttCallbackParam_t.u.message.reference.
+ *
+ * @return One of the following:
+ * - #IOT_MQTT_SUCCESS
+ * - #IOT_MQTT_BAD_PARAMETER
+ *
+ * @note If the network stack lent the message buffer, a retained message also
+ * keeps the MQTT connection's resources until it is released. All retained
+ * messages must be released before destroying a network connection that the
+ * MQTT library does not own.
+ *
+ * <b>Example</b>
+ * @code{c}
+ * void subscriptionCallback( void * pContext,
+ *                            IotMqttCallbackParam_t * pPublish )
+ * {
+ *     // Hand the message to another task without copying its payload.
+ *     if( IotMqtt_RetainMessage( pPublish->u.message.reference ) == IOT_MQTT_SUCCESS )
+ *     {
+ *         if( xQueueSend( xMessageQueue, &( pPublish->u.message.reference ), 0 ) != pdPASS )
+ *         {
+ *             IotMqtt_ReleaseMessage( pPublish->u.message.reference );
+ *         }
+ *     }
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_retainmessage] */
+IotMqttError_t IotMqtt_RetainMessage( IotMqttMessage_t message );
+/* @[declare_mqtt_retainmessage] */
+
+/**
+ * @brief Release a received PUBLISH message kept with @ref mqtt_function_retainmessage.
+ *
+ * The message is freed once every reference to it is released. Its topic name
+ * and payload must not be used after this function returns.
+ *
+ * @param[in] message The message to release.
+ */
+/* @[declare_mqtt_releasemessage] */
+void IotMqtt_ReleaseMessage( IotMqttMessage_t message );
+/* @[declare_mqtt_releasemessage] */
+
+/**
+ * @brief Get statistics of the PUBLISH packets coalesced on an MQTT connection.
+ *
+ * @param[in] mqttConnection The MQTT connection, established with a nonzero
+ * #IotMqttConnectInfo_t.coalesceMaxBytes.
+ * @param[out] pStats Set to the statistics of the connection.
+ *
+ * @return
+ * - #IOT_MQTT_SUCCESS if the statistics were copied.
+ * - #IOT_MQTT_BAD_PARAMETER if a parameter is `NULL` or the connection does
+ * not coalesce PUBLISH packets.
+ * - #IOT_MQTT_TIMEOUT if the statistics could not be locked.
+ */
+/* @[declare_mqtt_getcoalescestats] */
+IotMqttError_t IotMqtt_GetCoalesceStats( IotMqttConnection_t mqttConnection,
+                                         IotMqttCoalesceStats_t * pStats );
+/* @[declare_mqtt_getcoalescestats] */
+
+/**
+ * @brief Get the round-trip time statistics of an MQTT connection.
+ *
+ * @param[in] mqttConnection The MQTT connection.
+ * @param[out] pStats Set to the statistics of the connection. Before any round
+ * trip is measured, all members are 0 except
+ * #IotMqttRttStats_t.retransmitTimeoutMs, which is @ref IOT_MQTT_RESPONSE_WAIT_MS.
+ *
+ * @return
+ * - #IOT_MQTT_SUCCESS if the statistics were copied.
+ * - #IOT_MQTT_BAD_PARAMETER if a parameter is `NULL`.
+ */
+/* @[declare_mqtt_getrttstats] */
+IotMqttError_t IotMqtt_GetRttStats( IotMqttConnection_t mqttConnection,
+                                    IotMqttRttStats_t * pStats );
+/* @[declare_mqtt_getrttstats] */
+
+/**
+ * @brief Get statistics of the operation records reused by an MQTT connection.
+ *
+ * The hit rate of the pool is `operationHits / ( operationHits + operationMisses )`;
+ * a low rate suggests raising `MQTT_OPERATION_POOL_SIZE`. Likewise, a low rate of
+ * `packetHits` suggests raising `MQTT_OPERATION_INLINE_PACKET_SIZE`.
+ *
+ * @param[in] mqttConnection The MQTT connection.
+ * @param[out] pStats Set to the statistics of the connection.
+ *
+ * @return
+ * - #IOT_MQTT_SUCCESS if the statistics were copied.
+ * - #IOT_MQTT_BAD_PARAMETER if a parameter is `NULL`.
+ */
+/* @[declare_mqtt_getoperationpoolstats] */
+IotMqttError_t IotMqtt_GetOperationPoolStats( IotMqttConnection_t mqttConnection,
+                                              IotMqttOperationPoolStats_t * pStats );
+/* @[declare_mqtt_getoperationpoolstats] */
+
+/*------------------------ MQTT offline queue functions ----------------------*/
+
+/**
+ * @brief Initialize an offline PUBLISH queue.
+ *
+ * An offline queue holds PUBLISH messages while no MQTT connection can send
+ * them. To forward the queue, pass it as #IotMqttConnectInfo_t.pOfflineQueue
+ * to @ref mqtt_function_connect. Messages already in the store, such as those
+ * kept by a persistent backend across a reset, are forwarded as well.
+ *
+ * @param[out] pQueue The queue to initialize.
+ * @param[in] pQueueInfo Parameters of the queue. The store, store context, and
+ * record buffer must remain valid until @ref mqtt_function_offlinequeuedestroy
+ * is called.
+ *
+ * @return One of the following:
+ * - #IOT_MQTT_SUCCESS
+ * - #IOT_MQTT_BAD_PARAMETER
+ * - #IOT_MQTT_NO_MEMORY if the queue's mutex could not be created.
+ */
+/* @[declare_mqtt_offlinequeueinit] */
+IotMqttError_t IotMqtt_OfflineQueueInit( IotMqttOfflineQueue_t * pQueue,
+                                         const IotMqttOfflineQueueInfo_t * pQueueInfo );
+/* @[declare_mqtt_offlinequeueinit] */
+
+/**
+ * @brief Free the resources of an offline PUBLISH queue.
+ *
+ * Should be called after @ref mqtt_function_disconnect for every connection
+ * established with this queue. This function waits until those connections
+ * no longer use the queue. Messages left in the store are not removed.
+ *
+ * @param[in] pQueue The queue to destroy.
+ */
+/* @[declare_mqtt_offlinequeuedestroy] */
+void IotMqtt_OfflineQueueDestroy( IotMqttOfflineQueue_t * pQueue );
+/* @[declare_mqtt_offlinequeuedestroy] */
+
+/**
+ * @brief Publish a message, or store it to be published later.
+ *
+ * If a connection forwards this queue and no earlier message is waiting in the
+ * store, the message is published right away without a completion
+ * notification. Otherwise, or if that publish fails, the message is appended to
+ * the store and forwarded in order once a connection is available.
+ *
+ * [pPublishInfo->retryMs](@ref IotMqttPublishInfo_t.retryMs) and
+ * [pPublishInfo->retryLimit](@ref IotMqttPublishInfo_t.retryLimit) are ignored.
+ * Stored QoS 1 messages are retransmitted as set by
+ * #IotMqttOfflineQueueInfo_t.retryMs.
+ *
+ * @param[in] pQueue The offline queue.
+ * @param[in] pPublishInfo The message to publish.
+ *
+ * @return One of the following:
+ * - #IOT_MQTT_SUCCESS if the message was sent.
+ * - #IOT_MQTT_STATUS_PENDING if the message was stored.
+ * - #IOT_MQTT_BAD_PARAMETER if a parameter is invalid, or the message does not
+ * fit in #IotMqttOfflineQueueInfo_t.pRecordBuffer.
+ * - #IOT_MQTT_NO_MEMORY if the store is full. The message is lost.
+ *
+ * @note A stored QoS 0 message leaves the store once it is sent, and a stored
+ * QoS 1 message once its PUBACK arrives. A QoS 1 message published right away
+ * is not stored again if its connection is lost before the PUBACK arrives.
+ */
+/* @[declare_mqtt_offlinepublish] */
+IotMqttError_t IotMqtt_OfflinePublish( IotMqttOfflineQueue_t * pQueue,
+                                       const IotMqttPublishInfo_t * pPublishInfo );
+/* @[declare_mqtt_offlinepublish] */
+
+/**
+ * @brief Get statistics of an offline PUBLISH queue.
+ *
+ * @param[in] pQueue The offline queue.
+ * @param[out] pStats Set to the statistics of the queue.
+ *
+ * @return #IOT_MQTT_SUCCESS or #IOT_MQTT_BAD_PARAMETER.
+ */
+/* @[declare_mqtt_offlinequeuegetstats] */
+IotMqttError_t IotMqtt_OfflineQueueGetStats( IotMqttOfflineQueue_t * pQueue,
+                                             IotMqttOfflineQueueStats_t * pStats );
+/* @[declare_mqtt_offlinequeuegetstats] */
+
+/**
+ * @brief Initialize a RAM store for an offline PUBLISH queue.
+ *
+ * Use #IotMqttOfflineStoreRam as #IotMqttOfflineQueueInfo_t.pStore and the
+ * initialized `pRamStore` as #IotMqttOfflineQueueInfo_t.pStoreContext. The
+ * records are lost on reset.
+ *
+ * @param[out] pRamStore The RAM store to initialize.
+ * @param[in] pBuffer Memory that holds the records.
+ * @param[in] bufferSize Size of `pBuffer`.
+ */
+/* @[declare_mqtt_offlineramstoreinit] */
+void IotMqtt_OfflineRamStoreInit( IotMqttOfflineRamStore_t * pRamStore,
+                                  uint8_t * pBuffer,
+                                  size_t bufferSize );
+/* @[declare_mqtt_offlineramstoreinit] */
+
+/**
+ * @brief An #IotMqttOfflineStore_t that keeps records in a RAM ring buffer.
+ *
+ * Its context is an #IotMqttOfflineRamStore_t.
+ */
+extern const IotMqttOfflineStore_t IotMqttOfflineStoreRam;
+
+/*-------------------- MQTT subscription registry functions -----------------*/
+
+/**
+ * @brief Initialize a subscription registry.
+ *
+ * A subscription registry carries the subscriptions of an MQTT connection to
+ * the next one. Pass it as #IotMqttConnectInfo_t.pSubscriptionRegistry to
+ * every @ref mqtt_function_connect of a device, so that a reconnect restores
+ * all subscriptions with one bulk SUBSCRIBE instead of each library
+ * subscribing again on its own.
+ *
+ * @param[out] pRegistry The registry to initialize.
+ * @param[in] pSubscriptions Array that holds the saved subscriptions.
+ * @param[in] subscriptionLimit Length of `pSubscriptions`.
+ * @param[in] pFilterBuffer Memory that holds the saved topic filters.
+ * @param[in] filterBufferSize Size of `pFilterBuffer`.
+ *
+ * `pSubscriptions` and `pFilterBuffer` must remain valid until @ref
+ * mqtt_function_subscriptionregistrydestroy is called. Subscriptions that do
+ * not fit in either are not saved.
+ *
+ * @return One of the following:
+ * - #IOT_MQTT_SUCCESS
+ * - #IOT_MQTT_BAD_PARAMETER
+ * - #IOT_MQTT_NO_MEMORY if the registry's mutex could not be created.
+ */
+/* @[declare_mqtt_subscriptionregistryinit] */
+IotMqttError_t IotMqtt_SubscriptionRegistryInit( IotMqttSubscriptionRegistry_t * pRegistry,
+                                                 IotMqttSubscription_t * pSubscriptions,
+                                                 size_t subscriptionLimit,
+                                                 char * pFilterBuffer,
+                                                 size_t filterBufferSize );
+/* @[declare_mqtt_subscriptionregistryinit] */
+
+/**
+ * @brief Free the resources of a subscription registry.
+ *
+ * Must be called after @ref mqtt_function_disconnect for every connection
+ * established with this registry.
+ *
+ * @param[in] pRegistry The registry to destroy.
+ */
+/* @[declare_mqtt_subscriptionregistrydestroy] */
+void IotMqtt_SubscriptionRegistryDestroy( IotMqttSubscriptionRegistry_t * pRegistry );
+/* @[declare_mqtt_subscriptionregistrydestroy] */
+
+/**
+ * @brief Forget the subscriptions saved in a registry.
+ *
+ * The next connection established with the registry starts with no
+ * subscriptions. Subscriptions of a connection that is still established are
+ * saved again when that connection is destroyed.
+ *
+ * @param[in] pRegistry The registry to clear.
+ */
+/* @[declare_mqtt_subscriptionregistryclear] */
+void IotMqtt_SubscriptionRegistryClear( IotMqttSubscriptionRegistry_t * pRegistry );
+/* @[declare_mqtt_subscriptionregistryclear] */
+
+/*--------------------------- MQTT trace functions --------------------------*/
+
+/**
+ * @brief Set the function that receives PUBLISH trace records.
+ *
+ * When @ref IOT_MQTT_ENABLE_TRACE is `1`, every client-to-server PUBLISH
+ * reports each stage it reaches, from @ref mqtt_function_publish to its
+ * completion, as an #IotMqttTraceRecord_t. The timestamps of the records of
+ * one operation give its latency breakdown. When @ref IOT_MQTT_ENABLE_TRACE
+ * is `0`, no trace points are compiled and the sink is never called.
+ *
+ * The sink is replaced atomically, so it may be changed while PUBLISH
+ * operations are in progress. A trace point that started before the change
+ * may still call the previous sink, so the previous #IotMqttTraceSinkInfo_t
+ * and its context must remain valid until those operations complete.
+ *
+ * @param[in] pSinkInfo The sink for all MQTT connections; `NULL` to stop
+ * tracing. It must remain valid until it is replaced.
+ */
+/* @[declare_mqtt_settracesink] */
+void IotMqtt_SetTraceSink( const IotMqttTraceSinkInfo_t * pSinkInfo );
+/* @[declare_mqtt_settracesink] */
+
+/**
+ * @brief Initialize a ring buffer of PUBLISH trace records.
+ *
+ * @param[out] pRing The ring to initialize.
+ * @param[in] pRecords Memory that holds the records.
+ * @param[in] recordCount Number of records in `pRecords`. Must be nonzero.
+ */
+/* @[declare_mqtt_traceringinit] */
+void IotMqtt_TraceRingInit( IotMqttTraceRing_t * pRing,
+                            IotMqttTraceRecord_t * pRecords,
+                            uint32_t recordCount );
+/* @[declare_mqtt_traceringinit] */
+
+/**
+ * @brief An #IotMqttTraceSink_t that stores records in an #IotMqttTraceRing_t.
+ *
+ * Pass it to @ref mqtt_function_settracesink with an initialized ring as the
+ * sink context. It may be called from several threads at once.
+ *
+ * @param[in] pSinkContext The #IotMqttTraceRing_t.
+ * @param[in] pRecord The record to store.
+ */
+/* @[declare_mqtt_traceringsink] */
+void IotMqtt_TraceRingSink( void * pSinkContext,
+                            const IotMqttTraceRecord_t * pRecord );
+/* @[declare_mqtt_traceringsink] */
+
+/**
+ * @brief Print the records of an #IotMqttTraceRing_t, oldest first.
+ *
+ * Each record is printed as one line with the time since the previous record
+ * of the same operation, so that a PUBLISH reads as a latency breakdown. This
+ * function is meant for a command line or debug console; tracing should be
+ * stopped while it runs.
+ *
+ * @param[in] pRing The ring to print.
+ * @param[in] print Called with `pPrintContext` and each line of output.
+ * @param[in] pPrintContext Passed to `print`.
+ *
+ * @return The number of records printed.
+ */
+/* @[declare_mqtt_traceringdump] */
+uint32_t IotMqtt_TraceRingDump( const IotMqttTraceRing_t * pRing,
+                                void ( * print )( void * pPrintContext,
+                                                  const char * pLine ),
+                                void * pPrintContext );
+/* @[declare_mqtt_traceringdump] */
+
+/**
+ * @brief Returns a string that describes an #IotMqttTraceEvent_t.
+ *
+ * @param[in] event The trace event to describe.
+ *
+ * @return A read-only string that describes `event`.
+ *
+ * @warning The string returned by this function must never be modified.
+ */
+/* @[declare_mqtt_traceeventname] */
+const char * IotMqtt_TraceEventName( IotMqttTraceEvent_t event );
+/* @[declare_mqtt_traceeventname] */
+
 /*-------------------------- MQTT helper functions --------------------------*/
 
 /**
@@ -92,6 +92,20 @@ typedef struct _mqttConnection   * IotMqttConnection_t;
  */
 typedef struct _mqttOperation    * IotMqttOperation_t;
 
+/**
+ * @ingroup mqtt_datatypes_handles
+ * @brief Opaque handle that references a received PUBLISH message.
+ *
+ * Passed to subscription callbacks as #IotMqttCallbackParam_t.u.message.reference.
+ * A message is freed when its subscription callbacks return, unless it is kept
+ * with @ref mqtt_function_retainmessage. A retained message, including its topic
+ * name and payload, stays valid until it is released with
+ * @ref mqtt_function_releasemessage.
+ *
+ * @see @ref mqtt_function_retainmessage and @ref mqtt_function_releasemessage.
+ */
+typedef struct _mqttOperation    * IotMqttMessage_t;
+
 /*-------------------------- MQTT enumerated types --------------------------*/
 
 /**
@@ -255,7 +269,21 @@ typedef enum IotMqttError
      * May also be the value of an operation completion callback's
      * #IotMqttCallbackParam_t.result for a QoS 1 PUBLISH.
      */
-    IOT_MQTT_RETRY_NO_RESPONSE
+    IOT_MQTT_RETRY_NO_RESPONSE,
+
+    /**
+     * @brief A QoS 1 PUBLISH was not sent because too many QoS 1 PUBLISH
+     * messages are awaiting PUBACK.
+     *
+     * The limit is set by #IotMqttConnectInfo_t.maxInflightPublishes. Nothing
+     * was allocated or sent; the PUBLISH may be tried again once an earlier
+     * QoS 1 PUBLISH completes.
+     *
+     * Functions that may return this value:
+     * - @ref mqtt_function_publish
+     * - @ref mqtt_function_timedpublish
+     */
+    IOT_MQTT_WOULD_BLOCK
 } IotMqttError_t;
 
 /**
@@ -312,9 +340,31 @@ typedef enum IotMqttDisconnectReason
 {
     IOT_MQTT_DISCONNECT_CALLED,   /**< @ref mqtt_function_disconnect was invoked. */
     IOT_MQTT_BAD_PACKET_RECEIVED, /**< An invalid packet was received from the network. */
-    IOT_MQTT_KEEP_ALIVE_TIMEOUT   /**< Keep-alive response was not received within @ref IOT_MQTT_RESPONSE_WAIT_MS. */
+    IOT_MQTT_KEEP_ALIVE_TIMEOUT,  /**< Keep-alive response was not received within @ref IOT_MQTT_RESPONSE_WAIT_MS. */
+    IOT_MQTT_SEND_FAILED          /**< PUBLISH packets held back for coalescing could not be sent. */
 } IotMqttDisconnectReason_t;
 
+/**
+ * @ingroup mqtt_datatypes_enums
+ * @brief Stages of a client-to-server PUBLISH that are traced.
+ *
+ * The trace points are only compiled when @ref IOT_MQTT_ENABLE_TRACE is `1`.
+ * The function @ref mqtt_function_traceeventname can be used to get a trace
+ * event's description.
+ */
+typedef enum IotMqttTraceEvent
+{
+    IOT_MQTT_TRACE_PUBLISH_CREATED = 0, /**< The PUBLISH operation was created by @ref mqtt_function_publish. */
+    IOT_MQTT_TRACE_PUBLISH_LOCKED,      /**< The connection was locked to send the PUBLISH. */
+    IOT_MQTT_TRACE_PUBLISH_SERIALIZED,  /**< The PUBLISH header was serialized. */
+    IOT_MQTT_TRACE_PUBLISH_SENT,        /**< The PUBLISH was passed to the network. Not recorded for a coalesced QoS 0 PUBLISH. */
+    IOT_MQTT_TRACE_RETRY_SCHEDULED,     /**< A QoS 1 PUBLISH retransmission was scheduled. */
+    IOT_MQTT_TRACE_RETRY_SENT,          /**< A QoS 1 PUBLISH was retransmitted. */
+    IOT_MQTT_TRACE_PUBACK_RECEIVED,     /**< The PUBACK of a QoS 1 PUBLISH was received. */
+    IOT_MQTT_TRACE_NOTIFIED,            /**< The PUBLISH completed and its waiter or callback was notified. */
+    IOT_MQTT_TRACE_CALLBACK             /**< The completion callback of the PUBLISH is about to be invoked. */
+} IotMqttTraceEvent_t;
+
 /*------------------------- MQTT parameter structs --------------------------*/
 
 /**
@@ -346,10 +396,17 @@ typedef enum IotMqttDisconnectReason
  * Retransmission follows a truncated exponential backoff strategy. The constant
  * @ref IOT_MQTT_RETRY_MS_CEILING controls the maximum time between retransmissions.
  *
+ * Once the connection has measured round-trip times, the first retransmission
+ * waits for the retransmission timeout computed from them instead of
+ * #IotMqttPublishInfo_t.retryMs. This timeout is the smoothed round-trip time
+ * plus four times its variation, bounded by @ref IOT_MQTT_RETRY_MS_FLOOR and
+ * @ref IOT_MQTT_RETRY_MS_CEILING.
+ *
  * After #IotMqttPublishInfo_t.retryLimit retransmissions are sent, the MQTT
- * library will wait @ref IOT_MQTT_RESPONSE_WAIT_MS before a final check
- * for a PUBACK. If no PUBACK was received within this time, the QoS 1 PUBLISH
- * fails with the code #IOT_MQTT_RETRY_NO_RESPONSE.
+ * library will wait @ref IOT_MQTT_RESPONSE_WAIT_MS, or the retransmission
+ * timeout once it is measured, before a final check for a PUBACK. If no PUBACK
+ * was received within this time, the QoS 1 PUBLISH fails with the code
+ * #IOT_MQTT_RETRY_NO_RESPONSE.
  *
  * @note The lengths of the strings in this struct should not include the NULL
  * terminator. Strings in this struct do not need to be NULL-terminated.
@@ -427,7 +484,8 @@ typedef struct IotMqttPublishInfo
  * @attention Any pointers in this callback parameter may be freed as soon as
  * the [callback function](@ref IotMqttCallbackInfo_t.function) returns.
  * Therefore, data must be copied if it is needed after the callback function
- * returns.
+ * returns. The topic name and payload of an incoming PUBLISH may instead be
+ * kept without copying by retaining the message with @ref mqtt_function_retainmessage.
  * @attention The MQTT library may set strings that are not NULL-terminated.
  *
  * @see #IotMqttCallbackInfo_t for the signature of a callback function.
@@ -462,6 +520,7 @@ typedef struct IotMqttCallbackParam
             const char * pTopicFilter;  /**< @brief Topic filter that matched the message. */
             uint16_t topicFilterLength; /**< @brief Length of `pTopicFilter`. */
             IotMqttPublishInfo_t info;  /**< @brief PUBLISH message received from the server. */
+            IotMqttMessage_t reference; /**< @brief Reference to the received message, which may be retained. */
         } message;
 
         /* Valid when a connection is disconnected. */
@@ -558,6 +617,192 @@ typedef struct IotMqttSubscription
     IotMqttCallbackInfo_t callback;
 } IotMqttSubscription_t;
 
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Storage backend of an offline PUBLISH queue.
+ *
+ * The offline queue encodes each PUBLISH as one record, a byte string that
+ * holds the topic name, payload, QoS, and retain flag. A backend stores these
+ * records in first-in, first-out order; it does not need to understand them.
+ * Records may be kept in RAM (see #IotMqttOfflineStoreRam), in a file, or in
+ * a flash region, so that they survive as long as the backend does.
+ *
+ * The offline queue serializes all calls to a backend, so backend functions
+ * do not need to be thread-safe.
+ */
+typedef struct IotMqttOfflineStore
+{
+    /**
+     * @brief Append a record to the store.
+     *
+     * @param[in] pStoreContext The #IotMqttOfflineQueueInfo_t.pStoreContext of the queue.
+     * @param[in] pRecord The record to append.
+     * @param[in] recordLength Length of `pRecord`.
+     *
+     * @return `true` if the record was stored; `false` if the store is full.
+     */
+    bool ( * push )( void * pStoreContext,
+                     const uint8_t * pRecord,
+                     size_t recordLength );
+
+    /**
+     * @brief Read a record in the store without removing it.
+     *
+     * @param[in] pStoreContext The #IotMqttOfflineQueueInfo_t.pStoreContext of the queue.
+     * @param[in] index Position of the record; 0 is the oldest record, 1 the
+     * record after it, and so on. The queue reads at most
+     * #IotMqttOfflineQueueInfo_t.drainBatch records past the oldest one.
+     * @param[out] pBuffer Where to copy the record.
+     * @param[in] bufferSize Size of `pBuffer`. The record is only copied if it
+     * fits; pass 0 to only check if the record exists.
+     *
+     * @return Length of the record; 0 if the store holds `index` records or fewer.
+     */
+    size_t ( * peek )( void * pStoreContext,
+                       size_t index,
+                       uint8_t * pBuffer,
+                       size_t bufferSize );
+
+    /**
+     * @brief Remove the oldest record from the store.
+     *
+     * @param[in] pStoreContext The #IotMqttOfflineQueueInfo_t.pStoreContext of the queue.
+     */
+    void ( * pop )( void * pStoreContext );
+} IotMqttOfflineStore_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Context of #IotMqttOfflineStoreRam, a ring of records in a RAM buffer.
+ *
+ * Initialize with @ref mqtt_function_offlineramstoreinit. Each record takes its
+ * length plus 4 bytes of the buffer.
+ *
+ * @warning The members of this struct should not be used directly.
+ */
+typedef struct IotMqttOfflineRamStore
+{
+    uint8_t * pBuffer; /**< @brief Memory that holds the records. */
+    size_t bufferSize; /**< @brief Size of #IotMqttOfflineRamStore_t.pBuffer. */
+    size_t head;       /**< @brief Offset of the oldest record. */
+    size_t usedBytes;  /**< @brief Bytes taken by records. */
+} IotMqttOfflineRamStore_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Parameters of an offline PUBLISH queue.
+ *
+ * @paramfor @ref mqtt_function_offlinequeueinit
+ *
+ * @initializer{IotMqttOfflineQueueInfo_t,IOT_MQTT_OFFLINE_QUEUE_INFO_INITIALIZER}
+ */
+typedef struct IotMqttOfflineQueueInfo
+{
+    const IotMqttOfflineStore_t * pStore; /**< @brief Backend that stores the queued PUBLISH messages. */
+    void * pStoreContext;                 /**< @brief Passed to the functions of #IotMqttOfflineQueueInfo_t.pStore. */
+
+    /**
+     * @brief Buffer that holds one record while it is stored or forwarded.
+     *
+     * A PUBLISH whose topic name and payload do not fit in this buffer with 7
+     * bytes of record header cannot be queued.
+     */
+    uint8_t * pRecordBuffer;
+    size_t recordBufferSize; /**< @brief Size of #IotMqttOfflineQueueInfo_t.pRecordBuffer. */
+
+    /**
+     * @brief How many queued PUBLISH messages to forward at once after a
+     * connection is established. Must be between 1 and 32.
+     *
+     * This is also how many of the oldest stored messages may be sent but not
+     * yet removed from the store. A stored QoS 1 message stays in the store
+     * until its PUBACK arrives, and so does every message stored after it, so
+     * this many QoS 1 messages may wait for their PUBACK at once.
+     */
+    uint32_t drainBatch;
+
+    /**
+     * @brief Delay, in milliseconds, between forwarding two batches of
+     * queued PUBLISH messages.
+     *
+     * The queue drains at most #IotMqttOfflineQueueInfo_t.drainBatch messages
+     * every this many milliseconds, so that a backlog does not flood the new
+     * connection.
+     */
+    uint32_t drainIntervalMs;
+
+    /**
+     * @brief Retransmission of stored QoS 1 messages, as
+     * #IotMqttPublishInfo_t.retryMs and #IotMqttPublishInfo_t.retryLimit.
+     *
+     * Retransmissions set the DUP flag. A stored QoS 1 message leaves the
+     * store only once its PUBACK arrives; if the retransmissions go
+     * unacknowledged or the connection is lost, it is sent again later.
+     */
+    uint32_t retryMs;
+    uint32_t retryLimit; /**< @brief See #IotMqttOfflineQueueInfo_t.retryMs. */
+} IotMqttOfflineQueueInfo_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Statistics of an offline PUBLISH queue.
+ *
+ * Returned by @ref mqtt_function_offlinequeuegetstats.
+ */
+typedef struct IotMqttOfflineQueueStats
+{
+    uint32_t storedCount;    /**< @brief PUBLISH messages stored because no connection could send them. */
+    uint32_t forwardedCount; /**< @brief PUBLISH messages sent, either right away or from the store. A stored QoS 1 message counts once acknowledged. */
+    uint32_t droppedCount;   /**< @brief PUBLISH messages lost because the store was full or held an unreadable record. */
+} IotMqttOfflineQueueStats_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief An offline PUBLISH queue.
+ *
+ * Holds PUBLISH messages while no MQTT connection can send them, and forwards
+ * them once a connection established with #IotMqttConnectInfo_t.pOfflineQueue
+ * is available. Initialize with @ref mqtt_function_offlinequeueinit.
+ *
+ * @warning The members of this struct should not be used directly.
+ */
+typedef struct IotMqttOfflineQueue
+{
+    IotMutex_t mutex;                 /**< @brief Guards the members of this queue and its store. */
+    IotMqttOfflineQueueInfo_t info;   /**< @brief Parameters of this queue. */
+    IotMqttConnection_t connection;   /**< @brief The connection that forwards this queue; `NULL` if none. */
+    IotMqttConnection_t sending;      /**< @brief The connection waiting for the PUBACK of stored messages; `NULL` if none. */
+    uint32_t pendingRecords;          /**< @brief Bit `i` is set while the `i`-th oldest stored message waits for its PUBACK. */
+    uint32_t sentRecords;             /**< @brief Bit `i` is set once the `i`-th oldest stored message was sent, or acknowledged if QoS 1. */
+    uint32_t headSequence;            /**< @brief Sequence number of the oldest stored message; identifies the PUBACKs of stored messages. */
+    uint32_t users;                   /**< @brief Connections established with this queue that are not destroyed. */
+    IotMqttOfflineQueueStats_t stats; /**< @brief Statistics of this queue. */
+} IotMqttOfflineQueue_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief A registry of subscriptions carried from one MQTT connection to the next.
+ *
+ * When a connection established with #IotMqttConnectInfo_t.pSubscriptionRegistry
+ * is destroyed, its active subscriptions are saved in the registry. The next
+ * connection established with the registry restores them right after its
+ * CONNACK: with one bulk SUBSCRIBE if the server has no session, or locally if
+ * the server reports that the session is present. Initialize with @ref
+ * mqtt_function_subscriptionregistryinit.
+ *
+ * @warning The members of this struct should not be used directly.
+ */
+typedef struct IotMqttSubscriptionRegistry
+{
+    IotMutex_t mutex;                       /**< @brief Guards the members of this registry. */
+    IotMqttConnection_t connection;         /**< @brief The connection whose subscriptions are saved when it is destroyed; `NULL` if none. */
+    IotMqttSubscription_t * pSubscriptions; /**< @brief Saved subscriptions. */
+    size_t subscriptionLimit;               /**< @brief Length of #IotMqttSubscriptionRegistry_t.pSubscriptions. */
+    size_t subscriptionCount;               /**< @brief Subscriptions currently saved. */
+    char * pFilterBuffer;                   /**< @brief Memory that holds the saved topic filters. */
+    size_t filterBufferSize;                /**< @brief Size of #IotMqttSubscriptionRegistry_t.pFilterBuffer. */
+} IotMqttSubscriptionRegistry_t;
+
 /**
  * @ingroup mqtt_datatypes_paramstructs
  * @brief Information on a new MQTT connection.
@@ -673,8 +918,216 @@ typedef struct IotMqttConnectInfo
     uint16_t userNameLength; /**< @brief Length of #IotMqttConnectInfo_t.pUserName. */
     const char * pPassword;  /**< @brief Password for MQTT connection. */
     uint16_t passwordLength; /**< @brief Length of #IotMqttConnectInfo_t.pPassword. */
+
+    /**
+     * @brief The most bytes of outgoing PUBLISH packets to hold back and send
+     * together in one network send.
+     *
+     * When this is nonzero, PUBLISH packets are copied into a buffer of this
+     * size instead of being sent right away. The buffer is sent when it is full,
+     * when #IotMqttConnectInfo_t.coalesceDelayMs has passed since the first
+     * packet was held back, or before any other MQTT packet is sent. A PUBLISH
+     * that does not fit in an empty buffer is sent on its own.
+     *
+     * Set this to 0 to send every PUBLISH right away.
+     *
+     * @note A held back PUBLISH is reported as sent by @ref mqtt_function_publish.
+     * If the network send fails later, a QoS 0 PUBLISH is lost and a QoS 1
+     * PUBLISH receives no PUBACK.
+     */
+    uint32_t coalesceMaxBytes;
+
+    /**
+     * @brief The longest time, in milliseconds, that a PUBLISH may be held back.
+     *
+     * Ignored if #IotMqttConnectInfo_t.coalesceMaxBytes is 0.
+     */
+    uint32_t coalesceDelayMs;
+
+    /**
+     * @brief Size of a buffer that incoming data is read into before MQTT
+     * packets are framed out of it.
+     *
+     * When this is nonzero and the network interface provides `receiveUpto`,
+     * each time data arrives the MQTT library reads as much as fits in this
+     * buffer with one network receive, then processes every MQTT packet in it.
+     * This replaces the separate network receives for each byte of the fixed
+     * header and for the rest of every packet. Packets larger than the buffer
+     * are still received correctly.
+     *
+     * Set this to 0 to receive each MQTT packet directly from the network.
+     *
+     * @note PUBLISH packets are copied out of this buffer, so they are never
+     * lent in place by the network interface's `receiveBuffer`.
+     */
+    uint32_t receiveBufferSize;
+
+    /**
+     * @brief The most QoS 1 PUBLISH messages that may await PUBACK at once.
+     *
+     * While this many QoS 1 PUBLISH messages are outstanding, @ref
+     * mqtt_function_publish returns #IOT_MQTT_WOULD_BLOCK instead of allocating
+     * another operation. A PUBLISH leaves the window when its PUBACK arrives or
+     * when its operation is destroyed, whichever comes first.
+     *
+     * Set this to 0 for no limit other than the PUBLISH state records of the
+     * MQTT library, which also cause #IOT_MQTT_WOULD_BLOCK when exhausted.
+     */
+    uint16_t maxInflightPublishes;
+
+    /**
+     * @brief An offline PUBLISH queue to forward on this connection.
+     *
+     * Once the connection is established, messages stored in the queue are
+     * forwarded at the rate set by its #IotMqttOfflineQueueInfo_t, and @ref
+     * mqtt_function_offlinepublish sends through this connection. Set to
+     * `NULL` if not needed.
+     *
+     * A queue is forwarded by one connection at a time.
+     */
+    IotMqttOfflineQueue_t * pOfflineQueue;
+
+    /**
+     * @brief A subscription registry to restore on this connection.
+     *
+     * Subscriptions saved in the registry by a previous connection are
+     * restored right after the CONNACK, before @ref mqtt_function_connect
+     * returns. When the connection is destroyed, its active subscriptions
+     * replace those in the registry. Set to `NULL` if not needed.
+     *
+     * @note When the server reports that a session is present, the saved
+     * subscriptions are restored without sending a SUBSCRIBE.
+     */
+    IotMqttSubscriptionRegistry_t * pSubscriptionRegistry;
 } IotMqttConnectInfo_t;
 
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Statistics of the PUBLISH packets sent through the coalescing buffer of
+ * an MQTT connection.
+ *
+ * Returned by @ref mqtt_function_getcoalescestats for connections established
+ * with a nonzero #IotMqttConnectInfo_t.coalesceMaxBytes. The average number of
+ * bytes per send is `byteCount / sendCount`, and the number of network sends
+ * saved by coalescing is `packetCount - sendCount`.
+ */
+typedef struct IotMqttCoalesceStats
+{
+    uint32_t packetCount; /**< @brief PUBLISH packets sent. */
+    uint32_t sendCount;   /**< @brief Network sends used to send them. */
+    uint64_t byteCount;   /**< @brief Bytes sent. */
+    uint32_t largestSend; /**< @brief Most bytes sent in one network send. */
+} IotMqttCoalesceStats_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Round-trip time statistics of an MQTT connection.
+ *
+ * Returned by @ref mqtt_function_getrttstats. Round trips are measured from
+ * sending a QoS 1 PUBLISH, SUBSCRIBE, or UNSUBSCRIBE to receiving its
+ * acknowledgement. Packets that were retransmitted are not measured.
+ *
+ * The smoothed round-trip time and its variation are estimated like the TCP
+ * retransmission timer. The retransmission timeout derived from them is how
+ * long the connection waits for a server response; see
+ * #IotMqttPublishInfo_t.retryMs.
+ */
+typedef struct IotMqttRttStats
+{
+    uint32_t sampleCount;         /**< @brief Round trips measured. */
+    uint32_t lastRttMs;           /**< @brief Most recent round-trip time. */
+    uint32_t minRttMs;            /**< @brief Shortest round-trip time. */
+    uint32_t maxRttMs;            /**< @brief Longest round-trip time. */
+    uint32_t smoothedRttMs;       /**< @brief Smoothed round-trip time. */
+    uint32_t rttVariationMs;      /**< @brief Variation of the round-trip time. */
+    uint32_t retransmitTimeoutMs; /**< @brief Current wait for a server response. */
+} IotMqttRttStats_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Statistics of the operation records reused by an MQTT connection.
+ *
+ * Returned by @ref mqtt_function_getoperationpoolstats. Each connection keeps
+ * `MQTT_OPERATION_POOL_SIZE` operation records for reuse; an operation that
+ * finds none free is allocated. Every operation record also has room for one
+ * small packet, such as the copy of a PUBLISH kept for retransmission; a packet
+ * that does not fit is allocated.
+ */
+typedef struct IotMqttOperationPoolStats
+{
+    uint32_t operationHits;   /**< @brief Operations that reused a record of the pool. */
+    uint32_t operationMisses; /**< @brief Operations that were allocated. */
+    uint32_t packetHits;      /**< @brief Packets placed in the room of their operation record. */
+    uint32_t packetMisses;    /**< @brief Packets that were allocated. */
+    uint32_t inUse;           /**< @brief Records of the pool currently in use. */
+    uint32_t maxInUse;        /**< @brief Most records of the pool in use at once. */
+} IotMqttOperationPoolStats_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief One trace point of a client-to-server PUBLISH.
+ *
+ * Passed to the #IotMqttTraceSink_t set with @ref mqtt_function_settracesink.
+ *
+ * @note Operation records may be reused once an operation is destroyed, so
+ * #IotMqttTraceRecord_t.operation does not identify an operation by itself.
+ * An #IOT_MQTT_TRACE_PUBLISH_CREATED record starts a new operation.
+ */
+typedef struct IotMqttTraceRecord
+{
+    uint64_t timestamp;                 /**< @brief Time of the event; see @ref IOT_MQTT_TRACE_TIMESTAMP. */
+    IotMqttConnection_t mqttConnection; /**< @brief The connection of the PUBLISH. */
+    IotMqttOperation_t operation;       /**< @brief The PUBLISH operation. */
+    uint16_t packetIdentifier;          /**< @brief Packet identifier of the PUBLISH; 0 for QoS 0. */
+    IotMqttTraceEvent_t event;          /**< @brief Stage of the PUBLISH. */
+} IotMqttTraceRecord_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Function that receives PUBLISH trace records.
+ *
+ * A sink is called from the thread that reached the trace point, often with
+ * the connection locked; it must not block or call MQTT functions. A sink may
+ * store the record (see #IotMqttTraceRing_t) or forward it to a tracing tool,
+ * for example as a Tracealyzer user event.
+ *
+ * @param[in] pSinkContext The #IotMqttTraceSinkInfo_t.pSinkContext of the sink.
+ * @param[in] pRecord The trace record. Only valid for the duration of the call.
+ */
+typedef void ( * IotMqttTraceSink_t )( void * pSinkContext,
+                                       const IotMqttTraceRecord_t * pRecord );
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief A trace sink and its context.
+ *
+ * Passed to @ref mqtt_function_settracesink. The sink and its context are
+ * installed together, so a trace point never sees one without the other.
+ */
+typedef struct IotMqttTraceSinkInfo
+{
+    IotMqttTraceSink_t sink; /**< @brief The function that receives trace records. */
+    void * pSinkContext;     /**< @brief Passed to #IotMqttTraceSinkInfo_t.sink. */
+} IotMqttTraceSinkInfo_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief A ring buffer of PUBLISH trace records.
+ *
+ * Initialize with @ref mqtt_function_traceringinit and pass to
+ * @ref mqtt_function_settracesink with @ref mqtt_function_traceringsink. Once
+ * full, the ring overwrites its oldest records. Print its contents with
+ * @ref mqtt_function_traceringdump.
+ *
+ * @warning The members of this struct should not be used directly.
+ */
+typedef struct IotMqttTraceRing
+{
+    IotMqttTraceRecord_t * pRecords; /**< @brief Memory that holds the records. */
+    uint32_t recordCount;            /**< @brief Number of records in #IotMqttTraceRing_t.pRecords. */
+    uint32_t writeCount;             /**< @brief Records written since the ring was initialized. */
+} IotMqttTraceRing_t;
+
 #if IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1
 
 /**
@@ -1046,21 +1499,23 @@ typedef struct IotMqttNetworkInfo
 
 /* @[define_mqtt_initializers] */
 /** @brief Initializer for #IotMqttNetworkInfo_t. */
-#define IOT_MQTT_NETWORK_INFO_INITIALIZER     { .createNetworkConnection = true }
+#define IOT_MQTT_NETWORK_INFO_INITIALIZER          { .createNetworkConnection = true }
 /** @brief Initializer for #IotMqttSerializer_t. */
-#define IOT_MQTT_SERIALIZER_INITIALIZER       { 0 }
+#define IOT_MQTT_SERIALIZER_INITIALIZER            { 0 }
 /** @brief Initializer for #IotMqttConnectInfo_t. */
-#define IOT_MQTT_CONNECT_INFO_INITIALIZER     { .cleanSession = true }
+#define IOT_MQTT_CONNECT_INFO_INITIALIZER          { .cleanSession = true }
 /** @brief Initializer for #IotMqttPublishInfo_t. */
-#define IOT_MQTT_PUBLISH_INFO_INITIALIZER     { .qos = IOT_MQTT_QOS_0 }
+#define IOT_MQTT_PUBLISH_INFO_INITIALIZER          { .qos = IOT_MQTT_QOS_0 }
 /** @brief Initializer for #IotMqttSubscription_t. */
-#define IOT_MQTT_SUBSCRIPTION_INITIALIZER     { .qos = IOT_MQTT_QOS_0 }
+#define IOT_MQTT_SUBSCRIPTION_INITIALIZER          { .qos = IOT_MQTT_QOS_0 }
 /** @brief Initializer for #IotMqttCallbackInfo_t. */
-#define IOT_MQTT_CALLBACK_INFO_INITIALIZER    { 0 }
+#define IOT_MQTT_CALLBACK_INFO_INITIALIZER         { 0 }
 /** @brief Initializer for #IotMqttConnection_t. */
-#define IOT_MQTT_CONNECTION_INITIALIZER       NULL
+#define IOT_MQTT_CONNECTION_INITIALIZER            NULL
 /** @brief Initializer for #IotMqttOperation_t. */
-#define IOT_MQTT_OPERATION_INITIALIZER        NULL
+#define IOT_MQTT_OPERATION_INITIALIZER             NULL
+/** @brief Initializer for #IotMqttOfflineQueueInfo_t. */
+#define IOT_MQTT_OFFLINE_QUEUE_INFO_INITIALIZER    { .drainBatch = 1 }
 /* @[define_mqtt_initializers] */
 
 /**
@@ -63,6 +63,15 @@
 #if IOT_MQTT_RETRY_MS_CEILING <= 0
     #error "IOT_MQTT_RETRY_MS_CEILING cannot be 0 or negative."
 #endif
+#if IOT_MQTT_RETRY_MS_FLOOR <= 0 || IOT_MQTT_RETRY_MS_FLOOR > IOT_MQTT_RETRY_MS_CEILING
+    #error "IOT_MQTT_RETRY_MS_FLOOR must be positive and at most IOT_MQTT_RETRY_MS_CEILING."
+#endif
+
+/**
+ * @brief Bytes of a SUBSCRIBE packet besides its topic filters: the largest
+ * fixed header and the packet identifier.
+ */
+#define SUBSCRIBE_PACKET_OVERHEAD    ( 7U )
 
 /**
  * @brief Fixed Size Array to hold Mapping of MQTT Connection used in MQTT 201906.00 library to MQTT Context
@@ -158,6 +167,23 @@ static IotMqttError_t _subscriptionCommon( IotMqttOperationType_t operation,
                                            const IotMqttCallbackInfo_t * pCallbackInfo,
                                            IotMqttOperation_t * pOperationReference );
 
+/**
+ * @brief Find how many subscriptions at the start of a list fit in one
+ * SUBSCRIBE packet.
+ *
+ * A SUBSCRIBE packet is serialized into the network buffer of its connection's
+ * MQTT context, and AWS IoT limits the topic filters of a SUBSCRIBE packet.
+ *
+ * @param[in] awsIotMqttMode Whether the connection is to AWS IoT.
+ * @param[in] pSubscriptionList The subscriptions left to send.
+ * @param[in] subscriptionCount The number of subscriptions in `pSubscriptionList`.
+ *
+ * @return The number of subscriptions for the next SUBSCRIBE packet; at least 1.
+ */
+static size_t _subscribeBatchCount( bool awsIotMqttMode,
+                                    const IotMqttSubscription_t * pSubscriptionList,
+                                    size_t subscriptionCount );
+
 /**
  * @brief The time interface provided to the MQTT context used in calling MQTT LTS APIs.
  *
@@ -385,6 +411,11 @@ static bool _createKeepAliveJob( const IotMqttNetworkInfo_t * pNetworkInfo,
             EMPTY_ELSE_MARKER;
         }
 
+        /* Keep-alive must not wait behind bulk work in the task pool. */
+        jobStatus = IotTaskPool_SetJobClass( pMqttConnection->keepAliveJob,
+                                             IOT_TASKPOOL_JOB_CLASS_CONTROL );
+        IotMqtt_Assert( jobStatus == IOT_TASKPOOL_SUCCESS );
+
         /* Keep-alive references its MQTT connection, so increment reference. */
         ( pMqttConnection->references )++;
     }
@@ -401,6 +432,7 @@ static _mqttConnection_t * _createMqttConnection( bool awsIotMqttMode,
     IOT_FUNCTION_ENTRY( bool, true );
     _mqttConnection_t * pMqttConnection = NULL;
     bool referencesMutexCreated = false;
+    size_t i = 0;
 
     /* Allocate memory for the new MQTT connection. */
     pMqttConnection = IotMqtt_MallocConnection( sizeof( _mqttConnection_t ) );
@@ -422,6 +454,9 @@ static _mqttConnection_t * _createMqttConnection( bool awsIotMqttMode,
 
         /* Start a new MQTT connection with a reference count of 1. */
         pMqttConnection->references = 1;
+
+        /* The MQTT context is assigned later. */
+        pMqttConnection->contextIndex = -1;
     }
 
     /* Create the references mutex for a new connection. It is a recursive mutex. */
@@ -440,7 +475,11 @@ static _mqttConnection_t * _createMqttConnection( bool awsIotMqttMode,
 
     /* Create the new connection's subscription and operation lists. */
     IotListDouble_Create( &( pMqttConnection->pendingProcessing ) );
-    IotListDouble_Create( &( pMqttConnection->pendingResponse ) );
+
+    for( i = 0; i < MQTT_PENDING_RESPONSE_BUCKETS; i++ )
+    {
+        IotListDouble_Create( &( pMqttConnection->pendingResponse[ i ] ) );
+    }
 
     /* AWS IoT service limits set minimum and maximum values for keep-alive interval.
      * Adjust the user-provided keep-alive interval based on these requirements. */
@@ -569,12 +608,20 @@ static void _destroyMqttConnection( _mqttConnection_t * pMqttConnection )
 
     if( contextIndex != -1 )
     {
-        /* Remove all subscriptions. */
-        if( IotMutex_Take( &( connToContext[ contextIndex ].subscriptionMutex ) ) == true )
+        /* Remove all subscriptions, saving them first for the next connection
+         * established with this connection's subscription registry. */
+        if( _IotMqtt_LockSubscriptions( contextIndex ) == true )
         {
+            _IotMqtt_SaveSubscriptions( pMqttConnection, contextIndex );
+
             IotMqtt_RemoveAllMatches( ( connToContext[ contextIndex ].subscriptionArray ), NULL );
 
-            mutexStatus = IotMutex_Give( &( connToContext[ contextIndex ].subscriptionMutex ) );
+            /* Every element of the subscription array is free again. */
+            ( void ) memset( &( connToContext[ contextIndex ].subscriptionSlots ),
+                             0x00,
+                             sizeof( _mqttSubscriptionSlots_t ) );
+
+            mutexStatus = _IotMqtt_UnlockSubscriptions( contextIndex );
         }
         else
         {
@@ -606,13 +653,44 @@ static void _destroyMqttConnection( _mqttConnection_t * pMqttConnection )
         EMPTY_ELSE_MARKER;
     }
 
+    /* Stop forwarding an offline queue. */
+    if( pMqttConnection->pOfflineQueue != NULL )
+    {
+        _IotMqtt_DetachOfflineQueue( pMqttConnection );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Free the buffer for coalescing PUBLISH packets. Any packets still held
+     * back can't be sent anymore. */
+    if( pMqttConnection->pCoalesceBuffer != NULL )
+    {
+        IotMqtt_FreeMessage( pMqttConnection->pCoalesceBuffer );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Free the buffer for incoming data. */
+    if( pMqttConnection->receiveBuffer.pBuffer != NULL )
+    {
+        IotMqtt_FreeMessage( pMqttConnection->receiveBuffer.pBuffer );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* Destroy mutexes. */
     IotMutex_Destroy( &( pMqttConnection->referencesMutex ) );
 
     if( contextIndex != -1 )
     {
         IotMutex_Delete( &( connToContext[ contextIndex ].contextMutex ) );
-        IotMutex_Delete( &( connToContext[ contextIndex ].subscriptionMutex ) );
+        _IotMqtt_DeleteSubscriptionLocks( contextIndex );
         /* Lock mutex before updating the #connToContext array. */
         connContextMutexStatus = IotMutex_TakeRecursive( &connContextMutex );
 
@@ -761,10 +839,7 @@ static IotMqttError_t _subscriptionCommon( IotMqttOperationType_t operation,
         IotMqtt_Assert( IotLink_IsLinked( &( pSubscriptionOperation->link ) ) );
 
         /* Transfer to pending response list. */
-        IotListDouble_Remove( &( pSubscriptionOperation->link ) );
-        IotListDouble_InsertHead( &( mqttConnection->pendingResponse ),
-                                  &( pSubscriptionOperation->link ) );
-
+        _IotMqtt_AddPendingResponse( pSubscriptionOperation );
 
         /* Processing operation after sending it on the network. */
         _IotMqtt_ProcessOperation( pSubscriptionOperation );
@@ -815,6 +890,39 @@ static IotMqttError_t _subscriptionCommon( IotMqttOperationType_t operation,
 
 /*-----------------------------------------------------------*/
 
+static size_t _subscribeBatchCount( bool awsIotMqttMode,
+                                    const IotMqttSubscription_t * pSubscriptionList,
+                                    size_t subscriptionCount )
+{
+    size_t batchCount = 0, packetSize = SUBSCRIBE_PACKET_OVERHEAD, filterSize = 0;
+    bool batchFull = false;
+
+    while( ( batchCount < subscriptionCount ) && ( batchFull == false ) )
+    {
+        /* Each topic filter is encoded with its 2 byte length and a QoS byte. */
+        filterSize = ( size_t ) pSubscriptionList[ batchCount ].topicFilterLength + 3U;
+
+        if( ( awsIotMqttMode == true ) &&
+            ( batchCount == AWS_IOT_MQTT_SERVER_MAX_TOPIC_FILTERS_PER_SUBSCRIBE ) )
+        {
+            batchFull = true;
+        }
+        else if( ( batchCount > 0U ) && ( packetSize + filterSize > NETWORK_BUFFER_SIZE ) )
+        {
+            batchFull = true;
+        }
+        else
+        {
+            packetSize += filterSize;
+            batchCount++;
+        }
+    }
+
+    return batchCount;
+}
+
+/*-----------------------------------------------------------*/
+
 bool _IotMqtt_IncrementConnectionReferences( _mqttConnection_t * pMqttConnection )
 {
     bool disconnected = false;
@@ -1146,6 +1254,56 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
         #endif
     }
 
+    /* Allocate the buffer for coalescing PUBLISH packets if requested. */
+    if( pConnectInfo->coalesceMaxBytes > 0 )
+    {
+        newMqttConnection->pCoalesceBuffer = IotMqtt_MallocMessage( pConnectInfo->coalesceMaxBytes );
+
+        if( newMqttConnection->pCoalesceBuffer == NULL )
+        {
+            IotLogError( "Failed to allocate %lu bytes for coalescing PUBLISH packets.",
+                         ( unsigned long ) pConnectInfo->coalesceMaxBytes );
+
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
+        }
+        else
+        {
+            newMqttConnection->coalesceMaxBytes = pConnectInfo->coalesceMaxBytes;
+            newMqttConnection->coalesceDelayMs = pConnectInfo->coalesceDelayMs;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Allocate the buffer for reading incoming data ahead of packet framing if
+     * requested and the network interface can fill it. */
+    if( ( pConnectInfo->receiveBufferSize > 0 ) &&
+        ( newMqttConnection->pNetworkInterface->receiveUpto != NULL ) )
+    {
+        newMqttConnection->receiveBuffer.pBuffer = IotMqtt_MallocMessage( pConnectInfo->receiveBufferSize );
+
+        if( newMqttConnection->receiveBuffer.pBuffer == NULL )
+        {
+            IotLogError( "Failed to allocate %lu bytes for buffering incoming data.",
+                         ( unsigned long ) pConnectInfo->receiveBufferSize );
+
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
+        }
+        else
+        {
+            newMqttConnection->receiveBuffer.bufferSize = pConnectInfo->receiveBufferSize;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Bound the number of QoS 1 PUBLISH operations awaiting PUBACK. */
+    newMqttConnection->inflightMax = pConnectInfo->maxInflightPublishes;
+
     /* Set the MQTT receive callback. */
     networkStatus = newMqttConnection->pNetworkInterface->setReceiveCallback( pNetworkConnection,
                                                                               IotMqtt_ReceiveCallback,
@@ -1196,6 +1354,7 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
     {
         /* Assigning the MQTT Connection. */
         connToContext[ contextIndex ].mqttConnection = newMqttConnection;
+        newMqttConnection->contextIndex = contextIndex;
 
         /* Assigning the Network Context to be used by this MQTT Context. */
         connToContext[ contextIndex ].networkContext.pNetworkConnection = pNetworkConnection;
@@ -1212,8 +1371,7 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
         networkBuffer.pBuffer = &( connToContext[ contextIndex ].buffer[ 0 ] );
         networkBuffer.size = NETWORK_BUFFER_SIZE;
 
-        subscriptionMutexCreated = IotMutex_CreateNonRecursiveMutex( &( connToContext[ contextIndex ].subscriptionMutex ),
-                                                                     &( connToContext[ contextIndex ].subscriptionMutexStorage ) );
+        subscriptionMutexCreated = _IotMqtt_CreateSubscriptionLocks( contextIndex );
 
         if( subscriptionMutexCreated == false )
         {
@@ -1353,6 +1511,19 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
         pOperation = NULL;
     }
 
+    /* Restore the subscriptions of the previous connection before anything else
+     * is sent, so that the connection is ready once this function returns. */
+    if( ( status == IOT_MQTT_SUCCESS ) && ( pConnectInfo->pSubscriptionRegistry != NULL ) )
+    {
+        status = _IotMqtt_RestoreSubscriptions( newMqttConnection,
+                                                pConnectInfo->pSubscriptionRegistry,
+                                                timeoutMs );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* When a connection is successfully established, schedule keep-alive job. */
     if( status == IOT_MQTT_SUCCESS )
     {
@@ -1378,6 +1549,16 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
         {
             EMPTY_ELSE_MARKER;
         }
+
+        /* Start forwarding PUBLISH messages stored while offline. */
+        if( pConnectInfo->pOfflineQueue != NULL )
+        {
+            _IotMqtt_AttachOfflineQueue( newMqttConnection, pConnectInfo->pOfflineQueue );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
     }
     else
     {
@@ -1445,6 +1626,7 @@ void IotMqtt_Disconnect( IotMqttConnection_t mqttConnection,
                          uint32_t flags )
 {
     bool disconnected = false;
+    size_t i = 0;
     IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
     _mqttOperation_t * pOperation = NULL;
 
@@ -1534,9 +1716,12 @@ void IotMqtt_Disconnect( IotMqttConnection_t mqttConnection,
                              _mqttOperation_tryDestroy,
                              offsetof( _mqttOperation_t, link ) );
 
-    IotListDouble_RemoveAll( &( mqttConnection->pendingResponse ),
-                             _mqttOperation_tryDestroy,
-                             offsetof( _mqttOperation_t, link ) );
+    for( i = 0; i < MQTT_PENDING_RESPONSE_BUCKETS; i++ )
+    {
+        IotListDouble_RemoveAll( &( mqttConnection->pendingResponse[ i ] ),
+                                 _mqttOperation_tryDestroy,
+                                 offsetof( _mqttOperation_t, link ) );
+    }
 
     IotMutex_Unlock( &( mqttConnection->referencesMutex ) );
 
@@ -1602,6 +1787,138 @@ IotMqttError_t IotMqtt_TimedSubscribe( IotMqttConnection_t mqttConnection,
 
 /*-----------------------------------------------------------*/
 
+IotMqttError_t IotMqtt_TimedSubscribeBulk( IotMqttConnection_t mqttConnection,
+                                           const IotMqttSubscription_t * pSubscriptionList,
+                                           size_t subscriptionCount,
+                                           uint32_t flags,
+                                           uint32_t timeoutMs )
+{
+    IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
+    IotMqttError_t batchStatus = IOT_MQTT_STATUS_PENDING;
+    IotMqttOperation_t pOperations[ MQTT_BULK_SUBSCRIBE_WINDOW ] = { IOT_MQTT_OPERATION_INITIALIZER };
+    size_t sentCount = 0, batchCount = 0;
+    uint32_t issuedCount = 0, completedCount = 0;
+    uint64_t deadline = 0, now = 0;
+    bool sendMore = false;
+
+    /* Flags are not used, but the parameter is present for future compatibility. */
+    ( void ) flags;
+
+    if( ( mqttConnection == NULL ) || ( pSubscriptionList == NULL ) || ( subscriptionCount == 0U ) )
+    {
+        IotLogError( "Bulk subscription requires a connection and a nonempty subscription list." );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Check every SUBSCRIBE packet before any is sent. */
+    while( sentCount < subscriptionCount )
+    {
+        batchCount = _subscribeBatchCount( mqttConnection->awsIotMqttMode,
+                                           &( pSubscriptionList[ sentCount ] ),
+                                           subscriptionCount - sentCount );
+
+        if( _IotMqtt_ValidateSubscriptionList( IOT_MQTT_SUBSCRIBE,
+                                               mqttConnection->awsIotMqttMode,
+                                               &( pSubscriptionList[ sentCount ] ),
+                                               batchCount ) == false )
+        {
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        sentCount += batchCount;
+    }
+
+    sentCount = 0;
+    deadline = IotClock_GetTimeMs() + timeoutMs;
+    sendMore = true;
+
+    /* Keep up to MQTT_BULK_SUBSCRIBE_WINDOW SUBSCRIBE packets awaiting SUBACK.
+     * Once the window is full or all packets are sent, wait for the oldest. */
+    while( ( sendMore == true ) || ( completedCount < issuedCount ) )
+    {
+        if( ( sendMore == true ) && ( ( issuedCount - completedCount ) < MQTT_BULK_SUBSCRIBE_WINDOW ) )
+        {
+            batchCount = _subscribeBatchCount( mqttConnection->awsIotMqttMode,
+                                               &( pSubscriptionList[ sentCount ] ),
+                                               subscriptionCount - sentCount );
+
+            batchStatus = IotMqtt_Subscribe( mqttConnection,
+                                             &( pSubscriptionList[ sentCount ] ),
+                                             batchCount,
+                                             IOT_MQTT_FLAG_WAITABLE,
+                                             NULL,
+                                             &( pOperations[ issuedCount % MQTT_BULK_SUBSCRIBE_WINDOW ] ) );
+
+            if( batchStatus == IOT_MQTT_STATUS_PENDING )
+            {
+                issuedCount++;
+                sentCount += batchCount;
+            }
+            else
+            {
+                status = batchStatus;
+            }
+        }
+        else
+        {
+            now = IotClock_GetTimeMs();
+
+            batchStatus = IotMqtt_Wait( pOperations[ completedCount % MQTT_BULK_SUBSCRIBE_WINDOW ],
+                                        ( now < deadline ) ? ( uint32_t ) ( deadline - now ) : 0U );
+            completedCount++;
+
+            /* A refused topic filter does not stop the other SUBSCRIBE packets,
+             * but any other failure does. The first failure is returned. */
+            if( batchStatus == IOT_MQTT_SUCCESS )
+            {
+                EMPTY_ELSE_MARKER;
+            }
+            else if( batchStatus == IOT_MQTT_SERVER_REFUSED )
+            {
+                if( status == IOT_MQTT_SUCCESS )
+                {
+                    status = IOT_MQTT_SERVER_REFUSED;
+                }
+                else
+                {
+                    EMPTY_ELSE_MARKER;
+                }
+            }
+            else if( ( status == IOT_MQTT_SUCCESS ) || ( status == IOT_MQTT_SERVER_REFUSED ) )
+            {
+                status = batchStatus;
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+
+        sendMore = ( sentCount < subscriptionCount ) &&
+                   ( ( status == IOT_MQTT_SUCCESS ) || ( status == IOT_MQTT_SERVER_REFUSED ) );
+    }
+
+    IotLogInfo( "(MQTT connection %p) Bulk subscription of %lu topic filters in %lu "
+                "SUBSCRIBE packets complete with result %s.",
+                mqttConnection,
+                ( unsigned long ) sentCount,
+                ( unsigned long ) issuedCount,
+                IotMqtt_strerror( status ) );
+
+    IOT_FUNCTION_EXIT_NO_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
 IotMqttError_t IotMqtt_Unsubscribe( IotMqttConnection_t mqttConnection,
                                     const IotMqttSubscription_t * pSubscriptionList,
                                     size_t subscriptionCount,
@@ -1667,6 +1984,7 @@ IotMqttError_t IotMqtt_Publish( IotMqttConnection_t mqttConnection,
     IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
     _mqttOperation_t * pOperation = NULL;
     uint8_t ** pPacketIdentifierHigh = NULL;
+    bool inflightReserved = false;
 
     /* Check that the PUBLISH information is valid. */
     if( _IotMqtt_ValidatePublish( mqttConnection->awsIotMqttMode,
@@ -1732,6 +2050,26 @@ IotMqttError_t IotMqtt_Publish( IotMqttConnection_t mqttConnection,
         EMPTY_ELSE_MARKER;
     }
 
+    /* A QoS 1 PUBLISH must fit in the in-flight window. Check this before
+     * allocating anything, so that a full window costs no memory. */
+    if( pPublishInfo->qos != IOT_MQTT_QOS_0 )
+    {
+        inflightReserved = _IotMqtt_ReserveInflight( mqttConnection );
+
+        if( inflightReserved == false )
+        {
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_WOULD_BLOCK );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* Create a PUBLISH operation. */
     status = _IotMqtt_CreateOperation( mqttConnection,
                                        flags,
@@ -1747,9 +2085,13 @@ IotMqttError_t IotMqtt_Publish( IotMqttConnection_t mqttConnection,
         EMPTY_ELSE_MARKER;
     }
 
-    /* Check the PUBLISH operation data and set the operation type. */
+    /* Check the PUBLISH operation data and set the operation type. The
+     * operation now owns any slot of the in-flight window. */
     IotMqtt_Assert( pOperation->u.operation.status == IOT_MQTT_STATUS_PENDING );
     pOperation->u.operation.type = IOT_MQTT_PUBLISH_TO_SERVER;
+    pOperation->u.operation.inflight = inflightReserved;
+    inflightReserved = false;
+    IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_PUBLISH_CREATED );
 
     /* In AWS IoT MQTT mode, a pointer to the packet identifier must be saved. */
     if( mqttConnection->awsIotMqttMode == true )
@@ -1848,6 +2190,16 @@ IotMqttError_t IotMqtt_Publish( IotMqttConnection_t mqttConnection,
         {
             EMPTY_ELSE_MARKER;
         }
+
+        /* Return a slot of the in-flight window not yet owned by an operation. */
+        if( inflightReserved == true )
+        {
+            _IotMqtt_ReleaseInflight( mqttConnection );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
     }
     else
     {
@@ -2031,6 +2383,148 @@ IotMqttError_t IotMqtt_Wait( IotMqttOperation_t operation,
 
 /*-----------------------------------------------------------*/
 
+IotMqttError_t IotMqtt_RetainMessage( IotMqttMessage_t message )
+{
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+
+    /* Only incoming PUBLISH messages being processed may be retained. */
+    if( ( message == NULL ) || ( message->incomingPublish == false ) )
+    {
+        IotLogError( "Message reference must be an incoming PUBLISH." );
+
+        status = IOT_MQTT_BAD_PARAMETER;
+    }
+    else if( message->u.publish.references == 0U )
+    {
+        IotLogError( "(MQTT connection %p) Message %p has already been released.",
+                     message->pMqttConnection,
+                     message );
+
+        status = IOT_MQTT_BAD_PARAMETER;
+    }
+    else
+    {
+        ( void ) Atomic_Increment_u32( &( message->u.publish.references ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_ReleaseMessage( IotMqttMessage_t message )
+{
+    if( ( message != NULL ) && ( message->incomingPublish == true ) )
+    {
+        _IotMqtt_ReleaseIncomingPublish( message );
+    }
+    else
+    {
+        IotLogError( "Message reference must be an incoming PUBLISH." );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_GetCoalesceStats( IotMqttConnection_t mqttConnection,
+                                         IotMqttCoalesceStats_t * pStats )
+{
+    IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
+    int8_t contextIndex = -1;
+
+    if( ( mqttConnection == NULL ) || ( pStats == NULL ) )
+    {
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( mqttConnection->pCoalesceBuffer == NULL )
+    {
+        IotLogError( "(MQTT connection %p) Connection does not coalesce PUBLISH packets.",
+                     mqttConnection );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* The statistics are guarded by the mutex of the MQTT context. */
+    contextIndex = _IotMqtt_getContextIndexFromConnection( mqttConnection );
+
+    if( contextIndex < 0 )
+    {
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else if( IotMutex_TakeRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == false )
+    {
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_TIMEOUT );
+    }
+    else
+    {
+        *pStats = mqttConnection->coalesceStats;
+
+        ( void ) IotMutex_GiveRecursive( &( connToContext[ contextIndex ].contextMutex ) );
+    }
+
+    IOT_FUNCTION_EXIT_NO_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_GetRttStats( IotMqttConnection_t mqttConnection,
+                                    IotMqttRttStats_t * pStats )
+{
+    IotMqttError_t status = IOT_MQTT_BAD_PARAMETER;
+
+    if( ( mqttConnection != NULL ) && ( pStats != NULL ) )
+    {
+        /* The estimate is guarded by the references mutex. */
+        IotMutex_Lock( &( mqttConnection->referencesMutex ) );
+        *pStats = mqttConnection->rttStats;
+        pStats->retransmitTimeoutMs = _IotMqtt_ResponseWaitMs( mqttConnection );
+        IotMutex_Unlock( &( mqttConnection->referencesMutex ) );
+
+        status = IOT_MQTT_SUCCESS;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_GetOperationPoolStats( IotMqttConnection_t mqttConnection,
+                                              IotMqttOperationPoolStats_t * pStats )
+{
+    IotMqttError_t status = IOT_MQTT_BAD_PARAMETER;
+
+    if( ( mqttConnection != NULL ) && ( pStats != NULL ) )
+    {
+        /* The pool is guarded by the references mutex. */
+        IotMutex_Lock( &( mqttConnection->referencesMutex ) );
+        *pStats = mqttConnection->operationPoolStats;
+        IotMutex_Unlock( &( mqttConnection->referencesMutex ) );
+
+        status = IOT_MQTT_SUCCESS;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 const char * IotMqtt_strerror( IotMqttError_t status )
 {
     const char * pMessage = NULL;
@@ -2081,6 +2575,10 @@ const char * IotMqtt_strerror( IotMqttError_t status )
             pMessage = "NO RESPONSE";
             break;
 
+        case IOT_MQTT_WOULD_BLOCK:
+            pMessage = "WOULD BLOCK";
+            break;
+
         default:
             pMessage = "INVALID STATUS";
             break;
@@ -78,20 +78,30 @@ int8_t _IotMqtt_getContextIndexFromConnection( IotMqttConnection_t mqttConnectio
 
     IotMqtt_Assert( mqttConnection != NULL );
 
-    /* Getting the index of context from the mapping data structure for the given MQTT Connection. */
-    while( contextIndex < MAX_NO_OF_MQTT_CONNECTIONS )
+    /* Use the index stored in the MQTT Connection if it still refers to this connection. */
+    if( ( mqttConnection->contextIndex >= 0 ) &&
+        ( mqttConnection->contextIndex < MAX_NO_OF_MQTT_CONNECTIONS ) &&
+        ( connToContext[ mqttConnection->contextIndex ].mqttConnection == mqttConnection ) )
+    {
+        contextIndex = mqttConnection->contextIndex;
+    }
+    else
     {
-        if( connToContext[ contextIndex ].mqttConnection == mqttConnection )
+        /* Getting the index of context from the mapping data structure for the given MQTT Connection. */
+        while( contextIndex < MAX_NO_OF_MQTT_CONNECTIONS )
         {
-            break;
-        }
+            if( connToContext[ contextIndex ].mqttConnection == mqttConnection )
+            {
+                break;
+            }
 
-        contextIndex = contextIndex + 1;
-    }
+            contextIndex = contextIndex + 1;
+        }
 
-    if( contextIndex == MAX_NO_OF_MQTT_CONNECTIONS )
-    {
-        contextIndex = -1;
+        if( contextIndex == MAX_NO_OF_MQTT_CONNECTIONS )
+        {
+            contextIndex = -1;
+        }
     }
 
     return contextIndex;
@@ -101,20 +111,16 @@ int8_t _IotMqtt_getContextIndexFromConnection( IotMqttConnection_t mqttConnectio
 
 void _IotMqtt_removeContext( IotMqttConnection_t mqttConnection )
 {
-    int8_t contextIndex = 0;
+    int8_t contextIndex = -1;
 
     IotMqtt_Assert( mqttConnection != NULL );
 
     /* Finding the index corresponding to the given MQTT Connection. */
-    while( contextIndex < MAX_NO_OF_MQTT_CONNECTIONS )
-    {
-        if( connToContext[ contextIndex ].mqttConnection == mqttConnection )
-        {
-            memset( &connToContext[ contextIndex ], 0x00, sizeof( _connContext_t ) );
-            break;
-        }
+    contextIndex = _IotMqtt_getContextIndexFromConnection( mqttConnection );
 
-        contextIndex = contextIndex + 1;
+    if( contextIndex >= 0 )
+    {
+        memset( &connToContext[ contextIndex ], 0x00, sizeof( _connContext_t ) );
     }
 }
 
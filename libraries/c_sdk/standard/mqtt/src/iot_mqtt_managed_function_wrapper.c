@@ -38,6 +38,7 @@
 #include "private/iot_mqtt_internal.h"
 
 /* Platform layer includes. */
+#include "platform/iot_clock.h"
 #include "platform/iot_threads.h"
 
 /* Error handling include. */
@@ -48,12 +49,576 @@ extern _connContext_t connToContext[ MAX_NO_OF_MQTT_CONNECTIONS ];
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Send a PUBLISH packet without copying its payload.
+ *
+ * Only the fixed header, topic name and packet identifier are serialized into
+ * the network buffer of the MQTT context. The payload is sent straight from the
+ * application's buffer in the same vectored send, or held back with other
+ * packets if the connection coalesces PUBLISH packets. A full copy of the packet
+ * is kept in the operation only if the PUBLISH may be retransmitted.
+ *
+ * @param[in] pContext The MQTT context of the connection.
+ * @param[in] pOperation The PUBLISH operation, with its packet identifier set.
+ * @param[in] pPublishInfo The PUBLISH to send.
+ *
+ * @return #IOT_MQTT_SUCCESS, #IOT_MQTT_NO_MEMORY, #IOT_MQTT_NETWORK_ERROR, or
+ * a status converted from the MQTT LTS library.
+ */
+static IotMqttError_t _sendPublish( MQTTContext_t * pContext,
+                                    _mqttOperation_t * pOperation,
+                                    const MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Send the PUBLISH packets held back on an MQTT connection.
+ *
+ * The references mutex of the connection and the mutex of its MQTT context
+ * must be held.
+ *
+ * @param[in] pMqttConnection The MQTT connection.
+ *
+ * @return #IOT_MQTT_SUCCESS or #IOT_MQTT_NETWORK_ERROR. The held back packets
+ * are discarded either way.
+ */
+static IotMqttError_t _flushCoalesced( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Record the send time of the PUBLISH operations whose held back packets
+ * were just sent.
+ *
+ * Only operations awaiting a response are found; a QoS 0 PUBLISH completes
+ * once its packet is held back. The references mutex of the connection must
+ * be held.
+ *
+ * @param[in] pMqttConnection The MQTT connection.
+ */
+static void _stampCoalescedSend( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Task pool routine that sends held back PUBLISH packets once the
+ * coalescing delay of an MQTT connection passes.
+ *
+ * @param[in] pTaskPool Pointer to the system task pool.
+ * @param[in] pFlushJob The job that is executing.
+ * @param[in] pContext The MQTT connection.
+ */
+static void _processCoalesceFlush( IotTaskPool_t pTaskPool,
+                                   IotTaskPoolJob_t pFlushJob,
+                                   void * pContext );
+
+/**
+ * @brief Hold back a serialized PUBLISH packet to be sent with others.
+ *
+ * The references mutex of the connection and the mutex of its MQTT context
+ * must be held.
+ *
+ * @param[in] pMqttConnection The MQTT connection, which coalesces PUBLISH packets.
+ * @param[in] pBuffers The pieces of the PUBLISH packet.
+ * @param[in] bufferCount The number of entries in `pBuffers`.
+ * @param[in] packetSize The combined length of `pBuffers`.
+ * @param[out] pHeldBack Set to `true` if the packet is held back; `false` if
+ * it was sent.
+ *
+ * @return #IOT_MQTT_SUCCESS or #IOT_MQTT_NETWORK_ERROR.
+ */
+static IotMqttError_t _coalescePublish( _mqttConnection_t * pMqttConnection,
+                                        const IotNetworkBuffer_t * pBuffers,
+                                        size_t bufferCount,
+                                        size_t packetSize,
+                                        bool * pHeldBack );
+
+/*-----------------------------------------------------------*/
+
+static IotMqttError_t _flushCoalesced( _mqttConnection_t * pMqttConnection )
+{
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+    size_t bytesSent = 0;
+
+    if( pMqttConnection->coalescedBytes > 0 )
+    {
+        bytesSent = pMqttConnection->pNetworkInterface->send( pMqttConnection->pNetworkConnection,
+                                                              pMqttConnection->pCoalesceBuffer,
+                                                              pMqttConnection->coalescedBytes );
+
+        if( bytesSent == pMqttConnection->coalescedBytes )
+        {
+            _stampCoalescedSend( pMqttConnection );
+
+            pMqttConnection->coalesceStats.packetCount += pMqttConnection->coalescedPackets;
+            pMqttConnection->coalesceStats.sendCount++;
+            pMqttConnection->coalesceStats.byteCount += pMqttConnection->coalescedBytes;
+
+            if( pMqttConnection->coalescedBytes > pMqttConnection->coalesceStats.largestSend )
+            {
+                pMqttConnection->coalesceStats.largestSend = pMqttConnection->coalescedBytes;
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+        else
+        {
+            IotLogError( "(MQTT connection %p) Failed to send %lu coalesced PUBLISH packets.",
+                         pMqttConnection,
+                         ( unsigned long ) pMqttConnection->coalescedPackets );
+
+            status = IOT_MQTT_NETWORK_ERROR;
+        }
+
+        pMqttConnection->coalescedBytes = 0;
+        pMqttConnection->coalescedPackets = 0;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _stampCoalescedSend( _mqttConnection_t * pMqttConnection )
+{
+    size_t i = 0;
+    IotLink_t * pLink = NULL;
+    _mqttOperation_t * pOperation = NULL;
+
+    pMqttConnection->lastMessageTime = IotClock_GetTimeMs();
+
+    for( i = 0; i < MQTT_PENDING_RESPONSE_BUCKETS; i++ )
+    {
+        IotContainers_ForEach( &( pMqttConnection->pendingResponse[ i ] ), pLink )
+        {
+            pOperation = IotLink_Container( _mqttOperation_t, pLink, link );
+
+            if( pOperation->u.operation.coalesced == true )
+            {
+                pOperation->u.operation.coalesced = false;
+                pOperation->u.operation.sendTime = pMqttConnection->lastMessageTime;
+
+                IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_PUBLISH_SENT );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _processCoalesceFlush( IotTaskPool_t pTaskPool,
+                                   IotTaskPoolJob_t pFlushJob,
+                                   void * pContext )
+{
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+    int8_t contextIndex = -1;
+    _mqttConnection_t * pMqttConnection = ( _mqttConnection_t * ) pContext;
+
+    /* Check parameters. The task pool and job parameter is not used when asserts
+     * are disabled. */
+    ( void ) pTaskPool;
+    ( void ) pFlushJob;
+    IotMqtt_Assert( pTaskPool == IOT_SYSTEM_TASKPOOL );
+    IotMqtt_Assert( pFlushJob == pMqttConnection->coalesceJob );
+
+    /* The references mutex is taken before the context mutex, as when a PUBLISH
+     * is sent. It keeps the operations that were held back in their lists while
+     * their send time is recorded. */
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    contextIndex = _IotMqtt_getContextIndexFromConnection( pMqttConnection );
+
+    if( contextIndex >= 0 )
+    {
+        if( IotMutex_TakeRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == true )
+        {
+            pMqttConnection->coalesceFlushScheduled = false;
+
+            /* Packets held back on a closed connection can't be sent anymore. */
+            if( pMqttConnection->disconnected == true )
+            {
+                pMqttConnection->coalescedBytes = 0;
+                pMqttConnection->coalescedPackets = 0;
+            }
+            else
+            {
+                status = _flushCoalesced( pMqttConnection );
+            }
+
+            ( void ) IotMutex_GiveRecursive( &( connToContext[ contextIndex ].contextMutex ) );
+        }
+        else
+        {
+            IotLogError( "(MQTT connection %p) Failed to lock MQTT context to send coalesced PUBLISH packets.",
+                         pMqttConnection );
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* The held back packets are lost. Close the connection so that the
+     * operations waiting for them fail instead of waiting for a response. */
+    if( status != IOT_MQTT_SUCCESS )
+    {
+        _IotMqtt_CloseNetworkConnection( IOT_MQTT_SEND_FAILED,
+                                         pMqttConnection );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    /* Release the reference taken when this job was scheduled. */
+    _IotMqtt_DecrementConnectionReferences( pMqttConnection );
+}
+
+/*-----------------------------------------------------------*/
+
+static IotMqttError_t _coalescePublish( _mqttConnection_t * pMqttConnection,
+                                        const IotNetworkBuffer_t * pBuffers,
+                                        size_t bufferCount,
+                                        size_t packetSize,
+                                        bool * pHeldBack )
+{
+    IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
+    IotTaskPoolError_t taskPoolStatus = IOT_TASKPOOL_SUCCESS;
+    size_t i = 0;
+
+    *pHeldBack = false;
+
+    /* Make room for the new packet by sending the ones already held back. */
+    if( ( ( size_t ) pMqttConnection->coalescedBytes + packetSize ) > pMqttConnection->coalesceMaxBytes )
+    {
+        status = _flushCoalesced( pMqttConnection );
+
+        if( status != IOT_MQTT_SUCCESS )
+        {
+            IOT_GOTO_CLEANUP();
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* A packet larger than the whole buffer is sent on its own. */
+    if( packetSize > pMqttConnection->coalesceMaxBytes )
+    {
+        if( _IotMqtt_SendVector( pMqttConnection, pBuffers, bufferCount ) != packetSize )
+        {
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NETWORK_ERROR );
+        }
+        else
+        {
+            pMqttConnection->coalesceStats.packetCount++;
+            pMqttConnection->coalesceStats.sendCount++;
+            pMqttConnection->coalesceStats.byteCount += packetSize;
+
+            if( packetSize > pMqttConnection->coalesceStats.largestSend )
+            {
+                pMqttConnection->coalesceStats.largestSend = ( uint32_t ) packetSize;
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+
+            IOT_GOTO_CLEANUP();
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Hold back a copy of the packet. */
+    for( i = 0; i < bufferCount; i++ )
+    {
+        ( void ) memcpy( pMqttConnection->pCoalesceBuffer + pMqttConnection->coalescedBytes,
+                         pBuffers[ i ].pBuffer,
+                         pBuffers[ i ].length );
+        pMqttConnection->coalescedBytes += ( uint32_t ) pBuffers[ i ].length;
+    }
+
+    pMqttConnection->coalescedPackets++;
+
+    /* Send a full buffer right away. Otherwise, make sure that the packet is
+     * sent within the coalescing delay. */
+    if( pMqttConnection->coalescedBytes == pMqttConnection->coalesceMaxBytes )
+    {
+        status = _flushCoalesced( pMqttConnection );
+    }
+    else if( pMqttConnection->coalesceFlushScheduled == false )
+    {
+        /* The flush job references the MQTT connection. If the connection is
+         * closed, take the packet back out of the buffer. */
+        if( _IotMqtt_IncrementConnectionReferences( pMqttConnection ) == false )
+        {
+            pMqttConnection->coalescedBytes -= ( uint32_t ) packetSize;
+            pMqttConnection->coalescedPackets--;
+
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NETWORK_ERROR );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        /* Re-create the flush job. The previous run of the job has finished
+         * with the job storage once it cleared the scheduled flag. */
+        taskPoolStatus = IotTaskPool_CreateJob( _processCoalesceFlush,
+                                                pMqttConnection,
+                                                &( pMqttConnection->coalesceJobStorage ),
+                                                &( pMqttConnection->coalesceJob ) );
+        IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
+
+        taskPoolStatus = IotTaskPool_ScheduleDeferred( IOT_SYSTEM_TASKPOOL,
+                                                       pMqttConnection->coalesceJob,
+                                                       pMqttConnection->coalesceDelayMs );
+
+        if( taskPoolStatus == IOT_TASKPOOL_SUCCESS )
+        {
+            pMqttConnection->coalesceFlushScheduled = true;
+        }
+        else
+        {
+            /* Without a flush job, the packet can't be held back. The caller
+             * holds another reference, so the connection is not destroyed here. */
+            _IotMqtt_DecrementConnectionReferences( pMqttConnection );
+
+            status = _flushCoalesced( pMqttConnection );
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* The packet stays held back until the buffer is sent. */
+    *pHeldBack = ( pMqttConnection->coalescedBytes > 0U );
+
+    IOT_FUNCTION_EXIT_NO_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+static IotMqttError_t _sendPublish( MQTTContext_t * pContext,
+                                    _mqttOperation_t * pOperation,
+                                    const MQTTPublishInfo_t * pPublishInfo )
+{
+    IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
+    MQTTStatus_t managedMqttStatus = MQTTBadParameter;
+    MQTTPublishState_t publishState = MQTTStateNull;
+    size_t remainingLength = 0, packetSize = 0, headerSize = 0, bufferCount = 1;
+    bool heldBack = false;
+    uint16_t packetId = pOperation->u.operation.packetIdentifier;
+    uint8_t * pPacketCopy = NULL;
+    IotNetworkBuffer_t buffers[ 2 ] = { { 0 } };
+
+    /* Serialize everything but the payload into the network buffer. */
+    managedMqttStatus = MQTT_GetPublishPacketSize( pPublishInfo, &remainingLength, &packetSize );
+
+    if( managedMqttStatus == MQTTSuccess )
+    {
+        managedMqttStatus = MQTT_SerializePublishHeader( pPublishInfo,
+                                                         packetId,
+                                                         remainingLength,
+                                                         &( pContext->networkBuffer ),
+                                                         &headerSize );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( managedMqttStatus != MQTTSuccess )
+    {
+        IOT_SET_AND_GOTO_CLEANUP( convertReturnCode( managedMqttStatus ) );
+    }
+    else
+    {
+        IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_PUBLISH_SERIALIZED );
+    }
+
+    /* A PUBLISH that may be retransmitted needs the whole packet after the
+     * application's payload buffer is returned. Allocate the copy before
+     * anything is sent so that running out of memory has no side effects. A
+     * small PUBLISH is copied into the operation itself. */
+    if( pOperation->u.operation.retry.limit > 0 )
+    {
+        pPacketCopy = _IotMqtt_AllocateOperationPacket( pOperation, packetSize );
+
+        if( pPacketCopy == NULL )
+        {
+            IotLogError( "Failed to allocate %lu bytes for PUBLISH retransmission.",
+                         ( unsigned long ) packetSize );
+
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Reserve a state record for the packet identifier, as MQTT_Publish would. */
+    if( pPublishInfo->qos > MQTTQoS0 )
+    {
+        managedMqttStatus = MQTT_ReserveState( pContext, packetId, pPublishInfo->qos );
+
+        /* All state records are taken by PUBLISH packets awaiting PUBACK. The
+         * caller may publish again once some of them are acknowledged. */
+        if( managedMqttStatus == MQTTNoMemory )
+        {
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_WOULD_BLOCK );
+        }
+        else if( managedMqttStatus != MQTTSuccess )
+        {
+            IOT_SET_AND_GOTO_CLEANUP( convertReturnCode( managedMqttStatus ) );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Send the header and the payload in one call to the network stack. */
+    buffers[ 0 ].pBuffer = pContext->networkBuffer.pBuffer;
+    buffers[ 0 ].length = headerSize;
+
+    if( pPublishInfo->payloadLength > 0 )
+    {
+        buffers[ 1 ].pBuffer = ( const uint8_t * ) pPublishInfo->pPayload;
+        buffers[ 1 ].length = pPublishInfo->payloadLength;
+        bufferCount = 2;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( pOperation->pMqttConnection->pCoalesceBuffer != NULL )
+    {
+        status = _coalescePublish( pOperation->pMqttConnection, buffers, bufferCount, packetSize, &heldBack );
+    }
+    else if( _IotMqtt_SendVector( pOperation->pMqttConnection, buffers, bufferCount ) != packetSize )
+    {
+        status = IOT_MQTT_NETWORK_ERROR;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( status != IOT_MQTT_SUCCESS )
+    {
+        IOT_GOTO_CLEANUP();
+    }
+    else
+    {
+        pContext->lastPacketTime = pContext->getTime();
+
+        /* A held back PUBLISH is stamped and traced when its packet is sent. */
+        if( heldBack == true )
+        {
+            pOperation->u.operation.coalesced = true;
+        }
+        else
+        {
+            IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_PUBLISH_SENT );
+        }
+    }
+
+    if( pPublishInfo->qos > MQTTQoS0 )
+    {
+        managedMqttStatus = MQTT_UpdateStatePublish( pContext,
+                                                     packetId,
+                                                     MQTT_SEND,
+                                                     pPublishInfo->qos,
+                                                     &publishState );
+
+        if( managedMqttStatus != MQTTSuccess )
+        {
+            IotLogError( "Failed to update state of PUBLISH %hu.", packetId );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Keep the copy for retransmission. The packet identifier is not located
+     * for AWS IoT MQTT mode, so retransmissions set the DUP flag instead of
+     * changing the packet identifier that the state record was reserved for. */
+    if( pPacketCopy != NULL )
+    {
+        ( void ) memcpy( pPacketCopy, buffers[ 0 ].pBuffer, headerSize );
+
+        if( bufferCount == 2 )
+        {
+            ( void ) memcpy( pPacketCopy + headerSize, buffers[ 1 ].pBuffer, buffers[ 1 ].length );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        pOperation->u.operation.pMqttPacket = pPacketCopy;
+        pOperation->u.operation.packetSize = packetSize;
+        pPacketCopy = NULL;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IOT_FUNCTION_CLEANUP_BEGIN();
+
+    if( pPacketCopy != NULL )
+    {
+        _IotMqtt_FreeOperationPacket( pOperation, pPacketCopy );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IOT_FUNCTION_CLEANUP_END();
+}
+
+/*-----------------------------------------------------------*/
+
 IotMqttError_t _IotMqtt_managedDisconnect( IotMqttConnection_t mqttConnection )
 {
     IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_BAD_PARAMETER );
     int8_t contextIndex = -1;
     /* Initializing MQTT Status. */
     MQTTStatus_t managedMqttStatus = MQTTBadParameter;
+    IotMqttError_t flushStatus = IOT_MQTT_SUCCESS;
 
     IotMqtt_Assert( mqttConnection != NULL );
 
@@ -68,8 +633,18 @@ IotMqttError_t _IotMqtt_managedDisconnect( IotMqttConnection_t mqttConnection )
             IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_TIMEOUT );
         }
 
-        /* Calling MQTT LTS API for sending the DISCONNECT packet on the network. */
-        managedMqttStatus = MQTT_Disconnect( &( connToContext[ contextIndex ].context ) );
+        /* Send any held back PUBLISH packets first to keep packets in order. */
+        flushStatus = _flushCoalesced( mqttConnection );
+
+        if( flushStatus == IOT_MQTT_SUCCESS )
+        {
+            /* Calling MQTT LTS API for sending the DISCONNECT packet on the network. */
+            managedMqttStatus = MQTT_Disconnect( &( connToContext[ contextIndex ].context ) );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
 
         if( IotMutex_GiveRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == false )
         {
@@ -77,8 +652,17 @@ IotMqttError_t _IotMqtt_managedDisconnect( IotMqttConnection_t mqttConnection )
             IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
         }
 
-        /* Converting the status code. */
-        status = convertReturnCode( managedMqttStatus );
+        /* The DISCONNECT fails if the held back packets were lost. The caller
+         * closes the network connection after this function either way. */
+        if( flushStatus == IOT_MQTT_SUCCESS )
+        {
+            /* Converting the status code. */
+            status = convertReturnCode( managedMqttStatus );
+        }
+        else
+        {
+            status = flushStatus;
+        }
     }
     else
     {
@@ -100,6 +684,7 @@ IotMqttError_t _IotMqtt_managedSubscribe( IotMqttConnection_t mqttConnection,
     int8_t contextIndex = -1;
     /* Initializing MQTT Status. */
     MQTTStatus_t managedMqttStatus = MQTTBadParameter;
+    IotMqttError_t flushStatus = IOT_MQTT_SUCCESS;
     uint16_t packetId = 0;
     size_t i = 0;
 
@@ -107,7 +692,9 @@ IotMqttError_t _IotMqtt_managedSubscribe( IotMqttConnection_t mqttConnection,
     IotMqtt_Assert( pSubscriptionOperation != NULL );
     IotMqtt_Assert( pSubscriptionList != NULL );
 
-    MQTTSubscribeInfo_t * subscriptionList = IotMqtt_MallocMessage( sizeof( MQTTSubscribeInfo_t ) * subscriptionCount );
+    /* A short subscription list fits in the SUBSCRIBE operation itself. */
+    MQTTSubscribeInfo_t * subscriptionList = _IotMqtt_AllocateOperationPacket( pSubscriptionOperation,
+                                                                               sizeof( MQTTSubscribeInfo_t ) * subscriptionCount );
 
     if( subscriptionList == NULL )
     {
@@ -139,8 +726,18 @@ IotMqttError_t _IotMqtt_managedSubscribe( IotMqttConnection_t mqttConnection,
                 IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_TIMEOUT );
             }
 
-            /* Calling MQTT LTS API for sending the SUBSCRIBE packet on the network. */
-            managedMqttStatus = MQTT_Subscribe( &( connToContext[ contextIndex ].context ), subscriptionList, subscriptionCount, packetId );
+            /* Send any held back PUBLISH packets first to keep packets in order. */
+            flushStatus = _flushCoalesced( mqttConnection );
+
+            if( flushStatus == IOT_MQTT_SUCCESS )
+            {
+                /* Calling MQTT LTS API for sending the SUBSCRIBE packet on the network. */
+                managedMqttStatus = MQTT_Subscribe( &( connToContext[ contextIndex ].context ), subscriptionList, subscriptionCount, packetId );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
 
             if( IotMutex_GiveRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == false )
             {
@@ -148,8 +745,19 @@ IotMqttError_t _IotMqtt_managedSubscribe( IotMqttConnection_t mqttConnection,
                 IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
             }
 
-            /* Converting the status code. */
-            status = convertReturnCode( managedMqttStatus );
+            if( flushStatus == IOT_MQTT_SUCCESS )
+            {
+                /* Converting the status code. */
+                status = convertReturnCode( managedMqttStatus );
+            }
+            else
+            {
+                /* The held back packets are lost. Close the connection so that the
+                 * operations waiting for them fail instead of waiting for a response. */
+                _IotMqtt_CloseNetworkConnection( IOT_MQTT_SEND_FAILED,
+                                                 mqttConnection );
+                status = flushStatus;
+            }
         }
         else
         {
@@ -157,7 +765,7 @@ IotMqttError_t _IotMqtt_managedSubscribe( IotMqttConnection_t mqttConnection,
                          mqttConnection );
         }
 
-        IotMqtt_FreeMessage( subscriptionList );
+        _IotMqtt_FreeOperationPacket( pSubscriptionOperation, subscriptionList );
     }
 
     IOT_FUNCTION_EXIT_NO_CLEANUP();
@@ -174,6 +782,7 @@ IotMqttError_t _IotMqtt_managedUnsubscribe( IotMqttConnection_t mqttConnection,
     int8_t contextIndex = -1;
     /* Initializing MQTT Status. */
     MQTTStatus_t managedMqttStatus = MQTTBadParameter;
+    IotMqttError_t flushStatus = IOT_MQTT_SUCCESS;
     uint16_t packetId = 0;
     size_t i = 0;
 
@@ -181,7 +790,9 @@ IotMqttError_t _IotMqtt_managedUnsubscribe( IotMqttConnection_t mqttConnection,
     IotMqtt_Assert( pUnsubscriptionOperation != NULL );
     IotMqtt_Assert( pUnsubscriptionList != NULL );
 
-    MQTTSubscribeInfo_t * subscriptionList = IotMqtt_MallocMessage( sizeof( MQTTSubscribeInfo_t ) * unsubscriptionCount );
+    /* A short unsubscription list fits in the UNSUBSCRIBE operation itself. */
+    MQTTSubscribeInfo_t * subscriptionList = _IotMqtt_AllocateOperationPacket( pUnsubscriptionOperation,
+                                                                               sizeof( MQTTSubscribeInfo_t ) * unsubscriptionCount );
 
     if( subscriptionList == NULL )
     {
@@ -212,8 +823,18 @@ IotMqttError_t _IotMqtt_managedUnsubscribe( IotMqttConnection_t mqttConnection,
                 IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_TIMEOUT );
             }
 
-            /* Calling MQTT LTS API for sending the UNSUBSCRIBE packet on the network. */
-            managedMqttStatus = MQTT_Unsubscribe( &( connToContext[ contextIndex ].context ), subscriptionList, unsubscriptionCount, packetId );
+            /* Send any held back PUBLISH packets first to keep packets in order. */
+            flushStatus = _flushCoalesced( mqttConnection );
+
+            if( flushStatus == IOT_MQTT_SUCCESS )
+            {
+                /* Calling MQTT LTS API for sending the UNSUBSCRIBE packet on the network. */
+                managedMqttStatus = MQTT_Unsubscribe( &( connToContext[ contextIndex ].context ), subscriptionList, unsubscriptionCount, packetId );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
 
             if( IotMutex_GiveRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == false )
             {
@@ -221,8 +842,19 @@ IotMqttError_t _IotMqtt_managedUnsubscribe( IotMqttConnection_t mqttConnection,
                 IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
             }
 
-            /* Converting the status code. */
-            status = convertReturnCode( managedMqttStatus );
+            if( flushStatus == IOT_MQTT_SUCCESS )
+            {
+                /* Converting the status code. */
+                status = convertReturnCode( managedMqttStatus );
+            }
+            else
+            {
+                /* The held back packets are lost. Close the connection so that the
+                 * operations waiting for them fail instead of waiting for a response. */
+                _IotMqtt_CloseNetworkConnection( IOT_MQTT_SEND_FAILED,
+                                                 mqttConnection );
+                status = flushStatus;
+            }
         }
         else
         {
@@ -230,7 +862,7 @@ IotMqttError_t _IotMqtt_managedUnsubscribe( IotMqttConnection_t mqttConnection,
                          mqttConnection );
         }
 
-        IotMqtt_FreeMessage( subscriptionList );
+        _IotMqtt_FreeOperationPacket( pUnsubscriptionOperation, subscriptionList );
     }
 
     IOT_FUNCTION_EXIT_NO_CLEANUP();
@@ -245,8 +877,6 @@ IotMqttError_t _IotMqtt_managedPublish( IotMqttConnection_t mqttConnection,
 {
     IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_BAD_PARAMETER );
     int8_t contextIndex = -1;
-    /* Initializing MQTT Status. */
-    MQTTStatus_t managedMqttStatus = MQTTBadParameter;
     uint16_t packetId = 0;
     MQTTPublishInfo_t publishInfo;
 
@@ -280,8 +910,84 @@ IotMqttError_t _IotMqtt_managedPublish( IotMqttConnection_t mqttConnection,
             IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_TIMEOUT );
         }
 
-        /* Calling MQTT LTS API for sending the PUBLISH packet on the network. */
-        managedMqttStatus = MQTT_Publish( &( connToContext[ contextIndex ].context ), &publishInfo, packetId );
+        IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_PUBLISH_LOCKED );
+
+        /* Sending the PUBLISH packet on the network without copying its payload. */
+        status = _sendPublish( &( connToContext[ contextIndex ].context ), pOperation, &publishInfo );
+
+        if( IotMutex_GiveRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == false )
+        {
+            /* Fail to give context mutex as no space is available on queue. */
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
+        }
+    }
+    else
+    {
+        IotLogError( "(MQTT connection %p) MQTT Context is not set for this MQTT Connection.",
+                     mqttConnection );
+    }
+
+    IOT_FUNCTION_EXIT_NO_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t _IotMqtt_managedRetransmit( IotMqttConnection_t mqttConnection,
+                                           _mqttOperation_t * pOperation )
+{
+    IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_BAD_PARAMETER );
+    int8_t contextIndex = -1;
+    IotMqttError_t flushStatus = IOT_MQTT_SUCCESS;
+    size_t bytesSent = 0;
+
+    IotMqtt_Assert( mqttConnection != NULL );
+    IotMqtt_Assert( pOperation != NULL );
+    IotMqtt_Assert( pOperation->u.operation.pMqttPacket != NULL );
+
+    /* Getting MQTT Context for the specified MQTT Connection. */
+    contextIndex = _IotMqtt_getContextIndexFromConnection( mqttConnection );
+
+    if( contextIndex >= 0 )
+    {
+        /* The references mutex is taken before the context mutex, as when a
+         * PUBLISH is sent. It is only needed while held back packets are sent. */
+        IotMutex_Lock( &( mqttConnection->referencesMutex ) );
+
+        if( IotMutex_TakeRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == false )
+        {
+            IotMutex_Unlock( &( mqttConnection->referencesMutex ) );
+
+            /* Fail to take context mutex due to timeout. */
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_TIMEOUT );
+        }
+
+        /* Send any held back PUBLISH packets first to keep packets in order. */
+        flushStatus = _flushCoalesced( mqttConnection );
+
+        IotMutex_Unlock( &( mqttConnection->referencesMutex ) );
+
+        /* Send the stored packet while the context is locked, so that it is not
+         * interleaved with the packets of other operations. */
+        if( flushStatus == IOT_MQTT_SUCCESS )
+        {
+            bytesSent = mqttConnection->pNetworkInterface->send( mqttConnection->pNetworkConnection,
+                                                                 pOperation->u.operation.pMqttPacket,
+                                                                 pOperation->u.operation.packetSize );
+
+            if( bytesSent == pOperation->u.operation.packetSize )
+            {
+                connToContext[ contextIndex ].context.lastPacketTime = connToContext[ contextIndex ].context.getTime();
+                status = IOT_MQTT_SUCCESS;
+            }
+            else
+            {
+                status = IOT_MQTT_NETWORK_ERROR;
+            }
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
 
         if( IotMutex_GiveRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == false )
         {
@@ -289,8 +995,18 @@ IotMqttError_t _IotMqtt_managedPublish( IotMqttConnection_t mqttConnection,
             IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
         }
 
-        /* Converting the status code. */
-        status = convertReturnCode( managedMqttStatus );
+        /* The held back packets are lost. Close the connection so that the
+         * operations waiting for them fail instead of waiting for a response. */
+        if( flushStatus != IOT_MQTT_SUCCESS )
+        {
+            _IotMqtt_CloseNetworkConnection( IOT_MQTT_SEND_FAILED,
+                                             mqttConnection );
+            status = flushStatus;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
     }
     else
     {
@@ -301,6 +1017,8 @@ IotMqttError_t _IotMqtt_managedPublish( IotMqttConnection_t mqttConnection,
     IOT_FUNCTION_EXIT_NO_CLEANUP();
 }
 
+/*-----------------------------------------------------------*/
+
 IotMqttError_t _IotMqtt_managedPing( IotMqttConnection_t mqttConnection )
 {
     int8_t contextIndex = -1;
@@ -315,11 +1033,23 @@ IotMqttError_t _IotMqtt_managedPing( IotMqttConnection_t mqttConnection )
 
     if( contextIndex >= 0 )
     {
-        /* Calling MQTT LTS API for sending the PINGREQ packet on the network. */
-        managedMqttStatus = MQTT_Ping( &( connToContext[ contextIndex ].context ) );
+        /* Lock the context so that the PINGREQ is not sent in the middle of
+         * another packet, such as a PUBLISH retransmission. */
+        if( IotMutex_TakeRecursive( &( connToContext[ contextIndex ].contextMutex ) ) == true )
+        {
+            /* Calling MQTT LTS API for sending the PINGREQ packet on the network. */
+            managedMqttStatus = MQTT_Ping( &( connToContext[ contextIndex ].context ) );
+
+            ( void ) IotMutex_GiveRecursive( &( connToContext[ contextIndex ].contextMutex ) );
 
-        /* Converting the status code. */
-        status = convertReturnCode( managedMqttStatus );
+            /* Converting the status code. */
+            status = convertReturnCode( managedMqttStatus );
+        }
+        else
+        {
+            /* Fail to take context mutex due to timeout. */
+            status = IOT_MQTT_TIMEOUT;
+        }
     }
     else
     {
@@ -58,17 +58,66 @@ extern _connContext_t connToContext[ MAX_NO_OF_MQTT_CONNECTIONS ];
  */
 static bool _incomingPacketValid( uint8_t packetType );
 
+/**
+ * @brief Receive data through the receive buffer of an MQTT connection.
+ *
+ * Unread bytes in the buffer are returned first. When the buffer is empty, it
+ * is refilled by one network `receiveUpto`, unless the data still needed would
+ * fill the buffer anyway; that data is received directly into `pBuffer`.
+ * `receiveUpto` does not wait for data, so if nothing more has arrived, the
+ * rest of `bytesRequested` is received directly with a blocking `receive`.
+ *
+ * @param[in] pReceiveBuffer The #_mqttReceiveBuffer_t to read.
+ * @param[out] pBuffer Where to place the received data.
+ * @param[in] bytesRequested How many bytes to receive.
+ *
+ * @return The number of bytes received, which is less than `bytesRequested`
+ * only if the network failed.
+ */
+static size_t _receiveBuffered( void * pReceiveBuffer,
+                                uint8_t * pBuffer,
+                                size_t bytesRequested );
+
+/**
+ * @brief Borrow data from the network stack through the receive buffer of an
+ * MQTT connection.
+ *
+ * Bytes already read into the buffer precede what the network stack holds, so
+ * data is only lent while the buffer is empty. Otherwise the caller copies the
+ * data through #_receiveBuffered.
+ *
+ * @param[in] pReceiveBuffer The #_mqttReceiveBuffer_t to read.
+ * @param[in] bytesRequested How many bytes to borrow.
+ *
+ * @return The lent data; `NULL` if it cannot be lent.
+ */
+static uint8_t * _receiveBufferBuffered( void * pReceiveBuffer,
+                                         size_t bytesRequested );
+
+/**
+ * @brief Give back data lent by #_receiveBufferBuffered.
+ *
+ * @param[in] pReceiveBuffer The #_mqttReceiveBuffer_t that lent `pBuffer`.
+ * @param[in] pBuffer The lent data.
+ */
+static void _releaseBufferBuffered( void * pReceiveBuffer,
+                                    uint8_t * pBuffer );
+
 /**
  * @brief Get an incoming MQTT packet from the network.
  *
  * @param[in] pNetworkConnection Network connection to use for receive, which
  * may be different from the network connection associated with the MQTT connection.
+ * @param[in] pNetworkInterface Network interface to use for receive, which is
+ * different from the network interface of the MQTT connection when its receives
+ * are buffered.
  * @param[in] pMqttConnection The associated MQTT connection.
  * @param[out] pIncomingPacket Output parameter for the incoming packet.
  *
  * @return #IOT_MQTT_SUCCESS, #IOT_MQTT_NO_MEMORY or #IOT_MQTT_BAD_RESPONSE.
  */
 static IotMqttError_t _getIncomingPacket( void * pNetworkConnection,
+                                          const IotNetworkInterface_t * pNetworkInterface,
                                           const _mqttConnection_t * pMqttConnection,
                                           _mqttPacket_t * pIncomingPacket );
 
@@ -102,15 +151,28 @@ static void _sendPuback( _mqttConnection_t * pMqttConnection,
  *
  * @param[in] pNetworkConnection Network connection to use for receive, which
  * may be different from the network connection associated with the MQTT connection.
- * @param[in] pMqttConnection The associated MQTT connection.
+ * @param[in] pNetworkInterface Network interface to use for receive.
  * @param[in] length The length of the packet to flush.
  */
 static void _flushPacket( void * pNetworkConnection,
-                          const _mqttConnection_t * pMqttConnection,
+                          const IotNetworkInterface_t * pNetworkInterface,
                           size_t length );
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Network interface that receives through the receive buffer of an MQTT
+ * connection. Its network connection is a #_mqttReceiveBuffer_t.
+ */
+static const IotNetworkInterface_t _bufferedNetworkInterface =
+{
+    .receive       = _receiveBuffered,
+    .receiveBuffer = _receiveBufferBuffered,
+    .releaseBuffer = _releaseBufferBuffered
+};
+
+/*-----------------------------------------------------------*/
+
 static bool _incomingPacketValid( uint8_t packetType )
 {
     bool status = true;
@@ -138,7 +200,115 @@ static bool _incomingPacketValid( uint8_t packetType )
 
 /*-----------------------------------------------------------*/
 
+static size_t _receiveBuffered( void * pReceiveBuffer,
+                                uint8_t * pBuffer,
+                                size_t bytesRequested )
+{
+    size_t bytesReceived = 0, bytesCopied = 0, networkBytes = 0;
+    bool networkFailed = false;
+    _mqttReceiveBuffer_t * pBuffered = ( _mqttReceiveBuffer_t * ) pReceiveBuffer;
+
+    while( ( bytesReceived < bytesRequested ) && ( networkFailed == false ) )
+    {
+        if( pBuffered->length > 0 )
+        {
+            /* Copy unread bytes out of the buffer. */
+            bytesCopied = bytesRequested - bytesReceived;
+
+            if( bytesCopied > pBuffered->length )
+            {
+                bytesCopied = pBuffered->length;
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+
+            ( void ) memcpy( pBuffer + bytesReceived,
+                             pBuffered->pBuffer + pBuffered->offset,
+                             bytesCopied );
+
+            pBuffered->offset += bytesCopied;
+            pBuffered->length -= bytesCopied;
+            bytesReceived += bytesCopied;
+        }
+        else if( ( bytesRequested - bytesReceived ) >= pBuffered->bufferSize )
+        {
+            /* Data that would fill the buffer gains nothing from passing
+             * through it, so it is received directly. */
+            networkBytes = pBuffered->pNetworkInterface->receive( pBuffered->pNetworkConnection,
+                                                                  pBuffer + bytesReceived,
+                                                                  bytesRequested - bytesReceived );
+
+            bytesReceived += networkBytes;
+            networkFailed = ( networkBytes == 0 );
+        }
+        else
+        {
+            /* Refill the empty buffer with whatever the network has. */
+            networkBytes = pBuffered->pNetworkInterface->receiveUpto( pBuffered->pNetworkConnection,
+                                                                      pBuffered->pBuffer,
+                                                                      pBuffered->bufferSize );
+
+            pBuffered->offset = 0;
+            pBuffered->length = networkBytes;
+
+            /* The rest of a packet may not have arrived yet; wait for it. */
+            if( networkBytes == 0 )
+            {
+                networkBytes = pBuffered->pNetworkInterface->receive( pBuffered->pNetworkConnection,
+                                                                      pBuffer + bytesReceived,
+                                                                      bytesRequested - bytesReceived );
+
+                bytesReceived += networkBytes;
+                networkFailed = ( networkBytes == 0 );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * _receiveBufferBuffered( void * pReceiveBuffer,
+                                         size_t bytesRequested )
+{
+    uint8_t * pLentData = NULL;
+    _mqttReceiveBuffer_t * pBuffered = ( _mqttReceiveBuffer_t * ) pReceiveBuffer;
+
+    if( ( pBuffered->length == 0 ) &&
+        ( pBuffered->pNetworkInterface->receiveBuffer != NULL ) )
+    {
+        pLentData = pBuffered->pNetworkInterface->receiveBuffer( pBuffered->pNetworkConnection,
+                                                                 bytesRequested );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return pLentData;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _releaseBufferBuffered( void * pReceiveBuffer,
+                                    uint8_t * pBuffer )
+{
+    _mqttReceiveBuffer_t * pBuffered = ( _mqttReceiveBuffer_t * ) pReceiveBuffer;
+
+    pBuffered->pNetworkInterface->releaseBuffer( pBuffered->pNetworkConnection, pBuffer );
+}
+
+/*-----------------------------------------------------------*/
+
 static IotMqttError_t _getIncomingPacket( void * pNetworkConnection,
+                                          const IotNetworkInterface_t * pNetworkInterface,
                                           const _mqttConnection_t * pMqttConnection,
                                           _mqttPacket_t * pIncomingPacket )
 {
@@ -185,7 +355,7 @@ static IotMqttError_t _getIncomingPacket( void * pNetworkConnection,
 
     /* Read the packet type, which is the first byte available. */
     pIncomingPacket->type = getPacketType( pNetworkConnection,
-                                           pMqttConnection->pNetworkInterface );
+                                           pNetworkInterface );
 
     /* Check that the incoming packet type is valid. */
     if( _incomingPacketValid( pIncomingPacket->type ) == false )
@@ -203,7 +373,7 @@ static IotMqttError_t _getIncomingPacket( void * pNetworkConnection,
 
     /* Read the remaining length. */
     pIncomingPacket->remainingLength = getRemainingLength( pNetworkConnection,
-                                                           pMqttConnection->pNetworkInterface );
+                                                           pNetworkInterface );
 
     if( pIncomingPacket->remainingLength == MQTT_REMAINING_LENGTH_INVALID )
     {
@@ -214,8 +384,42 @@ static IotMqttError_t _getIncomingPacket( void * pNetworkConnection,
         EMPTY_ELSE_MARKER;
     }
 
-    /* Allocate a buffer for the remaining data and read the data. */
-    if( pIncomingPacket->remainingLength > 0 )
+    /* Read the remaining data of a PUBLISH in place if the network stack can
+     * lend it. */
+    if( ( pIncomingPacket->remainingLength > 0 ) &&
+        ( ( pIncomingPacket->type & 0xf0 ) == MQTT_PACKET_TYPE_PUBLISH ) &&
+        ( pNetworkInterface->receiveBuffer != NULL ) &&
+        ( pNetworkInterface->releaseBuffer != NULL ) )
+    {
+        pIncomingPacket->pRemainingData = pNetworkInterface->receiveBuffer( pNetworkConnection,
+                                                                            pIncomingPacket->remainingLength );
+
+        if( pIncomingPacket->pRemainingData != NULL )
+        {
+            /* Lent data may be kept after this receive, so it is given back
+             * directly to the network connection that lent it. */
+            if( pNetworkInterface == &_bufferedNetworkInterface )
+            {
+                pIncomingPacket->pLendingConnection = pMqttConnection->receiveBuffer.pNetworkConnection;
+            }
+            else
+            {
+                pIncomingPacket->pLendingConnection = pNetworkConnection;
+            }
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Otherwise, allocate a buffer for the remaining data and read the data. */
+    if( ( pIncomingPacket->remainingLength > 0 ) &&
+        ( pIncomingPacket->pRemainingData == NULL ) )
     {
         pIncomingPacket->pRemainingData = IotMqtt_MallocMessage( pIncomingPacket->remainingLength );
 
@@ -227,7 +431,7 @@ static IotMqttError_t _getIncomingPacket( void * pNetworkConnection,
                          ( unsigned long ) pIncomingPacket->remainingLength,
                          ( unsigned long ) pIncomingPacket->type );
 
-            _flushPacket( pNetworkConnection, pMqttConnection, pIncomingPacket->remainingLength );
+            _flushPacket( pNetworkConnection, pNetworkInterface, pIncomingPacket->remainingLength );
 
             IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
         }
@@ -236,9 +440,9 @@ static IotMqttError_t _getIncomingPacket( void * pNetworkConnection,
             EMPTY_ELSE_MARKER;
         }
 
-        dataBytesRead = pMqttConnection->pNetworkInterface->receive( pNetworkConnection,
-                                                                     pIncomingPacket->pRemainingData,
-                                                                     pIncomingPacket->remainingLength );
+        dataBytesRead = pNetworkInterface->receive( pNetworkConnection,
+                                                    pIncomingPacket->pRemainingData,
+                                                    pIncomingPacket->remainingLength );
 
         if( dataBytesRead != pIncomingPacket->remainingLength )
         {
@@ -261,7 +465,9 @@ static IotMqttError_t _getIncomingPacket( void * pNetworkConnection,
     {
         if( pIncomingPacket->pRemainingData != NULL )
         {
-            IotMqtt_FreeMessage( pIncomingPacket->pRemainingData );
+            _IotMqtt_FreeReceivedData( pMqttConnection,
+                                       pIncomingPacket->pLendingConnection,
+                                       pIncomingPacket->pRemainingData );
         }
         else
         {
@@ -325,6 +531,7 @@ static IotMqttError_t _deserializeIncomingPacket( _mqttConnection_t * pMqttConne
             #endif /* if IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1 */
 
             /* Deserialize CONNACK and notify of result. */
+            pIncomingPacket->u.pMqttConnection = pMqttConnection;
             status = deserialize( pIncomingPacket );
             pOperation = _IotMqtt_FindOperation( pMqttConnection,
                                                  IOT_MQTT_CONNECT,
@@ -402,6 +609,7 @@ static IotMqttError_t _deserializeIncomingPacket( _mqttConnection_t * pMqttConne
 
                 /* Transfer ownership of the received MQTT packet to the PUBLISH operation. */
                 pOperation->u.publish.pReceivedData = pIncomingPacket->pRemainingData;
+                pOperation->u.publish.pLendingConnection = pIncomingPacket->pLendingConnection;
                 pIncomingPacket->pRemainingData = NULL;
 
                 /* Add the PUBLISH to the list of operations pending processing. */
@@ -436,6 +644,7 @@ static IotMqttError_t _deserializeIncomingPacket( _mqttConnection_t * pMqttConne
                     /* Retrieve the pointer MQTT packet pointer so it may be freed later. */
                     IotMqtt_Assert( pIncomingPacket->pRemainingData == NULL );
                     pIncomingPacket->pRemainingData = ( uint8_t * ) pOperation->u.publish.pReceivedData;
+                    pIncomingPacket->pLendingConnection = pOperation->u.publish.pLendingConnection;
                 }
                 else
                 {
@@ -533,6 +742,8 @@ static IotMqttError_t _deserializeIncomingPacket( _mqttConnection_t * pMqttConne
 
             if( pOperation != NULL )
             {
+                IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_PUBACK_RECEIVED );
+
                 pOperation->u.operation.status = status;
                 _IotMqtt_Notify( pOperation );
             }
@@ -793,7 +1004,7 @@ static void _sendPuback( _mqttConnection_t * pMqttConnection,
 /*-----------------------------------------------------------*/
 
 static void _flushPacket( void * pNetworkConnection,
-                          const _mqttConnection_t * pMqttConnection,
+                          const IotNetworkInterface_t * pNetworkInterface,
                           size_t length )
 {
     size_t bytesFlushed = 0;
@@ -802,7 +1013,7 @@ static void _flushPacket( void * pNetworkConnection,
     for( bytesFlushed = 0; bytesFlushed < length; bytesFlushed++ )
     {
         ( void ) _IotMqtt_GetNextByte( pNetworkConnection,
-                                       pMqttConnection->pNetworkInterface,
+                                       pNetworkInterface,
                                        &receivedByte );
     }
 }
@@ -839,6 +1050,61 @@ bool _IotMqtt_GetNextByte( void * pNetworkConnection,
 
 /*-----------------------------------------------------------*/
 
+void _IotMqtt_FreeReceivedData( const _mqttConnection_t * pMqttConnection,
+                                void * pLendingConnection,
+                                uint8_t * pReceivedData )
+{
+    if( pLendingConnection != NULL )
+    {
+        pMqttConnection->pNetworkInterface->releaseBuffer( pLendingConnection, pReceivedData );
+    }
+    else
+    {
+        IotMqtt_FreeMessage( pReceivedData );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+size_t _IotMqtt_SendVector( const _mqttConnection_t * pMqttConnection,
+                            const IotNetworkBuffer_t * pBuffers,
+                            size_t bufferCount )
+{
+    size_t i = 0, bytesSent = 0, totalSent = 0;
+
+    if( pMqttConnection->pNetworkInterface->sendVector != NULL )
+    {
+        totalSent = pMqttConnection->pNetworkInterface->sendVector( pMqttConnection->pNetworkConnection,
+                                                                    pBuffers,
+                                                                    bufferCount );
+    }
+    else
+    {
+        /* Without a vectored send, send each buffer in turn and stop at the
+         * first one that is not sent completely. */
+        for( i = 0; i < bufferCount; i++ )
+        {
+            bytesSent = pMqttConnection->pNetworkInterface->send( pMqttConnection->pNetworkConnection,
+                                                                  pBuffers[ i ].pBuffer,
+                                                                  pBuffers[ i ].length );
+            totalSent += bytesSent;
+
+            if( bytesSent != pBuffers[ i ].length )
+            {
+                break;
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+    }
+
+    return totalSent;
+}
+
+/*-----------------------------------------------------------*/
+
 void _IotMqtt_CloseNetworkConnection( IotMqttDisconnectReason_t disconnectReason,
                                       _mqttConnection_t * pMqttConnection )
 {
@@ -948,39 +1214,72 @@ void IotMqtt_ReceiveCallback( void * pNetworkConnection,
 {
     IotMqttError_t status = IOT_MQTT_SUCCESS;
     _mqttPacket_t incomingPacket = { .u.pMqttConnection = NULL };
+    void * pReceiveConnection = pNetworkConnection;
+    const IotNetworkInterface_t * pReceiveInterface = NULL;
 
     /* Cast context to correct type. */
     _mqttConnection_t * pMqttConnection = ( _mqttConnection_t * ) pReceiveContext;
 
-    /* Read an MQTT packet from the network. */
-    status = _getIncomingPacket( pNetworkConnection,
-                                 pMqttConnection,
-                                 &incomingPacket );
+    /* Receive through the buffer of the MQTT connection if it has one. The
+     * buffer is empty between calls of this function. */
+    if( pMqttConnection->receiveBuffer.pBuffer != NULL )
+    {
+        IotMqtt_Assert( pMqttConnection->receiveBuffer.length == 0 );
+
+        pMqttConnection->receiveBuffer.pNetworkConnection = pNetworkConnection;
+        pMqttConnection->receiveBuffer.pNetworkInterface = pMqttConnection->pNetworkInterface;
 
-    if( status == IOT_MQTT_SUCCESS )
+        pReceiveConnection = &( pMqttConnection->receiveBuffer );
+        pReceiveInterface = &_bufferedNetworkInterface;
+    }
+    else
     {
-        /* Deserialize the received packet. */
-        status = _deserializeIncomingPacket( pMqttConnection,
-                                             &incomingPacket );
+        pReceiveInterface = pMqttConnection->pNetworkInterface;
+    }
+
+    /* Process MQTT packets until the buffered data is used up. Without a
+     * buffer, one packet is processed. */
+    do
+    {
+        ( void ) memset( &incomingPacket, 0x00, sizeof( _mqttPacket_t ) );
+
+        /* Read an MQTT packet from the network. */
+        status = _getIncomingPacket( pReceiveConnection,
+                                     pReceiveInterface,
+                                     pMqttConnection,
+                                     &incomingPacket );
 
-        /* Free any buffers allocated for the MQTT packet. */
-        if( incomingPacket.pRemainingData != NULL )
+        if( status == IOT_MQTT_SUCCESS )
         {
-            IotMqtt_FreeMessage( incomingPacket.pRemainingData );
+            /* Deserialize the received packet. */
+            status = _deserializeIncomingPacket( pMqttConnection,
+                                                 &incomingPacket );
+
+            /* Free any buffers allocated for the MQTT packet. */
+            if( incomingPacket.pRemainingData != NULL )
+            {
+                _IotMqtt_FreeReceivedData( pMqttConnection,
+                                           incomingPacket.pLendingConnection,
+                                           incomingPacket.pRemainingData );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
         }
         else
         {
             EMPTY_ELSE_MARKER;
         }
-    }
-    else
-    {
-        EMPTY_ELSE_MARKER;
-    }
+    } while( ( status != IOT_MQTT_BAD_RESPONSE ) &&
+             ( pMqttConnection->receiveBuffer.length > 0 ) );
 
     /* Close the network connection on a bad response. */
     if( status == IOT_MQTT_BAD_RESPONSE )
     {
+        /* Buffered data after a bad packet can't be framed. */
+        pMqttConnection->receiveBuffer.length = 0;
+
         IotLogError( "(MQTT connection %p) Error processing incoming data. Closing connection.",
                      pMqttConnection );
 
@@ -0,0 +1,1188 @@
+/*
+ * FreeRTOS MQTT V2.3.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_mqtt_offline_queue.c
+ * @brief Implements the offline PUBLISH queue and its RAM store.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* Error handling include. */
+#include "private/iot_error.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Length of the header of a stored PUBLISH record.
+ *
+ * The header holds, in order: one byte of flags, the 2-byte topic name
+ * length, and the 4-byte payload length. Lengths are big-endian. The topic
+ * name and payload follow the header.
+ */
+#define OFFLINE_RECORD_HEADER_LENGTH    ( 7U )
+
+/**
+ * @brief Flag bit of a stored PUBLISH record for QoS 1.
+ */
+#define OFFLINE_RECORD_FLAG_QOS1        ( 0x01U )
+
+/**
+ * @brief Flag bit of a stored PUBLISH record for the retain flag.
+ */
+#define OFFLINE_RECORD_FLAG_RETAIN      ( 0x02U )
+
+/**
+ * @brief Length of the prefix of a record in the RAM store.
+ */
+#define RAM_RECORD_PREFIX_LENGTH        ( 4U )
+
+/**
+ * @brief Largest #IotMqttOfflineQueueInfo_t.drainBatch; one bit of the masks
+ * that track sent records per record.
+ */
+#define OFFLINE_QUEUE_MAX_DRAIN_BATCH    ( 32U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Encode a PUBLISH as a record in the queue's record buffer.
+ *
+ * @param[in] pQueue The offline queue.
+ * @param[in] pPublishInfo The PUBLISH to encode.
+ *
+ * @return Length of the record; 0 if it does not fit in the record buffer.
+ */
+static size_t _encodeRecord( IotMqttOfflineQueue_t * pQueue,
+                             const IotMqttPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Decode a record in the queue's record buffer.
+ *
+ * @param[in] pQueue The offline queue.
+ * @param[in] recordLength Length of the record.
+ * @param[out] pPublishInfo Set to the PUBLISH in the record. Its topic name and
+ * payload point into the record buffer.
+ *
+ * @return `true` if the record is valid; `false` otherwise.
+ */
+static bool _decodeRecord( IotMqttOfflineQueue_t * pQueue,
+                           size_t recordLength,
+                           IotMqttPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Schedule the job that forwards stored PUBLISH messages on a connection.
+ *
+ * The queue mutex must be held. The scheduled job holds a reference to the
+ * connection.
+ *
+ * @param[in] pMqttConnection The connection that forwards the queue.
+ * @param[in] delayMs Delay before the job runs.
+ */
+static void _scheduleDrain( _mqttConnection_t * pMqttConnection,
+                            uint32_t delayMs );
+
+/**
+ * @brief Task pool routine that forwards a batch of stored PUBLISH messages.
+ *
+ * @param[in] pTaskPool Pointer to the system task pool.
+ * @param[in] pDrainJob Pointer the offline queue job.
+ * @param[in] pContext The MQTT connection that forwards the queue.
+ */
+static void _processDrain( IotTaskPool_t pTaskPool,
+                           IotTaskPoolJob_t pDrainJob,
+                           void * pContext );
+
+/**
+ * @brief Completion callback of a stored QoS 1 PUBLISH.
+ *
+ * Marks the record as sent if the PUBLISH was acknowledged, removes the oldest
+ * records that are sent, and resumes forwarding the queue.
+ *
+ * @param[in] pCallbackContext The sequence number of the record.
+ * @param[in] pCallbackParam The result of the PUBLISH.
+ */
+static void _drainPublishComplete( void * pCallbackContext,
+                                   IotMqttCallbackParam_t * pCallbackParam );
+
+/**
+ * @brief Schedule forwarding on the connection of a queue, if the store is
+ * not empty.
+ *
+ * The queue mutex must be held.
+ *
+ * @param[in] pQueue The offline queue.
+ */
+static void _resumeDrain( IotMqttOfflineQueue_t * pQueue );
+
+/**
+ * @brief Remove the oldest records from the store while they are sent.
+ *
+ * The store can only remove its oldest record, so a record sent before an
+ * older one waiting for its PUBACK stays in the store until that PUBACK.
+ * The queue mutex must be held.
+ *
+ * @param[in] pQueue The offline queue.
+ */
+static void _removeSentRecords( IotMqttOfflineQueue_t * pQueue );
+
+/**
+ * @brief Copy bytes into the RAM store, wrapping at the end of its buffer.
+ *
+ * @param[in] pRamStore The RAM store.
+ * @param[in] offset Offset from the oldest record where the bytes go.
+ * @param[in] pData The bytes to copy.
+ * @param[in] length Number of bytes.
+ */
+static void _ramStoreWrite( IotMqttOfflineRamStore_t * pRamStore,
+                            size_t offset,
+                            const uint8_t * pData,
+                            size_t length );
+
+/**
+ * @brief Copy bytes out of the RAM store, wrapping at the end of its buffer.
+ *
+ * @param[in] pRamStore The RAM store.
+ * @param[in] offset Offset from the oldest record where the bytes are.
+ * @param[out] pData Where to copy the bytes.
+ * @param[in] length Number of bytes.
+ */
+static void _ramStoreRead( const IotMqttOfflineRamStore_t * pRamStore,
+                           size_t offset,
+                           uint8_t * pData,
+                           size_t length );
+
+/**
+ * @brief Read the length of a record in the RAM store.
+ *
+ * @param[in] pRamStore The RAM store.
+ * @param[in] offset Offset from the oldest record where the record is; it
+ * must be less than the bytes taken by records.
+ *
+ * @return Length of the record.
+ */
+static size_t _ramStoreLength( const IotMqttOfflineRamStore_t * pRamStore,
+                               size_t offset );
+
+/**
+ * @brief The push function of #IotMqttOfflineStoreRam.
+ *
+ * @param[in] pStoreContext An #IotMqttOfflineRamStore_t.
+ * @param[in] pRecord The record to append.
+ * @param[in] recordLength Length of `pRecord`.
+ *
+ * @return `true` if the record was stored; `false` if the store is full.
+ */
+static bool _ramStorePush( void * pStoreContext,
+                           const uint8_t * pRecord,
+                           size_t recordLength );
+
+/**
+ * @brief The peek function of #IotMqttOfflineStoreRam.
+ *
+ * @param[in] pStoreContext An #IotMqttOfflineRamStore_t.
+ * @param[in] index Position of the record; 0 is the oldest record.
+ * @param[out] pBuffer Where to copy the record.
+ * @param[in] bufferSize Size of `pBuffer`.
+ *
+ * @return Length of the record; 0 if the store holds `index` records or fewer.
+ */
+static size_t _ramStorePeek( void * pStoreContext,
+                             size_t index,
+                             uint8_t * pBuffer,
+                             size_t bufferSize );
+
+/**
+ * @brief The pop function of #IotMqttOfflineStoreRam.
+ *
+ * @param[in] pStoreContext An #IotMqttOfflineRamStore_t.
+ */
+static void _ramStorePop( void * pStoreContext );
+
+/*-----------------------------------------------------------*/
+
+const IotMqttOfflineStore_t IotMqttOfflineStoreRam =
+{
+    .push = _ramStorePush,
+    .peek = _ramStorePeek,
+    .pop  = _ramStorePop
+};
+
+/*-----------------------------------------------------------*/
+
+static size_t _encodeRecord( IotMqttOfflineQueue_t * pQueue,
+                             const IotMqttPublishInfo_t * pPublishInfo )
+{
+    size_t recordLength = OFFLINE_RECORD_HEADER_LENGTH +
+                          ( size_t ) pPublishInfo->topicNameLength +
+                          pPublishInfo->payloadLength;
+    uint8_t * pRecord = pQueue->info.pRecordBuffer;
+    uint32_t payloadLength = ( uint32_t ) pPublishInfo->payloadLength;
+
+    if( recordLength > pQueue->info.recordBufferSize )
+    {
+        IotLogError( "(Offline queue %p) PUBLISH of %lu bytes does not fit in a record buffer of %lu bytes.",
+                     pQueue,
+                     ( unsigned long ) recordLength,
+                     ( unsigned long ) pQueue->info.recordBufferSize );
+
+        recordLength = 0;
+    }
+    else
+    {
+        pRecord[ 0 ] = 0;
+
+        if( pPublishInfo->qos == IOT_MQTT_QOS_1 )
+        {
+            pRecord[ 0 ] |= OFFLINE_RECORD_FLAG_QOS1;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        if( pPublishInfo->retain == true )
+        {
+            pRecord[ 0 ] |= OFFLINE_RECORD_FLAG_RETAIN;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        pRecord[ 1 ] = ( uint8_t ) ( pPublishInfo->topicNameLength >> 8 );
+        pRecord[ 2 ] = ( uint8_t ) ( pPublishInfo->topicNameLength & 0x00ffU );
+        pRecord[ 3 ] = ( uint8_t ) ( payloadLength >> 24 );
+        pRecord[ 4 ] = ( uint8_t ) ( ( payloadLength >> 16 ) & 0x00ffU );
+        pRecord[ 5 ] = ( uint8_t ) ( ( payloadLength >> 8 ) & 0x00ffU );
+        pRecord[ 6 ] = ( uint8_t ) ( payloadLength & 0x00ffU );
+
+        ( void ) memcpy( pRecord + OFFLINE_RECORD_HEADER_LENGTH,
+                         pPublishInfo->pTopicName,
+                         pPublishInfo->topicNameLength );
+
+        if( pPublishInfo->payloadLength > 0U )
+        {
+            ( void ) memcpy( pRecord + OFFLINE_RECORD_HEADER_LENGTH + pPublishInfo->topicNameLength,
+                             pPublishInfo->pPayload,
+                             pPublishInfo->payloadLength );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+
+    return recordLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _decodeRecord( IotMqttOfflineQueue_t * pQueue,
+                           size_t recordLength,
+                           IotMqttPublishInfo_t * pPublishInfo )
+{
+    bool status = false;
+    const uint8_t * pRecord = pQueue->info.pRecordBuffer;
+    uint16_t topicNameLength = 0;
+    uint32_t payloadLength = 0;
+
+    if( recordLength >= OFFLINE_RECORD_HEADER_LENGTH )
+    {
+        topicNameLength = ( uint16_t ) ( ( ( uint16_t ) pRecord[ 1 ] << 8 ) | pRecord[ 2 ] );
+        payloadLength = ( ( uint32_t ) pRecord[ 3 ] << 24 ) |
+                        ( ( uint32_t ) pRecord[ 4 ] << 16 ) |
+                        ( ( uint32_t ) pRecord[ 5 ] << 8 ) |
+                        ( uint32_t ) pRecord[ 6 ];
+
+        status = ( topicNameLength > 0U ) &&
+                 ( recordLength == ( OFFLINE_RECORD_HEADER_LENGTH + ( size_t ) topicNameLength + ( size_t ) payloadLength ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( status == true )
+    {
+        pPublishInfo->qos = ( ( pRecord[ 0 ] & OFFLINE_RECORD_FLAG_QOS1 ) != 0U ) ? IOT_MQTT_QOS_1 : IOT_MQTT_QOS_0;
+        pPublishInfo->retain = ( ( pRecord[ 0 ] & OFFLINE_RECORD_FLAG_RETAIN ) != 0U );
+        pPublishInfo->pTopicName = ( const char * ) ( pRecord + OFFLINE_RECORD_HEADER_LENGTH );
+        pPublishInfo->topicNameLength = topicNameLength;
+        pPublishInfo->pPayload = pRecord + OFFLINE_RECORD_HEADER_LENGTH + topicNameLength;
+        pPublishInfo->payloadLength = payloadLength;
+    }
+    else
+    {
+        IotLogWarn( "(Offline queue %p) Discarding malformed record of %lu bytes.",
+                    pQueue,
+                    ( unsigned long ) recordLength );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _scheduleDrain( _mqttConnection_t * pMqttConnection,
+                            uint32_t delayMs )
+{
+    IotTaskPoolError_t taskPoolStatus = IOT_TASKPOOL_SUCCESS;
+
+    /* Only one drain job runs per connection. */
+    if( pMqttConnection->offlineDrainScheduled == false )
+    {
+        /* The drain job references the connection. This fails once the
+         * connection is closed, which stops forwarding. */
+        if( _IotMqtt_IncrementConnectionReferences( pMqttConnection ) == true )
+        {
+            taskPoolStatus = IotTaskPool_CreateJob( _processDrain,
+                                                    pMqttConnection,
+                                                    &( pMqttConnection->offlineJobStorage ),
+                                                    &( pMqttConnection->offlineJob ) );
+            IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
+
+            /* Forwarding a backlog is bulk work; it must not delay keep-alive. */
+            taskPoolStatus = IotTaskPool_SetJobClass( pMqttConnection->offlineJob,
+                                                      IOT_TASKPOOL_JOB_CLASS_BULK );
+            IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
+
+            taskPoolStatus = IotTaskPool_ScheduleDeferred( IOT_SYSTEM_TASKPOOL,
+                                                           pMqttConnection->offlineJob,
+                                                           delayMs );
+
+            if( taskPoolStatus == IOT_TASKPOOL_SUCCESS )
+            {
+                pMqttConnection->offlineDrainScheduled = true;
+            }
+            else
+            {
+                IotLogWarn( "(MQTT connection %p) Failed to schedule forwarding of offline queue, error %s.",
+                            pMqttConnection,
+                            IotTaskPool_strerror( taskPoolStatus ) );
+
+                /* The caller also references the connection, so this does not
+                 * destroy it. */
+                _IotMqtt_DecrementConnectionReferences( pMqttConnection );
+            }
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _processDrain( IotTaskPool_t pTaskPool,
+                           IotTaskPoolJob_t pDrainJob,
+                           void * pContext )
+{
+    _mqttConnection_t * pMqttConnection = ( _mqttConnection_t * ) pContext;
+    IotMqttOfflineQueue_t * pQueue = pMqttConnection->pOfflineQueue;
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttCallbackInfo_t callbackInfo = IOT_MQTT_CALLBACK_INFO_INITIALIZER;
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+    size_t recordLength = 0;
+    uint32_t index = 0;
+    uint32_t recordBit = 0;
+    uint32_t forwarded = 0;
+    bool reschedule = false;
+
+    /* Check parameters. The task pool and job parameter is not used when asserts
+     * are disabled. */
+    ( void ) pTaskPool;
+    ( void ) pDrainJob;
+    IotMqtt_Assert( pTaskPool == IOT_SYSTEM_TASKPOOL );
+    IotMqtt_Assert( pDrainJob == pMqttConnection->offlineJob );
+    IotMqtt_Assert( pQueue != NULL );
+
+    IotMutex_Lock( &( pQueue->mutex ) );
+
+    pMqttConnection->offlineDrainScheduled = false;
+
+    /* Stop if a newer connection took over the queue, or if stored records
+     * sent by a previous connection wait for their PUBACK. Their completion
+     * resumes forwarding. */
+    if( ( pQueue->connection == pMqttConnection ) &&
+        ( ( pQueue->sending == NULL ) || ( pQueue->sending == pMqttConnection ) ) )
+    {
+        reschedule = true;
+
+        /* Send the oldest drainBatch records that are neither sent nor waiting
+         * for their PUBACK. QoS 1 records wait for their PUBACK together. */
+        for( index = 0; index < pQueue->info.drainBatch; index++ )
+        {
+            recordBit = ( uint32_t ) 1U << index;
+
+            if( ( ( pQueue->pendingRecords | pQueue->sentRecords ) & recordBit ) == 0U )
+            {
+                recordLength = pQueue->info.pStore->peek( pQueue->info.pStoreContext,
+                                                          index,
+                                                          pQueue->info.pRecordBuffer,
+                                                          pQueue->info.recordBufferSize );
+
+                if( recordLength == 0U )
+                {
+                    /* No more records. */
+                    reschedule = false;
+                    break;
+                }
+                else if( ( recordLength > pQueue->info.recordBufferSize ) ||
+                         ( _decodeRecord( pQueue, recordLength, &publishInfo ) == false ) )
+                {
+                    /* A record that cannot be read would block the queue forever.
+                     * Treat it as sent so that it is removed in order. */
+                    pQueue->sentRecords |= recordBit;
+                    ( pQueue->stats.droppedCount )++;
+                }
+                else if( publishInfo.qos == IOT_MQTT_QOS_1 )
+                {
+                    /* The record stays in the store until its PUBACK arrives.
+                     * The PUBLISH holds a slot of the in-flight window until
+                     * then. */
+                    publishInfo.retryMs = pQueue->info.retryMs;
+                    publishInfo.retryLimit = pQueue->info.retryLimit;
+                    callbackInfo.function = _drainPublishComplete;
+                    callbackInfo.pCallbackContext = ( void * ) ( uintptr_t ) ( pQueue->headSequence + index );
+
+                    /* Set before publishing; the completion waits for the queue
+                     * mutex. */
+                    pQueue->pendingRecords |= recordBit;
+                    pQueue->sending = pMqttConnection;
+
+                    status = IotMqtt_Publish( pMqttConnection, &publishInfo, 0, &callbackInfo, NULL );
+
+                    if( status == IOT_MQTT_STATUS_PENDING )
+                    {
+                        forwarded++;
+                    }
+                    else
+                    {
+                        /* Keep the record. A full in-flight window is retried in
+                         * the next batch; any other error means the connection
+                         * is unusable. */
+                        pQueue->pendingRecords &= ~recordBit;
+
+                        if( pQueue->pendingRecords == 0U )
+                        {
+                            pQueue->sending = NULL;
+                        }
+                        else
+                        {
+                            EMPTY_ELSE_MARKER;
+                        }
+
+                        reschedule = ( status == IOT_MQTT_WOULD_BLOCK );
+                        break;
+                    }
+                }
+                else
+                {
+                    status = IotMqtt_Publish( pMqttConnection, &publishInfo, 0, NULL, NULL );
+
+                    if( status == IOT_MQTT_SUCCESS )
+                    {
+                        pQueue->sentRecords |= recordBit;
+                        ( pQueue->stats.forwardedCount )++;
+                        forwarded++;
+                    }
+                    else
+                    {
+                        /* Keep the record, as above. */
+                        reschedule = ( status == IOT_MQTT_WOULD_BLOCK );
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                /* The record was sent, or waits for its PUBACK. */
+                EMPTY_ELSE_MARKER;
+            }
+        }
+
+        _removeSentRecords( pQueue );
+
+        IotLogDebug( "(MQTT connection %p) Forwarded %lu PUBLISH messages from offline queue %p.",
+                     pMqttConnection,
+                     ( unsigned long ) forwarded,
+                     pQueue );
+
+        /* Records waiting for their PUBACK resume forwarding when they
+         * complete. */
+        if( ( reschedule == true ) && ( pQueue->pendingRecords == 0U ) )
+        {
+            _scheduleDrain( pMqttConnection, pQueue->info.drainIntervalMs );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IotMutex_Unlock( &( pQueue->mutex ) );
+
+    /* Release the reference this job held. */
+    _IotMqtt_DecrementConnectionReferences( pMqttConnection );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _drainPublishComplete( void * pCallbackContext,
+                                   IotMqttCallbackParam_t * pCallbackParam )
+{
+    _mqttConnection_t * pMqttConnection = pCallbackParam->mqttConnection;
+    IotMqttOfflineQueue_t * pQueue = pMqttConnection->pOfflineQueue;
+    uint32_t sequence = ( uint32_t ) ( uintptr_t ) pCallbackContext;
+    uint32_t recordBit = 0;
+
+    /* The PUBLISH holds a reference to its connection, and the connection
+     * keeps the queue in use, so the queue is valid here. */
+    IotMqtt_Assert( pQueue != NULL );
+
+    IotMutex_Lock( &( pQueue->mutex ) );
+
+    /* A record waiting for its PUBACK is not removed, so its position follows
+     * from its sequence number. */
+    IotMqtt_Assert( pQueue->sending == pMqttConnection );
+    IotMqtt_Assert( ( sequence - pQueue->headSequence ) < pQueue->info.drainBatch );
+    recordBit = ( uint32_t ) 1U << ( sequence - pQueue->headSequence );
+    IotMqtt_Assert( ( pQueue->pendingRecords & recordBit ) != 0U );
+
+    pQueue->pendingRecords &= ~recordBit;
+
+    if( pQueue->pendingRecords == 0U )
+    {
+        pQueue->sending = NULL;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( pCallbackParam->u.operation.result == IOT_MQTT_SUCCESS )
+    {
+        pQueue->sentRecords |= recordBit;
+        ( pQueue->stats.forwardedCount )++;
+    }
+    else
+    {
+        /* The record is sent again by the next batch, or by the next
+         * connection if this one is lost. */
+        IotLogWarn( "(MQTT connection %p) Stored PUBLISH from offline queue %p failed with %s; "
+                    "it will be sent again.",
+                    pMqttConnection,
+                    pQueue,
+                    IotMqtt_strerror( pCallbackParam->u.operation.result ) );
+    }
+
+    _removeSentRecords( pQueue );
+    _resumeDrain( pQueue );
+
+    IotMutex_Unlock( &( pQueue->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _resumeDrain( IotMqttOfflineQueue_t * pQueue )
+{
+    if( ( pQueue->connection != NULL ) &&
+        ( pQueue->info.pStore->peek( pQueue->info.pStoreContext, 0, NULL, 0 ) > 0U ) )
+    {
+        _scheduleDrain( pQueue->connection, pQueue->info.drainIntervalMs );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _removeSentRecords( IotMqttOfflineQueue_t * pQueue )
+{
+    while( ( pQueue->sentRecords & 1U ) != 0U )
+    {
+        pQueue->info.pStore->pop( pQueue->info.pStoreContext );
+
+        /* Every record moves one position closer to the oldest. */
+        pQueue->sentRecords >>= 1;
+        pQueue->pendingRecords >>= 1;
+        ( pQueue->headSequence )++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _ramStoreWrite( IotMqttOfflineRamStore_t * pRamStore,
+                            size_t offset,
+                            const uint8_t * pData,
+                            size_t length )
+{
+    size_t start = ( pRamStore->head + offset ) % pRamStore->bufferSize;
+    size_t firstPart = pRamStore->bufferSize - start;
+
+    if( firstPart > length )
+    {
+        firstPart = length;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    ( void ) memcpy( pRamStore->pBuffer + start, pData, firstPart );
+    ( void ) memcpy( pRamStore->pBuffer, pData + firstPart, length - firstPart );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _ramStoreRead( const IotMqttOfflineRamStore_t * pRamStore,
+                           size_t offset,
+                           uint8_t * pData,
+                           size_t length )
+{
+    size_t start = ( pRamStore->head + offset ) % pRamStore->bufferSize;
+    size_t firstPart = pRamStore->bufferSize - start;
+
+    if( firstPart > length )
+    {
+        firstPart = length;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    ( void ) memcpy( pData, pRamStore->pBuffer + start, firstPart );
+    ( void ) memcpy( pData + firstPart, pRamStore->pBuffer, length - firstPart );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _ramStoreLength( const IotMqttOfflineRamStore_t * pRamStore,
+                               size_t offset )
+{
+    uint8_t prefix[ RAM_RECORD_PREFIX_LENGTH ] = { 0 };
+
+    _ramStoreRead( pRamStore, offset, prefix, RAM_RECORD_PREFIX_LENGTH );
+
+    return ( ( size_t ) prefix[ 0 ] << 24 ) |
+           ( ( size_t ) prefix[ 1 ] << 16 ) |
+           ( ( size_t ) prefix[ 2 ] << 8 ) |
+           ( size_t ) prefix[ 3 ];
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _ramStorePush( void * pStoreContext,
+                           const uint8_t * pRecord,
+                           size_t recordLength )
+{
+    bool status = false;
+    IotMqttOfflineRamStore_t * pRamStore = ( IotMqttOfflineRamStore_t * ) pStoreContext;
+    uint8_t prefix[ RAM_RECORD_PREFIX_LENGTH ] = { 0 };
+
+    if( ( recordLength > 0U ) &&
+        ( recordLength <= ( pRamStore->bufferSize - pRamStore->usedBytes ) ) &&
+        ( RAM_RECORD_PREFIX_LENGTH <= ( pRamStore->bufferSize - pRamStore->usedBytes - recordLength ) ) )
+    {
+        prefix[ 0 ] = ( uint8_t ) ( ( uint32_t ) recordLength >> 24 );
+        prefix[ 1 ] = ( uint8_t ) ( ( ( uint32_t ) recordLength >> 16 ) & 0x00ffU );
+        prefix[ 2 ] = ( uint8_t ) ( ( ( uint32_t ) recordLength >> 8 ) & 0x00ffU );
+        prefix[ 3 ] = ( uint8_t ) ( ( uint32_t ) recordLength & 0x00ffU );
+
+        _ramStoreWrite( pRamStore, pRamStore->usedBytes, prefix, RAM_RECORD_PREFIX_LENGTH );
+        _ramStoreWrite( pRamStore, pRamStore->usedBytes + RAM_RECORD_PREFIX_LENGTH, pRecord, recordLength );
+        pRamStore->usedBytes += RAM_RECORD_PREFIX_LENGTH + recordLength;
+
+        status = true;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _ramStorePeek( void * pStoreContext,
+                             size_t index,
+                             uint8_t * pBuffer,
+                             size_t bufferSize )
+{
+    size_t recordLength = 0;
+    size_t offset = 0;
+    size_t skipped = 0;
+    const IotMqttOfflineRamStore_t * pRamStore = ( const IotMqttOfflineRamStore_t * ) pStoreContext;
+
+    /* Skip the records before the requested one. */
+    while( ( skipped < index ) && ( offset < pRamStore->usedBytes ) )
+    {
+        offset += RAM_RECORD_PREFIX_LENGTH + _ramStoreLength( pRamStore, offset );
+        skipped++;
+    }
+
+    if( offset < pRamStore->usedBytes )
+    {
+        recordLength = _ramStoreLength( pRamStore, offset );
+
+        if( recordLength <= bufferSize )
+        {
+            _ramStoreRead( pRamStore, offset + RAM_RECORD_PREFIX_LENGTH, pBuffer, recordLength );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return recordLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _ramStorePop( void * pStoreContext )
+{
+    size_t recordLength = 0;
+    IotMqttOfflineRamStore_t * pRamStore = ( IotMqttOfflineRamStore_t * ) pStoreContext;
+
+    if( pRamStore->usedBytes > 0U )
+    {
+        recordLength = _ramStoreLength( pRamStore, 0 ) + RAM_RECORD_PREFIX_LENGTH;
+
+        pRamStore->head = ( pRamStore->head + recordLength ) % pRamStore->bufferSize;
+        pRamStore->usedBytes -= recordLength;
+
+        /* Restart at the beginning of the buffer once it is empty. */
+        if( pRamStore->usedBytes == 0U )
+        {
+            pRamStore->head = 0;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_AttachOfflineQueue( _mqttConnection_t * pMqttConnection,
+                                  IotMqttOfflineQueue_t * pQueue )
+{
+    _mqttConnection_t * pPreviousConnection = NULL;
+    bool previousConnected = false;
+
+    IotMutex_Lock( &( pQueue->mutex ) );
+
+    /* The queue must remain valid until this connection is destroyed. */
+    pMqttConnection->pOfflineQueue = pQueue;
+    ( pQueue->users )++;
+
+    /* A connection that was closed but not yet destroyed may still be set. */
+    pPreviousConnection = pQueue->connection;
+
+    if( pPreviousConnection != NULL )
+    {
+        IotMutex_Lock( &( pPreviousConnection->referencesMutex ) );
+        previousConnected = ( pPreviousConnection->disconnected == false );
+        IotMutex_Unlock( &( pPreviousConnection->referencesMutex ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( previousConnected == true )
+    {
+        IotLogWarn( "(MQTT connection %p) Offline queue %p is already forwarded by connection %p.",
+                    pMqttConnection,
+                    pQueue,
+                    pPreviousConnection );
+    }
+    else
+    {
+        pQueue->connection = pMqttConnection;
+
+        /* Forward anything stored while no connection was available. */
+        if( pQueue->info.pStore->peek( pQueue->info.pStoreContext, 0, NULL, 0 ) > 0U )
+        {
+            _scheduleDrain( pMqttConnection, 0 );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+
+    IotMutex_Unlock( &( pQueue->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_DetachOfflineQueue( _mqttConnection_t * pMqttConnection )
+{
+    IotMqttOfflineQueue_t * pQueue = pMqttConnection->pOfflineQueue;
+
+    if( pQueue != NULL )
+    {
+        IotMutex_Lock( &( pQueue->mutex ) );
+
+        /* A connection being destroyed has no drain job, because the job holds
+         * a reference to the connection. */
+        IotMqtt_Assert( pMqttConnection->offlineDrainScheduled == false );
+
+        if( pQueue->connection == pMqttConnection )
+        {
+            pQueue->connection = NULL;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        /* Stored PUBLISH messages destroyed with this connection may not have
+         * invoked their completion. Let the connection that took over the queue
+         * send them again. */
+        if( pQueue->sending == pMqttConnection )
+        {
+            pQueue->sending = NULL;
+            pQueue->pendingRecords = 0;
+            _resumeDrain( pQueue );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        IotMqtt_Assert( pQueue->users > 0U );
+        ( pQueue->users )--;
+
+        IotMutex_Unlock( &( pQueue->mutex ) );
+
+        pMqttConnection->pOfflineQueue = NULL;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_OfflineQueueInit( IotMqttOfflineQueue_t * pQueue,
+                                         const IotMqttOfflineQueueInfo_t * pQueueInfo )
+{
+    IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
+
+    if( ( pQueue == NULL ) || ( pQueueInfo == NULL ) )
+    {
+        IotLogError( "Offline queue and its parameters must not be NULL." );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( ( pQueueInfo->pStore == NULL ) ||
+        ( pQueueInfo->pStore->push == NULL ) ||
+        ( pQueueInfo->pStore->peek == NULL ) ||
+        ( pQueueInfo->pStore->pop == NULL ) )
+    {
+        IotLogError( "Offline queue store must set all of its functions." );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( ( pQueueInfo->pRecordBuffer == NULL ) ||
+        ( pQueueInfo->recordBufferSize <= OFFLINE_RECORD_HEADER_LENGTH ) )
+    {
+        IotLogError( "Offline queue record buffer must be larger than %u bytes.",
+                     ( unsigned int ) OFFLINE_RECORD_HEADER_LENGTH );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( ( pQueueInfo->drainBatch == 0U ) || ( pQueueInfo->drainBatch > OFFLINE_QUEUE_MAX_DRAIN_BATCH ) )
+    {
+        IotLogError( "Offline queue must forward between 1 and %u PUBLISH messages per batch.",
+                     ( unsigned int ) OFFLINE_QUEUE_MAX_DRAIN_BATCH );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    ( void ) memset( pQueue, 0x00, sizeof( IotMqttOfflineQueue_t ) );
+    pQueue->info = *pQueueInfo;
+
+    /* The mutex is recursive. Destroying a connection detaches it from the
+     * queue, and that may happen inside a publish made under this mutex. */
+    if( IotMutex_Create( &( pQueue->mutex ), true ) == false )
+    {
+        IotLogError( "Failed to create mutex for offline queue." );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IOT_FUNCTION_EXIT_NO_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_OfflineQueueDestroy( IotMqttOfflineQueue_t * pQueue )
+{
+    bool inUse = true;
+
+    /* Connections that are not destroyed, and their drain jobs, may still use
+     * the queue. They release it shortly after being disconnected. */
+    while( inUse == true )
+    {
+        IotMutex_Lock( &( pQueue->mutex ) );
+        inUse = ( pQueue->users > 0U );
+        IotMutex_Unlock( &( pQueue->mutex ) );
+
+        if( inUse == true )
+        {
+            IotClock_SleepMs( 1 );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+
+    IotMutex_Destroy( &( pQueue->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_OfflinePublish( IotMqttOfflineQueue_t * pQueue,
+                                       const IotMqttPublishInfo_t * pPublishInfo )
+{
+    IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_STATUS_PENDING );
+    size_t recordLength = 0;
+    bool queueLocked = false;
+    _mqttConnection_t * pMqttConnection = NULL;
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+
+    if( ( pQueue == NULL ) || ( pPublishInfo == NULL ) )
+    {
+        IotLogError( "Offline queue and PUBLISH information must not be NULL." );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* A record does not keep the retransmission settings of its message;
+     * stored QoS 1 messages use those of the queue. */
+    publishInfo = *pPublishInfo;
+    publishInfo.retryMs = 0;
+    publishInfo.retryLimit = 0;
+
+    if( _IotMqtt_ValidatePublish( false, &publishInfo ) == false )
+    {
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IotMutex_Lock( &( pQueue->mutex ) );
+    queueLocked = true;
+
+    /* Publish right away if a connection is available and nothing stored is
+     * waiting ahead of this message. */
+    pMqttConnection = pQueue->connection;
+
+    if( ( pMqttConnection != NULL ) &&
+        ( pQueue->info.pStore->peek( pQueue->info.pStoreContext, 0, NULL, 0 ) == 0U ) )
+    {
+        status = IotMqtt_Publish( pMqttConnection, &publishInfo, 0, NULL, NULL );
+
+        if( ( status == IOT_MQTT_SUCCESS ) || ( status == IOT_MQTT_STATUS_PENDING ) )
+        {
+            ( pQueue->stats.forwardedCount )++;
+
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_SUCCESS );
+        }
+        else if( status == IOT_MQTT_BAD_PARAMETER )
+        {
+            IOT_GOTO_CLEANUP();
+        }
+        else
+        {
+            IotLogDebug( "(Offline queue %p) Storing PUBLISH after send failed with %s.",
+                         pQueue,
+                         IotMqtt_strerror( status ) );
+
+            status = IOT_MQTT_STATUS_PENDING;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    recordLength = _encodeRecord( pQueue, &publishInfo );
+
+    if( recordLength == 0U )
+    {
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( pQueue->info.pStore->push( pQueue->info.pStoreContext,
+                                   pQueue->info.pRecordBuffer,
+                                   recordLength ) == false )
+    {
+        IotLogWarn( "(Offline queue %p) Store is full; PUBLISH dropped.", pQueue );
+
+        ( pQueue->stats.droppedCount )++;
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
+    }
+    else
+    {
+        ( pQueue->stats.storedCount )++;
+    }
+
+    /* Read the connection again; it may have been detached by the publish
+     * above. A connection that can no longer be referenced is not drained. */
+    pMqttConnection = pQueue->connection;
+
+    if( pMqttConnection != NULL )
+    {
+        _scheduleDrain( pMqttConnection, pQueue->info.drainIntervalMs );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IOT_FUNCTION_CLEANUP_BEGIN();
+
+    if( queueLocked == true )
+    {
+        IotMutex_Unlock( &( pQueue->mutex ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IOT_FUNCTION_CLEANUP_END();
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_OfflineQueueGetStats( IotMqttOfflineQueue_t * pQueue,
+                                             IotMqttOfflineQueueStats_t * pStats )
+{
+    IotMqttError_t status = IOT_MQTT_BAD_PARAMETER;
+
+    if( ( pQueue != NULL ) && ( pStats != NULL ) )
+    {
+        IotMutex_Lock( &( pQueue->mutex ) );
+        *pStats = pQueue->stats;
+        IotMutex_Unlock( &( pQueue->mutex ) );
+
+        status = IOT_MQTT_SUCCESS;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_OfflineRamStoreInit( IotMqttOfflineRamStore_t * pRamStore,
+                                  uint8_t * pBuffer,
+                                  size_t bufferSize )
+{
+    ( void ) memset( pRamStore, 0x00, sizeof( IotMqttOfflineRamStore_t ) );
+    pRamStore->pBuffer = pBuffer;
+    pRamStore->bufferSize = bufferSize;
+}
+
+/*-----------------------------------------------------------*/
@@ -44,6 +44,9 @@
 #include "platform/iot_clock.h"
 #include "platform/iot_threads.h"
 
+/* Atomics include. */
+#include "iot_atomic.h"
+
 /* Using initialized connToContext variable. */
 extern _connContext_t connToContext[ MAX_NO_OF_MQTT_CONNECTIONS ];
 
@@ -94,6 +97,55 @@ static bool _checkRetryLimit( _mqttOperation_t * pOperation );
  */
 static bool _scheduleNextRetry( _mqttOperation_t * pOperation );
 
+/**
+ * @brief Get the list that holds the operations awaiting a server response
+ * with a packet identifier.
+ *
+ * @param[in] pMqttConnection The MQTT connection of the operations.
+ * @param[in] packetIdentifier The packet identifier of the operations.
+ *
+ * @return The list in #_mqttConnection_t.pendingResponse for `packetIdentifier`.
+ */
+static IotListDouble_t * _pendingResponseList( _mqttConnection_t * pMqttConnection,
+                                               uint16_t packetIdentifier );
+
+/**
+ * @brief Update the round-trip time estimate of a connection with an
+ * acknowledged operation.
+ *
+ * The estimate follows the TCP retransmission timer (RFC 6298). Operations that
+ * were retransmitted are not measured, since their acknowledgement may be for
+ * any of the transmissions. The references mutex must be held.
+ *
+ * @param[in] pMqttConnection The MQTT connection of the operation.
+ * @param[in] pOperation The operation whose response was received.
+ */
+static void _sampleRoundTrip( _mqttConnection_t * pMqttConnection,
+                              const _mqttOperation_t * pOperation );
+
+/**
+ * @brief Take a free record from the operation pool of a connection.
+ *
+ * Counts the pool hit or miss.
+ *
+ * @param[in] pMqttConnection The MQTT connection that needs an operation.
+ * @param[out] pPacketArea Set to the free packet area of the record taken.
+ *
+ * @return A record of the pool; `NULL` if none is free.
+ */
+static _mqttOperation_t * _takePooledOperation( _mqttConnection_t * pMqttConnection,
+                                                _mqttOperationPacket_t ** pPacketArea );
+
+/**
+ * @brief Return an operation record to the pool of its connection, or free it
+ * if it was allocated.
+ *
+ * @param[in] pMqttConnection The MQTT connection of the operation.
+ * @param[in] pOperation The operation record to release.
+ */
+static void _releaseOperation( _mqttConnection_t * pMqttConnection,
+                               _mqttOperation_t * pOperation );
+
 /*-----------------------------------------------------------*/
 
 static bool _mqttOperation_match( const IotLink_t * pOperationLink,
@@ -225,16 +277,39 @@ static bool _scheduleNextRetry( _mqttOperation_t * pOperation )
      * next retry period. */
     if( pOperation->u.operation.retry.count > pOperation->u.operation.retry.limit )
     {
-        scheduleDelay = IOT_MQTT_RESPONSE_WAIT_MS;
+        scheduleDelay = _IotMqtt_ResponseWaitMs( pMqttConnection );
 
         IotLogDebug( "(MQTT connection %p, PUBLISH operation %p) Final retry was sent. Will check "
-                     "for response in %d ms.",
+                     "for response in %lu ms.",
                      pMqttConnection,
                      pOperation,
-                     IOT_MQTT_RESPONSE_WAIT_MS );
+                     ( unsigned long ) scheduleDelay );
     }
     else
     {
+        /* Once round trips were measured on this connection, the first retry
+         * waits for the retransmission timeout instead of the fixed retry
+         * period. Later retries back off from there. */
+        if( pOperation->u.operation.retry.count == 1 )
+        {
+            IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+            if( pMqttConnection->rttStats.sampleCount > 0U )
+            {
+                pOperation->u.operation.retry.nextPeriod = _IotMqtt_ResponseWaitMs( pMqttConnection );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+
+            IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
         scheduleDelay = pOperation->u.operation.retry.nextPeriod;
 
         /* Double the retry period, subject to a ceiling value. */
@@ -280,6 +355,8 @@ static bool _scheduleNextRetry( _mqttOperation_t * pOperation )
     /* Check for successful reschedule. */
     if( status == IOT_MQTT_SUCCESS )
     {
+        IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_RETRY_SCHEDULED );
+
         /* Move a successfully rescheduled PUBLISH from the pending processing
          * list to the pending responses list on the first retry. */
         if( firstRetry == true )
@@ -288,9 +365,7 @@ static bool _scheduleNextRetry( _mqttOperation_t * pOperation )
             IotMqtt_Assert( IotLink_IsLinked( &( pOperation->link ) ) == true );
 
             /* Transfer to pending response list. */
-            IotListDouble_Remove( &( pOperation->link ) );
-            IotListDouble_InsertHead( &( pMqttConnection->pendingResponse ),
-                                      &( pOperation->link ) );
+            _IotMqtt_AddPendingResponse( pOperation );
         }
         else
         {
@@ -318,6 +393,242 @@ static bool _scheduleNextRetry( _mqttOperation_t * pOperation )
 
 /*-----------------------------------------------------------*/
 
+static IotListDouble_t * _pendingResponseList( _mqttConnection_t * pMqttConnection,
+                                               uint16_t packetIdentifier )
+{
+    /* The number of lists is a power of 2, so the low bits of the packet
+     * identifier select a list. Packet identifiers are assigned in sequence,
+     * which spreads outstanding operations evenly across the lists. */
+    return &( pMqttConnection->pendingResponse[ packetIdentifier & ( MQTT_PENDING_RESPONSE_BUCKETS - 1 ) ] );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _sampleRoundTrip( _mqttConnection_t * pMqttConnection,
+                              const _mqttOperation_t * pOperation )
+{
+    uint64_t now = IotClock_GetTimeMs();
+    uint32_t rttMs = 0, deviation = 0;
+    int64_t delta = 0;
+    IotMqttRttStats_t * pStats = &( pMqttConnection->rttStats );
+
+    /* Only operations that were sent once are measured (Karn's algorithm). */
+    if( ( pOperation->u.operation.sendTime != 0U ) &&
+        ( pOperation->u.operation.retry.count == 0U ) &&
+        ( now >= pOperation->u.operation.sendTime ) )
+    {
+        rttMs = ( uint32_t ) ( now - pOperation->u.operation.sendTime );
+
+        if( pStats->sampleCount == 0U )
+        {
+            /* The first measurement sets SRTT = R and RTTVAR = R / 2. */
+            pMqttConnection->srttScaled = rttMs << 3;
+            pMqttConnection->rttVarScaled = rttMs << 1;
+            pStats->minRttMs = rttMs;
+            pStats->maxRttMs = rttMs;
+        }
+        else
+        {
+            /* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, then SRTT = 7/8 SRTT + 1/8 R.
+             * The scaled values keep the fractions in integer math. */
+            delta = ( int64_t ) rttMs - ( int64_t ) ( pMqttConnection->srttScaled >> 3 );
+            deviation = ( uint32_t ) ( ( delta < 0 ) ? -delta : delta );
+
+            pMqttConnection->rttVarScaled = pMqttConnection->rttVarScaled - ( pMqttConnection->rttVarScaled >> 2 ) + deviation;
+            pMqttConnection->srttScaled = ( uint32_t ) ( ( int64_t ) pMqttConnection->srttScaled + delta );
+
+            if( rttMs < pStats->minRttMs )
+            {
+                pStats->minRttMs = rttMs;
+            }
+            else if( rttMs > pStats->maxRttMs )
+            {
+                pStats->maxRttMs = rttMs;
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+
+        ( pStats->sampleCount )++;
+        pStats->lastRttMs = rttMs;
+        pStats->smoothedRttMs = pMqttConnection->srttScaled >> 3;
+        pStats->rttVariationMs = pMqttConnection->rttVarScaled >> 2;
+        pStats->retransmitTimeoutMs = _IotMqtt_ResponseWaitMs( pMqttConnection );
+
+        IotLogDebug( "(MQTT connection %p) Round trip of %lu ms. Smoothed round-trip time "
+                     "is %lu ms, retransmission timeout is %lu ms.",
+                     pMqttConnection,
+                     ( unsigned long ) rttMs,
+                     ( unsigned long ) pStats->smoothedRttMs,
+                     ( unsigned long ) pStats->retransmitTimeoutMs );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static _mqttOperation_t * _takePooledOperation( _mqttConnection_t * pMqttConnection,
+                                                _mqttOperationPacket_t ** pPacketArea )
+{
+    _mqttOperation_t * pOperation = NULL;
+    _mqttOperationPool_t * pPool = NULL;
+    IotMqttOperationPoolStats_t * pStats = &( pMqttConnection->operationPoolStats );
+    int8_t contextIndex = _IotMqtt_getContextIndexFromConnection( pMqttConnection );
+    uint32_t i = 0;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    /* A connection without an MQTT context has no pool. */
+    if( contextIndex >= 0 )
+    {
+        pPool = &( connToContext[ contextIndex ].operationPool );
+
+        for( i = 0; i < ( uint32_t ) MQTT_OPERATION_POOL_SIZE; i++ )
+        {
+            if( ( pPool->inUse & ( ( uint32_t ) 1U << i ) ) == 0U )
+            {
+                pPool->inUse |= ( ( uint32_t ) 1U << i );
+                pOperation = &( pPool->operations[ i ] );
+
+                /* A packet left in the area by the previous user of the record
+                 * was released with it. */
+                pPool->packets[ i ].inUse = false;
+                *pPacketArea = &( pPool->packets[ i ] );
+                break;
+            }
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( pOperation != NULL )
+    {
+        pStats->operationHits++;
+        pStats->inUse++;
+
+        if( pStats->inUse > pStats->maxInUse )
+        {
+            pStats->maxInUse = pStats->inUse;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        pStats->operationMisses++;
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    return pOperation;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _releaseOperation( _mqttConnection_t * pMqttConnection,
+                               _mqttOperation_t * pOperation )
+{
+    _mqttOperationPool_t * pPool = NULL;
+    int8_t contextIndex = _IotMqtt_getContextIndexFromConnection( pMqttConnection );
+    uint32_t i = 0;
+    bool pooled = false;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    if( contextIndex >= 0 )
+    {
+        pPool = &( connToContext[ contextIndex ].operationPool );
+
+        for( i = 0; i < ( uint32_t ) MQTT_OPERATION_POOL_SIZE; i++ )
+        {
+            if( pOperation == &( pPool->operations[ i ] ) )
+            {
+                IotMqtt_Assert( ( pPool->inUse & ( ( uint32_t ) 1U << i ) ) != 0U );
+
+                pPool->inUse &= ~( ( uint32_t ) 1U << i );
+                pMqttConnection->operationPoolStats.inUse--;
+                pooled = true;
+                break;
+            }
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    if( pooled == false )
+    {
+        IotMqtt_FreeOperation( pOperation );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t _IotMqtt_ResponseWaitMs( _mqttConnection_t * pMqttConnection )
+{
+    uint32_t waitMs = IOT_MQTT_RESPONSE_WAIT_MS;
+    uint32_t variation = 0;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    if( pMqttConnection->rttStats.sampleCount > 0U )
+    {
+        /* RTO = SRTT + max( G, 4 * RTTVAR ), with a clock granularity G of 1 ms.
+         * The scaled variation is already 4 * RTTVAR. */
+        variation = pMqttConnection->rttVarScaled;
+
+        if( variation == 0U )
+        {
+            variation = 1U;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        waitMs = ( pMqttConnection->srttScaled >> 3 ) + variation;
+
+        if( waitMs < IOT_MQTT_RETRY_MS_FLOOR )
+        {
+            waitMs = IOT_MQTT_RETRY_MS_FLOOR;
+        }
+        else if( waitMs > IOT_MQTT_RETRY_MS_CEILING )
+        {
+            waitMs = IOT_MQTT_RETRY_MS_CEILING;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    return waitMs;
+}
+
+/*-----------------------------------------------------------*/
+
 IotMqttError_t _IotMqtt_CreateOperation( _mqttConnection_t * pMqttConnection,
                                          uint32_t flags,
                                          const IotMqttCallbackInfo_t * pCallbackInfo,
@@ -326,6 +637,7 @@ IotMqttError_t _IotMqtt_CreateOperation( _mqttConnection_t * pMqttConnection,
     IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
     bool decrementOnError = false;
     _mqttOperation_t * pOperation = NULL;
+    _mqttOperationPacket_t * pPacketArea = NULL;
     bool waitable = ( ( flags & IOT_MQTT_FLAG_WAITABLE ) == IOT_MQTT_FLAG_WAITABLE );
 
     /* If the waitable flag is set, make sure that there's no callback. */
@@ -366,8 +678,18 @@ IotMqttError_t _IotMqtt_CreateOperation( _mqttConnection_t * pMqttConnection,
         decrementOnError = true;
     }
 
-    /* Allocate memory for a new operation. */
-    pOperation = IotMqtt_MallocOperation( sizeof( _mqttOperation_t ) );
+    /* Take a record from the connection's pool, or allocate memory for a new
+     * operation if none is free. */
+    pOperation = _takePooledOperation( pMqttConnection, &pPacketArea );
+
+    if( pOperation == NULL )
+    {
+        pOperation = IotMqtt_MallocOperation( sizeof( _mqttOperation_t ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
 
     if( pOperation == NULL )
     {
@@ -384,6 +706,7 @@ IotMqttError_t _IotMqtt_CreateOperation( _mqttConnection_t * pMqttConnection,
 
         /* Initialize some members of the new operation. */
         pOperation->pMqttConnection = pMqttConnection;
+        pOperation->u.operation.pPacketArea = pPacketArea;
         pOperation->u.operation.jobReference = 1;
         pOperation->u.operation.flags = flags;
         pOperation->u.operation.status = IOT_MQTT_STATUS_PENDING;
@@ -448,7 +771,7 @@ IotMqttError_t _IotMqtt_CreateOperation( _mqttConnection_t * pMqttConnection,
 
         if( pOperation != NULL )
         {
-            IotMqtt_FreeOperation( pOperation );
+            _releaseOperation( pMqttConnection, pOperation );
         }
         else
         {
@@ -586,10 +909,25 @@ void _IotMqtt_DestroyOperation( _mqttOperation_t * pOperation )
                      pOperation );
     }
 
+    /* A QoS 1 PUBLISH that never received a PUBACK still holds its slot of the
+     * in-flight window. */
+    if( pOperation->u.operation.inflight == true )
+    {
+        pOperation->u.operation.inflight = false;
+        _IotMqtt_ReleaseInflight( pMqttConnection );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
 
-    /* Free any allocated MQTT packet. */
-    if( pOperation->u.operation.pMqttPacket != NULL )
+    /* Free any allocated MQTT packet. A packet in the packet area of a pooled
+     * operation is released with the operation. */
+    if( ( pOperation->u.operation.pMqttPacket != NULL ) &&
+        ( ( pOperation->u.operation.pPacketArea == NULL ) ||
+          ( pOperation->u.operation.pMqttPacket != pOperation->u.operation.pPacketArea->area.bytes ) ) )
     {
         #if IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1
             if( pMqttConnection->pSerializer != NULL )
@@ -645,7 +983,7 @@ void _IotMqtt_DestroyOperation( _mqttOperation_t * pOperation )
                  pOperation );
 
     /* Free the memory used to hold operation data. */
-    IotMqtt_FreeOperation( pOperation );
+    _releaseOperation( pMqttConnection, pOperation );
 
     /* Decrement the MQTT connection's reference count after destroying an
      * operation. */
@@ -654,6 +992,51 @@ void _IotMqtt_DestroyOperation( _mqttOperation_t * pOperation )
 
 /*-----------------------------------------------------------*/
 
+void * _IotMqtt_AllocateOperationPacket( _mqttOperation_t * pOperation,
+                                         size_t packetSize )
+{
+    void * pPacket = NULL;
+    _mqttOperationPacket_t * pPacketArea = pOperation->u.operation.pPacketArea;
+    IotMqttOperationPoolStats_t * pStats = &( pOperation->pMqttConnection->operationPoolStats );
+
+    if( ( pPacketArea != NULL ) &&
+        ( packetSize <= sizeof( pPacketArea->area.bytes ) ) &&
+        ( pPacketArea->inUse == false ) )
+    {
+        pPacketArea->inUse = true;
+        pPacket = pPacketArea->area.bytes;
+
+        ( void ) Atomic_Increment_u32( &( pStats->packetHits ) );
+    }
+    else
+    {
+        pPacket = IotMqtt_MallocMessage( packetSize );
+
+        ( void ) Atomic_Increment_u32( &( pStats->packetMisses ) );
+    }
+
+    return pPacket;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_FreeOperationPacket( _mqttOperation_t * pOperation,
+                                   void * pPacket )
+{
+    _mqttOperationPacket_t * pPacketArea = pOperation->u.operation.pPacketArea;
+
+    if( ( pPacketArea != NULL ) && ( pPacket == ( void * ) pPacketArea->area.bytes ) )
+    {
+        pPacketArea->inUse = false;
+    }
+    else
+    {
+        IotMqtt_FreeMessage( pPacket );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
                                 IotTaskPoolJob_t pKeepAliveJob,
                                 void * pContext )
@@ -677,7 +1060,7 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
 
     /* Only two values are valid for the next keep alive job delay. */
     IotMqtt_Assert( ( pMqttConnection->nextKeepAliveMs == pMqttConnection->keepAliveMs ) ||
-                    ( pMqttConnection->nextKeepAliveMs == IOT_MQTT_RESPONSE_WAIT_MS ) );
+                    ( pMqttConnection->nextKeepAliveMs == pMqttConnection->pingWaitMs ) );
 
     IotLogDebug( "(MQTT connection %p) Keep-alive job started.", pMqttConnection );
 
@@ -688,6 +1071,10 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
                                             &pKeepAliveJob );
     IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
 
+    taskPoolStatus = IotTaskPool_SetJobClass( pKeepAliveJob,
+                                              IOT_TASKPOOL_JOB_CLASS_CONTROL );
+    IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
+
     IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
 
     /* Determine whether to send a PINGREQ or check for PINGRESP. */
@@ -733,12 +1120,24 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
                  * clear the failure flag upon receiving a PINGRESP. */
                 pMqttConnection->keepAliveFailure = true;
 
-                /* Schedule a check for PINGRESP. */
-                pMqttConnection->nextKeepAliveMs = IOT_MQTT_RESPONSE_WAIT_MS;
+                /* Schedule a check for PINGRESP. The wait follows the measured
+                 * round-trip time, but must end well before the next PINGREQ. */
+                pMqttConnection->pingWaitMs = _IotMqtt_ResponseWaitMs( pMqttConnection );
 
-                IotLogDebug( "(MQTT connection %p) PINGREQ sent. Scheduling check for PINGRESP in %d ms.",
+                if( pMqttConnection->pingWaitMs >= pMqttConnection->keepAliveMs )
+                {
+                    pMqttConnection->pingWaitMs = pMqttConnection->keepAliveMs / 2U;
+                }
+                else
+                {
+                    EMPTY_ELSE_MARKER;
+                }
+
+                pMqttConnection->nextKeepAliveMs = pMqttConnection->pingWaitMs;
+
+                IotLogDebug( "(MQTT connection %p) PINGREQ sent. Scheduling check for PINGRESP in %lu ms.",
                              pMqttConnection,
-                             IOT_MQTT_RESPONSE_WAIT_MS );
+                             ( unsigned long ) pMqttConnection->pingWaitMs );
             }
         }
     }
@@ -754,7 +1153,7 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
              *
              * 1. To send a PINGREQ.
              * 2. To check that the corresponding PINGRESP is received within
-             * IOT_MQTT_RESPONSE_WAIT_MS.
+             * pMqttConnection->pingWaitMs.
              *
              * The way it differentiates between the two is by checking
              * pMqttConnection->nextKeepAliveMs:
@@ -762,14 +1161,14 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
              * If pMqttConnection->nextKeepAliveMs is set to pMqttConnection->keepAliveMs,
              * the invocation is for sending PINGREQ.
              * Otherwise, the invocation is for checking that PINGRESP is received
-             * within IOT_MQTT_RESPONSE_WAIT_MS.
+             * within pMqttConnection->pingWaitMs.
              *
              * Therefore, it is necessary to set pMqttConnection->nextKeepAliveMs
              * to pMqttConnection->keepAliveMs to ensure that PINGREQ is sent in
              * the next invocation. But we must ensure that the next time to send
              * PINGREQ is calculated from the moment last PINGREQ was sent and NOT
              * when we checked for PINGRESP. As a result we need to schedule the next
-             * invocation at pMqttConnection->keepAliveMs - IOT_MQTT_RESPONSE_WAIT_MS.
+             * invocation at pMqttConnection->keepAliveMs - pMqttConnection->pingWaitMs.
              * The following diagram also explains it:
              *
              *      WaitMS    KeepAliveMS - WaitMS
@@ -781,25 +1180,25 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
              * (Call 1)  (Call 2)             (Call 3)
              *    <------------------------------->
              *                 KeepAliveMS
-             * WaitMS = IOT_MQTT_RESPONSE_WAIT_MS.
+             * WaitMS = pMqttConnection->pingWaitMs.
              * KeepAliveMS = pMqttConnection->keepAliveMs.
              * Call 1 - First PINGREQ is sent.
-             * Call 2 - PINGRESP is checked after IOT_MQTT_RESPONSE_WAIT_MS.
+             * Call 2 - PINGRESP is checked after WaitMS.
              * Call 3 - Next PINGREQ is sent. Time difference between Call 2 and
              * Call 3 is KeepAliveMS - WaitMS, while time difference between Call 1
              * and Call 3 is KeepAliveMS. */
             pMqttConnection->nextKeepAliveMs = pMqttConnection->keepAliveMs;
 
-            IotMqtt_Assert( pMqttConnection->keepAliveMs > IOT_MQTT_RESPONSE_WAIT_MS );
+            IotMqtt_Assert( pMqttConnection->keepAliveMs > pMqttConnection->pingWaitMs );
 
             /* Subtract time taken for PINGRESP check. */
-            scheduleDelay = pMqttConnection->keepAliveMs - IOT_MQTT_RESPONSE_WAIT_MS;
+            scheduleDelay = pMqttConnection->keepAliveMs - pMqttConnection->pingWaitMs;
         }
         else
         {
-            IotLogError( "(MQTT connection %p) Failed to receive PINGRESP within %d ms.",
+            IotLogError( "(MQTT connection %p) Failed to receive PINGRESP within %lu ms.",
                          pMqttConnection,
-                         IOT_MQTT_RESPONSE_WAIT_MS );
+                         ( unsigned long ) pMqttConnection->pingWaitMs );
 
             /* The network receive callback did not clear the failure flag. */
             status = false;
@@ -889,26 +1288,79 @@ void _IotMqtt_ProcessIncomingPublish( IotTaskPool_t pTaskPool,
         EMPTY_ELSE_MARKER;
     }
 
+    /* Data lent by the network stack must be given back before the network
+     * connection is destroyed, so the MQTT connection is kept until the
+     * PUBLISH is freed. This job's own connection reference is released when
+     * the subscription callbacks return. */
+    if( pOperation->u.publish.pLendingConnection != NULL )
+    {
+        ( pOperation->pMqttConnection->references )++;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     IotMutex_Unlock( &( pOperation->pMqttConnection->referencesMutex ) );
 
+    /* This job holds the only reference to the PUBLISH until a subscription
+     * callback retains it. */
+    pOperation->u.publish.references = 1;
+
     /* Process the current PUBLISH. */
     callbackParam.u.message.info = pOperation->u.publish.publishInfo;
+    callbackParam.u.message.reference = pOperation;
 
     _IotMqtt_InvokeSubscriptionCallback( pOperation->pMqttConnection,
                                          &callbackParam );
 
-    /* Free any buffers associated with the current PUBLISH message. */
-    if( pOperation->u.publish.pReceivedData != NULL )
+    /* Free the incoming PUBLISH unless a subscription callback retained it. */
+    _IotMqtt_ReleaseIncomingPublish( pOperation );
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_ReleaseIncomingPublish( _mqttOperation_t * pOperation )
+{
+    _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
+    void * pLendingConnection = pOperation->u.publish.pLendingConnection;
+
+    IotMqtt_Assert( pOperation->incomingPublish == true );
+    IotMqtt_Assert( pOperation->u.publish.references > 0U );
+
+    /* Free the PUBLISH when its last reference is released. Atomic_Decrement_u32
+     * returns the reference count before decrementing. */
+    if( Atomic_Decrement_u32( &( pOperation->u.publish.references ) ) == 1U )
     {
-        IotMqtt_FreeMessage( ( void * ) pOperation->u.publish.pReceivedData );
+        /* Free any buffers associated with the PUBLISH message. */
+        if( pOperation->u.publish.pReceivedData != NULL )
+        {
+            _IotMqtt_FreeReceivedData( pMqttConnection,
+                                       pLendingConnection,
+                                       ( uint8_t * ) pOperation->u.publish.pReceivedData );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        /* Free the incoming PUBLISH operation. */
+        IotMqtt_FreeOperation( pOperation );
+
+        /* Release the MQTT connection kept for lent data. */
+        if( pLendingConnection != NULL )
+        {
+            _IotMqtt_DecrementConnectionReferences( pMqttConnection );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
     }
     else
     {
         EMPTY_ELSE_MARKER;
     }
-
-    /* Free the incoming PUBLISH operation. */
-    IotMqtt_FreeOperation( pOperation );
 }
 
 /*-----------------------------------------------------------*/
@@ -917,7 +1369,7 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
                            IotTaskPoolJob_t pSendJob,
                            void * pContext )
 {
-    size_t bytesSent = 0;
+    IotMqttError_t sendStatus = IOT_MQTT_SUCCESS;
     bool destroyOperation = false, waitable = false, networkPending = false;
     _mqttOperation_t * pOperation = ( _mqttOperation_t * ) pContext;
     _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
@@ -962,13 +1414,12 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
                      IotMqtt_OperationType( pOperation->u.operation.type ),
                      pOperation );
 
-        /* Transmit the MQTT packet from the operation over the network. */
-        bytesSent = pMqttConnection->pNetworkInterface->send( pMqttConnection->pNetworkConnection,
-                                                              pOperation->u.operation.pMqttPacket,
-                                                              pOperation->u.operation.packetSize );
+        /* Transmit the MQTT packet from the operation over the network, after
+         * any PUBLISH packets held back before it. */
+        sendStatus = _IotMqtt_managedRetransmit( pMqttConnection, pOperation );
 
         /* Check transmission status. */
-        if( bytesSent != pOperation->u.operation.packetSize )
+        if( sendStatus != IOT_MQTT_SUCCESS )
         {
             pOperation->u.operation.status = IOT_MQTT_NETWORK_ERROR;
         }
@@ -977,8 +1428,12 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
             /* Update the timestamp of the last message on successful transmission. */
             IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
             pMqttConnection->lastMessageTime = IotClock_GetTimeMs();
+            pOperation->u.operation.sendTime = pMqttConnection->lastMessageTime;
+            pOperation->u.operation.coalesced = false;
             IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
 
+            IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_RETRY_SENT );
+
             /* DISCONNECT operations are considered successful upon successful
              * transmission. In addition, non-waitable operations with no callback
              * may also be considered successful. */
@@ -1051,9 +1506,7 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
                 IotMqtt_Assert( IotLink_IsLinked( &( pOperation->link ) ) );
 
                 /* Transfer to pending response list. */
-                IotListDouble_Remove( &( pOperation->link ) );
-                IotListDouble_InsertHead( &( pMqttConnection->pendingResponse ),
-                                          &( pOperation->link ) );
+                _IotMqtt_AddPendingResponse( pOperation );
 
                 IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
 
@@ -1117,8 +1570,17 @@ void _IotMqtt_ProcessOperation( _mqttOperation_t * pOperation )
     /* Check if this operation is waitable. */
     waitable = ( pOperation->u.operation.flags & IOT_MQTT_FLAG_WAITABLE ) == IOT_MQTT_FLAG_WAITABLE;
 
-    /* Update the timestamp of the last message on successful transmission. */
-    pMqttConnection->lastMessageTime = IotClock_GetTimeMs();
+    /* Update the timestamp of the last message on successful transmission. A
+     * PUBLISH held back for coalescing is stamped when its packet is sent. */
+    if( pOperation->u.operation.coalesced == false )
+    {
+        pMqttConnection->lastMessageTime = IotClock_GetTimeMs();
+        pOperation->u.operation.sendTime = pMqttConnection->lastMessageTime;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
 
     /* DISCONNECT operations are considered successful upon successful
      * transmission. In addition, non-waitable operations with no callback
@@ -1168,9 +1630,7 @@ void _IotMqtt_ProcessOperation( _mqttOperation_t * pOperation )
             IotMqtt_Assert( IotLink_IsLinked( &( pOperation->link ) ) );
 
             /* Transfer to pending response list. */
-            IotListDouble_Remove( &( pOperation->link ) );
-            IotListDouble_InsertHead( &( pMqttConnection->pendingResponse ),
-                                      &( pOperation->link ) );
+            _IotMqtt_AddPendingResponse( pOperation );
 
             /* This operation is now awaiting a response from the network. */
             networkPending = true;
@@ -1238,6 +1698,8 @@ void _IotMqtt_ProcessCompletedOperation( IotTaskPool_t pTaskPool,
     callbackParam.u.operation.reference = pOperation;
     callbackParam.u.operation.result = pOperation->u.operation.status;
 
+    IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_CALLBACK );
+
     /* Invoke the user callback function. */
     pOperation->u.operation.notify.callback.function( pOperation->u.operation.notify.callback.pCallbackContext,
                                                       &callbackParam );
@@ -1274,6 +1736,19 @@ IotMqttError_t _IotMqtt_ScheduleOperation( _mqttOperation_t * pOperation,
                                             &( pOperation->job ) );
     IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
 
+    /* Incoming PUBLISH callbacks are bulk work; they must not delay keep-alive
+     * and acknowledgement processing. */
+    if( jobRoutine == _IotMqtt_ProcessIncomingPublish )
+    {
+        taskPoolStatus = IotTaskPool_SetJobClass( pOperation->job,
+                                                  IOT_TASKPOOL_JOB_CLASS_BULK );
+        IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* Schedule the new job with a delay. */
     taskPoolStatus = IotTaskPool_ScheduleDeferred( IOT_SYSTEM_TASKPOOL,
                                                    pOperation->job,
@@ -1308,6 +1783,7 @@ _mqttOperation_t * _IotMqtt_FindOperation( _mqttConnection_t * pMqttConnection,
                                            const uint16_t * pPacketIdentifier )
 {
     bool waitable = false;
+    size_t i = 0;
     _mqttOperation_t * pResult = NULL;
     IotLink_t * pResultLink = NULL;
     _operationMatchParam_t param = { .type = type, .pPacketIdentifier = pPacketIdentifier };
@@ -1327,12 +1803,28 @@ _mqttOperation_t * _IotMqtt_FindOperation( _mqttConnection_t * pMqttConnection,
                      IotMqtt_OperationType( type ) );
     }
 
-    /* Find and remove the first matching element in the list. */
+    /* Find and remove the first matching element in the lists. An operation
+     * with a packet identifier can only be in the list for that identifier. */
     IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
-    pResultLink = IotListDouble_FindFirstMatch( &( pMqttConnection->pendingResponse ),
-                                                NULL,
-                                                _mqttOperation_match,
-                                                &param );
+
+    if( pPacketIdentifier != NULL )
+    {
+        pResultLink = IotListDouble_FindFirstMatch( _pendingResponseList( pMqttConnection,
+                                                                          *pPacketIdentifier ),
+                                                    NULL,
+                                                    _mqttOperation_match,
+                                                    &param );
+    }
+    else
+    {
+        for( i = 0; ( i < MQTT_PENDING_RESPONSE_BUCKETS ) && ( pResultLink == NULL ); i++ )
+        {
+            pResultLink = IotListDouble_FindFirstMatch( &( pMqttConnection->pendingResponse[ i ] ),
+                                                        NULL,
+                                                        _mqttOperation_match,
+                                                        &param );
+        }
+    }
 
     /* Check if a match was found. */
     if( pResultLink != NULL )
@@ -1372,6 +1864,29 @@ _mqttOperation_t * _IotMqtt_FindOperation( _mqttConnection_t * pMqttConnection,
 
         /* Remove the matched operation from the list. */
         IotListDouble_Remove( &( pResult->link ) );
+
+        /* Acknowledgements of operations with a packet identifier measure the
+         * round-trip time of the connection. */
+        if( pPacketIdentifier != NULL )
+        {
+            _sampleRoundTrip( pMqttConnection, pResult );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        /* A PUBLISH that received its PUBACK frees its slot of the in-flight
+         * window. */
+        if( pResult->u.operation.inflight == true )
+        {
+            pResult->u.operation.inflight = false;
+            _IotMqtt_ReleaseInflight( pMqttConnection );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
     }
     else
     {
@@ -1387,6 +1902,65 @@ _mqttOperation_t * _IotMqtt_FindOperation( _mqttConnection_t * pMqttConnection,
 
 /*-----------------------------------------------------------*/
 
+void _IotMqtt_AddPendingResponse( _mqttOperation_t * pOperation )
+{
+    _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
+
+    if( IotLink_IsLinked( &( pOperation->link ) ) == true )
+    {
+        IotListDouble_Remove( &( pOperation->link ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IotListDouble_InsertHead( _pendingResponseList( pMqttConnection,
+                                                    pOperation->u.operation.packetIdentifier ),
+                              &( pOperation->link ) );
+}
+
+/*-----------------------------------------------------------*/
+
+bool _IotMqtt_ReserveInflight( _mqttConnection_t * pMqttConnection )
+{
+    bool status = true;
+
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    if( ( pMqttConnection->inflightMax > 0U ) &&
+        ( pMqttConnection->inflightCount >= pMqttConnection->inflightMax ) )
+    {
+        IotLogDebug( "(MQTT connection %p) In-flight window of %lu QoS 1 PUBLISH is full.",
+                     pMqttConnection,
+                     ( unsigned long ) pMqttConnection->inflightMax );
+
+        status = false;
+    }
+    else
+    {
+        ( pMqttConnection->inflightCount )++;
+    }
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_ReleaseInflight( _mqttConnection_t * pMqttConnection )
+{
+    IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+    IotMqtt_Assert( pMqttConnection->inflightCount > 0U );
+    ( pMqttConnection->inflightCount )--;
+
+    IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
 void _IotMqtt_Notify( _mqttOperation_t * pOperation )
 {
     IotMqttError_t status = IOT_MQTT_SCHEDULING_ERROR;
@@ -1395,6 +1969,8 @@ void _IotMqtt_Notify( _mqttOperation_t * pOperation )
     /* Check if operation is waitable. */
     bool waitable = ( pOperation->u.operation.flags & IOT_MQTT_FLAG_WAITABLE ) == IOT_MQTT_FLAG_WAITABLE;
 
+    IotMqtt_Trace( pOperation, IOT_MQTT_TRACE_NOTIFIED );
+
     /* Remove any lingering subscriptions if a SUBSCRIBE failed. Rejected
      * subscriptions are removed by the deserializer, so not removed here. */
     if( pOperation->u.operation.type == IOT_MQTT_SUBSCRIBE )
@@ -612,6 +612,17 @@ IotMqttError_t _IotMqtt_deserializeConnackWrapper( _mqttPacket_t * pConnack )
     /* Deserializing Connack packet received from the network. */
     managedMqttStatus = MQTT_DeserializeAck( &pIncomingPacket, &( pConnack->packetIdentifier ), &sessionPresent );
     status = convertReturnCode( managedMqttStatus );
+
+    /* Keep the session present flag for restoring subscriptions. */
+    if( ( status == IOT_MQTT_SUCCESS ) && ( pConnack->u.pMqttConnection != NULL ) )
+    {
+        pConnack->u.pMqttConnection->sessionPresent = sessionPresent;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     return status;
 }
 
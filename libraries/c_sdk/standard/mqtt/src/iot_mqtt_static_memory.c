@@ -37,6 +37,7 @@
 /* Standard includes. */
     #include <stdbool.h>
     #include <stddef.h>
+    #include <stdint.h>
     #include <string.h>
 
 /* Static memory include. */
@@ -89,33 +90,44 @@
 /*
  * Static memory buffers and flags, allocated and zeroed at compile-time.
  */
-    static bool _pInUseMqttConnections[ IOT_MQTT_CONNECTIONS ] = { 0 };                                      /**< @brief MQTT connection in-use flags. */
-    static _mqttConnection_t _pMqttConnections[ IOT_MQTT_CONNECTIONS ] = { { 0 } };                          /**< @brief MQTT connections. */
+    static uint32_t _pInUseMqttConnections[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_MQTT_CONNECTIONS ) ] = { 0 };               /**< @brief MQTT connection in-use flags. */
+    static _mqttConnection_t _pMqttConnections[ IOT_MQTT_CONNECTIONS ] = { { 0 } };                                       /**< @brief MQTT connections. */
 
-    static bool _pInUseMqttOperations[ IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS ] = { 0 };                        /**< @brief MQTT operation in-use flags. */
-    static _mqttOperation_t _pMqttOperations[ IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS ] = { { .link = { 0 } } }; /**< @brief MQTT operations. */
+    static uint32_t _pInUseMqttOperations[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS ) ] = { 0 }; /**< @brief MQTT operation in-use flags. */
+    static _mqttOperation_t _pMqttOperations[ IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS ] = { { .link = { 0 } } };              /**< @brief MQTT operations. */
 
-    static bool _pInUseMqttSubscriptions[ IOT_MQTT_SUBSCRIPTIONS ] = { 0 };                                  /**< @brief MQTT subscription in-use flags. */
-    static char _pMqttSubscriptions[ IOT_MQTT_SUBSCRIPTIONS ][ MQTT_SUBSCRIPTION_SIZE ] = { { 0 } };         /**< @brief MQTT subscriptions. */
+    static uint32_t _pInUseMqttSubscriptions[ IOT_STATIC_MEMORY_POOL_WORDS( IOT_MQTT_SUBSCRIPTIONS ) ] = { 0 };           /**< @brief MQTT subscription in-use flags. */
+    static char _pMqttSubscriptions[ IOT_MQTT_SUBSCRIPTIONS ][ MQTT_SUBSCRIPTION_SIZE ] = { { 0 } };                      /**< @brief MQTT subscriptions. */
+
+/** @brief Pool of MQTT connections. */
+    static IotStaticMemoryPool_t _mqttConnectionPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pMqttConnections,
+                                                                                           _pInUseMqttConnections,
+                                                                                           sizeof( _mqttConnection_t ),
+                                                                                           IOT_MQTT_CONNECTIONS );
+
+/** @brief Pool of MQTT operations. */
+    static IotStaticMemoryPool_t _mqttOperationPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pMqttOperations,
+                                                                                          _pInUseMqttOperations,
+                                                                                          sizeof( _mqttOperation_t ),
+                                                                                          IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS );
+
+/** @brief Pool of MQTT subscriptions. */
+    static IotStaticMemoryPool_t _mqttSubscriptionPool = IOT_STATIC_MEMORY_POOL_INITIALIZER( _pMqttSubscriptions,
+                                                                                             _pInUseMqttSubscriptions,
+                                                                                             MQTT_SUBSCRIPTION_SIZE,
+                                                                                             IOT_MQTT_SUBSCRIPTIONS );
 
 /*-----------------------------------------------------------*/
 
     void * IotMqtt_MallocConnection( size_t size )
     {
-        int32_t freeIndex = -1;
         void * pNewConnection = NULL;
 
         /* Check size argument. */
         if( size == sizeof( _mqttConnection_t ) )
         {
             /* Find a free MQTT connection. */
-            freeIndex = IotStaticMemory_FindFree( _pInUseMqttConnections,
-                                                  IOT_MQTT_CONNECTIONS );
-
-            if( freeIndex != -1 )
-            {
-                pNewConnection = &( _pMqttConnections[ freeIndex ] );
-            }
+            pNewConnection = IotStaticMemory_Alloc( &_mqttConnectionPool );
         }
 
         return pNewConnection;
@@ -126,31 +138,20 @@
     void IotMqtt_FreeConnection( void * ptr )
     {
         /* Return the in-use MQTT connection. */
-        IotStaticMemory_ReturnInUse( ptr,
-                                     _pMqttConnections,
-                                     _pInUseMqttConnections,
-                                     IOT_MQTT_CONNECTIONS,
-                                     sizeof( _mqttConnection_t ) );
+        IotStaticMemory_Free( &_mqttConnectionPool, ptr );
     }
 
 /*-----------------------------------------------------------*/
 
     void * IotMqtt_MallocOperation( size_t size )
     {
-        int32_t freeIndex = -1;
         void * pNewOperation = NULL;
 
         /* Check size argument. */
         if( size == sizeof( _mqttOperation_t ) )
         {
             /* Find a free MQTT operation. */
-            freeIndex = IotStaticMemory_FindFree( _pInUseMqttOperations,
-                                                  IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS );
-
-            if( freeIndex != -1 )
-            {
-                pNewOperation = &( _pMqttOperations[ freeIndex ] );
-            }
+            pNewOperation = IotStaticMemory_Alloc( &_mqttOperationPool );
         }
 
         return pNewOperation;
@@ -161,30 +162,19 @@
     void IotMqtt_FreeOperation( void * ptr )
     {
         /* Return the in-use MQTT operation. */
-        IotStaticMemory_ReturnInUse( ptr,
-                                     _pMqttOperations,
-                                     _pInUseMqttOperations,
-                                     IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS,
-                                     sizeof( _mqttOperation_t ) );
+        IotStaticMemory_Free( &_mqttOperationPool, ptr );
     }
 
 /*-----------------------------------------------------------*/
 
     void * IotMqtt_MallocSubscription( size_t size )
     {
-        int32_t freeIndex = -1;
         void * pNewSubscription = NULL;
 
         if( size <= MQTT_SUBSCRIPTION_SIZE )
         {
-            /* Get the index of a free MQTT subscription. */
-            freeIndex = IotStaticMemory_FindFree( _pInUseMqttSubscriptions,
-                                                  IOT_MQTT_SUBSCRIPTIONS );
-
-            if( freeIndex != -1 )
-            {
-                pNewSubscription = &( _pMqttSubscriptions[ freeIndex ][ 0 ] );
-            }
+            /* Get a free MQTT subscription. */
+            pNewSubscription = IotStaticMemory_Alloc( &_mqttSubscriptionPool );
         }
 
         return pNewSubscription;
@@ -195,11 +185,7 @@
     void IotMqtt_FreeSubscription( void * ptr )
     {
         /* Return the in-use MQTT subscription. */
-        IotStaticMemory_ReturnInUse( ptr,
-                                     _pMqttSubscriptions,
-                                     _pInUseMqttSubscriptions,
-                                     IOT_MQTT_SUBSCRIPTIONS,
-                                     MQTT_SUBSCRIPTION_SIZE );
+        IotStaticMemory_Free( &_mqttSubscriptionPool, ptr );
     }
 
 /*-----------------------------------------------------------*/
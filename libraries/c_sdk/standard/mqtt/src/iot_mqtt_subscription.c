@@ -44,6 +44,9 @@
 /* Platform layer includes. */
 #include "platform/iot_threads.h"
 
+/* Atomic operations. */
+#include "iot_atomic.h"
+
 /* Using initialized connToContext variable. */
 extern _connContext_t connToContext[ MAX_NO_OF_MQTT_CONNECTIONS ];
 
@@ -76,6 +79,28 @@ static bool _topicMatch( const IotLink_t * pSubscriptionLink,
 static bool _packetMatch( const IotLink_t * pSubscriptionLink,
                           void * pMatch );
 
+/**
+ * @brief Take one subscription lock of an MQTT context to match and reference
+ * its subscriptions.
+ *
+ * Successive calls take the locks in turn, so PUBLISH messages processed at the
+ * same time are matched under different locks.
+ *
+ * @param[in] contextIndex Index of the MQTT context in `connToContext`.
+ *
+ * @return The lock taken, as an index in #_connContext_t.subscriptionShards.
+ */
+static uint32_t _lockSubscriptionShard( int8_t contextIndex );
+
+/**
+ * @brief Give back a lock taken by #_lockSubscriptionShard.
+ *
+ * @param[in] contextIndex Index of the MQTT context in `connToContext`.
+ * @param[in] shard The lock to give back.
+ */
+static void _unlockSubscriptionShard( int8_t contextIndex,
+                                      uint32_t shard );
+
 /*-----------------------------------------------------------*/
 
 static bool _topicMatch( const IotLink_t * pSubscriptionLink,
@@ -294,6 +319,142 @@ static bool _packetMatch( const IotLink_t * pSubscriptionLink,
 
 /*-----------------------------------------------------------*/
 
+static uint32_t _lockSubscriptionShard( int8_t contextIndex )
+{
+    bool mutexStatus = true;
+    uint32_t shard = Atomic_Increment_u32( &( connToContext[ contextIndex ].nextSubscriptionShard ) ) %
+                     ( uint32_t ) MQTT_SUBSCRIPTION_LOCK_SHARDS;
+
+    mutexStatus = IotMutex_Take( &( connToContext[ contextIndex ].subscriptionShards[ shard ].mutex ) );
+
+    /* Assert to check mutex has been taken successfully. */
+    IotMqtt_Assert( mutexStatus == true );
+
+    return shard;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _unlockSubscriptionShard( int8_t contextIndex,
+                                      uint32_t shard )
+{
+    bool mutexStatus = true;
+
+    mutexStatus = IotMutex_Give( &( connToContext[ contextIndex ].subscriptionShards[ shard ].mutex ) );
+
+    /* Assert to check mutex has been given successfully. */
+    IotMqtt_Assert( mutexStatus == true );
+}
+
+/*-----------------------------------------------------------*/
+
+bool _IotMqtt_CreateSubscriptionLocks( int8_t contextIndex )
+{
+    bool status = true;
+    size_t i = 0;
+    _mqttSubscriptionShard_t * pShards = connToContext[ contextIndex ].subscriptionShards;
+
+    for( i = 0; i < MQTT_SUBSCRIPTION_LOCK_SHARDS; i++ )
+    {
+        if( IotMutex_CreateNonRecursiveMutex( &( pShards[ i ].mutex ),
+                                              &( pShards[ i ].mutexStorage ) ) == false )
+        {
+            status = false;
+            break;
+        }
+    }
+
+    /* Delete the locks created before a failure. */
+    if( status == false )
+    {
+        while( i > 0U )
+        {
+            i--;
+            IotMutex_Delete( &( pShards[ i ].mutex ) );
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_DeleteSubscriptionLocks( int8_t contextIndex )
+{
+    size_t i = 0;
+
+    for( i = 0; i < MQTT_SUBSCRIPTION_LOCK_SHARDS; i++ )
+    {
+        IotMutex_Delete( &( connToContext[ contextIndex ].subscriptionShards[ i ].mutex ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool _IotMqtt_LockSubscriptions( int8_t contextIndex )
+{
+    bool status = true;
+    size_t i = 0;
+    _mqttSubscriptionShard_t * pShards = connToContext[ contextIndex ].subscriptionShards;
+
+    /* Every holder of all the locks takes them in the same order, so they can't
+     * deadlock each other. */
+    for( i = 0; i < MQTT_SUBSCRIPTION_LOCK_SHARDS; i++ )
+    {
+        if( IotMutex_Take( &( pShards[ i ].mutex ) ) == false )
+        {
+            status = false;
+            break;
+        }
+    }
+
+    /* Give back the locks taken before a failure. */
+    if( status == false )
+    {
+        while( i > 0U )
+        {
+            i--;
+            ( void ) IotMutex_Give( &( pShards[ i ].mutex ) );
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+bool _IotMqtt_UnlockSubscriptions( int8_t contextIndex )
+{
+    bool status = true;
+    size_t i = MQTT_SUBSCRIPTION_LOCK_SHARDS;
+
+    while( i > 0U )
+    {
+        i--;
+
+        if( IotMutex_Give( &( connToContext[ contextIndex ].subscriptionShards[ i ].mutex ) ) == false )
+        {
+            status = false;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 IotMqttError_t _IotMqtt_AddSubscriptions( _mqttConnection_t * pMqttConnection,
                                           uint16_t subscribePacketIdentifier,
                                           const IotMqttSubscription_t * pSubscriptionList,
@@ -303,14 +464,14 @@ IotMqttError_t _IotMqtt_AddSubscriptions( _mqttConnection_t * pMqttConnection,
     size_t i = 0;
     _topicMatchParams_t topicMatchParams = { .exactMatchOnly = true };
     int8_t contextIndex = -1;
-    int8_t matchedIndex = -1;
-    int8_t index = -1;
+    int16_t matchedIndex = -1;
+    int16_t index = -1;
     char * pTopicFilter = NULL;
 
     /* Getting MQTT Context for the specified MQTT Connection. */
     contextIndex = _IotMqtt_getContextIndexFromConnection( pMqttConnection );
 
-    if( IotMutex_Take( &( connToContext[ contextIndex ].subscriptionMutex ) ) == true )
+    if( _IotMqtt_LockSubscriptions( contextIndex ) == true )
     {
         for( i = 0; i < subscriptionCount; i++ )
         {
@@ -326,13 +487,15 @@ IotMqttError_t _IotMqtt_AddSubscriptions( _mqttConnection_t * pMqttConnection,
 
                 /* Replace the callback and packet info with the new parameters. */
                 connToContext[ contextIndex ].subscriptionArray[ matchedIndex ].callback = pSubscriptionList[ i ].callback;
+                connToContext[ contextIndex ].subscriptionArray[ matchedIndex ].qos = pSubscriptionList[ i ].qos;
                 connToContext[ contextIndex ].subscriptionArray[ matchedIndex ].packetInfo.identifier = subscribePacketIdentifier;
                 connToContext[ contextIndex ].subscriptionArray[ matchedIndex ].packetInfo.order = i;
             }
             else
             {
                 /* Getting index to insert the subscription in the subscription array. */
-                index = IotMqtt_GetFreeIndexInSubscriptionArray( ( connToContext[ contextIndex ].subscriptionArray ) );
+                index = IotMqtt_TakeFreeIndexInSubscriptionArray( &( connToContext[ contextIndex ].subscriptionSlots ),
+                                                                  connToContext[ contextIndex ].subscriptionArray );
 
                 if( index == -1 )
                 {
@@ -353,6 +516,7 @@ IotMqttError_t _IotMqtt_AddSubscriptions( _mqttConnection_t * pMqttConnection,
                     connToContext[ contextIndex ].subscriptionArray[ index ].packetInfo.identifier = subscribePacketIdentifier;
                     connToContext[ contextIndex ].subscriptionArray[ index ].packetInfo.order = i;
                     connToContext[ contextIndex ].subscriptionArray[ index ].callback = pSubscriptionList[ i ].callback;
+                    connToContext[ contextIndex ].subscriptionArray[ index ].qos = pSubscriptionList[ i ].qos;
                     connToContext[ contextIndex ].subscriptionArray[ index ].topicFilterLength = pSubscriptionList[ i ].topicFilterLength;
                     pTopicFilter = IotMqtt_MallocMessage( pSubscriptionList[ i ].topicFilterLength );
 
@@ -362,9 +526,34 @@ IotMqttError_t _IotMqtt_AddSubscriptions( _mqttConnection_t * pMqttConnection,
                         ( void ) memcpy( connToContext[ contextIndex ].subscriptionArray[ index ].pTopicFilter,
                                          pSubscriptionList[ i ].pTopicFilter,
                                          ( size_t ) ( pSubscriptionList[ i ].topicFilterLength ) );
+
+                        /* Index the new subscription by its topic filter levels. */
+                        if( IotMqtt_AddSubscriptionToTrie( &( connToContext[ contextIndex ].subscriptionTrie ),
+                                                           connToContext[ contextIndex ].subscriptionArray,
+                                                           index ) == false )
+                        {
+                            /* Free the array element, which was not added to the trie. */
+                            connToContext[ contextIndex ].subscriptionArray[ index ].topicFilterLength = 0;
+                            IotMqtt_ReleaseIndexInSubscriptionArray( &( connToContext[ contextIndex ].subscriptionSlots ), index );
+                            IotMqtt_FreeMessage( pTopicFilter );
+
+                            status = IOT_MQTT_NO_MEMORY;
+                            IotLogError( "(MQTT connection %p) Subscription trie is full. "
+                                         "Consider updating the MQTT_SUBSCRIPTION_TRIE_NODES config to resolve the issue. ",
+                                         pMqttConnection );
+                            break;
+                        }
+                        else
+                        {
+                            EMPTY_ELSE_MARKER;
+                        }
                     }
                     else
                     {
+                        /* Free the array element, which has no topic filter. */
+                        connToContext[ contextIndex ].subscriptionArray[ index ].topicFilterLength = 0;
+                        IotMqtt_ReleaseIndexInSubscriptionArray( &( connToContext[ contextIndex ].subscriptionSlots ), index );
+
                         status = IOT_MQTT_NO_MEMORY;
                         IotLogError( "(MQTT connection %p) Failed to allocate memory for topic filter. ",
                                      pMqttConnection );
@@ -374,7 +563,7 @@ IotMqttError_t _IotMqtt_AddSubscriptions( _mqttConnection_t * pMqttConnection,
             }
         }
 
-        if( IotMutex_Give( &( connToContext[ contextIndex ].subscriptionMutex ) ) == false )
+        if( _IotMqtt_UnlockSubscriptions( contextIndex ) == false )
         {
             /* Fail to give subscription mutex as no space is available on queue. */
             IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
@@ -409,8 +598,9 @@ void _IotMqtt_InvokeSubscriptionCallback( _mqttConnection_t * pMqttConnection,
     _mqttSubscription_t * pSubscription = NULL;
     void * pCallbackContext = NULL;
     int8_t contextIndex = -1;
-    int8_t index = 0;
-    bool mutexStatus = true;
+    int16_t index = 0;
+    uint32_t shard = 0, references = 0;
+    bool mutexStatus = true, freeSubscription = false;
 
     void ( * callbackFunction )( void *,
                                  IotMqttCallbackParam_t * ) = NULL;
@@ -423,27 +613,27 @@ void _IotMqtt_InvokeSubscriptionCallback( _mqttConnection_t * pMqttConnection,
 
     contextIndex = _IotMqtt_getContextIndexFromConnection( pMqttConnection );
 
-    /* Prevent any other thread from modifying the subscription array while this
-     * function is searching. */
-    mutexStatus = IotMutex_Take( &( connToContext[ contextIndex ].subscriptionMutex ) );
-
-    /* Assert to check mutex has been taken successfully. */
-    IotMqtt_Assert( mutexStatus == true );
-
-    /* Search the subscription list for all matching subscriptions starting at
-     * the array head. */
-
+    /* Search the subscription trie for all matching subscriptions in order of
+     * their position in the array. */
     while( index < MAX_NO_OF_MQTT_SUBSCRIPTIONS )
     {
         if( contextIndex >= 0 )
         {
-            index = IotMqtt_FindFirstMatch( &( connToContext[ contextIndex ].subscriptionArray[ 0 ] ),
-                                            index,
-                                            &topicMatchParams );
+            /* Prevent any other thread from modifying the subscription array while
+             * this function is searching. Other PUBLISH messages may be matched
+             * under the other locks at the same time. */
+            shard = _lockSubscriptionShard( contextIndex );
+
+            index = IotMqtt_FindFirstMatchInTrieShared( &( connToContext[ contextIndex ].subscriptionTrie ),
+                                                        connToContext[ contextIndex ].subscriptionShards[ shard ].pending,
+                                                        &( connToContext[ contextIndex ].subscriptionArray[ 0 ] ),
+                                                        index,
+                                                        &topicMatchParams );
 
             /* No subscription found. Exit loop. */
             if( index == -1 )
             {
+                _unlockSubscriptionShard( contextIndex, shard );
                 break;
             }
             else
@@ -454,19 +644,17 @@ void _IotMqtt_InvokeSubscriptionCallback( _mqttConnection_t * pMqttConnection,
             /* Subscription validation should not have allowed a NULL callback function. */
             IotMqtt_Assert( pSubscription->callback.function != NULL );
 
-            /* Increment the subscription's reference count. */
-            ( pSubscription->references )++;
+            /* Increment the subscription's reference count. Holders of the other
+             * locks may change it at the same time. */
+            ( void ) Atomic_Increment_u32( ( uint32_t * ) &( pSubscription->references ) );
 
             /* Copy the necessary members of the subscription before releasing the
-             * subscription list mutex. */
+             * subscription lock. */
             pCallbackContext = pSubscription->callback.pCallbackContext;
             callbackFunction = pSubscription->callback.function;
 
-            /* Unlock the subscription array mutex. */
-            mutexStatus = IotMutex_Give( &( connToContext[ contextIndex ].subscriptionMutex ) );
+            _unlockSubscriptionShard( contextIndex, shard );
 
-            /* Assert to check mutex has been given successfully. */
-            IotMqtt_Assert( mutexStatus == true );
             /* Set the members of the callback parameter. */
             pCallbackParam->mqttConnection = pMqttConnection;
             pCallbackParam->u.message.pTopicFilter = pSubscription->pTopicFilter;
@@ -475,26 +663,48 @@ void _IotMqtt_InvokeSubscriptionCallback( _mqttConnection_t * pMqttConnection,
             /* Invoke the subscription callback. */
             callbackFunction( pCallbackContext, pCallbackParam );
 
-            /* Lock the subscription array mutex to decrement the reference count. */
-            mutexStatus = IotMutex_Take( &( connToContext[ contextIndex ].subscriptionMutex ) );
+            /* Decrement the reference count under a lock, so that it is ordered
+             * with an unsubscribe that checks the count and sets the unsubscribed
+             * flag. The count must still be positive. */
+            shard = _lockSubscriptionShard( contextIndex );
+
+            references = Atomic_Decrement_u32( ( uint32_t * ) &( pSubscription->references ) );
+            IotMqtt_Assert( references > 0U );
 
-            /* Assert to check mutex has been taken successfully. */
-            IotMqtt_Assert( mutexStatus == true );
+            freeSubscription = ( references == 1U ) && ( pSubscription->unsubscribed == true );
 
-            /* Decrement the reference count. It must still be positive. */
-            ( pSubscription->references )--;
-            IotMqtt_Assert( pSubscription->references >= 0 );
+            _unlockSubscriptionShard( contextIndex, shard );
 
             /* Remove this subscription if it has no references and the unsubscribed
-             * flag is set. */
-            if( pSubscription->unsubscribed == true )
+             * flag is set. Freeing an element of the array takes every lock. */
+            if( freeSubscription == true )
             {
-                /* Free subscriptions with no references. */
-                if( pSubscription->references == 0 )
+                mutexStatus = _IotMqtt_LockSubscriptions( contextIndex );
+
+                /* Assert to check mutex has been taken successfully. */
+                IotMqtt_Assert( mutexStatus == true );
+
+                /* No lock was held since the check above, so check again. A
+                 * callback on another lock may have taken a reference. */
+                if( ( pSubscription->references == 0 ) && ( pSubscription->unsubscribed == true ) )
                 {
                     /* Free the subscription by setting the topicfilterlength to 0. */
                     pSubscription->topicFilterLength = 0;
+                    IotMqtt_ReleaseIndexInSubscriptionArray( &( connToContext[ contextIndex ].subscriptionSlots ), index );
+                }
+                else
+                {
+                    EMPTY_ELSE_MARKER;
                 }
+
+                mutexStatus = _IotMqtt_UnlockSubscriptions( contextIndex );
+
+                /* Assert to check mutex has been given successfully. */
+                IotMqtt_Assert( mutexStatus == true );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
             }
 
             index++;
@@ -505,10 +715,6 @@ void _IotMqtt_InvokeSubscriptionCallback( _mqttConnection_t * pMqttConnection,
         }
     }
 
-    mutexStatus = IotMutex_Give( &( connToContext[ contextIndex ].subscriptionMutex ) );
-
-    /* Assert to check mutex has been given successfully. */
-    IotMqtt_Assert( mutexStatus == true );
     _IotMqtt_DecrementConnectionReferences( pMqttConnection );
 }
 
@@ -529,14 +735,14 @@ void _IotMqtt_RemoveSubscriptionByPacket( _mqttConnection_t * pMqttConnection,
     /* Getting MQTT Context for the specified MQTT Connection. */
     contextIndex = _IotMqtt_getContextIndexFromConnection( pMqttConnection );
 
-    mutexStatus = IotMutex_Take( &( connToContext[ contextIndex ].subscriptionMutex ) );
+    mutexStatus = _IotMqtt_LockSubscriptions( contextIndex );
 
     if( mutexStatus == true )
     {
         IotMqtt_RemoveAllMatches( ( connToContext[ contextIndex ].subscriptionArray ),
                                   ( &packetMatchParams ) );
 
-        mutexStatus = IotMutex_Give( &( connToContext[ contextIndex ].subscriptionMutex ) );
+        mutexStatus = _IotMqtt_UnlockSubscriptions( contextIndex );
     }
 
     IotMqtt_Assert( mutexStatus == true );
@@ -552,7 +758,7 @@ void _IotMqtt_RemoveSubscriptionByTopicFilter( _mqttConnection_t * pMqttConnecti
     _mqttSubscription_t * pSubscription = NULL;
     _topicMatchParams_t topicMatchParams = { 0 };
     int8_t contextIndex = -1;
-    int8_t matchedIndex = -1;
+    int16_t matchedIndex = -1;
     bool mutexStatus = true;
     bool subscriptionStatus = true;
 
@@ -561,7 +767,7 @@ void _IotMqtt_RemoveSubscriptionByTopicFilter( _mqttConnection_t * pMqttConnecti
 
     /* Prevent any other thread from modifying the subscription list while this
      * function is running. */
-    if( IotMutex_Take( &( connToContext[ contextIndex ].subscriptionMutex ) ) == true )
+    if( _IotMqtt_LockSubscriptions( contextIndex ) == true )
     {
         /* Find and remove each topic filter from the list. */
         for( i = 0; i < subscriptionCount; i++ )
@@ -598,6 +804,7 @@ void _IotMqtt_RemoveSubscriptionByTopicFilter( _mqttConnection_t * pMqttConnecti
                 {
                     /* Free a subscription by setting topicFilterLength to 0 as it indicates that subscription is unsubscribed. */
                     pSubscription->topicFilterLength = 0;
+                    IotMqtt_ReleaseIndexInSubscriptionArray( &( connToContext[ contextIndex ].subscriptionSlots ), matchedIndex );
                 }
             }
             else
@@ -606,7 +813,7 @@ void _IotMqtt_RemoveSubscriptionByTopicFilter( _mqttConnection_t * pMqttConnecti
             }
         }
 
-        mutexStatus = IotMutex_Give( &( connToContext[ contextIndex ].subscriptionMutex ) );
+        mutexStatus = _IotMqtt_UnlockSubscriptions( contextIndex );
     }
     else
     {
@@ -624,7 +831,7 @@ bool IotMqtt_IsSubscribed( IotMqttConnection_t mqttConnection,
                            uint16_t topicFilterLength,
                            IotMqttSubscription_t * pCurrentSubscription )
 {
-    bool status = false, mutexStatus = true;
+    bool status = false;
     _mqttSubscription_t * pSubscription = NULL;
     _topicMatchParams_t topicMatchParams =
     {
@@ -633,43 +840,38 @@ bool IotMqtt_IsSubscribed( IotMqttConnection_t mqttConnection,
         .exactMatchOnly  = true
     };
     int8_t contextIndex = -1;
-    int8_t matchedIndex = -1;
+    int16_t matchedIndex = -1;
+    uint32_t shard = 0;
 
     /* Getting MQTT Context for the specified MQTT Connection. */
     contextIndex = _IotMqtt_getContextIndexFromConnection( mqttConnection );
     IotMqtt_Assert( contextIndex != -1 );
 
     /* Prevent any other thread from modifying the subscription list while this
-     * function is running. */
-    mutexStatus = IotMutex_Take( &( connToContext[ contextIndex ].subscriptionMutex ) );
+     * function is running. Reading it only takes one lock. */
+    shard = _lockSubscriptionShard( contextIndex );
 
-    if( mutexStatus == true )
+    matchedIndex = IotMqtt_FindFirstMatch( &( connToContext[ contextIndex ].subscriptionArray[ 0 ] ), 0
+                                           , &topicMatchParams );
+
+    /* Check if a matching subscription was found. */
+    if( matchedIndex != -1 )
     {
-        matchedIndex = IotMqtt_FindFirstMatch( &( connToContext[ contextIndex ].subscriptionArray[ 0 ] ), 0
-                                               , &topicMatchParams );
+        pSubscription = &( connToContext[ contextIndex ].subscriptionArray[ 0 ] );
 
-        /* Check if a matching subscription was found. */
-        if( matchedIndex != -1 )
+        /* Copy the matching subscription to the output parameter. */
+        if( pCurrentSubscription != NULL )
         {
-            pSubscription = &( connToContext[ contextIndex ].subscriptionArray[ 0 ] );
-
-            /* Copy the matching subscription to the output parameter. */
-            if( pCurrentSubscription != NULL )
-            {
-                pCurrentSubscription->pTopicFilter = pTopicFilter;
-                pCurrentSubscription->topicFilterLength = topicFilterLength;
-                pCurrentSubscription->qos = IOT_MQTT_QOS_0;
-                pCurrentSubscription->callback = pSubscription->callback;
-            }
-
-            status = true;
+            pCurrentSubscription->pTopicFilter = pTopicFilter;
+            pCurrentSubscription->topicFilterLength = topicFilterLength;
+            pCurrentSubscription->qos = IOT_MQTT_QOS_0;
+            pCurrentSubscription->callback = pSubscription->callback;
         }
 
-        mutexStatus = IotMutex_Give( &( connToContext[ contextIndex ].subscriptionMutex ) );
+        status = true;
     }
 
-    /* Assert to check whether mutex was given successfully or not. */
-    IotMqtt_Assert( mutexStatus == true );
+    _unlockSubscriptionShard( contextIndex, shard );
 
     return status;
 }
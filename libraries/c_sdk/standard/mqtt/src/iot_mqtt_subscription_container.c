@@ -66,6 +66,94 @@ static bool _packetMatch( _mqttSubscription_t * pSubscription,
 static bool _topicMatch( _mqttSubscription_t * pSubscription,
                          void * pMatch );
 
+/**
+ * @brief Matches a subscription trie node with a parent node and level length.
+ *
+ * @param[in] pLevelLink Pointer to the link member of an #_mqttTrieNode_t.
+ * @param[in] pMatch Pointer to a #_levelMatchParams_t.
+ *
+ * @return `true` if the node is a child of the given parent with a level of the
+ * given length; `false` otherwise.
+ */
+static bool _levelMatch( const IotHashLink_t * const pLevelLink,
+                         void * pMatch );
+
+/**
+ * @brief Calculate the key of a subscription trie level.
+ *
+ * @param[in] pParent The node of the previous level.
+ * @param[in] pLevel The text of the level.
+ * @param[in] levelLength Length of `pLevel`.
+ *
+ * @return Hash of the parent node and level text.
+ */
+static uint32_t _levelHash( const _mqttTrieNode_t * pParent,
+                            const char * pLevel,
+                            uint16_t levelLength );
+
+/**
+ * @brief Find or create the node of a level below a subscription trie node.
+ *
+ * @param[in] pTrie The subscription trie.
+ * @param[in] pParent The node of the previous level.
+ * @param[in] pLevel The text of the level, which may be a wildcard.
+ * @param[in] levelLength Length of `pLevel`.
+ *
+ * @return The node of the level; `NULL` if no free node is available.
+ */
+static _mqttTrieNode_t * _getLevelNode( _mqttSubscriptionTrie_t * pTrie,
+                                        _mqttTrieNode_t * pParent,
+                                        const char * pLevel,
+                                        uint16_t levelLength );
+
+/**
+ * @brief Release unused subscription trie nodes, starting at a node and moving
+ * up towards the root.
+ *
+ * @param[in] pTrie The subscription trie.
+ * @param[in] pNode The first node to check.
+ */
+static void _releaseLevelNodes( _mqttSubscriptionTrie_t * pTrie,
+                                _mqttTrieNode_t * pNode );
+
+/**
+ * @brief Remove the entry of a subscription array element from its trie node.
+ *
+ * @param[in] pTrie The subscription trie.
+ * @param[in] pEntry The entry to remove.
+ */
+static void _removeTrieEntry( _mqttSubscriptionTrie_t * pTrie,
+                              _mqttTrieEntry_t * pEntry );
+
+/**
+ * @brief Check the subscriptions of a trie node against a topic name, updating
+ * the first match found so far.
+ *
+ * @param[in] pTrie The subscription trie.
+ * @param[in] pNode The node whose subscriptions are checked.
+ * @param[in] pSubscriptionArray Subscription array indexed by `pTrie`.
+ * @param[in] startIndex The first element of `pSubscriptionArray` to consider.
+ * @param[in] pMatch Contains the topic name to match.
+ * @param[in,out] pFirstIndex The first match so far; `-1` if none was found.
+ */
+static void _matchLevelSubscriptions( const _mqttSubscriptionTrie_t * pTrie,
+                                      const _mqttTrieNode_t * pNode,
+                                      _mqttSubscription_t * pSubscriptionArray,
+                                      int16_t startIndex,
+                                      _topicMatchParams_t * pMatch,
+                                      int16_t * pFirstIndex );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Second parameter to #_levelMatch.
+ */
+typedef struct _levelMatchParams
+{
+    const _mqttTrieNode_t * pParent; /**< @brief The node of the previous level. */
+    uint16_t levelLength;            /**< @brief Length of the level. */
+} _levelMatchParams_t;
+
 /*-----------------------------------------------------------*/
 
 static bool _packetMatch( _mqttSubscription_t * pSubscription,
@@ -228,10 +316,10 @@ static bool _topicMatch( _mqttSubscription_t * pSubscription,
 
 /*-----------------------------------------------------------*/
 
-int8_t IotMqtt_GetFreeIndexInSubscriptionArray( _mqttSubscription_t * pSubscriptionArray )
+int16_t IotMqtt_GetFreeIndexInSubscriptionArray( _mqttSubscription_t * pSubscriptionArray )
 {
-    /* The shim supports only upto 128 subscriptions as the implementation uses 8 bit index. */
-    int8_t index = 0;
+    /* The shim supports only upto 32767 subscriptions as the implementation uses 16 bit index. */
+    int16_t index = 0;
 
     IotMqtt_Assert( pSubscriptionArray != NULL );
 
@@ -257,8 +345,69 @@ int8_t IotMqtt_GetFreeIndexInSubscriptionArray( _mqttSubscription_t * pSubscript
 
 /*-----------------------------------------------------------*/
 
+int16_t IotMqtt_TakeFreeIndexInSubscriptionArray( _mqttSubscriptionSlots_t * pSlots,
+                                                  _mqttSubscription_t * pSubscriptionArray )
+{
+    int16_t index = -1, candidate = 0;
+
+    IotMqtt_Assert( pSlots != NULL );
+    IotMqtt_Assert( pSubscriptionArray != NULL );
+
+    /* Reuse the most recently released element. An element may have been taken by
+     * a scan after it was released, so check that it is still free. */
+    while( ( index == -1 ) && ( pSlots->releasedCount > 0 ) )
+    {
+        pSlots->releasedCount--;
+        candidate = pSlots->released[ pSlots->releasedCount ];
+
+        if( pSubscriptionArray[ candidate ].topicFilterLength == 0 )
+        {
+            index = candidate;
+        }
+    }
+
+    /* Hand out the elements that were never used. */
+    while( ( index == -1 ) && ( pSlots->nextUnused < MAX_NO_OF_MQTT_SUBSCRIPTIONS ) )
+    {
+        candidate = pSlots->nextUnused;
+        pSlots->nextUnused++;
+
+        if( pSubscriptionArray[ candidate ].topicFilterLength == 0 )
+        {
+            index = candidate;
+        }
+    }
+
+    /* Elements freed without being released can only be found by a scan. */
+    if( index == -1 )
+    {
+        index = IotMqtt_GetFreeIndexInSubscriptionArray( pSubscriptionArray );
+    }
+
+    return index;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_ReleaseIndexInSubscriptionArray( _mqttSubscriptionSlots_t * pSlots,
+                                              int16_t index )
+{
+    IotMqtt_Assert( pSlots != NULL );
+    IotMqtt_Assert( ( index > -1 ) && ( index < MAX_NO_OF_MQTT_SUBSCRIPTIONS ) );
+
+    /* An element released more than once may fill the stack; any element that
+     * does not fit is still found by the scan. */
+    if( pSlots->releasedCount < MAX_NO_OF_MQTT_SUBSCRIPTIONS )
+    {
+        pSlots->released[ pSlots->releasedCount ] = index;
+        pSlots->releasedCount++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 bool IotMqtt_RemoveSubscription( _mqttSubscription_t * pSubscriptionArray,
-                                 int8_t deleteIndex )
+                                 int16_t deleteIndex )
 {
     bool status = false;
 
@@ -314,9 +463,9 @@ void IotMqtt_RemoveAllMatches( _mqttSubscription_t * pSubscriptionArray,
 
 /*-----------------------------------------------------------*/
 
-int8_t IotMqtt_FindFirstMatch( _mqttSubscription_t * pSubscriptionArray,
-                               int8_t startIndex,
-                               _topicMatchParams_t * pMatch )
+int16_t IotMqtt_FindFirstMatch( _mqttSubscription_t * pSubscriptionArray,
+                                int16_t startIndex,
+                                _topicMatchParams_t * pMatch )
 {
     /* This function must not be called with a NULL pSubscriptionArray parameter. */
     IotMqtt_Assert( pSubscriptionArray != NULL );
@@ -343,3 +492,375 @@ int8_t IotMqtt_FindFirstMatch( _mqttSubscription_t * pSubscriptionArray,
 }
 
 /*-----------------------------------------------------------*/
+
+static bool _levelMatch( const IotHashLink_t * const pLevelLink,
+                         void * pMatch )
+{
+    /* Because this function is called from a container function, the given link
+     * must never be NULL. */
+    IotMqtt_Assert( pLevelLink != NULL );
+
+    const _mqttTrieNode_t * pNode = IotLink_Container( _mqttTrieNode_t,
+                                                       pLevelLink,
+                                                       link );
+    const _levelMatchParams_t * pParam = ( const _levelMatchParams_t * ) pMatch;
+
+    /* The hash table has already compared the hash of the parent and level text. */
+    return ( pNode->pParent == pParam->pParent ) &&
+           ( pNode->levelLength == pParam->levelLength );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t _levelHash( const _mqttTrieNode_t * pParent,
+                            const char * pLevel,
+                            uint16_t levelLength )
+{
+    /* For a given parent, equal keys imply equal level hashes. */
+    return IotHash_String( pLevel, levelLength ) ^
+           IotHash_Uint32( ( uint32_t ) ( uintptr_t ) pParent );
+}
+
+/*-----------------------------------------------------------*/
+
+static _mqttTrieNode_t * _getLevelNode( _mqttSubscriptionTrie_t * pTrie,
+                                        _mqttTrieNode_t * pParent,
+                                        const char * pLevel,
+                                        uint16_t levelLength )
+{
+    _mqttTrieNode_t * pNode = NULL;
+    _mqttTrieNode_t ** ppWildcard = NULL;
+    IotHashLink_t * pLevelLink = NULL;
+    uint32_t hash = 0;
+    _levelMatchParams_t levelMatchParams =
+    {
+        .pParent     = pParent,
+        .levelLength = levelLength
+    };
+
+    /* Wildcard levels are kept in their parent rather than in the hash table. */
+    if( ( levelLength == 1U ) && ( pLevel[ 0 ] == '+' ) )
+    {
+        ppWildcard = &( pParent->pSingleLevel );
+        pNode = *ppWildcard;
+    }
+    else if( ( levelLength == 1U ) && ( pLevel[ 0 ] == '#' ) )
+    {
+        ppWildcard = &( pParent->pMultiLevel );
+        pNode = *ppWildcard;
+    }
+    else
+    {
+        hash = _levelHash( pParent, pLevel, levelLength );
+        pLevelLink = IotHashTable_FindFirstMatch( &( pTrie->levels ),
+                                                  hash,
+                                                  _levelMatch,
+                                                  &levelMatchParams );
+
+        if( pLevelLink != NULL )
+        {
+            pNode = IotLink_Container( _mqttTrieNode_t, pLevelLink, link );
+        }
+    }
+
+    /* Create the node if this level is new. */
+    if( pNode == NULL )
+    {
+        if( pTrie->pFreeNodes != NULL )
+        {
+            pNode = pTrie->pFreeNodes;
+            pTrie->pFreeNodes = pNode->pParent;
+        }
+        else if( pTrie->nodesUsed < ( size_t ) MQTT_SUBSCRIPTION_TRIE_NODES )
+        {
+            pNode = &( pTrie->nodes[ pTrie->nodesUsed ] );
+            pTrie->nodesUsed++;
+        }
+
+        if( pNode != NULL )
+        {
+            ( void ) memset( pNode, 0x00, sizeof( _mqttTrieNode_t ) );
+            pNode->pParent = pParent;
+            pNode->levelLength = levelLength;
+            IotListDouble_Create( &( pNode->subscriptions ) );
+
+            if( ppWildcard != NULL )
+            {
+                *ppWildcard = pNode;
+            }
+            else
+            {
+                IotHashTable_Insert( &( pTrie->levels ), &( pNode->link ), hash );
+            }
+
+            pParent->references++;
+        }
+    }
+
+    return pNode;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _releaseLevelNodes( _mqttSubscriptionTrie_t * pTrie,
+                                _mqttTrieNode_t * pNode )
+{
+    _mqttTrieNode_t * pParent = NULL;
+
+    while( ( pNode != &( pTrie->root ) ) && ( pNode->references == 0U ) )
+    {
+        pParent = pNode->pParent;
+
+        /* Unlink the node from its parent. */
+        if( pParent->pSingleLevel == pNode )
+        {
+            pParent->pSingleLevel = NULL;
+        }
+        else if( pParent->pMultiLevel == pNode )
+        {
+            pParent->pMultiLevel = NULL;
+        }
+        else
+        {
+            IotHashTable_Remove( &( pTrie->levels ), &( pNode->link ) );
+        }
+
+        /* Return the node to the free list. */
+        pNode->pParent = pTrie->pFreeNodes;
+        pTrie->pFreeNodes = pNode;
+
+        IotMqtt_Assert( pParent->references > 0U );
+        pParent->references--;
+        pNode = pParent;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _removeTrieEntry( _mqttSubscriptionTrie_t * pTrie,
+                              _mqttTrieEntry_t * pEntry )
+{
+    _mqttTrieNode_t * pNode = pEntry->pNode;
+
+    if( pNode != NULL )
+    {
+        IotListDouble_Remove( &( pEntry->link ) );
+        pEntry->pNode = NULL;
+
+        IotMqtt_Assert( pNode->references > 0U );
+        pNode->references--;
+        _releaseLevelNodes( pTrie, pNode );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _matchLevelSubscriptions( const _mqttSubscriptionTrie_t * pTrie,
+                                      const _mqttTrieNode_t * pNode,
+                                      _mqttSubscription_t * pSubscriptionArray,
+                                      int16_t startIndex,
+                                      _topicMatchParams_t * pMatch,
+                                      int16_t * pFirstIndex )
+{
+    const IotLink_t * pEntryLink = NULL;
+    const _mqttTrieEntry_t * pEntry = NULL;
+    int16_t index = -1;
+
+    IotContainers_ForEach( &( pNode->subscriptions ), pEntryLink )
+    {
+        pEntry = IotLink_Container( _mqttTrieEntry_t, pEntryLink, link );
+        index = ( int16_t ) ( pEntry - &( pTrie->entries[ 0 ] ) );
+
+        /* Only check subscriptions that would improve on the first match so far.
+         * Entries of removed subscriptions and colliding levels are rejected by
+         * comparing against the topic filter. An unsubscribed subscription
+         * waiting for its last callback takes no new references. */
+        if( ( index >= startIndex ) &&
+            ( ( *pFirstIndex == -1 ) || ( index < *pFirstIndex ) ) &&
+            ( pSubscriptionArray[ index ].topicFilterLength != 0U ) &&
+            ( pSubscriptionArray[ index ].unsubscribed == false ) &&
+            ( _topicMatch( &( pSubscriptionArray[ index ] ), pMatch ) == true ) )
+        {
+            *pFirstIndex = index;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotMqtt_AddSubscriptionToTrie( _mqttSubscriptionTrie_t * pTrie,
+                                    const _mqttSubscription_t * pSubscriptionArray,
+                                    int16_t index )
+{
+    bool status = true;
+    _mqttTrieNode_t * pNode = NULL, * pChild = NULL;
+    _mqttTrieEntry_t * pEntry = NULL;
+    const char * pTopicFilter = NULL;
+    uint16_t topicFilterLength = 0, levelStart = 0, levelEnd = 0;
+
+    IotMqtt_Assert( pTrie != NULL );
+    IotMqtt_Assert( pSubscriptionArray != NULL );
+    IotMqtt_Assert( ( index > -1 ) && ( index < MAX_NO_OF_MQTT_SUBSCRIPTIONS ) );
+
+    pEntry = &( pTrie->entries[ index ] );
+    pTopicFilter = pSubscriptionArray[ index ].pTopicFilter;
+    topicFilterLength = pSubscriptionArray[ index ].topicFilterLength;
+
+    /* An all-zero trie is valid; create its hash table on first use. */
+    if( pTrie->levels.pBuckets == NULL )
+    {
+        IotHashTable_Create( &( pTrie->levels ),
+                             pTrie->pBuckets,
+                             MQTT_SUBSCRIPTION_TRIE_BUCKETS );
+    }
+
+    /* The array element may have held another subscription. */
+    _removeTrieEntry( pTrie, pEntry );
+
+    /* Walk down the trie one topic filter level at a time, creating any missing
+     * levels. */
+    pNode = &( pTrie->root );
+
+    while( status == true )
+    {
+        levelEnd = levelStart;
+
+        while( ( levelEnd < topicFilterLength ) && ( pTopicFilter[ levelEnd ] != '/' ) )
+        {
+            levelEnd++;
+        }
+
+        pChild = _getLevelNode( pTrie,
+                                pNode,
+                                &( pTopicFilter[ levelStart ] ),
+                                ( uint16_t ) ( levelEnd - levelStart ) );
+
+        if( pChild == NULL )
+        {
+            /* Out of nodes. Release the levels created for this subscription. */
+            _releaseLevelNodes( pTrie, pNode );
+            status = false;
+        }
+        else
+        {
+            pNode = pChild;
+
+            if( levelEnd == topicFilterLength )
+            {
+                break;
+            }
+            else
+            {
+                levelStart = ( uint16_t ) ( levelEnd + 1U );
+            }
+        }
+    }
+
+    if( status == true )
+    {
+        IotListDouble_InsertTail( &( pNode->subscriptions ), &( pEntry->link ) );
+        pEntry->pNode = pNode;
+        pNode->references++;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+int16_t IotMqtt_FindFirstMatchInTrieShared( _mqttSubscriptionTrie_t * pTrie,
+                                            _mqttTriePending_t * pPending,
+                                            _mqttSubscription_t * pSubscriptionArray,
+                                            int16_t startIndex,
+                                            _topicMatchParams_t * pMatch )
+{
+    int16_t firstIndex = -1;
+    size_t pendingCount = 0;
+    _mqttTrieNode_t * pNode = NULL, * pChild = NULL;
+    IotHashLink_t * pLevelLink = NULL;
+    uint32_t nameIndex = 0, levelEnd = 0;
+    _levelMatchParams_t levelMatchParams = { 0 };
+
+    IotMqtt_Assert( pTrie != NULL );
+    IotMqtt_Assert( pPending != NULL );
+    IotMqtt_Assert( pSubscriptionArray != NULL );
+    IotMqtt_Assert( startIndex >= 0 );
+    IotMqtt_Assert( pMatch->exactMatchOnly == false );
+
+    const char * pTopicName = pMatch->pTopicName;
+    const uint32_t topicNameLength = pMatch->topicNameLength;
+
+    /* A trie with no subscriptions has not created its hash table. */
+    if( pTrie->levels.pBuckets != NULL )
+    {
+        pPending[ 0 ].pNode = &( pTrie->root );
+        pPending[ 0 ].nameIndex = 0;
+        pendingCount = 1;
+    }
+
+    /* Visit every node that matches a prefix of the topic name. Each node has a
+     * single parent and is visited at most once, so the pending nodes never
+     * outnumber the trie's nodes. */
+    while( pendingCount > 0U )
+    {
+        pendingCount--;
+        pNode = pPending[ pendingCount ].pNode;
+        nameIndex = pPending[ pendingCount ].nameIndex;
+
+        /* "#" matches the remaining levels, and also the parent level: "sport/#"
+         * matches "sport". */
+        if( pNode->pMultiLevel != NULL )
+        {
+            _matchLevelSubscriptions( pTrie, pNode->pMultiLevel, pSubscriptionArray,
+                                      startIndex, pMatch, &firstIndex );
+        }
+
+        if( nameIndex > topicNameLength )
+        {
+            /* All levels of the topic name matched. */
+            _matchLevelSubscriptions( pTrie, pNode, pSubscriptionArray,
+                                      startIndex, pMatch, &firstIndex );
+        }
+        else
+        {
+            levelEnd = nameIndex;
+
+            while( ( levelEnd < topicNameLength ) && ( pTopicName[ levelEnd ] != '/' ) )
+            {
+                levelEnd++;
+            }
+
+            /* Follow the exact level. */
+            levelMatchParams.pParent = pNode;
+            levelMatchParams.levelLength = ( uint16_t ) ( levelEnd - nameIndex );
+            pLevelLink = IotHashTable_FindFirstMatch( &( pTrie->levels ),
+                                                      _levelHash( pNode,
+                                                                  &( pTopicName[ nameIndex ] ),
+                                                                  levelMatchParams.levelLength ),
+                                                      _levelMatch,
+                                                      &levelMatchParams );
+
+            if( pLevelLink != NULL )
+            {
+                pChild = IotLink_Container( _mqttTrieNode_t, pLevelLink, link );
+                IotMqtt_Assert( pendingCount <= ( size_t ) MQTT_SUBSCRIPTION_TRIE_NODES );
+                pPending[ pendingCount ].pNode = pChild;
+                pPending[ pendingCount ].nameIndex = levelEnd + 1U;
+                pendingCount++;
+            }
+
+            /* Follow the "+" wildcard. */
+            if( pNode->pSingleLevel != NULL )
+            {
+                IotMqtt_Assert( pendingCount <= ( size_t ) MQTT_SUBSCRIPTION_TRIE_NODES );
+                pPending[ pendingCount ].pNode = pNode->pSingleLevel;
+                pPending[ pendingCount ].nameIndex = levelEnd + 1U;
+                pendingCount++;
+            }
+        }
+    }
+
+    return firstIndex;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,280 @@
+/*
+ * FreeRTOS MQTT V2.3.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_mqtt_subscription_registry.c
+ * @brief Implements the registry that carries subscriptions across connections.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* Error handling include. */
+#include "private/iot_error.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Platform layer includes. */
+#include "platform/iot_threads.h"
+
+/* Using initialized connToContext variable. */
+extern _connContext_t connToContext[ MAX_NO_OF_MQTT_CONNECTIONS ];
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t _IotMqtt_RestoreSubscriptions( _mqttConnection_t * pMqttConnection,
+                                              IotMqttSubscriptionRegistry_t * pRegistry,
+                                              uint32_t timeoutMs )
+{
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+
+    /* The saved subscriptions must not change while they are restored, so the
+     * registry stays locked for the round trip of the bulk SUBSCRIBE. */
+    IotMutex_Lock( &( pRegistry->mutex ) );
+
+    if( ( pRegistry->subscriptionCount > 0U ) && ( pMqttConnection->sessionPresent == true ) )
+    {
+        /* The server kept the subscriptions, so only their callbacks need to
+         * be set. Packet identifier 0 is never used by a SUBSCRIBE. */
+        IotLogInfo( "(MQTT connection %p) Session present; restoring %lu subscriptions "
+                    "without SUBSCRIBE.",
+                    pMqttConnection,
+                    ( unsigned long ) pRegistry->subscriptionCount );
+
+        status = _IotMqtt_AddSubscriptions( pMqttConnection,
+                                            0,
+                                            pRegistry->pSubscriptions,
+                                            pRegistry->subscriptionCount );
+    }
+    else if( pRegistry->subscriptionCount > 0U )
+    {
+        IotLogInfo( "(MQTT connection %p) Restoring %lu subscriptions.",
+                    pMqttConnection,
+                    ( unsigned long ) pRegistry->subscriptionCount );
+
+        status = IotMqtt_TimedSubscribeBulk( pMqttConnection,
+                                             pRegistry->pSubscriptions,
+                                             pRegistry->subscriptionCount,
+                                             0,
+                                             timeoutMs );
+
+        /* Topic filters refused by the server are removed by their SUBACK; the
+         * connection is usable with the others. */
+        if( status == IOT_MQTT_SERVER_REFUSED )
+        {
+            IotLogWarn( "(MQTT connection %p) Server refused some restored subscriptions.",
+                        pMqttConnection );
+
+            status = IOT_MQTT_SUCCESS;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    /* Save this connection's subscriptions when it is destroyed. */
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        pRegistry->connection = pMqttConnection;
+        pMqttConnection->pSubscriptionRegistry = pRegistry;
+    }
+    else
+    {
+        IotLogError( "(MQTT connection %p) Failed to restore subscriptions, error %s.",
+                     pMqttConnection,
+                     IotMqtt_strerror( status ) );
+    }
+
+    IotMutex_Unlock( &( pRegistry->mutex ) );
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_SaveSubscriptions( _mqttConnection_t * pMqttConnection,
+                                 int8_t contextIndex )
+{
+    IotMqttSubscriptionRegistry_t * pRegistry = pMqttConnection->pSubscriptionRegistry;
+    const _mqttSubscription_t * pSubscription = NULL;
+    IotMqttSubscription_t * pSaved = NULL;
+    size_t i = 0, filterOffset = 0, droppedCount = 0;
+
+    if( pRegistry != NULL )
+    {
+        IotMutex_Lock( &( pRegistry->mutex ) );
+
+        /* Only the connection that last restored the registry saves in it. A
+         * newer connection may have restored it while this one was still
+         * being disconnected. */
+        if( pRegistry->connection == pMqttConnection )
+        {
+            pRegistry->subscriptionCount = 0;
+
+            for( i = 0; i < MAX_NO_OF_MQTT_SUBSCRIPTIONS; i++ )
+            {
+                pSubscription = &( connToContext[ contextIndex ].subscriptionArray[ i ] );
+
+                /* Skip free elements and subscriptions waiting to be removed. */
+                if( ( pSubscription->topicFilterLength == 0U ) || ( pSubscription->unsubscribed == true ) )
+                {
+                    continue;
+                }
+                else
+                {
+                    EMPTY_ELSE_MARKER;
+                }
+
+                if( ( pRegistry->subscriptionCount == pRegistry->subscriptionLimit ) ||
+                    ( ( size_t ) pSubscription->topicFilterLength > ( pRegistry->filterBufferSize - filterOffset ) ) )
+                {
+                    droppedCount++;
+                }
+                else
+                {
+                    pSaved = &( pRegistry->pSubscriptions[ pRegistry->subscriptionCount ] );
+
+                    ( void ) memcpy( &( pRegistry->pFilterBuffer[ filterOffset ] ),
+                                     pSubscription->pTopicFilter,
+                                     ( size_t ) pSubscription->topicFilterLength );
+
+                    pSaved->qos = pSubscription->qos;
+                    pSaved->pTopicFilter = &( pRegistry->pFilterBuffer[ filterOffset ] );
+                    pSaved->topicFilterLength = pSubscription->topicFilterLength;
+                    pSaved->callback = pSubscription->callback;
+
+                    filterOffset += ( size_t ) pSubscription->topicFilterLength;
+                    ( pRegistry->subscriptionCount )++;
+                }
+            }
+
+            if( droppedCount > 0U )
+            {
+                IotLogWarn( "(MQTT connection %p) %lu subscriptions did not fit in the "
+                            "subscription registry and will not be restored.",
+                            pMqttConnection,
+                            ( unsigned long ) droppedCount );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+
+            IotLogDebug( "(MQTT connection %p) Saved %lu subscriptions.",
+                         pMqttConnection,
+                         ( unsigned long ) pRegistry->subscriptionCount );
+
+            pRegistry->connection = NULL;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        IotMutex_Unlock( &( pRegistry->mutex ) );
+
+        pMqttConnection->pSubscriptionRegistry = NULL;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_SubscriptionRegistryInit( IotMqttSubscriptionRegistry_t * pRegistry,
+                                                 IotMqttSubscription_t * pSubscriptions,
+                                                 size_t subscriptionLimit,
+                                                 char * pFilterBuffer,
+                                                 size_t filterBufferSize )
+{
+    IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
+
+    if( ( pRegistry == NULL ) ||
+        ( pSubscriptions == NULL ) || ( subscriptionLimit == 0U ) ||
+        ( pFilterBuffer == NULL ) || ( filterBufferSize == 0U ) )
+    {
+        IotLogError( "Subscription registry requires a subscription array and a filter buffer." );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_BAD_PARAMETER );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    ( void ) memset( pRegistry, 0x00, sizeof( IotMqttSubscriptionRegistry_t ) );
+    pRegistry->pSubscriptions = pSubscriptions;
+    pRegistry->subscriptionLimit = subscriptionLimit;
+    pRegistry->pFilterBuffer = pFilterBuffer;
+    pRegistry->filterBufferSize = filterBufferSize;
+
+    /* The mutex is recursive. Restoring the registry may fail the bulk
+     * SUBSCRIBE, and a disconnect callback run from that failure may destroy
+     * an older connection that saves in this registry. */
+    if( IotMutex_Create( &( pRegistry->mutex ), true ) == false )
+    {
+        IotLogError( "Failed to create mutex for subscription registry." );
+
+        IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_NO_MEMORY );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IOT_FUNCTION_EXIT_NO_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_SubscriptionRegistryDestroy( IotMqttSubscriptionRegistry_t * pRegistry )
+{
+    /* Connections established with the registry must be destroyed first. */
+    IotMqtt_Assert( pRegistry->connection == NULL );
+
+    IotMutex_Destroy( &( pRegistry->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_SubscriptionRegistryClear( IotMqttSubscriptionRegistry_t * pRegistry )
+{
+    IotMutex_Lock( &( pRegistry->mutex ) );
+    pRegistry->subscriptionCount = 0;
+    IotMutex_Unlock( &( pRegistry->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
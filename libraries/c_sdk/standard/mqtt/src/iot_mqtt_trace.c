@@ -0,0 +1,292 @@
+/*
+ * FreeRTOS MQTT V2.3.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file iot_mqtt_trace.c
+ * @brief Implements the PUBLISH trace points and the trace ring buffer.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdio.h>
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+
+/* Atomics include. */
+#include "iot_atomic.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Length of the buffer that holds one line of a trace ring dump.
+ */
+#define TRACE_LINE_LENGTH    ( 96 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find how long after the previous record of its operation a record
+ * was written.
+ *
+ * @param[in] pRing The ring being printed.
+ * @param[in] firstIndex Write index of the oldest record in the ring.
+ * @param[in] recordIndex Write index of the record.
+ * @param[out] pDelta Set to the time since the previous record.
+ *
+ * @return `true` if a previous record of the operation is in the ring.
+ */
+static bool _previousRecordDelta( const IotMqttTraceRing_t * pRing,
+                                  uint32_t firstIndex,
+                                  uint32_t recordIndex,
+                                  uint64_t * pDelta );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The sink of all PUBLISH trace records and its context; `NULL` if
+ * tracing is off.
+ *
+ * Swapped as a single pointer, so a trace point always reads a sink together
+ * with its own context.
+ */
+static IotMqttTraceSinkInfo_t * volatile _pTraceSinkInfo = NULL;
+
+/*-----------------------------------------------------------*/
+
+static bool _previousRecordDelta( const IotMqttTraceRing_t * pRing,
+                                  uint32_t firstIndex,
+                                  uint32_t recordIndex,
+                                  uint64_t * pDelta )
+{
+    bool found = false;
+    uint32_t index = recordIndex;
+    const IotMqttTraceRecord_t * pRecord = &( pRing->pRecords[ recordIndex % pRing->recordCount ] );
+    const IotMqttTraceRecord_t * pPrevious = NULL;
+
+    /* A created PUBLISH is a new operation, even if its record was used before. */
+    if( pRecord->event != IOT_MQTT_TRACE_PUBLISH_CREATED )
+    {
+        while( ( found == false ) && ( index != firstIndex ) )
+        {
+            index--;
+            pPrevious = &( pRing->pRecords[ index % pRing->recordCount ] );
+
+            if( pPrevious->operation == pRecord->operation )
+            {
+                *pDelta = pRecord->timestamp - pPrevious->timestamp;
+                found = true;
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_Trace( _mqttOperation_t * pOperation,
+                     IotMqttTraceEvent_t event )
+{
+    const IotMqttTraceSinkInfo_t * pSinkInfo = _pTraceSinkInfo;
+    IotMqttTraceRecord_t record = { 0 };
+
+    if( ( pSinkInfo != NULL ) &&
+        ( pOperation->incomingPublish == false ) &&
+        ( pOperation->u.operation.type == IOT_MQTT_PUBLISH_TO_SERVER ) )
+    {
+        record.timestamp = IOT_MQTT_TRACE_TIMESTAMP();
+        record.mqttConnection = pOperation->pMqttConnection;
+        record.operation = pOperation;
+        record.packetIdentifier = pOperation->u.operation.packetIdentifier;
+        record.event = event;
+
+        pSinkInfo->sink( pSinkInfo->pSinkContext, &record );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_SetTraceSink( const IotMqttTraceSinkInfo_t * pSinkInfo )
+{
+    /* The sink and its context are installed together with one pointer swap. */
+    ( void ) Atomic_SwapPointers_p32( ( void * volatile * ) &_pTraceSinkInfo,
+                                      ( void * ) pSinkInfo );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_TraceRingInit( IotMqttTraceRing_t * pRing,
+                            IotMqttTraceRecord_t * pRecords,
+                            uint32_t recordCount )
+{
+    IotMqtt_Assert( recordCount > 0U );
+
+    pRing->pRecords = pRecords;
+    pRing->recordCount = recordCount;
+    pRing->writeCount = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_TraceRingSink( void * pSinkContext,
+                            const IotMqttTraceRecord_t * pRecord )
+{
+    IotMqttTraceRing_t * pRing = ( IotMqttTraceRing_t * ) pSinkContext;
+
+    /* Claim a slot, so that concurrent PUBLISH operations write different records. */
+    uint32_t index = Atomic_Increment_u32( &( pRing->writeCount ) ) % pRing->recordCount;
+
+    pRing->pRecords[ index ] = *pRecord;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t IotMqtt_TraceRingDump( const IotMqttTraceRing_t * pRing,
+                                void ( * print )( void * pPrintContext,
+                                                  const char * pLine ),
+                                void * pPrintContext )
+{
+    uint32_t printCount = pRing->writeCount;
+    uint32_t firstIndex = 0, i = 0;
+    uint64_t delta = 0;
+    const IotMqttTraceRecord_t * pRecord = NULL;
+    char pLine[ TRACE_LINE_LENGTH ] = { 0 };
+
+    /* Only the newest records remain once the ring has wrapped. */
+    if( printCount > pRing->recordCount )
+    {
+        printCount = pRing->recordCount;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    firstIndex = pRing->writeCount - printCount;
+
+    for( i = firstIndex; i != firstIndex + printCount; i++ )
+    {
+        pRecord = &( pRing->pRecords[ i % pRing->recordCount ] );
+
+        if( _previousRecordDelta( pRing, firstIndex, i, &delta ) == true )
+        {
+            ( void ) snprintf( pLine,
+                               sizeof( pLine ),
+                               "%10lu %p %5u %-18s +%lu",
+                               ( unsigned long ) pRecord->timestamp,
+                               ( void * ) pRecord->operation,
+                               ( unsigned ) pRecord->packetIdentifier,
+                               IotMqtt_TraceEventName( pRecord->event ),
+                               ( unsigned long ) delta );
+        }
+        else
+        {
+            ( void ) snprintf( pLine,
+                               sizeof( pLine ),
+                               "%10lu %p %5u %-18s",
+                               ( unsigned long ) pRecord->timestamp,
+                               ( void * ) pRecord->operation,
+                               ( unsigned ) pRecord->packetIdentifier,
+                               IotMqtt_TraceEventName( pRecord->event ) );
+        }
+
+        print( pPrintContext, pLine );
+    }
+
+    return printCount;
+}
+
+/*-----------------------------------------------------------*/
+
+const char * IotMqtt_TraceEventName( IotMqttTraceEvent_t event )
+{
+    const char * pName = NULL;
+
+    switch( event )
+    {
+        case IOT_MQTT_TRACE_PUBLISH_CREATED:
+            pName = "PUBLISH CREATED";
+            break;
+
+        case IOT_MQTT_TRACE_PUBLISH_LOCKED:
+            pName = "PUBLISH LOCKED";
+            break;
+
+        case IOT_MQTT_TRACE_PUBLISH_SERIALIZED:
+            pName = "PUBLISH SERIALIZED";
+            break;
+
+        case IOT_MQTT_TRACE_PUBLISH_SENT:
+            pName = "PUBLISH SENT";
+            break;
+
+        case IOT_MQTT_TRACE_RETRY_SCHEDULED:
+            pName = "RETRY SCHEDULED";
+            break;
+
+        case IOT_MQTT_TRACE_RETRY_SENT:
+            pName = "RETRY SENT";
+            break;
+
+        case IOT_MQTT_TRACE_PUBACK_RECEIVED:
+            pName = "PUBACK RECEIVED";
+            break;
+
+        case IOT_MQTT_TRACE_NOTIFIED:
+            pName = "NOTIFIED";
+            break;
+
+        case IOT_MQTT_TRACE_CALLBACK:
+            pName = "CALLBACK";
+            break;
+
+        default:
+            pName = "INVALID EVENT";
+            break;
+    }
+
+    return pName;
+}
+
+/*-----------------------------------------------------------*/
@@ -38,6 +38,9 @@
 /* Linear containers (lists and queues) include. */
 #include "iot_linear_containers.h"
 
+/* Indexed containers (hash tables) include. */
+#include "iot_indexed_containers.h"
+
 /* MQTT include. */
 #include "iot_mqtt.h"
 
@@ -207,6 +210,15 @@
 #ifndef IOT_MQTT_RETRY_MS_CEILING
     #define IOT_MQTT_RETRY_MS_CEILING               ( 60000 )
 #endif
+#ifndef IOT_MQTT_RETRY_MS_FLOOR
+    #define IOT_MQTT_RETRY_MS_FLOOR                 ( 200 )
+#endif
+#ifndef IOT_MQTT_ENABLE_TRACE
+    #define IOT_MQTT_ENABLE_TRACE                   ( 0 )
+#endif
+#ifndef IOT_MQTT_TRACE_TIMESTAMP
+    #define IOT_MQTT_TRACE_TIMESTAMP()              IotClock_GetTimeMs()
+#endif
 /** @endcond */
 
 /**
@@ -253,21 +265,130 @@
 /**
  * @brief Default config for Maximum Number of MQTT CONNECTIONS.
  * This config can be specified by the application based on number of MQTT
- * connections needed.
+ * connections needed. Contexts are addressed by 8-bit indexes, so the maximum
+ * number of connections that shim can hold is 127.
  */
 #ifndef MAX_NO_OF_MQTT_CONNECTIONS
     #define MAX_NO_OF_MQTT_CONNECTIONS    ( 2 )
 #endif
 
+#if ( MAX_NO_OF_MQTT_CONNECTIONS <= 0 ) || ( MAX_NO_OF_MQTT_CONNECTIONS > 127 )
+    #error "MAX_NO_OF_MQTT_CONNECTIONS must be between 1 and 127."
+#endif
+
 /**
  * @brief Default config for Maximum Number of MQTT Subscriptions.
  * This config can be specified by the application based on number of MQTT
- * subscriptions. Maximum number of subscriptions that shim can hold is 128.
+ * subscriptions. Subscriptions are addressed by 16-bit indexes, so the maximum
+ * number of subscriptions that shim can hold per connection is 32767.
  */
 #ifndef MAX_NO_OF_MQTT_SUBSCRIPTIONS
     #define MAX_NO_OF_MQTT_SUBSCRIPTIONS    ( 10 )
 #endif
 
+#if ( MAX_NO_OF_MQTT_SUBSCRIPTIONS <= 0 ) || ( MAX_NO_OF_MQTT_SUBSCRIPTIONS > 32767 )
+    #error "MAX_NO_OF_MQTT_SUBSCRIPTIONS must be between 1 and 32767."
+#endif
+
+/**
+ * @brief Default config for the number of topic filter levels the subscription
+ * trie of a connection can hold.
+ *
+ * Each distinct topic filter prefix takes one node, so filters that share their
+ * leading levels share nodes. A SUBSCRIBE that needs more nodes than are free
+ * fails with #IOT_MQTT_NO_MEMORY.
+ */
+#ifndef MQTT_SUBSCRIPTION_TRIE_NODES
+    #define MQTT_SUBSCRIPTION_TRIE_NODES    ( MAX_NO_OF_MQTT_SUBSCRIPTIONS * 4 )
+#endif
+
+/**
+ * @brief Default config for the number of hash buckets of the subscription trie
+ * of a connection. Must be a power of 2.
+ */
+#ifndef MQTT_SUBSCRIPTION_TRIE_BUCKETS
+    #define MQTT_SUBSCRIPTION_TRIE_BUCKETS    ( 16 )
+#endif
+
+/**
+ * @brief Default config for the number of lists that hold the operations of a
+ * connection awaiting a server response. Must be a power of 2.
+ *
+ * Operations are placed in a list by their packet identifier, so a response is
+ * matched by searching one list instead of every outstanding operation.
+ */
+#ifndef MQTT_PENDING_RESPONSE_BUCKETS
+    #define MQTT_PENDING_RESPONSE_BUCKETS    ( 16 )
+#endif
+
+#if ( MQTT_PENDING_RESPONSE_BUCKETS & ( MQTT_PENDING_RESPONSE_BUCKETS - 1 ) ) != 0
+    #error "MQTT_PENDING_RESPONSE_BUCKETS must be a power of 2."
+#endif
+
+/**
+ * @brief Default config for the number of locks that guard the subscriptions of
+ * a connection.
+ *
+ * Each incoming PUBLISH takes one of these locks to match and reference its
+ * subscriptions, so up to this many PUBLISH messages are matched at once.
+ * Changing the subscriptions takes every lock. Each lock also holds room for
+ * #MQTT_SUBSCRIPTION_TRIE_NODES nodes left to visit while matching.
+ */
+#ifndef MQTT_SUBSCRIPTION_LOCK_SHARDS
+    #define MQTT_SUBSCRIPTION_LOCK_SHARDS    ( 4 )
+#endif
+
+#if ( MQTT_SUBSCRIPTION_LOCK_SHARDS <= 0 ) || ( MQTT_SUBSCRIPTION_LOCK_SHARDS > 64 )
+    #error "MQTT_SUBSCRIPTION_LOCK_SHARDS must be between 1 and 64."
+#endif
+
+/**
+ * @brief Default config for the number of operation records each connection
+ * keeps for reuse.
+ *
+ * Operations of a connection take a record from its pool while one is free and
+ * are allocated with #IotMqtt_MallocOperation otherwise. Incoming PUBLISH
+ * messages are always allocated, since they may be retained past the connection.
+ */
+#ifndef MQTT_OPERATION_POOL_SIZE
+    #define MQTT_OPERATION_POOL_SIZE    ( 4 )
+#endif
+
+#if ( MQTT_OPERATION_POOL_SIZE <= 0 ) || ( MQTT_OPERATION_POOL_SIZE > 32 )
+    #error "MQTT_OPERATION_POOL_SIZE must be between 1 and 32."
+#endif
+
+/**
+ * @brief Default config for the size of the packet area of each pooled operation record.
+ *
+ * Packets made for an operation that fit in this area, such as the copy of a
+ * PUBLISH kept for retransmission or the topic filter list of a SUBSCRIBE, are
+ * placed in it instead of being allocated with #IotMqtt_MallocMessage. Only the
+ * records of the operation pool have a packet area.
+ */
+#ifndef MQTT_OPERATION_INLINE_PACKET_SIZE
+    #define MQTT_OPERATION_INLINE_PACKET_SIZE    ( 128 )
+#endif
+
+#if MQTT_OPERATION_INLINE_PACKET_SIZE < 8
+    #error "MQTT_OPERATION_INLINE_PACKET_SIZE must be at least 8."
+#endif
+
+/**
+ * @brief Default config for the number of SUBSCRIBE packets that
+ * @ref mqtt_function_timedsubscribebulk keeps awaiting SUBACK.
+ *
+ * A bulk subscription sends this many SUBSCRIBE packets before it waits for
+ * the first SUBACK, and sends another each time a SUBACK arrives.
+ */
+#ifndef MQTT_BULK_SUBSCRIBE_WINDOW
+    #define MQTT_BULK_SUBSCRIBE_WINDOW    ( 8 )
+#endif
+
+#if MQTT_BULK_SUBSCRIBE_WINDOW <= 0
+    #error "MQTT_BULK_SUBSCRIBE_WINDOW must be positive."
+#endif
+
 /**
  * @brief Static buffer size provided to MQTT LTS API.
  * This buffer will be used to send the packets on the network.
@@ -278,6 +399,23 @@
 #endif
 /*---------------------- MQTT internal data structures ----------------------*/
 
+/**
+ * @brief Bytes read from the network ahead of the MQTT packets that use them.
+ *
+ * Filled by one call to the network interface's `receiveUpto` and drained in
+ * order by the packet framing in the receive callback. It is only refilled once
+ * it is empty, so the unread bytes never wrap around the end of the buffer.
+ */
+typedef struct _mqttReceiveBuffer
+{
+    void * pNetworkConnection;                       /**< @brief Network connection that fills the buffer. */
+    const IotNetworkInterface_t * pNetworkInterface; /**< @brief Network interface that fills the buffer. */
+    uint8_t * pBuffer;                               /**< @brief The buffer; `NULL` if receives are not buffered. */
+    size_t bufferSize;                               /**< @brief Size of #_mqttReceiveBuffer_t.pBuffer. */
+    size_t offset;                                   /**< @brief Index of the first unread byte. */
+    size_t length;                                   /**< @brief Number of unread bytes. */
+} _mqttReceiveBuffer_t;
+
 /**
  * @brief Represents an MQTT connection.
  */
@@ -294,19 +432,57 @@ typedef struct _mqttConnection
     #endif
 
     bool disconnected;                           /**< @brief Tracks if this connection has been disconnected. */
+    bool sessionPresent;                         /**< @brief The session present flag of this connection's CONNACK. */
     IotMutex_t referencesMutex;                  /**< @brief Recursive mutex. Grants access to connection state and operation lists. */
     int32_t references;                          /**< @brief Counts callbacks and operations using this connection. */
     IotListDouble_t pendingProcessing;           /**< @brief List of operations waiting to be processed by a task pool routine. */
-    IotListDouble_t pendingResponse;             /**< @brief List of processed operations awaiting a server response. */
+    IotListDouble_t pendingResponse[ MQTT_PENDING_RESPONSE_BUCKETS ]; /**< @brief Lists of processed operations awaiting a server response, indexed by packet identifier. */
+    uint32_t inflightMax;                        /**< @brief Most QoS 1 PUBLISH operations that may await a PUBACK; 0 for no limit. */
+    uint32_t inflightCount;                      /**< @brief QoS 1 PUBLISH operations holding a slot of the in-flight window. */
+
+    /* Round-trip time estimate, guarded by the references mutex. */
+    IotMqttRttStats_t rttStats;                  /**< @brief Round-trip times measured from acknowledged operations. */
+    uint32_t srttScaled;                         /**< @brief Smoothed round-trip time, in 1/8 ms. */
+    uint32_t rttVarScaled;                       /**< @brief Round-trip time variation, in 1/4 ms. */
 
     uint64_t lastMessageTime;                    /**< @brief When the most recent message was transmitted. */
     bool keepAliveFailure;                       /**< @brief Failure flag for keep-alive operation. */
     uint32_t keepAliveMs;                        /**< @brief Keep-alive interval in milliseconds. Its max value (per spec) is 65,535,000. */
     uint32_t nextKeepAliveMs;                    /**< @brief Relative delay for next keep-alive job. */
+    uint32_t pingWaitMs;                         /**< @brief How long the last PINGREQ waits for a PINGRESP. */
     IotTaskPoolJobStorage_t keepAliveJobStorage; /**< @brief Task pool job for processing this connection's keep-alive. */
     IotTaskPoolJob_t keepAliveJob;               /**< @brief Task pool job for processing this connection's keep-alive. */
     uint8_t * pPingreqPacket;                    /**< @brief An MQTT PINGREQ packet, allocated if keep-alive is active. */
     size_t pingreqPacketSize;                    /**< @brief The size of an allocated PINGREQ packet. */
+
+    /* Members for PUBLISH coalescing, guarded by the mutex of the MQTT context. */
+    uint8_t * pCoalesceBuffer;                   /**< @brief PUBLISH packets held back to be sent together; `NULL` if coalescing is disabled. */
+    uint32_t coalesceMaxBytes;                   /**< @brief Size of #_mqttConnection_t.pCoalesceBuffer. */
+    uint32_t coalesceDelayMs;                    /**< @brief Longest time a PUBLISH packet may be held back. */
+    uint32_t coalescedBytes;                     /**< @brief Bytes held in #_mqttConnection_t.pCoalesceBuffer. */
+    uint32_t coalescedPackets;                   /**< @brief PUBLISH packets held in #_mqttConnection_t.pCoalesceBuffer. */
+    bool coalesceFlushScheduled;                 /**< @brief Whether #_mqttConnection_t.coalesceJob is scheduled. */
+    IotTaskPoolJobStorage_t coalesceJobStorage;  /**< @brief Task pool job that sends held back PUBLISH packets. */
+    IotTaskPoolJob_t coalesceJob;                /**< @brief Task pool job that sends held back PUBLISH packets. */
+    IotMqttCoalesceStats_t coalesceStats;        /**< @brief Statistics of the coalesced PUBLISH packets. */
+
+    /* Reuse of operation records, guarded by the references mutex. Packet
+     * counts are changed atomically. */
+    IotMqttOperationPoolStats_t operationPoolStats; /**< @brief How often operations and their packets avoided an allocation. */
+
+    /* Members for forwarding an offline PUBLISH queue, guarded by the mutex of the queue. */
+    IotMqttOfflineQueue_t * pOfflineQueue;       /**< @brief Offline queue this connection was established with; `NULL` if none. */
+    bool offlineDrainScheduled;                  /**< @brief Whether #_mqttConnection_t.offlineJob is scheduled. */
+    IotTaskPoolJobStorage_t offlineJobStorage;   /**< @brief Task pool job that forwards stored PUBLISH messages. */
+    IotTaskPoolJob_t offlineJob;                 /**< @brief Task pool job that forwards stored PUBLISH messages. */
+
+    /* Subscription registry, set once the connection is established. */
+    IotMqttSubscriptionRegistry_t * pSubscriptionRegistry; /**< @brief Registry that receives this connection's subscriptions when it is destroyed; `NULL` if none. */
+
+    /* Incoming data read ahead of packet framing, only used by the receive callback. */
+    _mqttReceiveBuffer_t receiveBuffer;          /**< @brief Bytes received but not yet framed into MQTT packets. */
+
+    int8_t contextIndex;                         /**< @brief Index of this connection's MQTT context, set when the context is assigned. */
 } _mqttConnection_t;
 
 /**
@@ -326,7 +502,7 @@ typedef struct _mqttSubscription
 {
     IotLink_t link;     /**< @brief List link member. */
 
-    int32_t references; /**< @brief How many subscription callbacks are using this subscription. */
+    int32_t references; /**< @brief How many subscription callbacks are using this subscription. Changed atomically. */
 
     /**
      * @brief Tracks whether @ref mqtt_function_unsubscribe has been called for
@@ -346,11 +522,27 @@ typedef struct _mqttSubscription
     } packetInfo;                   /**< @brief Information about the SUBSCRIBE packet that registered this subscription. */
 
     IotMqttCallbackInfo_t callback; /**< @brief Callback information for this subscription. */
+    IotMqttQos_t qos;               /**< @brief QoS requested for this subscription. */
 
     uint16_t topicFilterLength;     /**< @brief Length of #_mqttSubscription_t.pTopicFilter. */
     char * pTopicFilter;            /**< @brief The subscription topic filter. */
 } _mqttSubscription_t;
 
+/**
+ * @brief Room for a small packet made for a pooled operation record, see
+ * #_IotMqtt_AllocateOperationPacket.
+ */
+typedef struct _mqttOperationPacket
+{
+    union
+    {
+        uint8_t bytes[ MQTT_OPERATION_INLINE_PACKET_SIZE ]; /**< @brief The packet area. */
+        uint64_t alignment;                                  /**< @brief Aligns the area for any structure placed in it. */
+        void * pAlignment;                                   /**< @brief Aligns the area for any structure placed in it. */
+    } area;                                                  /**< @brief Holds a small packet made for the operation. */
+    bool inUse;                                              /**< @brief Whether `area` holds a packet. */
+} _mqttOperationPacket_t;
+
 /**
  * @brief Internal structure representing a single MQTT operation, such as
  * CONNECT, SUBSCRIBE, PUBLISH, etc.
@@ -378,12 +570,18 @@ typedef struct _mqttOperation
             IotMqttOperationType_t type; /**< @brief What operation this structure represents. */
             uint32_t flags;              /**< @brief Flags passed to the function that created this operation. */
             uint16_t packetIdentifier;   /**< @brief The packet identifier used with this operation. */
+            bool inflight;               /**< @brief Whether this QoS 1 PUBLISH holds a slot of the in-flight window. */
+            uint64_t sendTime;           /**< @brief When the packet was last sent; 0 if not yet sent. */
+            bool coalesced;              /**< @brief Whether this PUBLISH is held back in the coalescing buffer and not yet sent. */
 
             /* Serialized packet and size. */
             uint8_t * pMqttPacket;           /**< @brief The MQTT packet to send over the network. */
             uint8_t * pPacketIdentifierHigh; /**< @brief The location of the high byte of the packet identifier in the MQTT packet. */
             size_t packetSize;               /**< @brief Size of `pMqttPacket`. */
 
+            /* Room for a small packet of this operation, see #_IotMqtt_AllocateOperationPacket. */
+            _mqttOperationPacket_t * pPacketArea; /**< @brief Packet area of a pooled record; `NULL` for an allocated record. */
+
             /* How to notify of an operation's completion. */
             union
             {
@@ -405,6 +603,8 @@ typedef struct _mqttOperation
         {
             IotMqttPublishInfo_t publishInfo; /**< @brief Deserialized PUBLISH. */
             const void * pReceivedData;       /**< @brief Any buffer associated with this PUBLISH that should be freed. */
+            void * pLendingConnection;        /**< @brief Network connection that lent `pReceivedData`; `NULL` if it was allocated. */
+            uint32_t references;              /**< @brief Number of holders of this PUBLISH; it is freed when this reaches 0. */
         } publish;
     } u;                                      /**< @brief Valid member depends on _mqttOperation_t.incomingPublish. */
 } _mqttOperation_t;
@@ -421,7 +621,7 @@ typedef struct _mqttPacket
     {
         /**
          * @brief (Input) MQTT connection associated with this packet. Only used
-         * when deserializing SUBACKs.
+         * when deserializing CONNACKs and SUBACKs.
          */
         _mqttConnection_t * pMqttConnection;
 
@@ -433,11 +633,108 @@ typedef struct _mqttPacket
     } u;                       /**< @brief Valid member depends on packet being decoded. */
 
     uint8_t * pRemainingData;  /**< @brief (Input) The remaining data in MQTT packet. */
+    void * pLendingConnection; /**< @brief (Input) Network connection that lent `pRemainingData`; `NULL` if it was allocated. */
     size_t remainingLength;    /**< @brief (Input) Length of the remaining data in the MQTT packet. */
     uint16_t packetIdentifier; /**< @brief (Output) MQTT packet identifier. */
     uint8_t type;              /**< @brief (Input) A value identifying the packet type. */
 } _mqttPacket_t;
 
+/**
+ * @brief A node of a subscription trie, representing one level of one or more
+ * topic filters.
+ *
+ * Nodes are keyed by their parent and the hash of their level, so the text of
+ * topic filters is only kept in the subscriptions. Levels whose hashes collide
+ * share a node; matches are confirmed against the subscription's topic filter.
+ */
+typedef struct _mqttTrieNode
+{
+    IotHashLink_t link;                  /**< @brief Link in the trie's table of levels, keyed by parent and level hash. */
+    struct _mqttTrieNode * pParent;      /**< @brief The node of the previous level. */
+    struct _mqttTrieNode * pSingleLevel; /**< @brief The child node for the `+` wildcard. */
+    struct _mqttTrieNode * pMultiLevel;  /**< @brief The child node for the `#` wildcard. */
+    uint16_t levelLength;                /**< @brief Length of this level. */
+    uint16_t references;                 /**< @brief Number of child nodes and subscriptions using this node. */
+    IotListDouble_t subscriptions;       /**< @brief Subscriptions whose topic filter ends at this level. */
+} _mqttTrieNode_t;
+
+/**
+ * @brief A node left to visit while matching a topic name in a subscription trie.
+ */
+typedef struct _mqttTriePending
+{
+    struct _mqttTrieNode * pNode; /**< @brief Node to visit. */
+    uint32_t nameIndex;           /**< @brief Start of the topic name level to match below the node. */
+} _mqttTriePending_t;
+
+/**
+ * @brief Places an element of a subscription array in a subscription trie.
+ */
+typedef struct _mqttTrieEntry
+{
+    IotLink_t link;           /**< @brief Link in the subscription list of #_mqttTrieEntry_t.pNode. */
+    _mqttTrieNode_t * pNode;  /**< @brief The node where the subscription's topic filter ends; `NULL` if not in the trie. */
+} _mqttTrieEntry_t;
+
+/**
+ * @brief Indexes a subscription array by topic filter level, so a PUBLISH is
+ * matched in time proportional to its topic depth.
+ *
+ * An all-zero trie is empty and valid. The trie is guarded by the subscription
+ * locks of its connection.
+ */
+typedef struct _mqttSubscriptionTrie
+{
+    _mqttTrieNode_t root;                                        /**< @brief Node before the first level of all topic filters. */
+    IotHashTable_t levels;                                       /**< @brief All nodes other than wildcards and the root. */
+    IotHashLink_t * pBuckets[ MQTT_SUBSCRIPTION_TRIE_BUCKETS ];  /**< @brief Buckets of #_mqttSubscriptionTrie_t.levels. */
+    _mqttTrieNode_t nodes[ MQTT_SUBSCRIPTION_TRIE_NODES ];       /**< @brief Storage for nodes. */
+    _mqttTrieNode_t * pFreeNodes;                                /**< @brief Released nodes, linked by #_mqttTrieNode_t.pParent. */
+    size_t nodesUsed;                                            /**< @brief Number of nodes taken from #_mqttSubscriptionTrie_t.nodes. */
+    _mqttTrieEntry_t entries[ MAX_NO_OF_MQTT_SUBSCRIPTIONS ];    /**< @brief Trie entry of each subscription array element. */
+} _mqttSubscriptionTrie_t;
+
+/**
+ * @brief Tracks the free elements of a subscription array, so that a free element
+ * is found without scanning the array.
+ *
+ * Elements are handed out in order until each one has been used once; after that,
+ * released elements are reused from a stack. An all-zero structure is valid for an
+ * empty subscription array. It is guarded by the subscription locks of its connection.
+ */
+typedef struct _mqttSubscriptionSlots
+{
+    int16_t nextUnused;                               /**< @brief Elements below this index have been handed out at least once. */
+    int16_t releasedCount;                            /**< @brief Number of indexes in #_mqttSubscriptionSlots_t.released. */
+    int16_t released[ MAX_NO_OF_MQTT_SUBSCRIPTIONS ]; /**< @brief Indexes of released elements, most recent last. */
+} _mqttSubscriptionSlots_t;
+
+/**
+ * @brief One of the locks that guard the subscriptions of a connection.
+ *
+ * Matching a PUBLISH takes one shard, so matches under different shards run at
+ * once. Adding or removing subscriptions takes every shard in order.
+ */
+typedef struct _mqttSubscriptionShard
+{
+    StaticSemaphore_t mutexStorage;                                 /**< @brief Static storage for #_mqttSubscriptionShard_t.mutex. */
+    SemaphoreHandle_t mutex;                                        /**< @brief The lock of this shard. */
+    _mqttTriePending_t pending[ MQTT_SUBSCRIPTION_TRIE_NODES + 1 ]; /**< @brief Nodes left to visit while matching under this shard. */
+} _mqttSubscriptionShard_t;
+
+/**
+ * @brief Operation records kept by an MQTT context for reuse by its connection.
+ *
+ * Guarded by the references mutex of the connection. A record that is not in
+ * use is free to be taken by #_IotMqtt_CreateOperation.
+ */
+typedef struct _mqttOperationPool
+{
+    _mqttOperation_t operations[ MQTT_OPERATION_POOL_SIZE ];    /**< @brief The records. */
+    _mqttOperationPacket_t packets[ MQTT_OPERATION_POOL_SIZE ]; /**< @brief Packet areas; `packets[ i ]` belongs to `operations[ i ]`. */
+    uint32_t inUse;                                             /**< @brief Bit `i` is set while `operations[ i ]` is taken. */
+} _mqttOperationPool_t;
+
 /**
  * @brief Represents a mapping of MQTT Connection in MQTT 201906.00 library to the corresponding MQTT context
  * used in MQTT LTS library. MQTT Context is used to call the MQTT LTS API from the shim to serialize
@@ -452,8 +749,11 @@ typedef struct connContextMapping
     uint8_t buffer[ NETWORK_BUFFER_SIZE ];                                 /**< @brief Network Buffer used to send packets on the network. This will be used by MQTT context defined above. */
     NetworkContext_t networkContext;                                       /**< @brief Network Context used to send packets on the network. This will be used by MQTT context defined above. */
     _mqttSubscription_t subscriptionArray[ MAX_NO_OF_MQTT_SUBSCRIPTIONS ]; /**< @brief Holds subscriptions associated with this connection. */
-    StaticSemaphore_t subscriptionMutexStorage;                            /**< @brief Static storage for Mutex for synchronization of subscription list. */
-    SemaphoreHandle_t subscriptionMutex;                                   /**< @brief Grants exclusive access to the subscription list. */
+    _mqttSubscriptionSlots_t subscriptionSlots;                            /**< @brief Free elements of #_connContext_t.subscriptionArray. */
+    _mqttSubscriptionTrie_t subscriptionTrie;                              /**< @brief Indexes #_connContext_t.subscriptionArray by topic filter. */
+    _mqttSubscriptionShard_t subscriptionShards[ MQTT_SUBSCRIPTION_LOCK_SHARDS ]; /**< @brief Locks that guard the subscriptions. */
+    uint32_t nextSubscriptionShard;                                        /**< @brief Picks the shard taken by the next PUBLISH; changed atomically. */
+    _mqttOperationPool_t operationPool;                                    /**< @brief Operation records reused by the connection. */
 } _connContext_t;
 
 /**
@@ -617,6 +917,29 @@ bool _IotMqtt_DecrementOperationReferences( _mqttOperation_t * pOperation,
  */
 void _IotMqtt_DestroyOperation( _mqttOperation_t * pOperation );
 
+/**
+ * @brief Get memory for a packet made for an MQTT operation.
+ *
+ * The packet is placed in the packet area of a pooled operation if it fits and
+ * the area is free; otherwise, it is allocated with #IotMqtt_MallocMessage.
+ *
+ * @param[in] pOperation The operation the packet is made for.
+ * @param[in] packetSize Size of the packet.
+ *
+ * @return Memory for the packet; `NULL` if it could not be allocated.
+ */
+void * _IotMqtt_AllocateOperationPacket( _mqttOperation_t * pOperation,
+                                         size_t packetSize );
+
+/**
+ * @brief Free memory returned by #_IotMqtt_AllocateOperationPacket.
+ *
+ * @param[in] pOperation The operation the packet was made for.
+ * @param[in] pPacket The packet to free.
+ */
+void _IotMqtt_FreeOperationPacket( _mqttOperation_t * pOperation,
+                                   void * pPacket );
+
 /**
  * @brief Task pool routine for processing an MQTT connection's keep-alive.
  *
@@ -640,6 +963,16 @@ void _IotMqtt_ProcessIncomingPublish( IotTaskPool_t pTaskPool,
                                       IotTaskPoolJob_t pPublishJob,
                                       void * pContext );
 
+/**
+ * @brief Release one reference to an incoming PUBLISH message.
+ *
+ * The message and its received data are freed when the last reference is
+ * released.
+ *
+ * @param[in] pOperation The incoming PUBLISH operation.
+ */
+void _IotMqtt_ReleaseIncomingPublish( _mqttOperation_t * pOperation );
+
 /**
  * @brief Task pool routine for processing an MQTT operation to send.
  *
@@ -694,6 +1027,48 @@ _mqttOperation_t * _IotMqtt_FindOperation( _mqttConnection_t * pMqttConnection,
                                            IotMqttOperationType_t type,
                                            const uint16_t * pPacketIdentifier );
 
+/**
+ * @brief Move an MQTT operation to the list of operations awaiting a server
+ * response.
+ *
+ * The operation is placed in the list selected by its packet identifier, which
+ * must be set before calling this function. The connection's references mutex
+ * must be held.
+ *
+ * @param[in] pOperation The MQTT operation that was sent.
+ */
+void _IotMqtt_AddPendingResponse( _mqttOperation_t * pOperation );
+
+/**
+ * @brief Take a slot of a connection's QoS 1 PUBLISH in-flight window.
+ *
+ * @param[in] pMqttConnection The MQTT connection sending the PUBLISH.
+ *
+ * @return `true` if a slot was taken; `false` if the window is full.
+ */
+bool _IotMqtt_ReserveInflight( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Return a slot taken with #_IotMqtt_ReserveInflight.
+ *
+ * @param[in] pMqttConnection The MQTT connection that sent the PUBLISH.
+ */
+void _IotMqtt_ReleaseInflight( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Get how long to wait for a server response on an MQTT connection.
+ *
+ * Before any round trip is measured, this is @ref IOT_MQTT_RESPONSE_WAIT_MS.
+ * Afterwards, it is the retransmission timeout computed from the smoothed
+ * round-trip time and its variation, bounded by @ref IOT_MQTT_RETRY_MS_FLOOR
+ * and @ref IOT_MQTT_RETRY_MS_CEILING.
+ *
+ * @param[in] pMqttConnection The MQTT connection.
+ *
+ * @return The response wait in milliseconds.
+ */
+uint32_t _IotMqtt_ResponseWaitMs( _mqttConnection_t * pMqttConnection );
+
 /**
  * @brief Notify of a completed MQTT operation.
  *
@@ -705,8 +1080,67 @@ _mqttOperation_t * _IotMqtt_FindOperation( _mqttConnection_t * pMqttConnection,
  */
 void _IotMqtt_Notify( _mqttOperation_t * pOperation );
 
+/**
+ * @brief Report a stage of a client-to-server PUBLISH to the trace sink.
+ *
+ * Other operation types are ignored.
+ *
+ * @param[in] pOperation The PUBLISH operation.
+ * @param[in] event The stage it reached.
+ *
+ * @note Use #IotMqtt_Trace, which is compiled out when @ref IOT_MQTT_ENABLE_TRACE
+ * is `0`.
+ */
+void _IotMqtt_Trace( _mqttOperation_t * pOperation,
+                     IotMqttTraceEvent_t event );
+
+/**
+ * @brief Trace point of a client-to-server PUBLISH.
+ */
+#if IOT_MQTT_ENABLE_TRACE == 1
+    #define IotMqtt_Trace( pOperation, event )    _IotMqtt_Trace( ( pOperation ), ( event ) )
+#else
+    #define IotMqtt_Trace( pOperation, event )
+#endif
+
 /*----------------- MQTT subscription management functions ------------------*/
 
+/**
+ * @brief Create the subscription locks of an MQTT context.
+ *
+ * @param[in] contextIndex Index of the MQTT context in `connToContext`.
+ *
+ * @return `true` if every lock was created; `false` otherwise, in which case no
+ * lock is left created.
+ */
+bool _IotMqtt_CreateSubscriptionLocks( int8_t contextIndex );
+
+/**
+ * @brief Delete the subscription locks of an MQTT context.
+ *
+ * @param[in] contextIndex Index of the MQTT context in `connToContext`.
+ */
+void _IotMqtt_DeleteSubscriptionLocks( int8_t contextIndex );
+
+/**
+ * @brief Take every subscription lock of an MQTT context, for exclusive access
+ * to its subscriptions.
+ *
+ * @param[in] contextIndex Index of the MQTT context in `connToContext`.
+ *
+ * @return `true` if the locks were taken; `false` if none were.
+ */
+bool _IotMqtt_LockSubscriptions( int8_t contextIndex );
+
+/**
+ * @brief Give back the subscription locks taken by #_IotMqtt_LockSubscriptions.
+ *
+ * @param[in] contextIndex Index of the MQTT context in `connToContext`.
+ *
+ * @return `true` if every lock was given back; `false` otherwise.
+ */
+bool _IotMqtt_UnlockSubscriptions( int8_t contextIndex );
+
 /**
  * @brief Add an array of subscriptions to the subscription manager.
  *
@@ -796,6 +1230,39 @@ bool _IotMqtt_GetNextByte( void * pNetworkConnection,
                            const IotNetworkInterface_t * pNetworkInterface,
                            uint8_t * pIncomingByte );
 
+/**
+ * @brief Free the remaining data of a packet received from the network.
+ *
+ * Data that was lent by the network stack is given back to it; otherwise, the
+ * data is freed.
+ *
+ * @param[in] pMqttConnection The MQTT connection that received the data. Only
+ * used if the data was lent.
+ * @param[in] pLendingConnection The network connection that lent the data;
+ * `NULL` if the data was allocated.
+ * @param[in] pReceivedData The data to free.
+ */
+void _IotMqtt_FreeReceivedData( const _mqttConnection_t * pMqttConnection,
+                                void * pLendingConnection,
+                                uint8_t * pReceivedData );
+
+/**
+ * @brief Send a message gathered from several buffers on an MQTT connection.
+ *
+ * Uses the network stack's vectored send if it has one; otherwise, sends the
+ * buffers one at a time.
+ *
+ * @param[in] pMqttConnection The MQTT connection to send on.
+ * @param[in] pBuffers The buffers to send, in order.
+ * @param[in] bufferCount The number of entries in `pBuffers`.
+ *
+ * @return The total number of bytes sent. Less than the combined length of
+ * `pBuffers` if the send failed.
+ */
+size_t _IotMqtt_SendVector( const _mqttConnection_t * pMqttConnection,
+                            const IotNetworkBuffer_t * pBuffers,
+                            size_t bufferCount );
+
 /**
  * @brief Closes the network connection associated with an MQTT connection.
  *
@@ -810,6 +1277,59 @@ bool _IotMqtt_GetNextByte( void * pNetworkConnection,
 void _IotMqtt_CloseNetworkConnection( IotMqttDisconnectReason_t disconnectReason,
                                       _mqttConnection_t * pMqttConnection );
 
+/**
+ * @brief Make a newly established MQTT connection forward an offline queue.
+ *
+ * Starts forwarding any PUBLISH messages in the queue's store. If another
+ * connection that is still connected forwards the queue, the queue is left
+ * with that connection.
+ *
+ * @param[in] pMqttConnection The new MQTT connection.
+ * @param[in] pQueue The offline queue from #IotMqttConnectInfo_t.pOfflineQueue.
+ */
+void _IotMqtt_AttachOfflineQueue( _mqttConnection_t * pMqttConnection,
+                                  IotMqttOfflineQueue_t * pQueue );
+
+/**
+ * @brief Stop an MQTT connection that is being destroyed from using its
+ * offline queue.
+ *
+ * @param[in] pMqttConnection The MQTT connection being destroyed.
+ */
+void _IotMqtt_DetachOfflineQueue( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Restore the subscriptions saved in a registry on a new MQTT connection.
+ *
+ * Called after the CONNACK of the connection is received. If the server has no
+ * session, the subscriptions are sent in bulk; otherwise, they are only added
+ * to the connection's subscription list. On success, the connection's
+ * subscriptions are saved in the registry when it is destroyed.
+ *
+ * @param[in] pMqttConnection The new MQTT connection.
+ * @param[in] pRegistry The registry from #IotMqttConnectInfo_t.pSubscriptionRegistry.
+ * @param[in] timeoutMs How long to wait for the SUBACKs.
+ *
+ * @return #IOT_MQTT_SUCCESS if the subscriptions were restored or the server
+ * refused some of them; otherwise, the error of the bulk SUBSCRIBE.
+ */
+IotMqttError_t _IotMqtt_RestoreSubscriptions( _mqttConnection_t * pMqttConnection,
+                                              IotMqttSubscriptionRegistry_t * pRegistry,
+                                              uint32_t timeoutMs );
+
+/**
+ * @brief Save the active subscriptions of an MQTT connection that is being
+ * destroyed in its subscription registry.
+ *
+ * Nothing is saved if a newer connection restored the registry. Must be called
+ * with the subscriptions of the connection locked, before they are removed.
+ *
+ * @param[in] pMqttConnection The MQTT connection being destroyed.
+ * @param[in] contextIndex Index of the connection's MQTT context.
+ */
+void _IotMqtt_SaveSubscriptions( _mqttConnection_t * pMqttConnection,
+                                 int8_t contextIndex );
+
 /*----------------- MQTT Serialization /Deserialization Wrapper functions for Shim------------------*/
 
 /**
@@ -1003,6 +1523,10 @@ void _IotMqtt_ProcessOperation( _mqttOperation_t * pOperation );
 /**
  * @brief Get the MQTT Context from the given MQTT Connection.
  *
+ * The index stored in the connection is checked against the mapping data structure,
+ * so the lookup takes constant time. Connections mapped without setting
+ * #_mqttConnection_t.contextIndex are found by searching the mapping data structure.
+ *
  * @param[in] mqttConnection The MQTT connection for which the context is needed.
  *
  * @return Index of the context from the mapping data structure used to store mapping of context and connection.
@@ -1057,6 +1581,24 @@ IotMqttError_t _IotMqtt_managedPublish( IotMqttConnection_t mqttConnection,
                                         _mqttOperation_t * pOperation,
                                         const IotMqttPublishInfo_t * pPublishInfo );
 
+/**
+ * @brief Retransmit the stored packet of an operation.
+ *
+ * The packet is sent with the MQTT context locked, after any PUBLISH packets
+ * that are held back on the connection. It takes the references mutex of the
+ * connection, so the caller must not hold the mutex of the MQTT context.
+ *
+ * @param[in] mqttConnection The MQTT connection to be used.
+ * @param[in] pOperation The operation, with its packet in
+ * #_mqttOperation_t.u.operation.pMqttPacket.
+ *
+ * @return #IOT_MQTT_TIMEOUT if the MQTT context could not be locked;
+ * #IOT_MQTT_NETWORK_ERROR if transport send failed;
+ * #IOT_MQTT_SUCCESS otherwise.
+ */
+IotMqttError_t _IotMqtt_managedRetransmit( IotMqttConnection_t mqttConnection,
+                                           _mqttOperation_t * pOperation );
+
 /**
  * @brief Send the SUBSCRIBE packet using MQTT LTS SUBSCRIBE API.
  *
@@ -1130,7 +1672,33 @@ IotMqttError_t convertReturnCode( MQTTStatus_t managedMqttStatus );
  *
  * @return The index where the subscription to be inserted.
  */
-int8_t IotMqtt_GetFreeIndexInSubscriptionArray( _mqttSubscription_t * pSubscriptionArray );
+int16_t IotMqtt_GetFreeIndexInSubscriptionArray( _mqttSubscription_t * pSubscriptionArray );
+
+/**
+ * @brief Take a free index from the subscription array to insert the new subscription.
+ *
+ * Unlike #IotMqtt_GetFreeIndexInSubscriptionArray, the array is only scanned when
+ * every element has been used once and no element was returned with
+ * #IotMqtt_ReleaseIndexInSubscriptionArray. The element is not marked as used; the
+ * caller must set its topicFilterLength.
+ *
+ * @param[in] pSlots The free elements of `pSubscriptionArray`.
+ * @param[in] pSubscriptionArray Subscription array in which the new subscription to be inserted.
+ *
+ * @return The index where the subscription to be inserted; `-1` if the array is full.
+ */
+int16_t IotMqtt_TakeFreeIndexInSubscriptionArray( _mqttSubscriptionSlots_t * pSlots,
+                                                  _mqttSubscription_t * pSubscriptionArray );
+
+/**
+ * @brief Return a freed element of the subscription array, so that it can be taken
+ * again without scanning the array.
+ *
+ * @param[in] pSlots The free elements of the subscription array.
+ * @param[in] index The element to return. Its topicFilterLength must already be 0.
+ */
+void IotMqtt_ReleaseIndexInSubscriptionArray( _mqttSubscriptionSlots_t * pSlots,
+                                              int16_t index );
 
 /**
  * @brief Remove the subscription in the subscription array.
@@ -1141,7 +1709,7 @@ int8_t IotMqtt_GetFreeIndexInSubscriptionArray( _mqttSubscription_t * pSubscript
  * @return 'true' if subscription is removed else 'false'.
  */
 bool IotMqtt_RemoveSubscription( _mqttSubscription_t * pSubscriptionArray,
-                                 int8_t deleteIndex );
+                                 int16_t deleteIndex );
 
 /**
  * @brief Remove all the matching subscriptions in the given subscription array.
@@ -1164,9 +1732,52 @@ void IotMqtt_RemoveAllMatches( _mqttSubscription_t * pSubscriptionArray,
  *
  * @return The first matching subscription from the subscription array.
  */
-int8_t IotMqtt_FindFirstMatch( _mqttSubscription_t * pSubscriptionArray,
-                               int8_t startIndex,
-                               _topicMatchParams_t * pMatch );
+int16_t IotMqtt_FindFirstMatch( _mqttSubscription_t * pSubscriptionArray,
+                                int16_t startIndex,
+                                _topicMatchParams_t * pMatch );
+
+/**
+ * @brief Add a subscription to a subscription trie.
+ *
+ * If the subscription was previously added from the same array element, its old
+ * entry is replaced. Subscriptions removed from the array need not be removed from
+ * the trie; their entries are ignored and replaced when the element is reused.
+ *
+ * @param[in] pTrie The trie indexing `pSubscriptionArray`.
+ * @param[in] pSubscriptionArray Subscription array holding the subscription.
+ * @param[in] index The element of `pSubscriptionArray` to add.
+ *
+ * @return `true` if the subscription was added; `false` if the trie does not have
+ * enough free nodes.
+ */
+bool IotMqtt_AddSubscriptionToTrie( _mqttSubscriptionTrie_t * pTrie,
+                                    const _mqttSubscription_t * pSubscriptionArray,
+                                    int16_t index );
+
+/**
+ * @brief Find the first subscription matching a topic name using a subscription
+ * trie, keeping the nodes left to visit in the caller's storage.
+ *
+ * Gives the same result as #IotMqtt_FindFirstMatch for subscriptions added with
+ * #IotMqtt_AddSubscriptionToTrie, but only visits the levels of the trie that
+ * match the topic name. Unsubscribed subscriptions waiting for their last
+ * callback are skipped. The trie is not modified, so callers with their own
+ * `pPending` may search a trie at once.
+ *
+ * @param[in] pTrie The trie indexing `pSubscriptionArray`.
+ * @param[in] pPending Storage for #MQTT_SUBSCRIPTION_TRIE_NODES + 1 nodes left to visit.
+ * @param[in] pSubscriptionArray Subscription array from which the subscription needs to be matched.
+ * @param[in] startIndex Only elements starting from this one are returned. Pass 0 to
+ * search from the beginning of the array.
+ * @param[in] pMatch Contains the topic name to match. Wildcards must be allowed.
+ *
+ * @return The index of the first matching subscription; `-1` if none matches.
+ */
+int16_t IotMqtt_FindFirstMatchInTrieShared( _mqttSubscriptionTrie_t * pTrie,
+                                            _mqttTriePending_t * pPending,
+                                            _mqttSubscription_t * pSubscriptionArray,
+                                            int16_t startIndex,
+                                            _topicMatchParams_t * pMatch );
 
 /*-----------------------------------Mutexes Wrappers--------------------------------------------*/
 
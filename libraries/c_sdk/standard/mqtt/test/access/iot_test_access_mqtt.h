@@ -43,6 +43,15 @@ _mqttConnection_t * IotTestMqtt_createMqttConnection( bool awsIotMqttMode,
                                                       const IotMqttNetworkInfo_t * pNetworkInfo,
                                                       uint16_t keepAliveSeconds );
 
+/**
+ * @brief Test access function for #_subscribeBatchCount.
+ *
+ * @see #_subscribeBatchCount.
+ */
+size_t IotTestMqtt_subscribeBatchCount( bool awsIotMqttMode,
+                                        const IotMqttSubscription_t * pSubscriptionList,
+                                        size_t subscriptionCount );
+
 /*------------------------- iot_mqtt_serialize.c ------------------------*/
 
 /*
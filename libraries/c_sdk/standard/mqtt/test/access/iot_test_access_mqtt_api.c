@@ -35,6 +35,9 @@
 _mqttConnection_t * IotTestMqtt_createMqttConnection( bool awsIotMqttMode,
                                                       const IotMqttNetworkInfo_t * pNetworkInfo,
                                                       uint16_t keepAliveSeconds );
+size_t IotTestMqtt_subscribeBatchCount( bool awsIotMqttMode,
+                                        const IotMqttSubscription_t * pSubscriptionList,
+                                        size_t subscriptionCount );
 
 /*-----------------------------------------------------------*/
 
@@ -46,3 +49,12 @@ _mqttConnection_t * IotTestMqtt_createMqttConnection( bool awsIotMqttMode,
 }
 
 /*-----------------------------------------------------------*/
+
+size_t IotTestMqtt_subscribeBatchCount( bool awsIotMqttMode,
+                                        const IotMqttSubscription_t * pSubscriptionList,
+                                        size_t subscriptionCount )
+{
+    return _subscribeBatchCount( awsIotMqttMode, pSubscriptionList, subscriptionCount );
+}
+
+/*-----------------------------------------------------------*/
@@ -148,6 +148,36 @@
       4 * DUP_CHECK_RETRY_MS + \
       IOT_MQTT_RESPONSE_WAIT_MS )
 
+/**
+ * @brief How often the broker stand-in of #TEST_MQTT_Unit_API_ConnectMultiple
+ * answers outstanding CONNECT packets.
+ */
+#define BROKER_POLL_MS             ( 10 )
+
+/**
+ * @brief Length of the topic filters of #TEST_MQTT_Unit_API_SubscribeBulk.
+ */
+#define BULK_FILTER_LENGTH         ( 16 )
+
+/**
+ * @brief How many times the SUBACK stand-in of #TEST_MQTT_Unit_API_SubscribeBulk
+ * looks for SUBSCRIBE packets to answer before it gives up.
+ */
+#define SUBACK_POLL_LIMIT          ( 100 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The state kept by the broker stand-in for one network connection.
+ */
+typedef struct _brokerSession
+{
+    IotMqttConnection_t mqttConnection; /**< @brief The MQTT connection using this network connection. */
+    volatile bool connectReceived;      /**< @brief Whether a CONNECT was sent on this network connection. */
+    volatile uint32_t publishCount;     /**< @brief Number of PUBLISH packets sent on this network connection. */
+    size_t connackOffset;               /**< @brief Bytes of the CONNACK already received. */
+} _brokerSession_t;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -160,6 +190,26 @@ static bool _publishSetDupCalled = false;
  */
 static int32_t _pingreqSendCount = 0;
 
+/**
+ * @brief The buffers last passed to #_sendVector.
+ */
+static IotNetworkBuffer_t _sentBuffers[ 2 ] = { { 0 } };
+
+/**
+ * @brief How many buffers were last passed to #_sendVector.
+ */
+static size_t _sentBufferCount = 0;
+
+/**
+ * @brief Counts how many times #_sendCounter has been called.
+ */
+static int32_t _sendCount = 0;
+
+/**
+ * @brief Counts the bytes passed to #_sendCounter.
+ */
+static size_t _sentBytes = 0;
+
 /**
  * @brief Counts how many times #_close has been called.
  */
@@ -185,6 +235,36 @@ static IotMqttNetworkInfo_t _networkInfo = IOT_MQTT_NETWORK_INFO_INITIALIZER;
  */
 static IotNetworkInterface_t _networkInterface = { 0 };
 
+/**
+ * @brief Network connections served by the broker stand-in.
+ */
+static _brokerSession_t _brokerSessions[ MAX_NO_OF_MQTT_CONNECTIONS ] = { { 0 } };
+
+/**
+ * @brief Posted to stop the broker stand-in.
+ */
+static IotSemaphore_t _brokerStop;
+
+/**
+ * @brief Posted by the broker stand-in when it stops.
+ */
+static IotSemaphore_t _brokerStopped;
+
+/**
+ * @brief Packet identifiers of the SUBSCRIBE packets passed to #_sendSubscribe.
+ */
+static volatile uint16_t _subscribePacketIds[ MAX_NO_OF_MQTT_SUBSCRIPTIONS ] = { 0 };
+
+/**
+ * @brief Counts the SUBSCRIBE packets passed to #_sendSubscribe.
+ */
+static volatile uint32_t _subscribePacketCount = 0;
+
+/**
+ * @brief How many SUBSCRIBE packets #_subackTask answers.
+ */
+static uint32_t _subackTarget = 0;
+
 /**
  * @brief Buffer holding the keep-alive periodic status string.
  * This needed in the thread simulating incoming PINGRESP messages.
@@ -306,6 +386,105 @@ static size_t _sendSuccess( void * pSendContext,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief A send function that records the packet identifier of every SUBSCRIBE.
+ */
+static size_t _sendSubscribe( void * pSendContext,
+                              const uint8_t * pMessage,
+                              size_t messageLength )
+{
+    size_t i = 1;
+
+    /* Silence warnings about unused parameters. */
+    ( void ) pSendContext;
+
+    if( ( pMessage[ 0 ] == MQTT_PACKET_TYPE_SUBSCRIBE ) &&
+        ( _subscribePacketCount < MAX_NO_OF_MQTT_SUBSCRIPTIONS ) )
+    {
+        /* Skip the remaining length to find the packet identifier. */
+        while( ( pMessage[ i ] & 0x80 ) != 0 )
+        {
+            i++;
+        }
+
+        _subscribePacketIds[ _subscribePacketCount ] = UINT16_DECODE( pMessage + i + 1 );
+        _subscribePacketCount++;
+    }
+
+    /* This function returns the message length to simulate a successful send. */
+    return messageLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A send function that always "succeeds" and counts the sends and bytes.
+ */
+static size_t _sendCounter( void * pSendContext,
+                            const uint8_t * pMessage,
+                            size_t messageLength )
+{
+    /* Silence warnings about unused parameters. */
+    ( void ) pSendContext;
+    ( void ) pMessage;
+
+    _sendCount++;
+    _sentBytes += messageLength;
+
+    /* This function returns the message length to simulate a successful send. */
+    return messageLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A send function that always fails.
+ */
+static size_t _sendFailure( void * pSendContext,
+                            const uint8_t * pMessage,
+                            size_t messageLength )
+{
+    /* Silence warnings about unused parameters. */
+    ( void ) pSendContext;
+    ( void ) pMessage;
+    ( void ) messageLength;
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A vectored send function that always "succeeds" and remembers the
+ * buffers it was given.
+ */
+static size_t _sendVector( void * pConnection,
+                           const IotNetworkBuffer_t * pBuffers,
+                           size_t bufferCount )
+{
+    size_t i = 0, bytesSent = 0;
+
+    /* Silence warnings about unused parameters. */
+    ( void ) pConnection;
+
+    _sentBufferCount = bufferCount;
+
+    for( i = 0; i < bufferCount; i++ )
+    {
+        if( i < 2 )
+        {
+            _sentBuffers[ i ] = pBuffers[ i ];
+        }
+
+        bytesSent += pBuffers[ i ].length;
+    }
+
+    /* This function returns the total length to simulate a successful send. */
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief A send function for PINGREQ that responds with a PINGRESP.
  */
@@ -513,6 +692,156 @@ static IotNetworkError_t _close( void * pCloseContext )
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief A function for setting the receive callback that records the MQTT
+ * connection of a broker stand-in session.
+ */
+static IotNetworkError_t _brokerSetReceiveCallback( void * pConnection,
+                                                    IotNetworkReceiveCallback_t receiveCallback,
+                                                    void * pReceiveContext )
+{
+    _brokerSession_t * pSession = ( _brokerSession_t * ) pConnection;
+
+    /* The MQTT library always sets its own receive callback. */
+    ( void ) receiveCallback;
+
+    pSession->mqttConnection = ( IotMqttConnection_t ) pReceiveContext;
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A send function that passes packets to the broker stand-in.
+ */
+static size_t _brokerSend( void * pSendContext,
+                           const uint8_t * pMessage,
+                           size_t messageLength )
+{
+    _brokerSession_t * pSession = ( _brokerSession_t * ) pSendContext;
+
+    switch( pMessage[ 0 ] & 0xf0 )
+    {
+        case MQTT_PACKET_TYPE_CONNECT:
+            pSession->connectReceived = true;
+            break;
+
+        case MQTT_PACKET_TYPE_PUBLISH:
+            pSession->publishCount++;
+            break;
+
+        default:
+            break;
+    }
+
+    /* Return the message length to simulate a successful send. */
+    return messageLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A receive function that returns a CONNACK from the broker stand-in.
+ */
+static size_t _brokerReceive( void * pReceiveContext,
+                              uint8_t * pBuffer,
+                              size_t bytesRequested )
+{
+    _brokerSession_t * pSession = ( _brokerSession_t * ) pReceiveContext;
+    const uint8_t pConnack[ 4 ] = { MQTT_PACKET_TYPE_CONNACK, 0x02, 0x00, 0x00 };
+    size_t bytesReceived = sizeof( pConnack ) - pSession->connackOffset;
+
+    if( bytesReceived > bytesRequested )
+    {
+        bytesReceived = bytesRequested;
+    }
+
+    ( void ) memcpy( pBuffer, &( pConnack[ pSession->connackOffset ] ), bytesReceived );
+    pSession->connackOffset += bytesReceived;
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A thread routine that answers every CONNECT sent to the broker stand-in
+ * with a CONNACK until #_brokerStop is posted.
+ *
+ * A CONNACK is repeated until the CONNECT completes, as it is ignored when it
+ * arrives before the CONNECT is waiting for a response.
+ */
+static void _brokerTask( void * pArgument )
+{
+    size_t i = 0;
+
+    /* Silence warnings about unused parameters. */
+    ( void ) pArgument;
+
+    while( IotSemaphore_TimedWait( &_brokerStop, BROKER_POLL_MS ) == false )
+    {
+        for( i = 0; i < MAX_NO_OF_MQTT_CONNECTIONS; i++ )
+        {
+            if( ( _brokerSessions[ i ].connectReceived == true ) &&
+                ( _brokerSessions[ i ].mqttConnection != NULL ) )
+            {
+                _brokerSessions[ i ].connackOffset = 0;
+                IotMqtt_ReceiveCallback( &( _brokerSessions[ i ] ),
+                                         _brokerSessions[ i ].mqttConnection );
+            }
+        }
+    }
+
+    IotSemaphore_Post( &_brokerStopped );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A thread routine that answers the SUBSCRIBE packets recorded by
+ * #_sendSubscribe with successful SUBACKs, in order, until #_subackTarget are
+ * answered.
+ *
+ * @param[in] pArgument A semaphore to post once done.
+ */
+static void _subackTask( void * pArgument )
+{
+    uint32_t acknowledged = 0, polls = 0;
+    uint16_t packetIdentifier = 0;
+    _mqttOperation_t * pOperation = NULL;
+
+    while( ( acknowledged < _subackTarget ) && ( polls < SUBACK_POLL_LIMIT ) )
+    {
+        pOperation = NULL;
+
+        /* A SUBSCRIBE can only be answered once it awaits a response. */
+        if( acknowledged < _subscribePacketCount )
+        {
+            packetIdentifier = _subscribePacketIds[ acknowledged ];
+            pOperation = _IotMqtt_FindOperation( _pMqttConnection,
+                                                 IOT_MQTT_SUBSCRIBE,
+                                                 &packetIdentifier );
+        }
+
+        if( pOperation != NULL )
+        {
+            pOperation->u.operation.status = IOT_MQTT_SUCCESS;
+            _IotMqtt_Notify( pOperation );
+            acknowledged++;
+        }
+        else
+        {
+            IotClock_SleepMs( BROKER_POLL_MS );
+            polls++;
+        }
+    }
+
+    IotSemaphore_Post( ( IotSemaphore_t * ) pArgument );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief An MQTT disconnect callback that counts how many times it was invoked.
  */
@@ -530,6 +859,25 @@ static void _disconnectCallback( void * pCallbackContext,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief A trace ring print function that counts the printed lines, and the
+ * lines with the time since a previous record.
+ */
+static void _tracePrint( void * pPrintContext,
+                         const char * pLine )
+{
+    uint32_t * pLineCounts = ( uint32_t * ) pPrintContext;
+
+    pLineCounts[ 0 ]++;
+
+    if( strchr( pLine, '+' ) != NULL )
+    {
+        pLineCounts[ 1 ]++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief A task pool job routine that decrements an MQTT operation's job
  * reference count.
@@ -724,8 +1072,7 @@ static IotMqttError_t _setContext( IotMqttConnection_t pMqttConnection,
         /* Fill the values for network buffer. */
         networkBuffer.pBuffer = &( connToContext[ contextIndex ].buffer[ 0 ] );
         networkBuffer.size = NETWORK_BUFFER_SIZE;
-        subscriptionMutexCreated = IotMutex_CreateNonRecursiveMutex( &( connToContext[ contextIndex ].subscriptionMutex ),
-                                                                     &( connToContext[ contextIndex ].subscriptionMutexStorage ) );
+        subscriptionMutexCreated = _IotMqtt_CreateSubscriptionLocks( contextIndex );
 
         if( subscriptionMutexCreated == false )
         {
@@ -813,6 +1160,9 @@ TEST_SETUP( MQTT_Unit_API )
 
     /* Reset the counters. */
     _pingreqSendCount = 0;
+    _sentBufferCount = 0;
+    _sendCount = 0;
+    _sentBytes = 0;
     _closeCount = 0;
     _disconnectCallbackCount = 0;
 
@@ -848,12 +1198,22 @@ TEST_GROUP_RUNNER( MQTT_Unit_API )
     RUN_TEST_CASE( MQTT_Unit_API, PublishQoS0Parameters );
     RUN_TEST_CASE( MQTT_Unit_API, PublishQoS0MallocFail );
     RUN_TEST_CASE( MQTT_Unit_API, PublishQoS1 );
+    RUN_TEST_CASE( MQTT_Unit_API, PublishVectored );
+    RUN_TEST_CASE( MQTT_Unit_API, PublishCoalesce );
+    RUN_TEST_CASE( MQTT_Unit_API, PublishInflightWindow );
+    RUN_TEST_CASE( MQTT_Unit_API, OfflineQueue );
+    RUN_TEST_CASE( MQTT_Unit_API, RoundTripTime );
+    RUN_TEST_CASE( MQTT_Unit_API, OperationPool );
+    RUN_TEST_CASE( MQTT_Unit_API, PublishTrace );
     RUN_TEST_CASE( MQTT_Unit_API, SubscribeUnsubscribeParameters );
     RUN_TEST_CASE( MQTT_Unit_API, SubscribeMallocFail );
+    RUN_TEST_CASE( MQTT_Unit_API, SubscribeBulk );
+    RUN_TEST_CASE( MQTT_Unit_API, SubscriptionRegistry );
     RUN_TEST_CASE( MQTT_Unit_API, UnsubscribeMallocFail );
     RUN_TEST_CASE( MQTT_Unit_API, KeepAlivePeriodic );
     RUN_TEST_CASE( MQTT_Unit_API, KeepAliveJobCleanup );
     RUN_TEST_CASE( MQTT_Unit_API, WaitAfterDisconnect );
+    RUN_TEST_CASE( MQTT_Unit_API, ConnectMultiple );
 }
 
 /*-----------------------------------------------------------*/
@@ -1403,64 +1763,847 @@ TEST( MQTT_Unit_API, PublishQoS1 )
 /*-----------------------------------------------------------*/
 
 /**
- * @brief Tests that duplicate QoS 1 PUBLISH packets are different from the
- * original.
- *
- * For non-AWS IoT MQTT servers, checks that the DUP flag is set. For
- * AWS IoT MQTT servers, checks that the packet identifier is different.
+ * @brief Tests that @ref mqtt_function_publish sends the payload from the
+ * application's buffer, and keeps a copy of the packet only for retransmission.
  */
-TEST( MQTT_Unit_API, PublishDuplicates )
+TEST( MQTT_Unit_API, PublishVectored )
 {
-    static IotMqttSerializer_t serializer = IOT_MQTT_SERIALIZER_INITIALIZER;
+    size_t i = 0;
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
     IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
     IotMqttOperation_t publishOperation = IOT_MQTT_OPERATION_INITIALIZER;
-    bool dupCheckResult = false;
-    uint64_t startTime = 0;
+    static uint8_t pPayload[ 1024 ] = { 0 };
 
-    /* Initializer parameters. */
-    serializer.serialize.publishSetDup = _publishSetDup;
-    _networkInterface.send = _dupChecker;
+    for( i = 0; i < sizeof( pPayload ); i++ )
+    {
+        pPayload[ i ] = ( uint8_t ) i;
+    }
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendSuccess;
+    _networkInterface.sendVector = _sendVector;
 
     /* Create a new MQTT connection. */
     _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
                                                          &_networkInfo,
                                                          0 );
     TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
     /* Set the MQTT Context for the new MQTT Connection*/
     TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
 
-    /* Set the serializers and parameter to the send function. */
-    _pMqttConnection->pNetworkConnection = &dupCheckResult;
-    _pMqttConnection->pSerializer = &serializer;
-
     /* Set the publish info. */
     publishInfo.qos = IOT_MQTT_QOS_1;
     publishInfo.pTopicName = TEST_TOPIC_NAME;
     publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
-    publishInfo.pPayload = "test";
-    publishInfo.payloadLength = 4;
-    publishInfo.retryMs = DUP_CHECK_RETRY_MS;
-    publishInfo.retryLimit = DUP_CHECK_RETRY_LIMIT;
-
-    startTime = IotClock_GetTimeMs();
+    publishInfo.pPayload = pPayload;
+    publishInfo.payloadLength = sizeof( pPayload );
 
     if( TEST_PROTECT() )
     {
-        /* Send a PUBLISH with retransmissions enabled. */
-        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING,
-                           IotMqtt_Publish( _pMqttConnection,
-                                            &publishInfo,
-                                            IOT_MQTT_FLAG_WAITABLE,
-                                            NULL,
-                                            &publishOperation ) );
+        /* Without retry, the payload is sent in place and not copied. */
+        status = IotMqtt_Publish( _pMqttConnection,
+                                  &publishInfo,
+                                  IOT_MQTT_FLAG_WAITABLE,
+                                  NULL,
+                                  &publishOperation );
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, status );
+        TEST_ASSERT_EQUAL( 2, _sentBufferCount );
+        TEST_ASSERT_EQUAL_PTR( pPayload, _sentBuffers[ 1 ].pBuffer );
+        TEST_ASSERT_EQUAL( sizeof( pPayload ), _sentBuffers[ 1 ].length );
 
-        /* Since _dupChecker doesn't actually transmit a PUBLISH, no PUBACK is
-         * expected. */
-        TEST_ASSERT_EQUAL( IOT_MQTT_RETRY_NO_RESPONSE,
-                           IotMqtt_Wait( publishOperation, DUP_CHECK_TIMEOUT ) );
+        /* The header holds the fixed header, topic name and packet identifier. */
+        TEST_ASSERT_EQUAL( 3 + 2 + TEST_TOPIC_NAME_LENGTH + 2, _sentBuffers[ 0 ].length );
+        TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBLISH | 0x02, _sentBuffers[ 0 ].pBuffer[ 0 ] );
 
-        /* Check the result of the DUP check. */
-        TEST_ASSERT_EQUAL_INT( true, dupCheckResult );
+        IotMutex_Lock( &( _pMqttConnection->referencesMutex ) );
+        TEST_ASSERT_NULL( publishOperation->u.operation.pMqttPacket );
+        IotMutex_Unlock( &( _pMqttConnection->referencesMutex ) );
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_TIMEOUT, IotMqtt_Wait( publishOperation, TIMEOUT_MS ) );
+
+        /* With retry, the whole packet is copied for retransmission. */
+        publishInfo.retryLimit = 1;
+        publishInfo.retryMs = TIMEOUT_MS * 10;
+
+        status = IotMqtt_Publish( _pMqttConnection,
+                                  &publishInfo,
+                                  IOT_MQTT_FLAG_WAITABLE,
+                                  NULL,
+                                  &publishOperation );
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, status );
+        TEST_ASSERT_EQUAL_PTR( pPayload, _sentBuffers[ 1 ].pBuffer );
+
+        IotMutex_Lock( &( _pMqttConnection->referencesMutex ) );
+        TEST_ASSERT_NOT_NULL( publishOperation->u.operation.pMqttPacket );
+        TEST_ASSERT_EQUAL( _sentBuffers[ 0 ].length + sizeof( pPayload ),
+                           publishOperation->u.operation.packetSize );
+        TEST_ASSERT_EQUAL_MEMORY( pPayload,
+                                  publishOperation->u.operation.pMqttPacket + _sentBuffers[ 0 ].length,
+                                  sizeof( pPayload ) );
+        IotMutex_Unlock( &( _pMqttConnection->referencesMutex ) );
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_TIMEOUT, IotMqtt_Wait( publishOperation, TIMEOUT_MS ) );
+    }
+
+    /* Clean up MQTT connection. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that PUBLISH packets are held back and sent together on a
+ * connection that coalesces them.
+ */
+TEST( MQTT_Unit_API, PublishCoalesce )
+{
+    int32_t i = 0;
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttCoalesceStats_t stats = { 0 };
+    IotMqttOperation_t publishOperation = IOT_MQTT_OPERATION_INITIALIZER;
+    IotMqttDisconnectReason_t expectedReason = IOT_MQTT_SEND_FAILED;
+    static uint8_t pPayload[ 16 ] = { 0 };
+
+    /* Each PUBLISH packet has a 2 byte fixed header, the topic name with its
+     * length, and the payload. Four packets fit in the coalescing buffer. */
+    const size_t packetSize = 2 + 2 + TEST_TOPIC_NAME_LENGTH + sizeof( pPayload );
+    const uint32_t coalesceMaxBytes = ( uint32_t ) ( 4 * packetSize + 1 );
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendCounter;
+    _networkInterface.close = _close;
+    _networkInfo.disconnectCallback.pCallbackContext = &expectedReason;
+    _networkInfo.disconnectCallback.function = _disconnectCallback;
+
+    /* Create a new MQTT connection. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
+    /* Set the MQTT Context for the new MQTT Connection*/
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    /* Statistics are only available on a coalescing connection. */
+    TEST_ASSERT_EQUAL( IOT_MQTT_BAD_PARAMETER, IotMqtt_GetCoalesceStats( _pMqttConnection, &stats ) );
+
+    /* Enable coalescing as IotMqtt_Connect would. */
+    _pMqttConnection->pCoalesceBuffer = IotMqtt_MallocMessage( coalesceMaxBytes );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection->pCoalesceBuffer );
+    _pMqttConnection->coalesceMaxBytes = coalesceMaxBytes;
+    _pMqttConnection->coalesceDelayMs = TIMEOUT_MS / 4;
+
+    /* Set the publish info. */
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = pPayload;
+    publishInfo.payloadLength = sizeof( pPayload );
+
+    if( TEST_PROTECT() )
+    {
+        /* Packets are held back until the coalescing delay passes. */
+        for( i = 0; i < 4; i++ )
+        {
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Publish( _pMqttConnection, &publishInfo, 0, NULL, NULL ) );
+        }
+
+        TEST_ASSERT_EQUAL_INT32( 0, _sendCount );
+
+        IotClock_SleepMs( TIMEOUT_MS );
+        TEST_ASSERT_EQUAL_INT32( 1, _sendCount );
+        TEST_ASSERT_EQUAL( 4 * packetSize, _sentBytes );
+
+        /* A packet that does not fit sends the held back packets right away. */
+        for( i = 0; i < 5; i++ )
+        {
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Publish( _pMqttConnection, &publishInfo, 0, NULL, NULL ) );
+        }
+
+        TEST_ASSERT_EQUAL_INT32( 2, _sendCount );
+
+        IotClock_SleepMs( TIMEOUT_MS );
+        TEST_ASSERT_EQUAL_INT32( 3, _sendCount );
+        TEST_ASSERT_EQUAL( 9 * packetSize, _sentBytes );
+
+        /* Check the statistics. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_GetCoalesceStats( _pMqttConnection, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( 9, stats.packetCount );
+        TEST_ASSERT_EQUAL_UINT32( 3, stats.sendCount );
+        TEST_ASSERT_EQUAL( 9 * packetSize, stats.byteCount );
+        TEST_ASSERT_EQUAL( 4 * packetSize, stats.largestSend );
+
+        /* A held back QoS 1 PUBLISH is stamped when its packet is sent. */
+        publishInfo.qos = IOT_MQTT_QOS_1;
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING,
+                           IotMqtt_Publish( _pMqttConnection,
+                                            &publishInfo,
+                                            IOT_MQTT_FLAG_WAITABLE,
+                                            NULL,
+                                            &publishOperation ) );
+        TEST_ASSERT_TRUE( publishOperation->u.operation.coalesced );
+        TEST_ASSERT_TRUE( publishOperation->u.operation.sendTime == 0U );
+
+        IotClock_SleepMs( TIMEOUT_MS );
+        TEST_ASSERT_EQUAL_INT32( 4, _sendCount );
+        TEST_ASSERT_FALSE( publishOperation->u.operation.coalesced );
+        TEST_ASSERT_TRUE( publishOperation->u.operation.sendTime != 0U );
+        TEST_ASSERT_EQUAL( IOT_MQTT_TIMEOUT, IotMqtt_Wait( publishOperation, TIMEOUT_MS ) );
+
+        /* Held back packets that can't be sent close the connection. */
+        _networkInterface.send = _sendFailure;
+        publishInfo.qos = IOT_MQTT_QOS_0;
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Publish( _pMqttConnection, &publishInfo, 0, NULL, NULL ) );
+
+        IotClock_SleepMs( TIMEOUT_MS );
+        TEST_ASSERT_EQUAL_INT32( 1, _disconnectCallbackCount );
+        TEST_ASSERT_TRUE( _pMqttConnection->disconnected );
+    }
+
+    /* Clean up MQTT connection. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that @ref mqtt_function_publish refuses a QoS 1 PUBLISH while
+ * the in-flight window is full, and that PUBACKs and destroyed operations free
+ * slots of the window.
+ */
+TEST( MQTT_Unit_API, PublishInflightWindow )
+{
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttOperation_t pPublishOperations[ 3 ] = { IOT_MQTT_OPERATION_INITIALIZER };
+    _mqttOperation_t * pAcknowledged = NULL;
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendSuccess;
+
+    /* Create a new MQTT connection. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
+    /* Set the MQTT Context for the new MQTT Connection*/
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    /* Allow two QoS 1 PUBLISH messages to await PUBACK, as IotMqtt_Connect would. */
+    _pMqttConnection->inflightMax = 2;
+
+    /* Set the publish info. */
+    publishInfo.qos = IOT_MQTT_QOS_1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+
+    if( TEST_PROTECT() )
+    {
+        /* Fill the window. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING,
+                           IotMqtt_Publish( _pMqttConnection,
+                                            &publishInfo,
+                                            IOT_MQTT_FLAG_WAITABLE,
+                                            NULL,
+                                            &( pPublishOperations[ 0 ] ) ) );
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING,
+                           IotMqtt_Publish( _pMqttConnection,
+                                            &publishInfo,
+                                            IOT_MQTT_FLAG_WAITABLE,
+                                            NULL,
+                                            &( pPublishOperations[ 1 ] ) ) );
+
+        /* A PUBLISH that does not fit in the window is refused. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_WOULD_BLOCK,
+                           IotMqtt_Publish( _pMqttConnection,
+                                            &publishInfo,
+                                            IOT_MQTT_FLAG_WAITABLE,
+                                            NULL,
+                                            &( pPublishOperations[ 2 ] ) ) );
+        TEST_ASSERT_NULL( pPublishOperations[ 2 ] );
+        TEST_ASSERT_EQUAL_UINT32( 2, _pMqttConnection->inflightCount );
+
+        /* A response is matched by both type and packet identifier. */
+        TEST_ASSERT_NULL( _IotMqtt_FindOperation( _pMqttConnection,
+                                                  IOT_MQTT_SUBSCRIBE,
+                                                  &( pPublishOperations[ 1 ]->u.operation.packetIdentifier ) ) );
+
+        /* Receive a PUBACK for the second PUBLISH. */
+        pAcknowledged = _IotMqtt_FindOperation( _pMqttConnection,
+                                                IOT_MQTT_PUBLISH_TO_SERVER,
+                                                &( pPublishOperations[ 1 ]->u.operation.packetIdentifier ) );
+        TEST_ASSERT_EQUAL_PTR( pPublishOperations[ 1 ], pAcknowledged );
+        TEST_ASSERT_EQUAL_UINT32( 1, _pMqttConnection->inflightCount );
+
+        pAcknowledged->u.operation.status = IOT_MQTT_SUCCESS;
+        _IotMqtt_Notify( pAcknowledged );
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Wait( pPublishOperations[ 1 ], TIMEOUT_MS ) );
+
+        /* The freed slot can be used by a new PUBLISH. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING,
+                           IotMqtt_Publish( _pMqttConnection,
+                                            &publishInfo,
+                                            IOT_MQTT_FLAG_WAITABLE,
+                                            NULL,
+                                            &( pPublishOperations[ 2 ] ) ) );
+
+        /* Operations destroyed without a PUBACK also free their slots. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_TIMEOUT, IotMqtt_Wait( pPublishOperations[ 0 ], TIMEOUT_MS ) );
+        TEST_ASSERT_EQUAL( IOT_MQTT_TIMEOUT, IotMqtt_Wait( pPublishOperations[ 2 ], TIMEOUT_MS ) );
+        TEST_ASSERT_EQUAL_UINT32( 0, _pMqttConnection->inflightCount );
+    }
+
+    /* Clean up MQTT connection. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that the offline queue stores PUBLISH messages while no
+ * connection is available and forwards them in order once one is.
+ */
+TEST( MQTT_Unit_API, OfflineQueue )
+{
+    int32_t i = 0;
+    IotMqttOfflineRamStore_t ramStore = { 0 };
+    IotMqttOfflineQueue_t queue;
+    IotMqttOfflineQueueInfo_t queueInfo = IOT_MQTT_OFFLINE_QUEUE_INFO_INITIALIZER;
+    IotMqttOfflineQueueStats_t stats = { 0 };
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    _mqttOperation_t * pAcknowledged = NULL;
+    uint8_t pRecord[ 4 ] = { 0 };
+    static uint8_t pPayload[ 16 ] = { 0 };
+    static uint8_t pRecordBuffer[ 64 ] = { 0 };
+
+    /* Each stored record has a 7 byte header, the topic name and the payload.
+     * The RAM store prefixes records with 4 bytes and holds three of them. */
+    const size_t recordSize = 7 + TEST_TOPIC_NAME_LENGTH + sizeof( pPayload );
+    const size_t packetSize = 2 + 2 + TEST_TOPIC_NAME_LENGTH + sizeof( pPayload );
+    static uint8_t pStoreBuffer[ 3 * ( 4 + 7 + TEST_TOPIC_NAME_LENGTH + sizeof( pPayload ) ) ] = { 0 };
+
+    /* The RAM store wraps records around the end of its buffer. Its size is
+     * not a multiple of the record size, so a record is split by the end. */
+    IotMqtt_OfflineRamStoreInit( &ramStore, pStoreBuffer, 3 * ( 4 + sizeof( pRecord ) ) + 3 );
+
+    for( i = 0; i < 5; i++ )
+    {
+        if( i >= 3 )
+        {
+            IotMqttOfflineStoreRam.pop( &ramStore );
+        }
+
+        ( void ) memset( pRecord, i, sizeof( pRecord ) );
+        TEST_ASSERT_EQUAL_INT( true, IotMqttOfflineStoreRam.push( &ramStore, pRecord, sizeof( pRecord ) ) );
+    }
+
+    TEST_ASSERT_EQUAL_INT( false, IotMqttOfflineStoreRam.push( &ramStore, pRecord, sizeof( pRecord ) ) );
+
+    /* Records after the oldest can be read, including one split by the end. */
+    TEST_ASSERT_EQUAL( sizeof( pRecord ), IotMqttOfflineStoreRam.peek( &ramStore, 2, pRecord, sizeof( pRecord ) ) );
+    TEST_ASSERT_EQUAL_UINT8( 4, pRecord[ 0 ] );
+    TEST_ASSERT_EQUAL_UINT8( 4, pRecord[ 3 ] );
+    TEST_ASSERT_EQUAL( 0, IotMqttOfflineStoreRam.peek( &ramStore, 3, NULL, 0 ) );
+
+    for( i = 2; i < 5; i++ )
+    {
+        TEST_ASSERT_EQUAL( sizeof( pRecord ), IotMqttOfflineStoreRam.peek( &ramStore, 0, pRecord, sizeof( pRecord ) ) );
+        TEST_ASSERT_EQUAL_UINT8( i, pRecord[ 0 ] );
+        TEST_ASSERT_EQUAL_UINT8( i, pRecord[ 3 ] );
+        IotMqttOfflineStoreRam.pop( &ramStore );
+    }
+
+    TEST_ASSERT_EQUAL( 0, IotMqttOfflineStoreRam.peek( &ramStore, 0, NULL, 0 ) );
+
+    /* Set up a queue that forwards two records per batch. */
+    IotMqtt_OfflineRamStoreInit( &ramStore, pStoreBuffer, sizeof( pStoreBuffer ) );
+    queueInfo.pStore = &IotMqttOfflineStoreRam;
+    queueInfo.pStoreContext = &ramStore;
+    queueInfo.pRecordBuffer = pRecordBuffer;
+    queueInfo.recordBufferSize = sizeof( pRecordBuffer );
+    queueInfo.drainBatch = 0;
+    TEST_ASSERT_EQUAL( IOT_MQTT_BAD_PARAMETER, IotMqtt_OfflineQueueInit( &queue, &queueInfo ) );
+    queueInfo.drainBatch = 33;
+    TEST_ASSERT_EQUAL( IOT_MQTT_BAD_PARAMETER, IotMqtt_OfflineQueueInit( &queue, &queueInfo ) );
+    queueInfo.drainBatch = 2;
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_OfflineQueueInit( &queue, &queueInfo ) );
+
+    /* Set the publish info. */
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = pPayload;
+    publishInfo.payloadLength = sizeof( pPayload );
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendCounter;
+
+    /* Create a new MQTT connection. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
+    /* Set the MQTT Context for the new MQTT Connection*/
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    if( TEST_PROTECT() )
+    {
+        /* PUBLISH messages are stored while no connection is attached. */
+        for( i = 0; i < 3; i++ )
+        {
+            TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, IotMqtt_OfflinePublish( &queue, &publishInfo ) );
+        }
+
+        /* A full store drops new PUBLISH messages. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_NO_MEMORY, IotMqtt_OfflinePublish( &queue, &publishInfo ) );
+
+        /* A PUBLISH larger than the record buffer is refused. */
+        publishInfo.payloadLength = sizeof( pRecordBuffer ) - recordSize + sizeof( pPayload ) + 1;
+        TEST_ASSERT_EQUAL( IOT_MQTT_BAD_PARAMETER, IotMqtt_OfflinePublish( &queue, &publishInfo ) );
+        publishInfo.payloadLength = sizeof( pPayload );
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_OfflineQueueGetStats( &queue, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( 3, stats.storedCount );
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.forwardedCount );
+        TEST_ASSERT_EQUAL_UINT32( 1, stats.droppedCount );
+        TEST_ASSERT_EQUAL_INT32( 0, _sendCount );
+
+        /* Attach the queue as IotMqtt_Connect would. The stored PUBLISH
+         * messages are forwarded in the background. */
+        _IotMqtt_AttachOfflineQueue( _pMqttConnection, &queue );
+        IotClock_SleepMs( TIMEOUT_MS );
+
+        TEST_ASSERT_EQUAL( 3 * packetSize, _sentBytes );
+        TEST_ASSERT_EQUAL( 0, IotMqttOfflineStoreRam.peek( &ramStore, 0, NULL, 0 ) );
+
+        /* With an empty store, PUBLISH messages are sent right away. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_OfflinePublish( &queue, &publishInfo ) );
+        TEST_ASSERT_EQUAL( 4 * packetSize, _sentBytes );
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_OfflineQueueGetStats( &queue, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( 3, stats.storedCount );
+        TEST_ASSERT_EQUAL_UINT32( 4, stats.forwardedCount );
+        TEST_ASSERT_EQUAL_UINT32( 1, stats.droppedCount );
+
+        /* Store a QoS 1 PUBLISH as if the connection were lost, then a QoS 0
+         * PUBLISH behind it once the connection is back. */
+        queue.connection = NULL;
+        publishInfo.qos = IOT_MQTT_QOS_1;
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, IotMqtt_OfflinePublish( &queue, &publishInfo ) );
+        queue.connection = _pMqttConnection;
+        publishInfo.qos = IOT_MQTT_QOS_0;
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, IotMqtt_OfflinePublish( &queue, &publishInfo ) );
+        IotClock_SleepMs( TIMEOUT_MS );
+
+        /* Both records are sent without waiting for the PUBACK of the QoS 1
+         * record. Both stay in the store until that PUBACK, since the store
+         * removes records in order. A QoS 1 PUBLISH also carries a packet
+         * identifier. */
+        TEST_ASSERT_EQUAL( 6 * packetSize + 2, _sentBytes );
+        TEST_ASSERT_EQUAL_PTR( _pMqttConnection, queue.sending );
+        TEST_ASSERT_EQUAL_UINT32( 0x1, queue.pendingRecords );
+        TEST_ASSERT_EQUAL_UINT32( 0x2, queue.sentRecords );
+        TEST_ASSERT_EQUAL( recordSize, IotMqttOfflineStoreRam.peek( &ramStore, 1, NULL, 0 ) );
+
+        /* A failed PUBLISH keeps the record, which is sent again. The QoS 0
+         * record behind it is not sent again. */
+        pAcknowledged = _IotMqtt_FindOperation( _pMqttConnection,
+                                                IOT_MQTT_PUBLISH_TO_SERVER,
+                                                NULL );
+        TEST_ASSERT_NOT_NULL( pAcknowledged );
+        pAcknowledged->u.operation.status = IOT_MQTT_RETRY_NO_RESPONSE;
+        _IotMqtt_Notify( pAcknowledged );
+        IotClock_SleepMs( TIMEOUT_MS );
+
+        TEST_ASSERT_EQUAL( 7 * packetSize + 4, _sentBytes );
+        TEST_ASSERT_EQUAL_PTR( _pMqttConnection, queue.sending );
+        TEST_ASSERT_EQUAL( recordSize, IotMqttOfflineStoreRam.peek( &ramStore, 1, NULL, 0 ) );
+
+        /* Receive a PUBACK. Both records leave the store in order. */
+        pAcknowledged = _IotMqtt_FindOperation( _pMqttConnection,
+                                                IOT_MQTT_PUBLISH_TO_SERVER,
+                                                NULL );
+        TEST_ASSERT_NOT_NULL( pAcknowledged );
+        pAcknowledged->u.operation.status = IOT_MQTT_SUCCESS;
+        _IotMqtt_Notify( pAcknowledged );
+        IotClock_SleepMs( TIMEOUT_MS );
+
+        TEST_ASSERT_EQUAL( 7 * packetSize + 4, _sentBytes );
+        TEST_ASSERT_NULL( queue.sending );
+        TEST_ASSERT_EQUAL_UINT32( 0, queue.sentRecords );
+        TEST_ASSERT_EQUAL( 0, IotMqttOfflineStoreRam.peek( &ramStore, 0, NULL, 0 ) );
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_OfflineQueueGetStats( &queue, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( 5, stats.storedCount );
+        TEST_ASSERT_EQUAL_UINT32( 6, stats.forwardedCount );
+        TEST_ASSERT_EQUAL_UINT32( 1, stats.droppedCount );
+    }
+
+    /* Clean up MQTT connection. Destroying it detaches the queue. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+    IotMqtt_OfflineQueueDestroy( &queue );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that acknowledged operations update the round-trip time estimate
+ * of a connection, and that the estimate sets the response wait.
+ */
+TEST( MQTT_Unit_API, RoundTripTime )
+{
+    int32_t i = 0;
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttOperation_t pPublishOperations[ 3 ] = { IOT_MQTT_OPERATION_INITIALIZER };
+    _mqttOperation_t * pAcknowledged = NULL;
+    IotMqttRttStats_t stats = { 0 };
+
+    /* Round trips of the PUBLISH messages, in ms. The last one is
+     * retransmitted and not measured. */
+    const uint32_t pRoundTrips[ 3 ] = { 100, 300, 1000 };
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendSuccess;
+
+    /* Create a new MQTT connection. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
+    /* Set the MQTT Context for the new MQTT Connection*/
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    /* Set the publish info. */
+    publishInfo.qos = IOT_MQTT_QOS_1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+
+    if( TEST_PROTECT() )
+    {
+        /* Without measurements, the fixed response wait is used. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_GetRttStats( _pMqttConnection, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.sampleCount );
+        TEST_ASSERT_EQUAL_UINT32( IOT_MQTT_RESPONSE_WAIT_MS, stats.retransmitTimeoutMs );
+
+        for( i = 0; i < 3; i++ )
+        {
+            TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING,
+                               IotMqtt_Publish( _pMqttConnection,
+                                                &publishInfo,
+                                                IOT_MQTT_FLAG_WAITABLE,
+                                                NULL,
+                                                &( pPublishOperations[ i ] ) ) );
+            TEST_ASSERT_NOT_EQUAL( 0, pPublishOperations[ i ]->u.operation.sendTime );
+
+            /* Move the send time back instead of sleeping for the round trip. */
+            pPublishOperations[ i ]->u.operation.sendTime -= pRoundTrips[ i ];
+
+            if( i == 2 )
+            {
+                pPublishOperations[ i ]->u.operation.retry.count = 1;
+            }
+
+            /* Receive a PUBACK. */
+            pAcknowledged = _IotMqtt_FindOperation( _pMqttConnection,
+                                                    IOT_MQTT_PUBLISH_TO_SERVER,
+                                                    &( pPublishOperations[ i ]->u.operation.packetIdentifier ) );
+            TEST_ASSERT_EQUAL_PTR( pPublishOperations[ i ], pAcknowledged );
+
+            pAcknowledged->u.operation.status = IOT_MQTT_SUCCESS;
+            _IotMqtt_Notify( pAcknowledged );
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Wait( pPublishOperations[ i ], TIMEOUT_MS ) );
+        }
+
+        /* After the first round trip, SRTT is 100 and RTTVAR is 50. After the
+         * second, RTTVAR is 3/4 * 50 + 1/4 * 200 = 87 and SRTT is
+         * 7/8 * 100 + 1/8 * 300 = 125. The timeout is SRTT + 4 * RTTVAR. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_GetRttStats( _pMqttConnection, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( 2, stats.sampleCount );
+        TEST_ASSERT_UINT32_WITHIN( 10, 300, stats.lastRttMs );
+        TEST_ASSERT_UINT32_WITHIN( 10, 100, stats.minRttMs );
+        TEST_ASSERT_UINT32_WITHIN( 10, 300, stats.maxRttMs );
+        TEST_ASSERT_UINT32_WITHIN( 10, 125, stats.smoothedRttMs );
+        TEST_ASSERT_UINT32_WITHIN( 10, 87, stats.rttVariationMs );
+        TEST_ASSERT_UINT32_WITHIN( 40, 475, stats.retransmitTimeoutMs );
+        TEST_ASSERT_EQUAL_UINT32( stats.retransmitTimeoutMs, _IotMqtt_ResponseWaitMs( _pMqttConnection ) );
+    }
+
+    /* Clean up MQTT connection. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test that operations reuse the records of their connection's pool and
+ * place small packets in their records.
+ */
+TEST( MQTT_Unit_API, OperationPool )
+{
+    int32_t i = 0;
+    int8_t contextIndex = -1;
+    _mqttOperation_t * pOperations[ MQTT_OPERATION_POOL_SIZE + 1 ] = { NULL };
+    _mqttOperation_t * pReused = NULL;
+    void * pPackets[ 4 ] = { NULL };
+    _mqttOperationPacket_t * pPacketArea = NULL;
+    IotMqttOperationPoolStats_t stats = { 0 };
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendSuccess;
+
+    /* Create a new MQTT connection. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
+    /* Set the MQTT Context for the new MQTT Connection*/
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+    contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+
+    if( TEST_PROTECT() )
+    {
+        /* Every record of the pool is taken before an operation is allocated. */
+        for( i = 0; i <= MQTT_OPERATION_POOL_SIZE; i++ )
+        {
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _IotMqtt_CreateOperation( _pMqttConnection,
+                                                                           0,
+                                                                           NULL,
+                                                                           &( pOperations[ i ] ) ) );
+        }
+
+        for( i = 0; i < MQTT_OPERATION_POOL_SIZE; i++ )
+        {
+            TEST_ASSERT_EQUAL_PTR( &( connToContext[ contextIndex ].operationPool.operations[ i ] ),
+                                   pOperations[ i ] );
+        }
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_GetOperationPoolStats( _pMqttConnection, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( MQTT_OPERATION_POOL_SIZE, stats.operationHits );
+        TEST_ASSERT_EQUAL_UINT32( 1, stats.operationMisses );
+        TEST_ASSERT_EQUAL_UINT32( MQTT_OPERATION_POOL_SIZE, stats.inUse );
+        TEST_ASSERT_EQUAL_UINT32( MQTT_OPERATION_POOL_SIZE, stats.maxInUse );
+
+        /* Only pooled records have a packet area. */
+        pPacketArea = &( connToContext[ contextIndex ].operationPool.packets[ 0 ] );
+        TEST_ASSERT_EQUAL_PTR( pPacketArea, pOperations[ 0 ]->u.operation.pPacketArea );
+        TEST_ASSERT_NULL( pOperations[ MQTT_OPERATION_POOL_SIZE ]->u.operation.pPacketArea );
+
+        /* A packet that fits is placed in the packet area of its pooled operation,
+         * one at a time. Others are allocated. */
+        pPackets[ 0 ] = _IotMqtt_AllocateOperationPacket( pOperations[ 0 ], MQTT_OPERATION_INLINE_PACKET_SIZE );
+        pPackets[ 1 ] = _IotMqtt_AllocateOperationPacket( pOperations[ 0 ], 1 );
+        pPackets[ 2 ] = _IotMqtt_AllocateOperationPacket( pOperations[ 1 ], MQTT_OPERATION_INLINE_PACKET_SIZE + 1 );
+        pPackets[ 3 ] = _IotMqtt_AllocateOperationPacket( pOperations[ MQTT_OPERATION_POOL_SIZE ], 1 );
+
+        TEST_ASSERT_EQUAL_PTR( pPacketArea->area.bytes, pPackets[ 0 ] );
+        TEST_ASSERT_NOT_NULL( pPackets[ 1 ] );
+        TEST_ASSERT_TRUE( pPackets[ 0 ] != pPackets[ 1 ] );
+        TEST_ASSERT_NOT_NULL( pPackets[ 2 ] );
+        TEST_ASSERT_TRUE( pOperations[ 1 ]->u.operation.pPacketArea->area.bytes != pPackets[ 2 ] );
+        TEST_ASSERT_NOT_NULL( pPackets[ 3 ] );
+
+        _IotMqtt_FreeOperationPacket( pOperations[ 0 ], pPackets[ 0 ] );
+        _IotMqtt_FreeOperationPacket( pOperations[ 0 ], pPackets[ 1 ] );
+        _IotMqtt_FreeOperationPacket( pOperations[ 1 ], pPackets[ 2 ] );
+        _IotMqtt_FreeOperationPacket( pOperations[ MQTT_OPERATION_POOL_SIZE ], pPackets[ 3 ] );
+        TEST_ASSERT_EQUAL_INT( false, pPacketArea->inUse );
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_GetOperationPoolStats( _pMqttConnection, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( 1, stats.packetHits );
+        TEST_ASSERT_EQUAL_UINT32( 3, stats.packetMisses );
+
+        /* Destroyed operations return their records to the pool. */
+        for( i = 0; i <= MQTT_OPERATION_POOL_SIZE; i++ )
+        {
+            _IotMqtt_DestroyOperation( pOperations[ i ] );
+        }
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _IotMqtt_CreateOperation( _pMqttConnection,
+                                                                       0,
+                                                                       NULL,
+                                                                       &pReused ) );
+        TEST_ASSERT_EQUAL_PTR( pOperations[ 0 ], pReused );
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_GetOperationPoolStats( _pMqttConnection, &stats ) );
+        TEST_ASSERT_EQUAL_UINT32( MQTT_OPERATION_POOL_SIZE + 1, stats.operationHits );
+        TEST_ASSERT_EQUAL_UINT32( 1, stats.inUse );
+        TEST_ASSERT_EQUAL_UINT32( MQTT_OPERATION_POOL_SIZE, stats.maxInUse );
+
+        _IotMqtt_DestroyOperation( pReused );
+    }
+
+    /* Clean up MQTT connection. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test that a QoS 1 PUBLISH reports its stages to the trace sink, and
+ * that the trace ring keeps and prints the newest records.
+ */
+TEST( MQTT_Unit_API, PublishTrace )
+{
+    uint32_t i = 0, j = 0;
+    uint32_t pLineCounts[ 2 ] = { 0 };
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttOperation_t publishOperation = IOT_MQTT_OPERATION_INITIALIZER;
+    _mqttOperation_t * pAcknowledged = NULL;
+    IotMqttTraceRecord_t pRecords[ 8 ] = { { 0 } };
+    IotMqttTraceRing_t ring = { 0 };
+    IotMqttTraceSinkInfo_t sinkInfo = { 0 };
+
+    /* The stages of a QoS 1 PUBLISH acknowledged by a PUBACK. */
+    const IotMqttTraceEvent_t pExpectedEvents[] =
+    {
+        IOT_MQTT_TRACE_PUBLISH_CREATED,
+        IOT_MQTT_TRACE_PUBLISH_LOCKED,
+        IOT_MQTT_TRACE_PUBLISH_SERIALIZED,
+        IOT_MQTT_TRACE_PUBLISH_SENT,
+        IOT_MQTT_TRACE_NOTIFIED
+    };
+    const uint32_t expectedCount = sizeof( pExpectedEvents ) / sizeof( pExpectedEvents[ 0 ] );
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendSuccess;
+
+    /* Create a new MQTT connection. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
+    /* Set the MQTT Context for the new MQTT Connection*/
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    /* Set the publish info. */
+    publishInfo.qos = IOT_MQTT_QOS_1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+
+    IotMqtt_TraceRingInit( &ring, pRecords, 8 );
+    sinkInfo.sink = IotMqtt_TraceRingSink;
+    sinkInfo.pSinkContext = &ring;
+    IotMqtt_SetTraceSink( &sinkInfo );
+
+    if( TEST_PROTECT() )
+    {
+        for( i = 0; i < 2; i++ )
+        {
+            TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING,
+                               IotMqtt_Publish( _pMqttConnection,
+                                                &publishInfo,
+                                                IOT_MQTT_FLAG_WAITABLE,
+                                                NULL,
+                                                &publishOperation ) );
+
+            /* Receive a PUBACK. */
+            pAcknowledged = _IotMqtt_FindOperation( _pMqttConnection,
+                                                    IOT_MQTT_PUBLISH_TO_SERVER,
+                                                    &( publishOperation->u.operation.packetIdentifier ) );
+            TEST_ASSERT_EQUAL_PTR( publishOperation, pAcknowledged );
+
+            pAcknowledged->u.operation.status = IOT_MQTT_SUCCESS;
+            _IotMqtt_Notify( pAcknowledged );
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Wait( publishOperation, TIMEOUT_MS ) );
+
+            /* Check the records of the first PUBLISH before the ring wraps. */
+            if( i == 0 )
+            {
+                TEST_ASSERT_EQUAL_UINT32( expectedCount, ring.writeCount );
+
+                for( j = 0; j < expectedCount; j++ )
+                {
+                    TEST_ASSERT_EQUAL( pExpectedEvents[ j ], pRecords[ j ].event );
+                    TEST_ASSERT_EQUAL_PTR( _pMqttConnection, pRecords[ j ].mqttConnection );
+                    TEST_ASSERT_TRUE( pRecords[ j ].timestamp >= pRecords[ 0 ].timestamp );
+                }
+
+                /* The packet identifier is assigned when the connection is locked. */
+                TEST_ASSERT_EQUAL_UINT16( 0, pRecords[ 0 ].packetIdentifier );
+                TEST_ASSERT_NOT_EQUAL( 0, pRecords[ expectedCount - 1 ].packetIdentifier );
+            }
+        }
+
+        /* Only the newest records are printed. Each line but the first of each
+         * PUBLISH has the time since the previous stage. */
+        TEST_ASSERT_EQUAL_UINT32( 2 * expectedCount, ring.writeCount );
+        TEST_ASSERT_EQUAL_UINT32( 8, IotMqtt_TraceRingDump( &ring, _tracePrint, pLineCounts ) );
+        TEST_ASSERT_EQUAL_UINT32( 8, pLineCounts[ 0 ] );
+        TEST_ASSERT_EQUAL_UINT32( 6, pLineCounts[ 1 ] );
+
+        TEST_ASSERT_EQUAL_STRING( "PUBACK RECEIVED", IotMqtt_TraceEventName( IOT_MQTT_TRACE_PUBACK_RECEIVED ) );
+    }
+
+    IotMqtt_SetTraceSink( NULL );
+
+    /* Clean up MQTT connection. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that duplicate QoS 1 PUBLISH packets are different from the
+ * original.
+ *
+ * For non-AWS IoT MQTT servers, checks that the DUP flag is set. For
+ * AWS IoT MQTT servers, checks that the packet identifier is different.
+ */
+TEST( MQTT_Unit_API, PublishDuplicates )
+{
+    static IotMqttSerializer_t serializer = IOT_MQTT_SERIALIZER_INITIALIZER;
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttOperation_t publishOperation = IOT_MQTT_OPERATION_INITIALIZER;
+    bool dupCheckResult = false;
+    uint64_t startTime = 0;
+
+    /* Initializer parameters. */
+    serializer.serialize.publishSetDup = _publishSetDup;
+    _networkInterface.send = _dupChecker;
+
+    /* Create a new MQTT connection. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+    /* Set the MQTT Context for the new MQTT Connection*/
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    /* Set the serializers and parameter to the send function. */
+    _pMqttConnection->pNetworkConnection = &dupCheckResult;
+    _pMqttConnection->pSerializer = &serializer;
+
+    /* Set the publish info. */
+    publishInfo.qos = IOT_MQTT_QOS_1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = "test";
+    publishInfo.payloadLength = 4;
+    publishInfo.retryMs = DUP_CHECK_RETRY_MS;
+    publishInfo.retryLimit = DUP_CHECK_RETRY_LIMIT;
+
+    startTime = IotClock_GetTimeMs();
+
+    if( TEST_PROTECT() )
+    {
+        /* Send a PUBLISH with retransmissions enabled. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING,
+                           IotMqtt_Publish( _pMqttConnection,
+                                            &publishInfo,
+                                            IOT_MQTT_FLAG_WAITABLE,
+                                            NULL,
+                                            &publishOperation ) );
+
+        /* Since _dupChecker doesn't actually transmit a PUBLISH, no PUBACK is
+         * expected. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_RETRY_NO_RESPONSE,
+                           IotMqtt_Wait( publishOperation, DUP_CHECK_TIMEOUT ) );
+
+        /* Check the result of the DUP check. */
+        TEST_ASSERT_EQUAL_INT( true, dupCheckResult );
 
         /* Check that at least the minimum wait time elapsed. */
         TEST_ASSERT_TRUE( startTime + DUP_CHECK_MINIMUM_WAIT <= IotClock_GetTimeMs() );
@@ -1602,6 +2745,299 @@ TEST( MQTT_Unit_API, SubscribeMallocFail )
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Tests that @ref mqtt_function_timedsubscribebulk splits a list of
+ * topic filters into SUBSCRIBE packets, sends them without waiting for SUBACKs,
+ * and returns one result.
+ */
+TEST( MQTT_Unit_API, SubscribeBulk )
+{
+    size_t i = 0, sentCount = 0;
+    uint32_t expectedPackets = 0;
+    IotSemaphore_t subackDone;
+    IotMqttSubscription_t pSubscriptions[ MAX_NO_OF_MQTT_SUBSCRIPTIONS ] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER };
+    char pTopicFilters[ MAX_NO_OF_MQTT_SUBSCRIPTIONS ][ BULK_FILTER_LENGTH ] = { { 0 } };
+    IotMqttSubscription_t longSubscription = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+    IotMqttSubscription_t pLongSubscriptions[ 8 ] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER };
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendSubscribe;
+    _subscribePacketCount = 0;
+
+    /* Create a new MQTT connection. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+
+    /* Set the MQTT Context for the new MQTT Connection*/
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    for( i = 0; i < MAX_NO_OF_MQTT_SUBSCRIPTIONS; i++ )
+    {
+        pSubscriptions[ i ].pTopicFilter = pTopicFilters[ i ];
+        pSubscriptions[ i ].topicFilterLength = ( uint16_t ) snprintf( pTopicFilters[ i ],
+                                                                       BULK_FILTER_LENGTH,
+                                                                       "/bulk/%lu",
+                                                                       ( unsigned long ) i );
+        pSubscriptions[ i ].callback.function = SUBSCRIPTION_CALLBACK;
+    }
+
+    /* Topic filters of which 3 fill a network buffer. Only their lengths are
+     * used to split packets. */
+    longSubscription.pTopicFilter = TEST_TOPIC_NAME;
+    longSubscription.topicFilterLength = ( uint16_t ) ( ( NETWORK_BUFFER_SIZE - 7U ) / 3U - 3U );
+
+    for( i = 0; i < 8; i++ )
+    {
+        pLongSubscriptions[ i ] = longSubscription;
+    }
+
+    /* Count the SUBSCRIBE packets of the bulk subscription. */
+    while( sentCount < MAX_NO_OF_MQTT_SUBSCRIPTIONS )
+    {
+        sentCount += IotTestMqtt_subscribeBatchCount( _pMqttConnection->awsIotMqttMode,
+                                                      &( pSubscriptions[ sentCount ] ),
+                                                      MAX_NO_OF_MQTT_SUBSCRIPTIONS - sentCount );
+        expectedPackets++;
+    }
+
+    TEST_ASSERT_TRUE( expectedPackets <= MQTT_BULK_SUBSCRIBE_WINDOW );
+
+    if( TEST_PROTECT() )
+    {
+        /* AWS IoT limits the topic filters of a packet; otherwise, the network
+         * buffer does. */
+        TEST_ASSERT_EQUAL( AWS_IOT_MQTT_SERVER_MAX_TOPIC_FILTERS_PER_SUBSCRIBE,
+                           IotTestMqtt_subscribeBatchCount( true, pLongSubscriptions, 8 ) );
+        TEST_ASSERT_EQUAL( 3, IotTestMqtt_subscribeBatchCount( false, pLongSubscriptions, 8 ) );
+        TEST_ASSERT_EQUAL( 1, IotTestMqtt_subscribeBatchCount( false, pLongSubscriptions, 1 ) );
+        TEST_ASSERT_EQUAL( 2, IotTestMqtt_subscribeBatchCount( false, pSubscriptions, 2 ) );
+
+        /* Nothing is sent if any topic filter is invalid. */
+        pSubscriptions[ MAX_NO_OF_MQTT_SUBSCRIPTIONS - 1 ].qos = IOT_MQTT_QOS_2;
+        TEST_ASSERT_EQUAL( IOT_MQTT_BAD_PARAMETER,
+                           IotMqtt_TimedSubscribeBulk( _pMqttConnection,
+                                                       pSubscriptions,
+                                                       MAX_NO_OF_MQTT_SUBSCRIPTIONS,
+                                                       0,
+                                                       TIMEOUT_MS ) );
+        TEST_ASSERT_EQUAL_UINT32( 0, _subscribePacketCount );
+        pSubscriptions[ MAX_NO_OF_MQTT_SUBSCRIPTIONS - 1 ].qos = IOT_MQTT_QOS_0;
+
+        /* Without SUBACKs, every packet is still sent before the timeout. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_TIMEOUT,
+                           IotMqtt_TimedSubscribeBulk( _pMqttConnection,
+                                                       pSubscriptions,
+                                                       MAX_NO_OF_MQTT_SUBSCRIPTIONS,
+                                                       0,
+                                                       TIMEOUT_MS ) );
+        TEST_ASSERT_EQUAL_UINT32( expectedPackets, _subscribePacketCount );
+        TEST_ASSERT_FALSE( IotMqtt_IsSubscribed( _pMqttConnection,
+                                                 pSubscriptions[ 0 ].pTopicFilter,
+                                                 pSubscriptions[ 0 ].topicFilterLength,
+                                                 NULL ) );
+
+        /* With SUBACKs, all topic filters are subscribed. */
+        _subscribePacketCount = 0;
+        _subackTarget = expectedPackets;
+        TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &subackDone, 0, 1 ) );
+
+        if( Iot_CreateDetachedThread( _subackTask,
+                                      &subackDone,
+                                      IOT_THREAD_DEFAULT_PRIORITY,
+                                      IOT_THREAD_DEFAULT_STACK_SIZE ) == false )
+        {
+            IotSemaphore_Destroy( &subackDone );
+            TEST_FAIL_MESSAGE( "Failed to create SUBACK thread." );
+        }
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS,
+                           IotMqtt_TimedSubscribeBulk( _pMqttConnection,
+                                                       pSubscriptions,
+                                                       MAX_NO_OF_MQTT_SUBSCRIPTIONS,
+                                                       0,
+                                                       SUBACK_POLL_LIMIT * BROKER_POLL_MS ) );
+
+        IotSemaphore_Wait( &subackDone );
+        IotSemaphore_Destroy( &subackDone );
+
+        TEST_ASSERT_EQUAL_UINT32( expectedPackets, _subscribePacketCount );
+
+        for( i = 0; i < MAX_NO_OF_MQTT_SUBSCRIPTIONS; i++ )
+        {
+            TEST_ASSERT_TRUE( IotMqtt_IsSubscribed( _pMqttConnection,
+                                                    pSubscriptions[ i ].pTopicFilter,
+                                                    pSubscriptions[ i ].topicFilterLength,
+                                                    NULL ) );
+        }
+    }
+
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a subscription registry saves the subscriptions of a
+ * destroyed connection and restores them on the next one.
+ */
+TEST( MQTT_Unit_API, SubscriptionRegistry )
+{
+    size_t i = 0;
+    IotSemaphore_t subackDone;
+    IotMqttSubscriptionRegistry_t registry;
+    IotMqttSubscription_t pSaved[ 3 ] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER };
+    char pFilterBuffer[ 3 * BULK_FILTER_LENGTH ] = { 0 };
+    IotMqttSubscription_t pSubscriptions[ 4 ] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER };
+    char pTopicFilters[ 4 ][ BULK_FILTER_LENGTH ] = { { 0 } };
+
+    /* Initialize parameters. */
+    _networkInterface.send = _sendSubscribe;
+    _subscribePacketCount = 0;
+
+    for( i = 0; i < 4; i++ )
+    {
+        pSubscriptions[ i ].qos = IOT_MQTT_QOS_1;
+        pSubscriptions[ i ].pTopicFilter = pTopicFilters[ i ];
+        pSubscriptions[ i ].topicFilterLength = ( uint16_t ) snprintf( pTopicFilters[ i ],
+                                                                       BULK_FILTER_LENGTH,
+                                                                       "/registry/%lu",
+                                                                       ( unsigned long ) i );
+        pSubscriptions[ i ].callback.function = SUBSCRIPTION_CALLBACK;
+    }
+
+    /* The registry holds at most 3 subscriptions. */
+    TEST_ASSERT_EQUAL( IOT_MQTT_BAD_PARAMETER,
+                       IotMqtt_SubscriptionRegistryInit( &registry, pSaved, 0, pFilterBuffer, sizeof( pFilterBuffer ) ) );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS,
+                       IotMqtt_SubscriptionRegistryInit( &registry, pSaved, 3, pFilterBuffer, sizeof( pFilterBuffer ) ) );
+
+    /* The first connection restores an empty registry and subscribes. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    if( TEST_PROTECT() )
+    {
+        /* Restore the registry as IotMqtt_Connect would. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _IotMqtt_RestoreSubscriptions( _pMqttConnection, &registry, TIMEOUT_MS ) );
+        TEST_ASSERT_EQUAL_UINT32( 0, _subscribePacketCount );
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _IotMqtt_AddSubscriptions( _pMqttConnection, 1, pSubscriptions, 4 ) );
+    }
+
+    /* Destroying the connection saves the subscriptions that fit. */
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+
+    TEST_ASSERT_NULL( registry.connection );
+    TEST_ASSERT_EQUAL( 3, registry.subscriptionCount );
+
+    for( i = 0; i < 3; i++ )
+    {
+        TEST_ASSERT_EQUAL( IOT_MQTT_QOS_1, pSaved[ i ].qos );
+        TEST_ASSERT_EQUAL( pSubscriptions[ 0 ].topicFilterLength, pSaved[ i ].topicFilterLength );
+        TEST_ASSERT_EQUAL_PTR( &( pFilterBuffer[ i * pSaved[ i ].topicFilterLength ] ), pSaved[ i ].pTopicFilter );
+        TEST_ASSERT_EQUAL_PTR( SUBSCRIPTION_CALLBACK, pSaved[ i ].callback.function );
+    }
+
+    /* The second connection has a session, so nothing is sent. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    if( TEST_PROTECT() )
+    {
+        _pMqttConnection->sessionPresent = true;
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _IotMqtt_RestoreSubscriptions( _pMqttConnection, &registry, TIMEOUT_MS ) );
+        TEST_ASSERT_EQUAL_UINT32( 0, _subscribePacketCount );
+
+        for( i = 0; i < 3; i++ )
+        {
+            TEST_ASSERT_TRUE( IotMqtt_IsSubscribed( _pMqttConnection,
+                                                    pSaved[ i ].pTopicFilter,
+                                                    pSaved[ i ].topicFilterLength,
+                                                    NULL ) );
+        }
+    }
+
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+    TEST_ASSERT_EQUAL( 3, registry.subscriptionCount );
+
+    /* The third connection has no session. Its bulk SUBSCRIBE is not answered,
+     * so the registry is not restored and keeps its subscriptions. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    if( TEST_PROTECT() )
+    {
+        TEST_ASSERT_EQUAL( IOT_MQTT_TIMEOUT, _IotMqtt_RestoreSubscriptions( _pMqttConnection, &registry, TIMEOUT_MS ) );
+        TEST_ASSERT_EQUAL_UINT32( 1, _subscribePacketCount );
+        TEST_ASSERT_NULL( _pMqttConnection->pSubscriptionRegistry );
+    }
+
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+    TEST_ASSERT_EQUAL( 3, registry.subscriptionCount );
+
+    /* The fourth connection restores all subscriptions in one round trip. */
+    _pMqttConnection = IotTestMqtt_createMqttConnection( AWS_IOT_MQTT_SERVER,
+                                                         &_networkInfo,
+                                                         0 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _setContext( _pMqttConnection, transportSend ) );
+
+    if( TEST_PROTECT() )
+    {
+        _subscribePacketCount = 0;
+        _subackTarget = 1;
+        TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &subackDone, 0, 1 ) );
+
+        if( Iot_CreateDetachedThread( _subackTask,
+                                      &subackDone,
+                                      IOT_THREAD_DEFAULT_PRIORITY,
+                                      IOT_THREAD_DEFAULT_STACK_SIZE ) == false )
+        {
+            IotSemaphore_Destroy( &subackDone );
+            TEST_FAIL_MESSAGE( "Failed to create SUBACK thread." );
+        }
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS,
+                           _IotMqtt_RestoreSubscriptions( _pMqttConnection,
+                                                          &registry,
+                                                          SUBACK_POLL_LIMIT * BROKER_POLL_MS ) );
+
+        IotSemaphore_Wait( &subackDone );
+        IotSemaphore_Destroy( &subackDone );
+
+        TEST_ASSERT_EQUAL_UINT32( 1, _subscribePacketCount );
+        TEST_ASSERT_EQUAL_PTR( _pMqttConnection, registry.connection );
+
+        for( i = 0; i < 3; i++ )
+        {
+            TEST_ASSERT_TRUE( IotMqtt_IsSubscribed( _pMqttConnection,
+                                                    pSaved[ i ].pTopicFilter,
+                                                    pSaved[ i ].topicFilterLength,
+                                                    NULL ) );
+        }
+    }
+
+    IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+    TEST_ASSERT_EQUAL( 3, registry.subscriptionCount );
+
+    /* A cleared registry restores nothing. */
+    IotMqtt_SubscriptionRegistryClear( &registry );
+    TEST_ASSERT_EQUAL( 0, registry.subscriptionCount );
+    IotMqtt_SubscriptionRegistryDestroy( &registry );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Tests the behavior of @ref mqtt_function_unsubscribe when memory
  * allocation fails at various points.
@@ -1828,3 +3264,105 @@ TEST( MQTT_Unit_API, WaitAfterDisconnect )
 }
 
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that the maximum number of MQTT connections can be open at the
+ * same time, each with its own MQTT context.
+ */
+TEST( MQTT_Unit_API, ConnectMultiple )
+{
+    size_t i = 0, j = 0;
+    int8_t contextIndex = -1;
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    IotMqttConnectInfo_t connectInfo = IOT_MQTT_CONNECT_INFO_INITIALIZER;
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttConnection_t pMqttConnections[ MAX_NO_OF_MQTT_CONNECTIONS ] = { IOT_MQTT_CONNECTION_INITIALIZER };
+
+    /* Send all packets to the broker stand-in. */
+    ( void ) memset( _brokerSessions, 0x00, sizeof( _brokerSessions ) );
+    _networkInterface.setReceiveCallback = _brokerSetReceiveCallback;
+    _networkInterface.send = _brokerSend;
+    _networkInterface.receive = _brokerReceive;
+    _networkInterface.close = _close;
+    _networkInfo.createNetworkConnection = false;
+
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = CLIENT_IDENTIFIER;
+    connectInfo.clientIdentifierLength = CLIENT_IDENTIFIER_LENGTH;
+
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = "";
+    publishInfo.payloadLength = 0;
+
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &_brokerStop, 0, 1 ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &_brokerStopped, 0, 1 ) );
+    TEST_ASSERT_EQUAL_INT( true, Iot_CreateDetachedThread( _brokerTask,
+                                                           NULL,
+                                                           IOT_THREAD_DEFAULT_PRIORITY,
+                                                           IOT_THREAD_DEFAULT_STACK_SIZE ) );
+
+    if( TEST_PROTECT() )
+    {
+        /* Open every connection, each on its own network connection. */
+        for( i = 0; i < MAX_NO_OF_MQTT_CONNECTIONS; i++ )
+        {
+            _networkInfo.u.pNetworkConnection = &( _brokerSessions[ i ] );
+
+            status = IotMqtt_Connect( &_networkInfo,
+                                      &connectInfo,
+                                      TIMEOUT_MS,
+                                      &( pMqttConnections[ i ] ) );
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, status );
+        }
+
+        /* No context is left for another connection. */
+        TEST_ASSERT_EQUAL_INT( -1, _IotMqtt_getFreeIndexFromContextConnectionArray() );
+    }
+
+    /* Stop answering CONNECT before the connections are used. */
+    IotSemaphore_Post( &_brokerStop );
+    IotSemaphore_Wait( &_brokerStopped );
+
+    if( TEST_PROTECT() )
+    {
+        for( i = 0; i < MAX_NO_OF_MQTT_CONNECTIONS; i++ )
+        {
+            /* Each connection has its own context, found through the index it stores. */
+            contextIndex = _IotMqtt_getContextIndexFromConnection( pMqttConnections[ i ] );
+            TEST_ASSERT_EQUAL_INT( pMqttConnections[ i ]->contextIndex, contextIndex );
+            TEST_ASSERT_EQUAL_PTR( pMqttConnections[ i ], connToContext[ contextIndex ].mqttConnection );
+
+            for( j = 0; j < i; j++ )
+            {
+                TEST_ASSERT_NOT_EQUAL( pMqttConnections[ j ]->contextIndex, contextIndex );
+            }
+
+            /* A PUBLISH is sent on the connection's own network connection. */
+            status = IotMqtt_PublishSync( pMqttConnections[ i ], &publishInfo, 0, TIMEOUT_MS );
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, status );
+        }
+
+        for( i = 0; i < MAX_NO_OF_MQTT_CONNECTIONS; i++ )
+        {
+            TEST_ASSERT_EQUAL_UINT32( 1, _brokerSessions[ i ].publishCount );
+        }
+    }
+
+    /* Close every connection that was opened. */
+    for( i = 0; i < MAX_NO_OF_MQTT_CONNECTIONS; i++ )
+    {
+        if( pMqttConnections[ i ] != IOT_MQTT_CONNECTION_INITIALIZER )
+        {
+            IotMqtt_Disconnect( pMqttConnections[ i ], IOT_MQTT_FLAG_CLEANUP_ONLY );
+        }
+    }
+
+    IotSemaphore_Destroy( &_brokerStop );
+    IotSemaphore_Destroy( &_brokerStopped );
+
+    /* Every context is free again. */
+    TEST_ASSERT_EQUAL_INT( 0, _IotMqtt_getFreeIndexFromContextConnectionArray() );
+}
+
+/*-----------------------------------------------------------*/
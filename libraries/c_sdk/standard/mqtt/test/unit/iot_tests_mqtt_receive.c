@@ -32,12 +32,17 @@
 #include "iot_config.h"
 
 /* Standard includes. */
+#include <stdio.h>
 #include <string.h>
 
 /* SDK initialization include. */
 #include "iot_init.h"
 
+/* Atomics include. */
+#include "iot_atomic.h"
+
 /* Platform layer includes. */
+#include "platform/iot_clock.h"
 #include "platform/iot_threads.h"
 
 /* MQTT internal include. */
@@ -110,6 +115,33 @@ static const uint8_t _pPingrespTemplate[] = { 0xd0, 0x00 };
  */
 #define PUBLISH_CALLBACK_TIMEOUT    ( 1000 )
 
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this section.
+ *
+ * Provide default values of test configuration constants.
+ */
+#ifndef TEST_MQTT_BENCHMARK_RECEIVE_BYTES
+    #define TEST_MQTT_BENCHMARK_RECEIVE_BYTES          ( 4UL * 1024UL * 1024UL )
+#endif
+#ifndef TEST_MQTT_BENCHMARK_RECEIVE_ROUNDS
+    #define TEST_MQTT_BENCHMARK_RECEIVE_ROUNDS         ( 16UL )
+#endif
+#ifndef TEST_MQTT_BENCHMARK_RECEIVE_BUFFER_SIZE
+    #define TEST_MQTT_BENCHMARK_RECEIVE_BUFFER_SIZE    ( 1024UL )
+#endif
+/** @endcond */
+
+/**
+ * @brief Largest PUBLISH payload received by the throughput benchmark.
+ */
+#define BENCHMARK_MAX_PAYLOAD_LENGTH           ( 64UL * 1024UL )
+
+/**
+ * @brief Length of the buffer for printing benchmark results.
+ */
+#define BENCHMARK_RESULT_LENGTH                ( 160 )
+
 /**
  * @brief Declare a buffer holding a packet and its size.
  */
@@ -143,6 +175,7 @@ typedef struct _receiveContext
     const uint8_t * pData; /**< @brief The data to receive. */
     size_t dataLength;     /**< @brief Length of data. */
     size_t dataIndex;      /**< @brief Next byte of data to read. */
+    size_t arrivedLength;  /**< @brief How much data #_receiveUpto may read; all of it if 0. */
 } _receiveContext_t;
 
 /*-----------------------------------------------------------*/
@@ -187,6 +220,36 @@ static bool _networkCloseCalled = false;
  */
 static bool _disconnectCallbackCalled = false;
 
+/**
+ * @brief Number of buffers lent by #_receiveBuffer that have not been released.
+ */
+static uint32_t _lentBuffers = 0;
+
+/**
+ * @brief The message retained by #_retainCallback.
+ */
+static IotMqttMessage_t _retainedMessage = NULL;
+
+/**
+ * @brief PUBLISH packet received by the throughput benchmark.
+ */
+static uint8_t _pBenchmarkPacket[ BENCHMARK_MAX_PAYLOAD_LENGTH + 32 ];
+
+/**
+ * @brief Where #_copyCallback copies the payload of a PUBLISH.
+ */
+static uint8_t _pBenchmarkPayload[ BENCHMARK_MAX_PAYLOAD_LENGTH ];
+
+/**
+ * @brief Receive buffer of the MQTT connection in the receive buffer benchmark.
+ */
+static uint8_t _pBenchmarkReceiveBuffer[ TEST_MQTT_BENCHMARK_RECEIVE_BUFFER_SIZE ];
+
+/**
+ * @brief Number of calls to #_receive and #_receiveUpto.
+ */
+static uint32_t _networkReads = 0;
+
 /*-----------------------------------------------------------*/
 
 /* Using initialized connToContext variable. */
@@ -301,7 +364,7 @@ static void _operationResetAndPush( _mqttOperation_t * pOperation )
     pOperation->u.operation.status = IOT_MQTT_STATUS_PENDING;
     pOperation->u.operation.jobReference = 1;
 
-    IotListDouble_InsertHead( &( _pMqttConnection->pendingResponse ), &( pOperation->link ) );
+    _IotMqtt_AddPendingResponse( pOperation );
 }
 
 /*-----------------------------------------------------------*/
@@ -421,6 +484,43 @@ static void _publishCallback( void * pCallbackContext,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Called when a PUBLISH message is "received"; keeps the message.
+ */
+static void _retainCallback( void * pCallbackContext,
+                             IotMqttCallbackParam_t * pPublish )
+{
+    IotSemaphore_t * pInvokeCount = ( IotSemaphore_t * ) pCallbackContext;
+
+    if( IotMqtt_RetainMessage( pPublish->u.message.reference ) == IOT_MQTT_SUCCESS )
+    {
+        _retainedMessage = pPublish->u.message.reference;
+        IotSemaphore_Post( pInvokeCount );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Called when a PUBLISH message is "received"; copies the payload, as
+ * is needed to use it after the callback returns without retaining the message.
+ */
+static void _copyCallback( void * pCallbackContext,
+                           IotMqttCallbackParam_t * pPublish )
+{
+    IotSemaphore_t * pInvokeCount = ( IotSemaphore_t * ) pCallbackContext;
+
+    if( pPublish->u.message.info.payloadLength <= sizeof( _pBenchmarkPayload ) )
+    {
+        ( void ) memcpy( _pBenchmarkPayload,
+                         pPublish->u.message.info.pPayload,
+                         pPublish->u.message.info.payloadLength );
+        IotSemaphore_Post( pInvokeCount );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief A PUBACK serializer function that does nothing, but always returns failure.
  *
@@ -449,6 +549,8 @@ static size_t _receive( void * pConnection,
     size_t bytesReceived = 0;
     _receiveContext_t * pReceiveContext = pConnection;
 
+    _networkReads++;
+
     if( pReceiveContext->dataIndex != pReceiveContext->dataLength )
     {
         TEST_ASSERT_NOT_EQUAL( 0, bytesRequested );
@@ -482,6 +584,278 @@ static size_t _receive( void * pConnection,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Simulates a network receive function that returns as much data as is
+ * available, up to the size of the buffer.
+ */
+static size_t _receiveUpto( void * pConnection,
+                            uint8_t * pBuffer,
+                            size_t bufferSize )
+{
+    size_t bytesReceived = 0;
+    _receiveContext_t * pReceiveContext = pConnection;
+
+    /* Data that has not arrived yet can only be read by a blocking receive. */
+    if( ( pReceiveContext->arrivedLength == 0 ) ||
+        ( pReceiveContext->arrivedLength > pReceiveContext->dataIndex ) )
+    {
+        if( ( pReceiveContext->arrivedLength > 0 ) &&
+            ( bufferSize > ( pReceiveContext->arrivedLength - pReceiveContext->dataIndex ) ) )
+        {
+            bufferSize = pReceiveContext->arrivedLength - pReceiveContext->dataIndex;
+        }
+
+        bytesReceived = _receive( pConnection, pBuffer, bufferSize );
+    }
+    else
+    {
+        _networkReads++;
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Simulates a network receive function that lends the data in place.
+ */
+static uint8_t * _receiveBuffer( void * pConnection,
+                                 size_t bytesRequested )
+{
+    uint8_t * pBuffer = NULL;
+    _receiveContext_t * pReceiveContext = pConnection;
+
+    if( ( pReceiveContext->dataLength - pReceiveContext->dataIndex ) >= bytesRequested )
+    {
+        pBuffer = ( uint8_t * ) ( pReceiveContext->pData + pReceiveContext->dataIndex );
+        pReceiveContext->dataIndex += bytesRequested;
+
+        ( void ) Atomic_Increment_u32( &_lentBuffers );
+    }
+
+    return pBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Gives back a buffer lent by #_receiveBuffer.
+ */
+static void _releaseBuffer( void * pConnection,
+                            uint8_t * pBuffer )
+{
+    /* Silence warnings about unused parameters. */
+    ( void ) pConnection;
+    ( void ) pBuffer;
+
+    ( void ) Atomic_Decrement_u32( &_lentBuffers );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wait for the number of lent buffers to reach a value.
+ */
+static bool _waitForLentBuffers( uint32_t count )
+{
+    uint32_t waitTime = 0;
+
+    while( ( _lentBuffers != count ) && ( waitTime < PUBLISH_CALLBACK_TIMEOUT ) )
+    {
+        IotClock_SleepMs( 10 );
+        waitTime += 10;
+    }
+
+    return( _lentBuffers == count );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Write a QoS 0 PUBLISH on #TEST_TOPIC_NAME with a payload of a given
+ * length to a buffer.
+ *
+ * @return The size of the PUBLISH.
+ */
+static size_t _buildPublish( uint8_t * pBuffer,
+                             size_t payloadLength )
+{
+    size_t i = 0, index = 1;
+    size_t remainingLength = 2 + TEST_TOPIC_LENGTH + payloadLength;
+
+    pBuffer[ 0 ] = 0x30;
+
+    /* Encode the remaining length, 7 bits at a time. */
+    do
+    {
+        pBuffer[ index ] = ( uint8_t ) ( remainingLength % 128U );
+        remainingLength /= 128U;
+
+        if( remainingLength > 0U )
+        {
+            pBuffer[ index ] |= 0x80;
+        }
+
+        index++;
+    } while( remainingLength > 0U );
+
+    pBuffer[ index++ ] = 0x00;
+    pBuffer[ index++ ] = ( uint8_t ) TEST_TOPIC_LENGTH;
+    ( void ) memcpy( pBuffer + index, TEST_TOPIC_NAME, TEST_TOPIC_LENGTH );
+    index += TEST_TOPIC_LENGTH;
+
+    for( i = 0; i < payloadLength; i++ )
+    {
+        pBuffer[ index++ ] = ( uint8_t ) i;
+    }
+
+    return index;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Receive #_pBenchmarkPacket a number of times and wait for each PUBLISH
+ * to be delivered.
+ *
+ * @return The time taken in milliseconds, or 0 if a PUBLISH was not delivered.
+ */
+static uint32_t _benchmarkPublish( size_t packetSize,
+                                   uint32_t messageCount,
+                                   bool inPlace )
+{
+    uint32_t i = 0;
+    uint64_t elapsedTime = 0, startTime = 0;
+    bool delivered = true;
+    IotSemaphore_t invokeCount;
+    _receiveContext_t receiveContext = { 0 };
+    int8_t contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+
+    if( IotSemaphore_Create( &invokeCount, 0, 1 ) == false )
+    {
+        return 0;
+    }
+
+    /* In place, the network lends each PUBLISH and the subscription callback
+     * retains it. Otherwise, the PUBLISH is copied into a message buffer and
+     * the subscription callback copies the payload. */
+    _networkInterface.receiveBuffer = ( inPlace == true ) ? _receiveBuffer : NULL;
+    _networkInterface.releaseBuffer = ( inPlace == true ) ? _releaseBuffer : NULL;
+    ( connToContext[ contextIndex ].subscriptionArray[ 0 ] ).callback.function = ( inPlace == true ) ? _retainCallback : _copyCallback;
+    ( connToContext[ contextIndex ].subscriptionArray[ 0 ] ).callback.pCallbackContext = &invokeCount;
+
+    startTime = IotClock_GetTimeMs();
+
+    for( i = 0; ( i < messageCount ) && ( delivered == true ); i++ )
+    {
+        receiveContext.pData = _pBenchmarkPacket;
+        receiveContext.dataLength = packetSize;
+        receiveContext.dataIndex = 0;
+
+        IotMqtt_ReceiveCallback( &receiveContext,
+                                 _pMqttConnection );
+
+        delivered = IotSemaphore_TimedWait( &invokeCount,
+                                            PUBLISH_CALLBACK_TIMEOUT );
+
+        if( ( delivered == true ) && ( inPlace == true ) )
+        {
+            IotMqtt_ReleaseMessage( _retainedMessage );
+        }
+    }
+
+    elapsedTime = IotClock_GetTimeMs() - startTime;
+
+    /* Every lent buffer must be given back. */
+    delivered = delivered && _waitForLentBuffers( 0 );
+
+    IotSemaphore_Destroy( &invokeCount );
+
+    /* Avoid reporting zero on very fast runs. */
+    if( elapsedTime == 0ULL )
+    {
+        elapsedTime = 1ULL;
+    }
+
+    return ( delivered == true ) ? ( uint32_t ) elapsedTime : 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Receive a stream of PUBLISH packets in #_pBenchmarkPacket a number of
+ * times, invoking the receive callback while data remains as a network stack
+ * would.
+ *
+ * The number of network receives made is placed in #_networkReads.
+ *
+ * @return The time taken in milliseconds, or 0 if a PUBLISH was not delivered.
+ */
+static uint32_t _benchmarkReceiveBuffer( size_t streamLength,
+                                         uint32_t packetCount,
+                                         size_t receiveBufferSize )
+{
+    uint32_t i = 0, j = 0;
+    uint64_t elapsedTime = 0, startTime = 0;
+    bool delivered = true;
+    IotSemaphore_t invokeCount;
+    _receiveContext_t receiveContext = { 0 };
+    int8_t contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+
+    if( IotSemaphore_Create( &invokeCount, 0, packetCount ) == false )
+    {
+        return 0;
+    }
+
+    ( connToContext[ contextIndex ].subscriptionArray[ 0 ] ).callback.function = _publishCallback;
+    ( connToContext[ contextIndex ].subscriptionArray[ 0 ] ).callback.pCallbackContext = &invokeCount;
+
+    /* A receive buffer size of 0 receives each packet directly. */
+    _pMqttConnection->receiveBuffer.pBuffer = ( receiveBufferSize > 0U ) ? _pBenchmarkReceiveBuffer : NULL;
+    _pMqttConnection->receiveBuffer.bufferSize = receiveBufferSize;
+    _networkReads = 0;
+
+    startTime = IotClock_GetTimeMs();
+
+    for( i = 0; ( i < TEST_MQTT_BENCHMARK_RECEIVE_ROUNDS ) && ( delivered == true ); i++ )
+    {
+        receiveContext.pData = _pBenchmarkPacket;
+        receiveContext.dataLength = streamLength;
+        receiveContext.dataIndex = 0;
+
+        while( receiveContext.dataIndex < receiveContext.dataLength )
+        {
+            IotMqtt_ReceiveCallback( &receiveContext,
+                                     _pMqttConnection );
+        }
+
+        for( j = 0; ( j < packetCount ) && ( delivered == true ); j++ )
+        {
+            delivered = IotSemaphore_TimedWait( &invokeCount,
+                                                PUBLISH_CALLBACK_TIMEOUT );
+        }
+    }
+
+    elapsedTime = IotClock_GetTimeMs() - startTime;
+
+    /* The connection must not free the static buffer. */
+    _pMqttConnection->receiveBuffer.pBuffer = NULL;
+    _pMqttConnection->receiveBuffer.bufferSize = 0;
+
+    IotSemaphore_Destroy( &invokeCount );
+
+    /* Avoid reporting zero on very fast runs. */
+    if( elapsedTime == 0ULL )
+    {
+        elapsedTime = 1ULL;
+    }
+
+    return ( delivered == true ) ? ( uint32_t ) elapsedTime : 0U;
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief A network close function that reports if it was invoked.
  */
@@ -654,8 +1028,7 @@ static IotMqttError_t _setContext( IotMqttConnection_t pMqttConnection )
         /* Fill the values for network buffer. */
         networkBuffer.pBuffer = &( connToContext[ contextIndex ].buffer[ 0 ] );
         networkBuffer.size = NETWORK_BUFFER_SIZE;
-        subscriptionMutexCreated = IotMutex_CreateNonRecursiveMutex( &( connToContext[ contextIndex ].subscriptionMutex ),
-                                                                     &( connToContext[ contextIndex ].subscriptionMutexStorage ) );
+        subscriptionMutexCreated = _IotMqtt_CreateSubscriptionLocks( contextIndex );
 
         if( subscriptionMutexCreated == false )
         {
@@ -731,6 +1104,9 @@ TEST_SETUP( MQTT_Unit_Receive )
     serializer.getRemainingLength = _getRemainingLength;
 
     _networkInterface.receive = _receive;
+    _networkInterface.receiveUpto = _receiveUpto;
+    _networkInterface.receiveBuffer = NULL;
+    _networkInterface.releaseBuffer = NULL;
     _networkInterface.close = _close;
     networkInfo.pNetworkInterface = &_networkInterface;
     networkInfo.disconnectCallback.function = _disconnectCallback;
@@ -763,6 +1139,9 @@ TEST_SETUP( MQTT_Unit_Receive )
     _getRemainingLengthCalled = false;
     _networkCloseCalled = false;
     _disconnectCallbackCalled = false;
+    _lentBuffers = 0;
+    _retainedMessage = NULL;
+    _networkReads = 0;
 }
 
 /*-----------------------------------------------------------*/
@@ -794,6 +1173,10 @@ TEST_GROUP_RUNNER( MQTT_Unit_Receive )
     RUN_TEST_CASE( MQTT_Unit_Receive, ConnackInvalid );
     RUN_TEST_CASE( MQTT_Unit_Receive, PublishValid );
     RUN_TEST_CASE( MQTT_Unit_Receive, PublishInvalid );
+    RUN_TEST_CASE( MQTT_Unit_Receive, PublishRetain );
+    RUN_TEST_CASE( MQTT_Unit_Receive, PublishThroughput );
+    RUN_TEST_CASE( MQTT_Unit_Receive, PublishBuffered );
+    RUN_TEST_CASE( MQTT_Unit_Receive, ReceiveBufferThroughput );
     RUN_TEST_CASE( MQTT_Unit_Receive, PubackValid );
     RUN_TEST_CASE( MQTT_Unit_Receive, PubackInvalid );
     RUN_TEST_CASE( MQTT_Unit_Receive, SubackValid );
@@ -1320,6 +1703,293 @@ TEST( MQTT_Unit_Receive, PublishInvalid )
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Tests that a PUBLISH lent by the network is deserialized in place and
+ * kept until its last reference is released.
+ */
+TEST( MQTT_Unit_Receive, PublishRetain )
+{
+    int8_t contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+
+    _networkInterface.receiveBuffer = _receiveBuffer;
+    _networkInterface.releaseBuffer = _releaseBuffer;
+
+    /* A message that is not retained is given back to the network once its
+     * subscription callback returns. */
+    {
+        DECLARE_PACKET( _pPublishTemplate, pPublish, publishSize );
+        TEST_ASSERT_EQUAL_INT( true, _processPublish( pPublish,
+                                                      publishSize,
+                                                      1 ) );
+        TEST_ASSERT_EQUAL_INT( true, _waitForLentBuffers( 0 ) );
+    }
+
+    /* A retained message points into the lent buffer until it is released. */
+    {
+        DECLARE_PACKET( _pPublishTemplate, pPublish, publishSize );
+        ( connToContext[ contextIndex ].subscriptionArray[ 0 ] ).callback.function = _retainCallback;
+
+        TEST_ASSERT_EQUAL_INT( true, _processPublish( pPublish,
+                                                      publishSize,
+                                                      1 ) );
+        TEST_ASSERT_NOT_NULL( _retainedMessage );
+
+        /* The topic name starts after the fixed header and topic name length. */
+        TEST_ASSERT_EQUAL_PTR( pPublish + 5, _retainedMessage->u.publish.publishInfo.pTopicName );
+        TEST_ASSERT_EQUAL_INT( 0, memcmp( _pPublishTemplate + 16,
+                                          _retainedMessage->u.publish.publishInfo.pPayload,
+                                          _retainedMessage->u.publish.publishInfo.payloadLength ) );
+
+        /* Another holder may also retain the message. */
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_RetainMessage( _retainedMessage ) );
+        IotMqtt_ReleaseMessage( _retainedMessage );
+        TEST_ASSERT_EQUAL_UINT32( 1, _lentBuffers );
+
+        IotMqtt_ReleaseMessage( _retainedMessage );
+        TEST_ASSERT_EQUAL_INT( true, _waitForLentBuffers( 0 ) );
+    }
+
+    /* Messages allocated by the MQTT library may also be retained. */
+    {
+        DECLARE_PACKET( _pPublishTemplate, pPublish, publishSize );
+        _networkInterface.receiveBuffer = NULL;
+        _networkInterface.releaseBuffer = NULL;
+        _retainedMessage = NULL;
+
+        TEST_ASSERT_EQUAL_INT( true, _processPublish( pPublish,
+                                                      publishSize,
+                                                      1 ) );
+        TEST_ASSERT_NOT_NULL( _retainedMessage );
+        TEST_ASSERT_EQUAL_INT( 0, memcmp( _pPublishTemplate + 5,
+                                          _retainedMessage->u.publish.publishInfo.pTopicName,
+                                          TEST_TOPIC_LENGTH ) );
+
+        IotMqtt_ReleaseMessage( _retainedMessage );
+    }
+
+    /* Only incoming PUBLISH messages may be retained. */
+    TEST_ASSERT_EQUAL( IOT_MQTT_BAD_PARAMETER, IotMqtt_RetainMessage( NULL ) );
+
+    /* Network close function should not have been invoked. */
+    TEST_ASSERT_EQUAL_INT( false, _networkCloseCalled );
+    TEST_ASSERT_EQUAL_INT( false, _disconnectCallbackCalled );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare the throughput of receiving 1-64 KB PUBLISH messages that are
+ * copied out of the network and by the subscription callback with messages that
+ * are lent by the network and retained.
+ */
+TEST( MQTT_Unit_Receive, PublishThroughput )
+{
+    size_t i = 0, packetSize = 0;
+    uint32_t messageCount = 0, copyTime = 0, inPlaceTime = 0;
+    void * pMessageBuffer = NULL;
+    char pOutput[ BENCHMARK_RESULT_LENGTH ] = { 0 };
+    static const size_t pPayloadLengths[] = { 1024, 4096, 16384, BENCHMARK_MAX_PAYLOAD_LENGTH };
+
+    for( i = 0; i < ( sizeof( pPayloadLengths ) / sizeof( pPayloadLengths[ 0 ] ) ); i++ )
+    {
+        packetSize = _buildPublish( _pBenchmarkPacket, pPayloadLengths[ i ] );
+        messageCount = ( uint32_t ) ( TEST_MQTT_BENCHMARK_RECEIVE_BYTES / pPayloadLengths[ i ] );
+
+        /* Copies are only benchmarked if a message buffer can hold the PUBLISH. */
+        pMessageBuffer = IotMqtt_MallocMessage( packetSize );
+
+        if( pMessageBuffer != NULL )
+        {
+            IotMqtt_FreeMessage( pMessageBuffer );
+
+            copyTime = _benchmarkPublish( packetSize, messageCount, false );
+            TEST_ASSERT_NOT_EQUAL( 0, copyTime );
+        }
+        else
+        {
+            copyTime = 0;
+        }
+
+        inPlaceTime = _benchmarkPublish( packetSize, messageCount, true );
+        TEST_ASSERT_NOT_EQUAL( 0, inPlaceTime );
+
+        snprintf( pOutput,
+                  BENCHMARK_RESULT_LENGTH,
+                  "%lu PUBLISH of %lu bytes: copied %lu ms (%lu KB/s), in place %lu ms (%lu KB/s).\r\n",
+                  ( unsigned long ) messageCount,
+                  ( unsigned long ) pPayloadLengths[ i ],
+                  ( unsigned long ) copyTime,
+                  ( copyTime == 0U ) ? 0UL : ( unsigned long ) ( ( TEST_MQTT_BENCHMARK_RECEIVE_BYTES / 1024UL ) * 1000UL / copyTime ),
+                  ( unsigned long ) inPlaceTime,
+                  ( unsigned long ) ( ( TEST_MQTT_BENCHMARK_RECEIVE_BYTES / 1024UL ) * 1000UL / inPlaceTime ) );
+
+        UnityPrint( pOutput );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a connection with a receive buffer processes every packet
+ * read in one network receive, including packets larger than the buffer.
+ */
+TEST( MQTT_Unit_Receive, PublishBuffered )
+{
+    uint32_t i = 0;
+    size_t streamLength = 0;
+    uint8_t pStream[ 320 ] = { 0 };
+    IotSemaphore_t invokeCount;
+    _receiveContext_t receiveContext = { 0 };
+    int8_t contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &invokeCount, 0, 3 ) );
+    ( connToContext[ contextIndex ].subscriptionArray[ 0 ] ).callback.pCallbackContext = &invokeCount;
+
+    /* The buffer is freed when the connection is destroyed. */
+    _pMqttConnection->receiveBuffer.pBuffer = IotMqtt_MallocMessage( 64 );
+    TEST_ASSERT_NOT_NULL( _pMqttConnection->receiveBuffer.pBuffer );
+    _pMqttConnection->receiveBuffer.bufferSize = 64;
+
+    if( TEST_PROTECT() )
+    {
+        /* Three 23-byte PUBLISH packets and a PINGRESP span two reads of the
+         * 64-byte buffer. */
+        for( i = 0; i < 3; i++ )
+        {
+            streamLength += _buildPublish( pStream + streamLength, 8 );
+        }
+
+        ( void ) memcpy( pStream + streamLength, _pPingrespTemplate, sizeof( _pPingrespTemplate ) );
+        streamLength += sizeof( _pPingrespTemplate );
+
+        receiveContext.pData = pStream;
+        receiveContext.dataLength = streamLength;
+
+        IotMqtt_ReceiveCallback( &receiveContext,
+                                 _pMqttConnection );
+
+        for( i = 0; i < 3; i++ )
+        {
+            TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &invokeCount,
+                                                                 PUBLISH_CALLBACK_TIMEOUT ) );
+        }
+
+        TEST_ASSERT_EQUAL( streamLength, receiveContext.dataIndex );
+        TEST_ASSERT_EQUAL( 0, _pMqttConnection->receiveBuffer.length );
+        TEST_ASSERT_EQUAL_UINT32( 2, _networkReads );
+        TEST_ASSERT_EQUAL_INT( false, _networkCloseCalled );
+
+        /* The data of a PUBLISH that does not fit in the buffer bypasses it
+         * once the buffered part is copied. */
+        _networkReads = 0;
+        streamLength = _buildPublish( pStream, 200 );
+
+        receiveContext.dataLength = streamLength;
+        receiveContext.dataIndex = 0;
+
+        IotMqtt_ReceiveCallback( &receiveContext,
+                                 _pMqttConnection );
+
+        TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &invokeCount,
+                                                             PUBLISH_CALLBACK_TIMEOUT ) );
+        TEST_ASSERT_EQUAL( streamLength, receiveContext.dataIndex );
+        TEST_ASSERT_EQUAL_UINT32( 2, _networkReads );
+        TEST_ASSERT_EQUAL_INT( false, _networkCloseCalled );
+
+        /* When the rest of a PUBLISH has not arrived, it is waited for with a
+         * blocking receive after an empty read. */
+        _networkReads = 0;
+        streamLength = _buildPublish( pStream, 8 );
+
+        receiveContext.dataLength = streamLength;
+        receiveContext.dataIndex = 0;
+        receiveContext.arrivedLength = 10;
+
+        IotMqtt_ReceiveCallback( &receiveContext,
+                                 _pMqttConnection );
+
+        TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &invokeCount,
+                                                             PUBLISH_CALLBACK_TIMEOUT ) );
+        TEST_ASSERT_EQUAL( streamLength, receiveContext.dataIndex );
+        TEST_ASSERT_EQUAL_UINT32( 3, _networkReads );
+        TEST_ASSERT_EQUAL_INT( false, _networkCloseCalled );
+
+        /* The data of a PUBLISH is lent in place if none of it was read into
+         * the buffer. The 3-byte fixed header is all that has arrived. */
+        _networkInterface.receiveBuffer = _receiveBuffer;
+        _networkInterface.releaseBuffer = _releaseBuffer;
+        _networkReads = 0;
+        streamLength = _buildPublish( pStream, 200 );
+
+        receiveContext.dataLength = streamLength;
+        receiveContext.dataIndex = 0;
+        receiveContext.arrivedLength = 3;
+
+        IotMqtt_ReceiveCallback( &receiveContext,
+                                 _pMqttConnection );
+
+        TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &invokeCount,
+                                                             PUBLISH_CALLBACK_TIMEOUT ) );
+        TEST_ASSERT_EQUAL( streamLength, receiveContext.dataIndex );
+        TEST_ASSERT_EQUAL_UINT32( 1, _networkReads );
+        TEST_ASSERT_EQUAL_INT( true, _waitForLentBuffers( 0 ) );
+        TEST_ASSERT_EQUAL_INT( false, _networkCloseCalled );
+    }
+
+    IotSemaphore_Destroy( &invokeCount );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare the number of network receives and the time taken to receive
+ * bursts of small PUBLISH messages with and without a receive buffer.
+ */
+TEST( MQTT_Unit_Receive, ReceiveBufferThroughput )
+{
+    size_t i = 0, packetSize = 0, streamLength = 0;
+    uint32_t packetCount = 0, directTime = 0, directReads = 0, bufferedTime = 0, bufferedReads = 0;
+    char pOutput[ BENCHMARK_RESULT_LENGTH ] = { 0 };
+    static const size_t pPayloadLengths[] = { 16, 128, 1024 };
+
+    for( i = 0; i < ( sizeof( pPayloadLengths ) / sizeof( pPayloadLengths[ 0 ] ) ); i++ )
+    {
+        /* Fill the benchmark packet buffer with back-to-back PUBLISH packets. */
+        packetSize = _buildPublish( _pBenchmarkPacket, pPayloadLengths[ i ] );
+        packetCount = ( uint32_t ) ( sizeof( _pBenchmarkPacket ) / packetSize );
+
+        for( streamLength = packetSize; streamLength < ( packetCount * packetSize ); streamLength += packetSize )
+        {
+            ( void ) memcpy( _pBenchmarkPacket + streamLength, _pBenchmarkPacket, packetSize );
+        }
+
+        directTime = _benchmarkReceiveBuffer( streamLength, packetCount, 0 );
+        directReads = _networkReads;
+        TEST_ASSERT_NOT_EQUAL( 0, directTime );
+
+        bufferedTime = _benchmarkReceiveBuffer( streamLength, packetCount, TEST_MQTT_BENCHMARK_RECEIVE_BUFFER_SIZE );
+        bufferedReads = _networkReads;
+        TEST_ASSERT_NOT_EQUAL( 0, bufferedTime );
+
+        /* Buffering must at least halve the network receives. */
+        TEST_ASSERT_LESS_THAN( directReads / 2U, bufferedReads );
+
+        snprintf( pOutput,
+                  BENCHMARK_RESULT_LENGTH,
+                  "%lu PUBLISH of %lu bytes: direct %lu reads in %lu ms, buffered %lu reads in %lu ms.\r\n",
+                  ( unsigned long ) ( packetCount * TEST_MQTT_BENCHMARK_RECEIVE_ROUNDS ),
+                  ( unsigned long ) pPayloadLengths[ i ],
+                  ( unsigned long ) directReads,
+                  ( unsigned long ) directTime,
+                  ( unsigned long ) bufferedReads,
+                  ( unsigned long ) bufferedTime );
+
+        UnityPrint( pOutput );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Tests the behavior of @ref mqtt_function_receivecallback with a
  * spec-compliant PUBACK.
@@ -1433,7 +2103,7 @@ TEST( MQTT_Unit_Receive, PubackInvalid )
 
     /* Deserializing the PUBACK packet using the lightweight API doesnot serialize the packet id if the packet type
      * is not valid and as a result operation cannot be deleted from the pendingResponse list. So removing it explicitily. */
-    IotListDouble_RemoveHead( &( _pMqttConnection->pendingResponse ) );
+    IotListDouble_Remove( &( publish.link ) );
     _operationResetAndPush( &publish );
 
     /* A PUBACK must have a remaining length of 2. */
@@ -1800,7 +2470,7 @@ TEST( MQTT_Unit_Receive, UnsubackInvalid )
 
     /* Deserializing the UNSUBACK packet using the lightweight API doesnot serialize the packet id if the packet type
      * is not valid and as a result operation cannot be deleted from the pendingResponse list. So removing it explicitily. */
-    IotListDouble_RemoveHead( &( _pMqttConnection->pendingResponse ) );
+    IotListDouble_Remove( &( unsubscribe.link ) );
     _operationResetAndPush( &unsubscribe );
 
     /* An UNSUBACK must have a remaining length of 2. */
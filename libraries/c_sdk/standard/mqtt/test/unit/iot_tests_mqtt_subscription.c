@@ -38,6 +38,9 @@
 /* SDK initialization include. */
 #include "iot_init.h"
 
+/* Atomics include. */
+#include "iot_atomic.h"
+
 /* Platform layer includes. */
 #include "platform/iot_threads.h"
 #include "platform/iot_clock.h"
@@ -73,6 +76,12 @@ extern _connContext_t connToContext[ MAX_NO_OF_MQTT_CONNECTIONS ];
 #ifndef IOT_TEST_MQTT_TIMEOUT_MS
     #define IOT_TEST_MQTT_TIMEOUT_MS    ( 5000 )
 #endif
+#ifndef TEST_MQTT_BENCHMARK_DISPATCHES
+    #define TEST_MQTT_BENCHMARK_DISPATCHES    ( 4000 )
+#endif
+#ifndef TEST_MQTT_BENCHMARK_MAX_WORKERS
+    #define TEST_MQTT_BENCHMARK_MAX_WORKERS    ( 4 )
+#endif
 /** @endcond */
 
 /**
@@ -91,6 +100,13 @@ extern _connContext_t connToContext[ MAX_NO_OF_MQTT_CONNECTIONS ];
 #define TEST_TOPIC_FILTER_FORMAT    ( "/test%lu" )                             /**< @brief Format of each topic filter. */
 #define TEST_TOPIC_FILTER_LENGTH    ( sizeof( TEST_TOPIC_FILTER_FORMAT ) + 1 ) /**< @brief Maximum length of each topic filter. */
 
+/*
+ * Constants relating to the dispatch benchmark.
+ */
+#define DISPATCH_TOPIC_NAME                 ( "/dispatch/benchmark" ) /**< @brief Topic name of every dispatched PUBLISH. */
+#define DISPATCH_SUBSCRIPTION_COUNT         ( 3 )                     /**< @brief Number of subscriptions matching #DISPATCH_TOPIC_NAME. */
+#define DISPATCH_BENCHMARK_RESULT_LENGTH    ( 160 )                   /**< @brief Size of the buffer used to print a result. */
+
 /**
  * @brief A non-NULL function pointer to use for subscription callback. This
  * "function" should cause a crash if actually called.
@@ -152,6 +168,16 @@ static int8_t contextIndex = -1;
  */
 static _mqttConnection_t * _pMqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
 
+/**
+ * @brief Counts subscription callbacks invoked by the dispatch benchmark.
+ */
+static uint32_t _dispatchedCallbacks = 0;
+
+/**
+ * @brief Number of PUBLISH messages each dispatch benchmark worker delivers.
+ */
+static uint32_t _dispatchesPerWorker = 0;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -223,12 +249,12 @@ static bool _waitForCount( IotMutex_t * pMutex,
 /*-----------------------------------------------------------*/
 
 /**
- * @brief Wait for a reference count to reach a target value, using FreeRTOS semaphores,
- * subject to a timeout.
+ * @brief Wait for a subscription reference count to reach a target value, reading
+ * it under the subscription locks, subject to a timeout.
  */
-static bool _waitForCountSemaphore( SemaphoreHandle_t sem,
-                                    const int32_t * pReferenceCount,
-                                    int32_t target )
+static bool _waitForSubscriptionCount( int8_t subscriptionContextIndex,
+                                       const int32_t * pReferenceCount,
+                                       int32_t target )
 {
     bool status = false;
     int32_t referenceCount = 0;
@@ -242,9 +268,9 @@ static bool _waitForCountSemaphore( SemaphoreHandle_t sem,
     for( sleepCount = 0; sleepCount < sleepLimit; sleepCount++ )
     {
         /* Read reference count. */
-        xSemaphoreTake( sem, portMAX_DELAY );
+        ( void ) _IotMqtt_LockSubscriptions( subscriptionContextIndex );
         referenceCount = *pReferenceCount;
-        xSemaphoreGive( sem );
+        ( void ) _IotMqtt_UnlockSubscriptions( subscriptionContextIndex );
 
         /* Exit if target value is reached. Otherwise, sleep. */
         if( referenceCount == target )
@@ -319,6 +345,49 @@ static void _blockingCallback( void * pArgument,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief A subscription callback function that counts its invocations.
+ */
+static void _countingCallback( void * pArgument,
+                               IotMqttCallbackParam_t * pPublish )
+{
+    /* Silence warnings about unused parameters. */
+    ( void ) pArgument;
+    ( void ) pPublish;
+
+    ( void ) Atomic_Increment_u32( &_dispatchedCallbacks );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Dispatch benchmark worker; delivers incoming PUBLISH messages to the
+ * subscription callbacks, then posts to a semaphore.
+ */
+static void _dispatchWorker( void * pArgument )
+{
+    uint32_t i = 0;
+    IotSemaphore_t * pDone = ( IotSemaphore_t * ) pArgument;
+    IotMqttCallbackParam_t callbackParam = { .mqttConnection = NULL };
+
+    for( i = 0; i < _dispatchesPerWorker; i++ )
+    {
+        ( void ) memset( &callbackParam, 0x00, sizeof( IotMqttCallbackParam_t ) );
+        callbackParam.u.message.info.pTopicName = DISPATCH_TOPIC_NAME;
+        callbackParam.u.message.info.topicNameLength = ( uint16_t ) ( sizeof( DISPATCH_TOPIC_NAME ) - 1 );
+
+        /* Subscription callback invocation releases a connection reference. */
+        if( _IotMqtt_IncrementConnectionReferences( _pMqttConnection ) == true )
+        {
+            _IotMqtt_InvokeSubscriptionCallback( _pMqttConnection, &callbackParam );
+        }
+    }
+
+    IotSemaphore_Post( pDone );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief The time interface provided to the MQTT context used in calling MQTT LTS APIs.
  */
@@ -465,8 +534,7 @@ static IotMqttError_t _setContext( IotMqttConnection_t pMqttConnection )
         /* Fill the values for network buffer. */
         networkBuffer.pBuffer = &( connToContext[ contextIndex ].buffer[ 0 ] );
         networkBuffer.size = NETWORK_BUFFER_SIZE;
-        subscriptionMutexCreated = IotMutex_CreateNonRecursiveMutex( &( connToContext[ contextIndex ].subscriptionMutex ),
-                                                                     &( connToContext[ contextIndex ].subscriptionMutexStorage ) );
+        subscriptionMutexCreated = _IotMqtt_CreateSubscriptionLocks( contextIndex );
 
         if( subscriptionMutexCreated == false )
         {
@@ -600,6 +668,10 @@ TEST_GROUP_RUNNER( MQTT_Unit_Subscription )
     RUN_TEST_CASE( MQTT_Unit_Subscription, SubscriptionReferences );
     RUN_TEST_CASE( MQTT_Unit_Subscription, TopicFilterMatchTrue );
     RUN_TEST_CASE( MQTT_Unit_Subscription, TopicFilterMatchFalse );
+    RUN_TEST_CASE( MQTT_Unit_Subscription, SubscriptionTrieMatch );
+    RUN_TEST_CASE( MQTT_Unit_Subscription, SubscriptionTrieFull );
+    RUN_TEST_CASE( MQTT_Unit_Subscription, SubscriptionSlotReuse );
+    RUN_TEST_CASE( MQTT_Unit_Subscription, DispatchThroughput );
 }
 
 /*-----------------------------------------------------------*/
@@ -609,7 +681,7 @@ TEST_GROUP_RUNNER( MQTT_Unit_Subscription )
  */
 TEST( MQTT_Unit_Subscription, ListInsertRemove )
 {
-    int8_t index = -1;
+    int16_t index = -1;
 
     /* Getting MQTT Context for the specified MQTT Connection. */
     contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
@@ -651,7 +723,7 @@ TEST( MQTT_Unit_Subscription, ListFindByTopicFilter )
 {
     _mqttSubscription_t * pSubscription = NULL;
     _topicMatchParams_t topicMatchParams = { 0 };
-    int8_t index = -1;
+    int16_t index = -1;
 
     /* Getting MQTT Context for the specified MQTT Connection. */
     contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
@@ -916,7 +988,7 @@ TEST( MQTT_Unit_Subscription, SubscriptionAddDuplicate )
     TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, status );
 
     /* Find the subscription that was just modified. */
-    int8_t index = -1;
+    int16_t index = -1;
 
     topicMatchParams.pTopicName = "/test1";
     topicMatchParams.topicNameLength = 6;
@@ -1157,9 +1229,9 @@ TEST( MQTT_Unit_Subscription, SubscriptionReferences )
                                                     3 + keepAliveReference ) );
 
         /* Check that the subscription also has a reference count of 3. */
-        TEST_ASSERT_EQUAL_INT32( true, _waitForCountSemaphore( connToContext[ contextIndex ].subscriptionMutex,
-                                                               &( pSubscription->references ),
-                                                               3 ) );
+        TEST_ASSERT_EQUAL_INT32( true, _waitForSubscriptionCount( contextIndex,
+                                                                  &( pSubscription->references ),
+                                                                  3 ) );
 
         /* Post to the wait semaphore, which unblocks one subscription callback. */
         IotSemaphore_Post( &waitSem );
@@ -1170,9 +1242,9 @@ TEST( MQTT_Unit_Subscription, SubscriptionReferences )
         TEST_ASSERT_EQUAL_INT( true, _waitForCount( &( _pMqttConnection->referencesMutex ),
                                                     &( _pMqttConnection->references ),
                                                     2 + keepAliveReference ) );
-        TEST_ASSERT_EQUAL_INT32( true, _waitForCountSemaphore( connToContext[ contextIndex ].subscriptionMutex,
-                                                               &( pSubscription->references ),
-                                                               2 ) );
+        TEST_ASSERT_EQUAL_INT32( true, _waitForSubscriptionCount( contextIndex,
+                                                                  &( pSubscription->references ),
+                                                                  2 ) );
 
         /* Shut down the MQTT connection. */
         IotMqtt_Disconnect( _pMqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
@@ -1284,3 +1356,280 @@ TEST( MQTT_Unit_Subscription, TopicFilterMatchFalse )
 }
 
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that matching topic names through the subscription trie gives the
+ * same subscriptions as scanning the subscription array.
+ */
+TEST( MQTT_Unit_Subscription, SubscriptionTrieMatch )
+{
+    size_t i = 0, j = 0;
+    int16_t scanIndex = 0, trieIndex = 0;
+    _topicMatchParams_t topicMatchParams = { .exactMatchOnly = false };
+    IotMqttSubscription_t subscription[ 8 ] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER };
+    static _mqttTriePending_t pPending[ MQTT_SUBSCRIPTION_TRIE_NODES + 1 ];
+    const char * const pTopicFilters[ 8 ] =
+    {
+        "/aws/iot/shadow", "/aws/+/shadow", "/aws/#",   "#",
+        "aws/iot",         "aws/+",         "aws//iot", "+/+"
+    };
+    const char * const pTopicNames[ 10 ] =
+    {
+        "/aws/iot/shadow", "/aws/thing/shadow", "/aws", "/aws/", "aws/iot",
+        "aws",             "aws//iot",          "aws/", "/",     "none"
+    };
+
+    /* Getting MQTT Context for the specified MQTT Connection. */
+    contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+
+    for( i = 0; i < 8; i++ )
+    {
+        subscription[ i ].pTopicFilter = pTopicFilters[ i ];
+        subscription[ i ].topicFilterLength = ( uint16_t ) strlen( pTopicFilters[ i ] );
+        subscription[ i ].callback.function = SUBSCRIPTION_CALLBACK_FUNCTION;
+    }
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _IotMqtt_AddSubscriptions( _pMqttConnection,
+                                                                    1,
+                                                                    subscription,
+                                                                    8 ) );
+
+    /* Check every topic name before and after removing some subscriptions. */
+    for( j = 0; j < 2; j++ )
+    {
+        for( i = 0; i < 10; i++ )
+        {
+            topicMatchParams.pTopicName = pTopicNames[ i ];
+            topicMatchParams.topicNameLength = ( uint16_t ) strlen( pTopicNames[ i ] );
+            scanIndex = 0;
+            trieIndex = 0;
+
+            /* Both searches must return the same sequence of subscriptions. */
+            while( scanIndex != -1 )
+            {
+                scanIndex = IotMqtt_FindFirstMatch( connToContext[ contextIndex ].subscriptionArray,
+                                                    scanIndex,
+                                                    &topicMatchParams );
+                trieIndex = IotMqtt_FindFirstMatchInTrieShared( &( connToContext[ contextIndex ].subscriptionTrie ),
+                                                                pPending,
+                                                                connToContext[ contextIndex ].subscriptionArray,
+                                                                trieIndex,
+                                                                &topicMatchParams );
+                TEST_ASSERT_EQUAL_INT( scanIndex, trieIndex );
+
+                if( scanIndex != -1 )
+                {
+                    scanIndex++;
+                    trieIndex++;
+                }
+            }
+        }
+
+        /* Removed subscriptions must not be found in the trie. */
+        _IotMqtt_RemoveSubscriptionByTopicFilter( _pMqttConnection, &( subscription[ 1 ] ), 3 );
+    }
+
+    /* A subscription unsubscribed while a callback uses it must not be found
+     * by new PUBLISH messages. */
+    topicMatchParams.pTopicName = pTopicNames[ 0 ];
+    topicMatchParams.topicNameLength = ( uint16_t ) strlen( pTopicNames[ 0 ] );
+    TEST_ASSERT_EQUAL_INT( 0, IotMqtt_FindFirstMatchInTrieShared( &( connToContext[ contextIndex ].subscriptionTrie ),
+                                                                  pPending,
+                                                                  connToContext[ contextIndex ].subscriptionArray,
+                                                                  0,
+                                                                  &topicMatchParams ) );
+
+    connToContext[ contextIndex ].subscriptionArray[ 0 ].unsubscribed = true;
+    TEST_ASSERT_EQUAL_INT( -1, IotMqtt_FindFirstMatchInTrieShared( &( connToContext[ contextIndex ].subscriptionTrie ),
+                                                                   pPending,
+                                                                   connToContext[ contextIndex ].subscriptionArray,
+                                                                   0,
+                                                                   &topicMatchParams ) );
+    connToContext[ contextIndex ].subscriptionArray[ 0 ].unsubscribed = false;
+
+    _IotMqtt_RemoveSubscriptionByTopicFilter( _pMqttConnection, subscription, 8 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a subscription needing more levels than the subscription
+ * trie has free is rejected without changing the trie.
+ */
+TEST( MQTT_Unit_Subscription, SubscriptionTrieFull )
+{
+    size_t i = 0;
+    char pTopicFilter[ ( MQTT_SUBSCRIPTION_TRIE_NODES + 1 ) * 2 ] = { 0 };
+    IotMqttSubscription_t subscription = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+
+    /* Getting MQTT Context for the specified MQTT Connection. */
+    contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+
+    /* Create a topic filter with one more level than the trie has nodes. */
+    for( i = 0; i < MQTT_SUBSCRIPTION_TRIE_NODES + 1; i++ )
+    {
+        pTopicFilter[ 2 * i ] = 'a';
+        pTopicFilter[ ( 2 * i ) + 1 ] = '/';
+    }
+
+    subscription.pTopicFilter = pTopicFilter;
+    subscription.topicFilterLength = ( uint16_t ) ( ( 2 * i ) - 1 );
+    subscription.callback.function = SUBSCRIPTION_CALLBACK_FUNCTION;
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_NO_MEMORY, _IotMqtt_AddSubscriptions( _pMqttConnection,
+                                                                      1,
+                                                                      &subscription,
+                                                                      1 ) );
+    TEST_ASSERT_TRUE( _isEmpty( connToContext[ contextIndex ].subscriptionArray ) );
+    TEST_ASSERT_EQUAL( 0, connToContext[ contextIndex ].subscriptionTrie.root.references );
+    TEST_ASSERT_EQUAL( 0, IotHashTable_Count( &( connToContext[ contextIndex ].subscriptionTrie.levels ) ) );
+
+    /* A topic filter that fits is accepted. */
+    subscription.topicFilterLength = 3;
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _IotMqtt_AddSubscriptions( _pMqttConnection,
+                                                                    1,
+                                                                    &subscription,
+                                                                    1 ) );
+    TEST_ASSERT_EQUAL( 2, IotHashTable_Count( &( connToContext[ contextIndex ].subscriptionTrie.levels ) ) );
+
+    _IotMqtt_RemoveSubscriptionByTopicFilter( _pMqttConnection, &subscription, 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that free elements of the subscription array are taken in order,
+ * then reused after they are released.
+ */
+TEST( MQTT_Unit_Subscription, SubscriptionSlotReuse )
+{
+    int16_t i = 0, index = -1;
+    _mqttSubscriptionSlots_t * pSlots = NULL;
+    _mqttSubscription_t * pSubscriptionArray = NULL;
+
+    /* Getting MQTT Context for the specified MQTT Connection. */
+    contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+    pSlots = &( connToContext[ contextIndex ].subscriptionSlots );
+    pSubscriptionArray = connToContext[ contextIndex ].subscriptionArray;
+
+    /* Elements that were never used are taken in order. */
+    for( i = 0; i < MAX_NO_OF_MQTT_SUBSCRIPTIONS; i++ )
+    {
+        index = IotMqtt_TakeFreeIndexInSubscriptionArray( pSlots, pSubscriptionArray );
+        TEST_ASSERT_EQUAL_INT( i, index );
+        pSubscriptionArray[ index ].topicFilterLength = 1;
+    }
+
+    TEST_ASSERT_EQUAL_INT( -1, IotMqtt_TakeFreeIndexInSubscriptionArray( pSlots, pSubscriptionArray ) );
+
+    /* Released elements are reused, most recent first. */
+    pSubscriptionArray[ 0 ].topicFilterLength = 0;
+    IotMqtt_ReleaseIndexInSubscriptionArray( pSlots, 0 );
+    pSubscriptionArray[ MAX_NO_OF_MQTT_SUBSCRIPTIONS - 1 ].topicFilterLength = 0;
+    IotMqtt_ReleaseIndexInSubscriptionArray( pSlots, MAX_NO_OF_MQTT_SUBSCRIPTIONS - 1 );
+
+    index = IotMqtt_TakeFreeIndexInSubscriptionArray( pSlots, pSubscriptionArray );
+    TEST_ASSERT_EQUAL_INT( MAX_NO_OF_MQTT_SUBSCRIPTIONS - 1, index );
+    pSubscriptionArray[ index ].topicFilterLength = 1;
+
+    index = IotMqtt_TakeFreeIndexInSubscriptionArray( pSlots, pSubscriptionArray );
+    TEST_ASSERT_EQUAL_INT( 0, index );
+    pSubscriptionArray[ index ].topicFilterLength = 1;
+
+    /* An element freed without being released is still found. */
+    pSubscriptionArray[ MAX_NO_OF_MQTT_SUBSCRIPTIONS / 2 ].topicFilterLength = 0;
+    TEST_ASSERT_EQUAL_INT( MAX_NO_OF_MQTT_SUBSCRIPTIONS / 2,
+                           IotMqtt_TakeFreeIndexInSubscriptionArray( pSlots, pSubscriptionArray ) );
+
+    /* Clear the subscription array. */
+    memset( pSubscriptionArray, 0x00, sizeof( connToContext[ contextIndex ].subscriptionArray ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measures how many incoming PUBLISH messages are dispatched to subscription
+ * callbacks per second as the number of workers grows.
+ */
+TEST( MQTT_Unit_Subscription, DispatchThroughput )
+{
+    uint32_t i = 0, workers = 0;
+    uint64_t startTime = 0, elapsedMs = 0;
+    IotSemaphore_t doneSem;
+    char pResult[ DISPATCH_BENCHMARK_RESULT_LENGTH ] = { 0 };
+    IotMqttSubscription_t subscriptions[ DISPATCH_SUBSCRIPTION_COUNT ] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER };
+    const char * const pTopicFilters[ DISPATCH_SUBSCRIPTION_COUNT ] =
+    {
+        DISPATCH_TOPIC_NAME,
+        "/dispatch/+",
+        "/dispatch/#"
+    };
+
+    /* Getting MQTT Context for the specified MQTT Connection. */
+    contextIndex = _IotMqtt_getContextIndexFromConnection( _pMqttConnection );
+
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &doneSem, 0, TEST_MQTT_BENCHMARK_MAX_WORKERS ) );
+
+    for( i = 0; i < DISPATCH_SUBSCRIPTION_COUNT; i++ )
+    {
+        subscriptions[ i ].pTopicFilter = pTopicFilters[ i ];
+        subscriptions[ i ].topicFilterLength = ( uint16_t ) strlen( pTopicFilters[ i ] );
+        subscriptions[ i ].callback.function = _countingCallback;
+    }
+
+    if( TEST_PROTECT() )
+    {
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _IotMqtt_AddSubscriptions( _pMqttConnection,
+                                                                        1,
+                                                                        subscriptions,
+                                                                        DISPATCH_SUBSCRIPTION_COUNT ) );
+
+        for( workers = 1; workers <= TEST_MQTT_BENCHMARK_MAX_WORKERS; workers *= 2 )
+        {
+            _dispatchedCallbacks = 0;
+            _dispatchesPerWorker = TEST_MQTT_BENCHMARK_DISPATCHES / workers;
+            startTime = IotClock_GetTimeMs();
+
+            for( i = 0; i < workers; i++ )
+            {
+                TEST_ASSERT_EQUAL_INT( true, Iot_CreateDetachedThread( _dispatchWorker,
+                                                                       &doneSem,
+                                                                       IOT_THREAD_DEFAULT_PRIORITY,
+                                                                       IOT_THREAD_DEFAULT_STACK_SIZE ) );
+            }
+
+            for( i = 0; i < workers; i++ )
+            {
+                TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &doneSem, IOT_TEST_MQTT_TIMEOUT_MS * 10 ) );
+            }
+
+            elapsedMs = IotClock_GetTimeMs() - startTime;
+
+            /* Every PUBLISH must reach every matching subscription exactly once. */
+            TEST_ASSERT_EQUAL_UINT32( _dispatchesPerWorker * workers * DISPATCH_SUBSCRIPTION_COUNT,
+                                      _dispatchedCallbacks );
+
+            ( void ) snprintf( pResult,
+                               DISPATCH_BENCHMARK_RESULT_LENGTH,
+                               "%lu worker(s) dispatched %lu PUBLISH to %d subscriptions in %lu ms (%lu PUBLISH/s).",
+                               ( unsigned long ) workers,
+                               ( unsigned long ) ( _dispatchesPerWorker * workers ),
+                               DISPATCH_SUBSCRIPTION_COUNT,
+                               ( unsigned long ) elapsedMs,
+                               ( unsigned long ) ( ( ( uint64_t ) _dispatchesPerWorker * workers * 1000U ) /
+                                                   ( ( elapsedMs == 0U ) ? 1U : elapsedMs ) ) );
+            UnityPrint( pResult );
+            UNITY_PRINT_EOL();
+        }
+
+        /* No subscription may still be referenced by a callback. */
+        for( i = 0; i < DISPATCH_SUBSCRIPTION_COUNT; i++ )
+        {
+            TEST_ASSERT_EQUAL_INT32( 0, connToContext[ contextIndex ].subscriptionArray[ i ].references );
+        }
+    }
+
+    IotSemaphore_Destroy( &doneSem );
+}
+
+/*-----------------------------------------------------------*/
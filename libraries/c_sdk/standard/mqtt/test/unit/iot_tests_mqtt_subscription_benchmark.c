@@ -0,0 +1,343 @@
+/*
+ * FreeRTOS MQTT V2.3.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file iot_tests_mqtt_subscription_benchmark.c
+ * @brief Benchmark comparing subscription dispatch through the subscription trie
+ * with a scan of the subscription array.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this section.
+ *
+ * Provide default values of test configuration constants.
+ */
+#ifndef TEST_MQTT_BENCHMARK_FILTERS
+    #define TEST_MQTT_BENCHMARK_FILTERS    ( 1000 )
+#endif
+#ifndef TEST_MQTT_BENCHMARK_TOPICS
+    #define TEST_MQTT_BENCHMARK_TOPICS     ( 100000UL )
+#endif
+/** @endcond */
+
+/**
+ * @brief Number of topic filters benchmarked; limited by the size of the
+ * subscription array. Set MAX_NO_OF_MQTT_SUBSCRIPTIONS to benchmark all of
+ * TEST_MQTT_BENCHMARK_FILTERS.
+ */
+#if TEST_MQTT_BENCHMARK_FILTERS > MAX_NO_OF_MQTT_SUBSCRIPTIONS
+    #define BENCHMARK_FILTER_COUNT    ( MAX_NO_OF_MQTT_SUBSCRIPTIONS )
+#else
+    #define BENCHMARK_FILTER_COUNT    ( TEST_MQTT_BENCHMARK_FILTERS )
+#endif
+
+/**
+ * @brief Number of distinct topic names; the benchmark cycles through them.
+ */
+#define BENCHMARK_TOPIC_NAME_COUNT       ( 512 )
+
+/**
+ * @brief Maximum length of the generated topic filters and names.
+ */
+#define BENCHMARK_TOPIC_LENGTH           ( 48 )
+
+/**
+ * @brief Length of the buffer for printing benchmark results.
+ */
+#define BENCHMARK_RESULT_LENGTH          ( 160 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Subscriptions matched by the benchmark.
+ */
+static _mqttSubscription_t _pSubscriptions[ MAX_NO_OF_MQTT_SUBSCRIPTIONS ];
+
+/**
+ * @brief Trie indexing #_pSubscriptions.
+ */
+static _mqttSubscriptionTrie_t _subscriptionTrie;
+
+/**
+ * @brief Nodes left to visit while matching in #_subscriptionTrie.
+ */
+static _mqttTriePending_t _pPending[ MQTT_SUBSCRIPTION_TRIE_NODES + 1 ];
+
+/**
+ * @brief Text of the topic filters in #_pSubscriptions.
+ */
+static char _pTopicFilters[ MAX_NO_OF_MQTT_SUBSCRIPTIONS ][ BENCHMARK_TOPIC_LENGTH ];
+
+/**
+ * @brief Topic names of the PUBLISH messages.
+ */
+static char _pTopicNames[ BENCHMARK_TOPIC_NAME_COUNT ][ BENCHMARK_TOPIC_LENGTH ];
+
+/**
+ * @brief State of the pseudo-random generator, so every run uses the same topics.
+ */
+static uint32_t _randomState = 1;
+
+/**
+ * @brief The last level of the generated topics.
+ */
+static const char * const _pMeasurements[ 4 ] = { "temp", "humidity", "co2", "light" };
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for MQTT subscription benchmarks.
+ */
+TEST_GROUP( MQTT_Benchmark_Subscription );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for MQTT subscription benchmarks.
+ */
+TEST_SETUP( MQTT_Benchmark_Subscription )
+{
+    ( void ) memset( _pSubscriptions, 0x00, sizeof( _pSubscriptions ) );
+    ( void ) memset( &_subscriptionTrie, 0x00, sizeof( _subscriptionTrie ) );
+    _randomState = 1;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for MQTT subscription benchmarks.
+ */
+TEST_TEAR_DOWN( MQTT_Benchmark_Subscription )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for MQTT subscription benchmarks.
+ */
+TEST_GROUP_RUNNER( MQTT_Benchmark_Subscription )
+{
+    RUN_TEST_CASE( MQTT_Benchmark_Subscription, TopicMatch );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return a pseudo-random number less than `limit`.
+ */
+static uint32_t _random( uint32_t limit )
+{
+    _randomState = ( _randomState * 1103515245UL ) + 12345UL;
+
+    return ( _randomState >> 16 ) % limit;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Generate a topic filter of the form "site/floor/room/measurement",
+ * where a quarter of the filters use wildcards.
+ */
+static uint16_t _generateTopicFilter( char * pTopicFilter,
+                                      uint32_t filterNumber )
+{
+    int length = 0;
+    uint32_t site = _random( 8 ), floorNumber = _random( 8 ), room = _random( 16 );
+    const char * pMeasurement = _pMeasurements[ _random( 4 ) ];
+
+    switch( filterNumber % 8U )
+    {
+        case 4:
+            length = snprintf( pTopicFilter, BENCHMARK_TOPIC_LENGTH, "s%lu/f%lu/+/%s",
+                               ( unsigned long ) site, ( unsigned long ) floorNumber, pMeasurement );
+            break;
+
+        case 5:
+            length = snprintf( pTopicFilter, BENCHMARK_TOPIC_LENGTH, "s%lu/+/r%lu/%s",
+                               ( unsigned long ) site, ( unsigned long ) room, pMeasurement );
+            break;
+
+        case 6:
+            length = snprintf( pTopicFilter, BENCHMARK_TOPIC_LENGTH, "s%lu/f%lu/#",
+                               ( unsigned long ) site, ( unsigned long ) floorNumber );
+            break;
+
+        case 7:
+            length = snprintf( pTopicFilter, BENCHMARK_TOPIC_LENGTH, "+/f%lu/r%lu/#",
+                               ( unsigned long ) floorNumber, ( unsigned long ) room );
+            break;
+
+        default:
+            length = snprintf( pTopicFilter, BENCHMARK_TOPIC_LENGTH, "s%lu/f%lu/r%lu/%s",
+                               ( unsigned long ) site, ( unsigned long ) floorNumber,
+                               ( unsigned long ) room, pMeasurement );
+            break;
+    }
+
+    return ( uint16_t ) length;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Count the subscriptions matching a topic name, in the same way that
+ * subscription callbacks are invoked.
+ */
+static uint32_t _countMatches( _topicMatchParams_t * pMatch,
+                               bool useTrie )
+{
+    uint32_t matchCount = 0;
+    int16_t index = 0;
+
+    while( index < MAX_NO_OF_MQTT_SUBSCRIPTIONS )
+    {
+        if( useTrie == true )
+        {
+            index = IotMqtt_FindFirstMatchInTrieShared( &_subscriptionTrie, _pPending, _pSubscriptions, index, pMatch );
+        }
+        else
+        {
+            index = IotMqtt_FindFirstMatch( _pSubscriptions, index, pMatch );
+        }
+
+        if( index == -1 )
+        {
+            break;
+        }
+
+        matchCount++;
+        index++;
+    }
+
+    return matchCount;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return the elapsed time since a start time, never 0.
+ */
+static uint32_t _elapsedMs( uint64_t startTime )
+{
+    uint64_t elapsedTime = IotClock_GetTimeMs() - startTime;
+
+    /* Avoid reporting zero on very fast runs. */
+    if( elapsedTime == 0ULL )
+    {
+        elapsedTime = 1ULL;
+    }
+
+    return ( uint32_t ) elapsedTime;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare the time taken to match PUBLISH topic names against a mix of
+ * exact and wildcard topic filters by scanning the subscription array and by
+ * walking the subscription trie.
+ */
+TEST( MQTT_Benchmark_Subscription, TopicMatch )
+{
+    uint32_t i = 0, scanMatches = 0, trieMatches = 0, scanTime = 0, trieTime = 0;
+    uint64_t startTime = 0;
+    _topicMatchParams_t topicMatchParams = { .exactMatchOnly = false };
+    char pOutput[ BENCHMARK_RESULT_LENGTH ] = { 0 };
+
+    /* Add the topic filters to the subscription array and trie. */
+    for( i = 0; i < BENCHMARK_FILTER_COUNT; i++ )
+    {
+        _pSubscriptions[ i ].pTopicFilter = _pTopicFilters[ i ];
+        _pSubscriptions[ i ].topicFilterLength = _generateTopicFilter( _pTopicFilters[ i ], i );
+
+        TEST_ASSERT_TRUE( IotMqtt_AddSubscriptionToTrie( &_subscriptionTrie, _pSubscriptions, ( int16_t ) i ) );
+    }
+
+    /* Generate topic names from the same hierarchy. */
+    for( i = 0; i < BENCHMARK_TOPIC_NAME_COUNT; i++ )
+    {
+        ( void ) snprintf( _pTopicNames[ i ], BENCHMARK_TOPIC_LENGTH, "s%lu/f%lu/r%lu/%s",
+                           ( unsigned long ) _random( 8 ), ( unsigned long ) _random( 8 ),
+                           ( unsigned long ) _random( 16 ), _pMeasurements[ _random( 4 ) ] );
+    }
+
+    startTime = IotClock_GetTimeMs();
+
+    for( i = 0; i < TEST_MQTT_BENCHMARK_TOPICS; i++ )
+    {
+        topicMatchParams.pTopicName = _pTopicNames[ i % BENCHMARK_TOPIC_NAME_COUNT ];
+        topicMatchParams.topicNameLength = ( uint16_t ) strlen( topicMatchParams.pTopicName );
+        scanMatches += _countMatches( &topicMatchParams, false );
+    }
+
+    scanTime = _elapsedMs( startTime );
+
+    startTime = IotClock_GetTimeMs();
+
+    for( i = 0; i < TEST_MQTT_BENCHMARK_TOPICS; i++ )
+    {
+        topicMatchParams.pTopicName = _pTopicNames[ i % BENCHMARK_TOPIC_NAME_COUNT ];
+        topicMatchParams.topicNameLength = ( uint16_t ) strlen( topicMatchParams.pTopicName );
+        trieMatches += _countMatches( &topicMatchParams, true );
+    }
+
+    trieTime = _elapsedMs( startTime );
+
+    /* Both methods must find the same subscriptions. */
+    TEST_ASSERT_EQUAL_UINT32( scanMatches, trieMatches );
+
+    snprintf( pOutput,
+              BENCHMARK_RESULT_LENGTH,
+              "%lu topic names against %lu topic filters (%lu matches): scan %lu ms, trie %lu ms.\r\n",
+              ( unsigned long ) TEST_MQTT_BENCHMARK_TOPICS,
+              ( unsigned long ) BENCHMARK_FILTER_COUNT,
+              ( unsigned long ) trieMatches,
+              ( unsigned long ) scanTime,
+              ( unsigned long ) trieTime );
+
+    UnityPrint( pOutput );
+}
+
+/*-----------------------------------------------------------*/
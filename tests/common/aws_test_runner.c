@@ -75,6 +75,19 @@ static void RunTests( void )
         RUN_TEST_GROUP( Common_Unit_Task_Pool );
     #endif
 
+    #if ( testrunnerFULL_TASKPOOL_BENCHMARK_ENABLED == 1 )
+        RUN_TEST_GROUP( Common_Benchmark_Task_Pool );
+    #endif
+
+    #if ( testrunnerFULL_LINEAR_CONTAINERS_ENABLED == 1 )
+        RUN_TEST_GROUP( Common_Unit_Indexed_Containers );
+        RUN_TEST_GROUP( Common_Benchmark_Indexed_Containers );
+    #endif
+
+    #if ( testrunnerFULL_STATIC_MEMORY_ENABLED == 1 )
+        RUN_TEST_GROUP( Common_Unit_Static_Memory );
+    #endif
+
     #if ( testrunnerFULL_WIFI_PROVISIONING_ENABLED == 1 )
         RUN_TEST_GROUP( Full_WiFi_Provisioning );
     #endif
@@ -106,6 +119,7 @@ static void RunTests( void )
     #if ( testrunnerFULL_MQTTv4_ENABLED == 1 )
         RUN_TEST_GROUP( MQTT_Unit_Validate );
         RUN_TEST_GROUP( MQTT_Unit_Subscription );
+        RUN_TEST_GROUP( MQTT_Benchmark_Subscription );
         RUN_TEST_GROUP( MQTT_Unit_Receive );
         RUN_TEST_GROUP( MQTT_Unit_API );
         RUN_TEST_GROUP( MQTT_Unit_Metrics );
@@ -151,6 +151,22 @@
 /* Require MQTT serializer overrides for the tests. */
 #define IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES    ( 1 )
 
+/* Compile the MQTT PUBLISH trace points for the tests. */
+#define IOT_MQTT_ENABLE_TRACE                   ( 1 )
+
+/* Allow several MQTT connections at once, so that the tests open more than the
+ * default of 2. Each connection takes an MQTT context with its own network
+ * buffer, so boards short on RAM may lower this. */
+#ifndef MAX_NO_OF_MQTT_CONNECTIONS
+    #define MAX_NO_OF_MQTT_CONNECTIONS          ( 8 )
+#endif
+
+/* Compile the work-stealing task pool dispatcher, so that its tests and benchmark run. */
+#define IOT_TASKPOOL_ENABLE_WORK_STEALING       ( 1 )
+
+/* Record task pool wait and run times, so that the instrumentation tests run. */
+#define IOT_TASKPOOL_ENABLE_INSTRUMENTATION     ( 1 )
+
 /* Platform and SDK name for AWS MQTT metrics. Only used when AWS_IOT_MQTT_ENABLE_METRICS is 1. */
 #define IOT_SDK_NAME                            "AmazonFreeRTOS"
 #ifdef configPLATFORM_NAME
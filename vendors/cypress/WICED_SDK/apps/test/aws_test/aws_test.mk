@@ -149,6 +149,7 @@ $(NAME)_SOURCES    := $(AMAZON_FREERTOS_PATH)vendors/cypress/boards/$(PLATFORM)/
                       $(AFR_C_SDK_STANDARD_PATH)mqtt/test/unit/iot_tests_mqtt_api.c \
                       $(AFR_C_SDK_STANDARD_PATH)mqtt/test/unit/iot_tests_mqtt_receive.c \
                       $(AFR_C_SDK_STANDARD_PATH)mqtt/test/unit/iot_tests_mqtt_subscription.c \
+                      $(AFR_C_SDK_STANDARD_PATH)mqtt/test/unit/iot_tests_mqtt_subscription_benchmark.c \
                       $(AFR_C_SDK_STANDARD_PATH)mqtt/test/unit/iot_tests_mqtt_validate.c \
                       $(AFR_C_SDK_STANDARD_PATH)mqtt/test/unit/iot_tests_mqtt_metrics.c \
                       $(AMAZON_FREERTOS_PATH)tests/integration_test/core_mqtt_system_test.c \
@@ -177,6 +178,10 @@ $(NAME)_SOURCES    := $(AMAZON_FREERTOS_PATH)vendors/cypress/boards/$(PLATFORM)/
                       $(AFR_ABSTRACTIONS_PATH)platform/test/iot_test_platform_threads.c \
                       $(AFR_C_SDK_STANDARD_PATH)common/test/iot_memory_leak.c \
                       $(AFR_C_SDK_STANDARD_PATH)common/test/iot_tests_taskpool.c \
+                      $(AFR_C_SDK_STANDARD_PATH)common/test/iot_tests_taskpool_benchmark.c \
+                      $(AFR_C_SDK_STANDARD_PATH)common/test/iot_tests_static_memory.c \
+                      $(AFR_C_SDK_STANDARD_PATH)common/test/iot_tests_indexed_containers.c \
+                      $(AFR_C_SDK_STANDARD_PATH)common/test/iot_tests_indexed_containers_benchmark.c \
                       $(AFR_C_SDK_STANDARD_PATH)serializer/src/cbor/iot_serializer_tinycbor_decoder.c \
                       $(AFR_C_SDK_STANDARD_PATH)serializer/src/cbor/iot_serializer_tinycbor_encoder.c \
                       $(AFR_C_SDK_STANDARD_PATH)serializer/src/json/iot_serializer_json_decoder.c \
@@ -128,6 +128,9 @@ $(NAME)_SOURCES :=  $(AFR_FREERTOS_PLUS_AWS_PATH)greengrass/src/aws_greengrass_d
                     $(AFR_C_SDK_STANDARD_PATH)mqtt/src/iot_mqtt_serializer_deserializer_wrapper.c                   \
                     $(AFR_C_SDK_STANDARD_PATH)mqtt/src/iot_mqtt_managed_function_wrapper.c                          \
                     $(AFR_C_SDK_STANDARD_PATH)mqtt/src/iot_mqtt_subscription_container.c                            \
+                    $(AFR_C_SDK_STANDARD_PATH)mqtt/src/iot_mqtt_trace.c                                             \
+                    $(AFR_C_SDK_STANDARD_PATH)mqtt/src/iot_mqtt_subscription_registry.c                             \
+                    $(AFR_C_SDK_STANDARD_PATH)mqtt/src/iot_mqtt_offline_queue.c                                     \
                     $(AFR_C_SDK_STANDARD_PATH)mqtt/src/iot_mqtt_mutex_wrapper.c                                     \
                     $(AFR_C_SDK_STANDARD_PATH)mqtt/src/iot_mqtt_publish_duplicates.c                                \
                     $(AFR_LIBRARIES_PATH)coreMQTT/source/core_mqtt.c                                                \
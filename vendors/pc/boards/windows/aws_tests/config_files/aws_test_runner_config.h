@@ -39,6 +39,9 @@
 
 /* Supported tests. 0 = Disabled, 1 = Enabled */
 #define testrunnerFULL_TASKPOOL_ENABLED               0
+#define testrunnerFULL_TASKPOOL_BENCHMARK_ENABLED     0
+#define testrunnerFULL_LINEAR_CONTAINERS_ENABLED      1
+#define testrunnerFULL_STATIC_MEMORY_ENABLED          0
 #define testrunnerFULL_CRYPTO_ENABLED                 0
 #define testrunnerFULL_FREERTOS_TCP_ENABLED           0
 #define testrunnerFULL_DEFENDER_ENABLED               0
@@ -28,6 +28,13 @@
 #define IOT_THREAD_DEFAULT_STACK_SIZE        2048
 #define IOT_THREAD_DEFAULT_PRIORITY          5
 
+/* The static memory tests need a build that uses static memory only. */
+#include "aws_test_runner_config.h"
+
+#if ( testrunnerFULL_STATIC_MEMORY_ENABLED == 1 )
+    #define IOT_STATIC_MEMORY_ONLY    ( 1 )
+#endif
+
 /* Include the common configuration file for FreeRTOS. */
 #include "iot_config_common.h"
 